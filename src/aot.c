@@ -0,0 +1,33 @@
+#include "aot.h"
+
+// Whether anything is attached that compiled blocks would bypass
+static inline bool instrumented(const Emulator *emu) {
+  return emu->tracer != NULL || emu->profiler != NULL ||
+         emu->callgraph != NULL || emu->stats != NULL ||
+         emu->breakpoints != NULL || emu->heatmap != NULL ||
+         emu->stack_guard != NULL;
+}
+
+void aot_step(Emulator *emu, const AotProgram *prog) {
+  if (emu->interrupts == 0 && !instrumented(emu)) {
+    const AotBlock block = prog->lookup(emu->cpu.pc);
+    if (block != NULL && block(emu)) {
+      return;
+    }
+  }
+  emu_tick(emu);
+}
+
+EmuStop aot_run(Emulator *emu, const AotProgram *prog, const u64 max_cycles) {
+  if (instrumented(emu)) {
+    return emu_run(emu, max_cycles);
+  }
+  const u64 end = emu->cycles + max_cycles;
+  while (emu->cycles < end) {
+    if (!emu->is_running) {
+      return EMU_STOP_HALT;
+    }
+    aot_step(emu, prog);
+  }
+  return emu->is_running ? EMU_STOP_LIMIT : EMU_STOP_HALT;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "calc.h"
+#include "common.h"
+#include "emu6502.h"
+
+// Running code recompiled ahead of time by `emu6502-recomp` (see `recomp.c`).
+//
+// The recompiler turns the code reachable from the entry points of a ROM
+// image into C, one function per basic block, which is compiled and linked
+// with the emulator. It provides an `AotProgram` that maps the start address
+// of each block to its function. `aot_step` runs the block at PC, or one
+// instruction through `emu_tick` where there is none: for indirect jump and
+// return targets the recompiler could not see, for BRK and for the
+// instructions the recompiler leaves to the interpreter. Interrupts are also
+// taken through `emu_tick`.
+//
+// A block first checks that its own bytes are still the ones it was compiled
+// from. If they are not (the code was modified, or something else was loaded
+// there), the block returns false without running and the interpreter runs
+// instead. A store that overwrites the rest of its own block stops the block
+// right after it. Blocks keep the cycle count exact, page crosses and taken
+// branches included, but do not update the tracer, profiler, call graph,
+// statistics, heatmap, stack guard or breakpoints, so `aot_step` interprets
+// everything while any of them is attached.
+//
+// Generated code works on the flat `Emulator.mem`, so it cannot be used in
+// `EMU_BANKING` builds. It must be built for the CPU variant the recompiler
+// was built for.
+
+#ifdef EMU_BANKING
+#error "recompiled code needs the flat memory of builds without EMU_BANKING"
+#endif
+
+// Run a block, returns false without doing anything if its code changed
+typedef bool (*AotBlock)(Emulator *emu);
+
+typedef struct AotProgram {
+  const char *cpu; // `CPU_NAME` of the recompiler
+  // the block starting at `pc`, NULL if there is none
+  AotBlock (*lookup)(u16 pc);
+} AotProgram;
+
+// Run the block at PC, or one instruction (one fused sequence if `fusion` is
+// enabled) through `emu_tick`
+void aot_step(Emulator *emu, const AotProgram *prog);
+
+// `emu_run` through `aot_step`
+// With breakpoints or other instrumentation attached this is `emu_run`
+EmuStop aot_run(Emulator *emu, const AotProgram *prog, u64 max_cycles);
+
+// Helpers for generated code, the same operations as in `emu6502.c` on the
+// flat memory and without instrumentation
+
+static inline void aot_nz(Emulator *emu, const u8 x) {
+  emu->cpu.sr.bits.z = (x == 0);
+  emu->cpu.sr.bits.n = (x & 0x80) >> 7;
+}
+
+// a pointer in the zero page, wrapping around within it
+static inline u16 aot_zp_word(const Emulator *emu, const u8 addr) {
+  return (u16)(emu->mem[addr] | emu->mem[(u8)(addr + 1)] << 8);
+}
+
+// 1 if indexing `base` to `addr` crossed a page
+static inline u64 aot_cross(const u16 base, const u16 addr) {
+  return ((base ^ addr) & 0xFF00) != 0;
+}
+
+static inline void aot_set_adc_result(Emulator *emu,
+                                      const struct adc_result r) {
+  emu->cpu.a = r.result;
+  emu->cpu.sr.bits.c = r.carry;
+  emu->cpu.sr.bits.v = r.overflow;
+  emu->cpu.sr.bits.n = r.negative;
+  emu->cpu.sr.bits.z = r.zero;
+}
+
+static inline void aot_adc(Emulator *emu, const u8 m) {
+  const CPU *cpu = &emu->cpu;
+  if (cpu->sr.bits.d) {
+#ifdef EMU_CPU_65C02
+    emu->cycles++;
+#endif
+    aot_set_adc_result(emu, carrying_bcd_add_u8(cpu->a, m, cpu->sr.bits.c));
+  } else {
+    aot_set_adc_result(emu, carrying_add_u8(cpu->a, m, cpu->sr.bits.c));
+  }
+}
+
+static inline void aot_sbc(Emulator *emu, const u8 m) {
+  const CPU *cpu = &emu->cpu;
+  if (cpu->sr.bits.d) {
+#ifdef EMU_CPU_65C02
+    emu->cycles++;
+#endif
+    aot_set_adc_result(emu, carrying_bcd_sub_u8(cpu->a, m, cpu->sr.bits.c));
+  } else {
+    aot_set_adc_result(emu, carrying_add_u8(cpu->a, (u8)~m, cpu->sr.bits.c));
+  }
+}
+
+static inline void aot_cmp(Emulator *emu, const u8 reg, const u8 m) {
+  aot_nz(emu, (u8)(reg - m));
+  emu->cpu.sr.bits.c = (reg >= m);
+}
+
+static inline void aot_bit(Emulator *emu, const u8 m) {
+  emu->cpu.sr.bits.n = (m & 0x80) >> 7;
+  emu->cpu.sr.bits.v = (m & 0x40) >> 6;
+  emu->cpu.sr.bits.z = ((m & emu->cpu.a) == 0);
+}
+
+static inline u8 aot_asl(Emulator *emu, const u8 x) {
+  emu->cpu.sr.bits.c = (x & 0x80) != 0;
+  const u8 result = (u8)(x << 1);
+  aot_nz(emu, result);
+  return result;
+}
+
+static inline u8 aot_lsr(Emulator *emu, const u8 x) {
+  emu->cpu.sr.bits.c = (x & 0x01) != 0;
+  const u8 result = x >> 1;
+  aot_nz(emu, result);
+  return result;
+}
+
+static inline u8 aot_rol(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x << 1) | emu->cpu.sr.bits.c;
+  emu->cpu.sr.bits.c = (x & 0x80) != 0;
+  aot_nz(emu, result);
+  return result;
+}
+
+static inline u8 aot_ror(Emulator *emu, const u8 x) {
+  const u8 result = (x >> 1) | (u8)(emu->cpu.sr.bits.c << 7);
+  emu->cpu.sr.bits.c = (x & 0x01) != 0;
+  aot_nz(emu, result);
+  return result;
+}
+
+static inline u8 aot_inc(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x + 1);
+  aot_nz(emu, result);
+  return result;
+}
+
+static inline u8 aot_dec(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x - 1);
+  aot_nz(emu, result);
+  return result;
+}
+
+static inline void aot_push(Emulator *emu, const u8 byte) {
+  emu->mem[0x0100 | emu->cpu.sp] = byte;
+  emu->cpu.sp--;
+}
+
+static inline u8 aot_pull(Emulator *emu) {
+  emu->cpu.sp++;
+  return emu->mem[0x0100 | emu->cpu.sp];
+}
+
+// SR pulled by PLP and RTI, B and the unused bit are not real flags
+static inline void aot_pull_sr(Emulator *emu) {
+  emu->cpu.sr.byte = (u8)((aot_pull(emu) & ~SR_B) | SR_UNUSED);
+}
+
+// End a block with a conditional branch from `next` to `target`
+static inline void aot_branch(Emulator *emu, const bool taken, const u16 next,
+                              const u16 target) {
+  if (taken) {
+    emu->cycles += ((next ^ target) & 0xFF00) ? 2 : 1;
+    emu->cpu.pc = target;
+  } else {
+    emu->cpu.pc = next;
+  }
+}
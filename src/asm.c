@@ -0,0 +1,56 @@
+#include "assembler.h"
+#include "common.h"
+
+// Assembles a source file into a binary image holding everything from the
+// lowest to the highest address the source wrote.
+// With `--prg` the image starts with its 2-byte load address, like a Commodore
+// program file.
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--prg] SOURCE OUTPUT\n", name);
+}
+
+i32 main(i32 argc, char *argv[]) {
+  const char *paths[2] = {NULL, NULL};
+  usize n_paths = 0;
+  bool prg = false;
+
+  for (i32 i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--prg") == 0) {
+      prg = true;
+    } else if (n_paths < 2 && argv[i][0] != '-') {
+      paths[n_paths++] = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 1;
+    }
+  }
+  if (n_paths != 2) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  static Assembler assembler;
+  static u8 mem[MEM_SIZE];
+  asm_init(&assembler);
+  if (!asm_assemble_file(&assembler, paths[0], mem)) {
+    return 1;
+  }
+
+  FILE *file = fopen(paths[1], "wb");
+  if (file == NULL) {
+    printf("cannot create %s\n", paths[1]);
+    return 1;
+  }
+  const u8 load_addr[2] = {(u8)assembler.lo, (u8)(assembler.lo >> 8)};
+  const usize size = assembler.hi - assembler.lo;
+  bool ok = !prg || fwrite(load_addr, 1, 2, file) == 2;
+  ok = ok && fwrite(&mem[assembler.lo], 1, size, file) == size;
+  ok = (fclose(file) == 0) && ok;
+  if (!ok) {
+    printf("cannot write %s\n", paths[1]);
+    return 1;
+  }
+  printf("$%04X-$%04X (%zu bytes)\n", assembler.lo, assembler.hi, size);
+  return 0;
+}
@@ -0,0 +1,854 @@
+#include "assembler.h"
+#include "opcode.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+
+#define N_MODES (ADDR_IAX + 1)
+#define MAX_MNEMONICS 80
+#define MAX_SYMBOLS (ASM_SYMBOL_SLOTS / 4 * 3)
+
+// opcodes by mnemonic and addressing mode, -1 where there is none
+static i16 opcodes[MAX_MNEMONICS][N_MODES];
+// 1 + index into `opcodes` by the 3 letters of a mnemonic packed into 15 bits,
+// 0 if they are not a mnemonic
+static u8 mnemonics[1 << 15];
+static u8 n_mnemonics = 0;
+static bool tables_built = false;
+
+// Returns -1 if `name` is not 3 letters
+static i32 pack_mnemonic(const char *name) {
+  i32 key = 0;
+  for (usize i = 0; i < 3; i++) {
+    const i32 c = toupper((u8)name[i]);
+    if (c < 'A' || c > 'Z') {
+      return -1;
+    }
+    key = (key << 5) | (c - 'A');
+  }
+  return key;
+}
+
+static void add_opcode(const u8 op) {
+  const OpcodeInfo *info = &opcode_table[op];
+  const i32 key = pack_mnemonic(info->mnemonic);
+  if (mnemonics[key] == 0) {
+    mnemonics[key] = ++n_mnemonics;
+  }
+  i16 *slot = &opcodes[mnemonics[key] - 1][info->mode];
+  // the first opcode in list order wins, so the documented NOP and SBC #imm
+  // are used rather than their undocumented duplicates
+  if (*slot < 0) {
+    *slot = op;
+  }
+}
+
+static void build_tables(void) {
+  if (tables_built) {
+    return;
+  }
+  memset(opcodes, 0xFF, sizeof(opcodes));
+#define ADD_OPCODE(NAME, OPCODE, MNEMONIC, MODE, CYCLES) add_opcode(OPCODE);
+  OPCODE_VARIANT_LIST(ADD_OPCODE)
+#undef ADD_OPCODE
+  tables_built = true;
+}
+
+typedef struct Parser {
+  Assembler *as;
+  const char *p;
+  const char *end;
+  u8 *mem;
+  u32 line;
+  u32 pc;        // location counter, may reach 0x10000 after the last byte
+  u32 n_defined; // symbols defined so far in this pass
+  u32 scope;     // 1 + slot of the last label not starting with `@`
+  bool pass2;
+} Parser;
+
+typedef struct Value {
+  i32 value;
+  // depends on a symbol that was not defined yet at this point of the first
+  // pass, so the first pass could not know its value
+  bool forward;
+} Value;
+
+static bool fail(Parser *ps, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(ps->as->error, ASM_ERROR_SIZE, fmt, args);
+  va_end(args);
+  ps->as->error_line = ps->line;
+  return false;
+}
+
+// the end of the source reads as a newline
+static inline char peek(const Parser *ps) {
+  return (ps->p < ps->end) ? *ps->p : '\n';
+}
+
+static inline char peek_next(const Parser *ps) {
+  return (ps->p + 1 < ps->end) ? ps->p[1] : '\n';
+}
+
+static inline void skip_spaces(Parser *ps) {
+  while (ps->p < ps->end && (*ps->p == ' ' || *ps->p == '\t' || *ps->p == '\r')) {
+    ps->p++;
+  }
+}
+
+static inline bool is_ident_start(const char c) {
+  return isalpha((u8)c) || c == '_' || c == '@';
+}
+
+static inline bool is_ident_char(const char c) {
+  return isalnum((u8)c) || c == '_';
+}
+
+// Skip an identifier, returning its length
+static u32 ident_length(Parser *ps) {
+  const char *start = ps->p;
+  ps->p++;
+  while (is_ident_char(peek(ps))) {
+    ps->p++;
+  }
+  return (u32)(ps->p - start);
+}
+
+// Consume `word` (case insensitive) if it is next and is a whole word
+static bool accept_word(Parser *ps, const char *word) {
+  const usize len = strlen(word);
+  if ((usize)(ps->end - ps->p) < len || strncasecmp(ps->p, word, len) != 0) {
+    return false;
+  }
+  if (ps->p + len < ps->end && is_ident_char(ps->p[len])) {
+    return false;
+  }
+  ps->p += len;
+  return true;
+}
+
+static u32 hash_name(const char *name, const u32 len, const u32 scope) {
+  u32 h = 2166136261u ^ (scope * 2654435761u);
+  for (u32 i = 0; i < len; i++) {
+    h = (h ^ (u8)name[i]) * 16777619u;
+  }
+  return h;
+}
+
+// Find a symbol, or add it if `create` is set
+// Returns NULL if there is no such symbol or the table is full
+static AsmSymbol *lookup(Assembler *as, const char *name, const u32 len,
+                         const u32 scope, const bool create) {
+  const u32 mask = ASM_SYMBOL_SLOTS - 1;
+  for (u32 i = hash_name(name, len, scope) & mask;; i = (i + 1) & mask) {
+    AsmSymbol *sym = &as->symbols[i];
+    if (sym->generation != as->generation) {
+      if (!create || as->n_symbols == MAX_SYMBOLS) {
+        return NULL;
+      }
+      memset(sym, 0, sizeof(AsmSymbol));
+      sym->name = name;
+      sym->len = len;
+      sym->generation = as->generation;
+      sym->scope = scope;
+      as->n_symbols++;
+      return sym;
+    }
+    if (sym->len == len && sym->scope == scope &&
+        memcmp(sym->name, name, len) == 0) {
+      return sym;
+    }
+  }
+}
+
+static bool define(Parser *ps, const char *name, const u32 len, const Value v,
+                   const bool is_label) {
+  const u32 scope = (name[0] == '@') ? ps->scope : 0;
+  AsmSymbol *sym = lookup(ps->as, name, len, scope, true);
+  if (sym == NULL) {
+    return fail(ps, "too many symbols");
+  }
+  if (!ps->pass2) {
+    if (sym->defined) {
+      return fail(ps, "%.*s is already defined", (i32)len, name);
+    }
+    sym->defined = true;
+    sym->order = ps->n_defined;
+    sym->forward = v.forward;
+  }
+  sym->value = v.value;
+  ps->n_defined++;
+  if (is_label && name[0] != '@') {
+    ps->scope = (u32)(sym - ps->as->symbols) + 1;
+  }
+  return true;
+}
+
+static bool expr(Parser *ps, Value *out);
+
+static bool number(Parser *ps, const u32 base, Value *out) {
+  u32 x = 0;
+  const char *start = ps->p;
+  while (true) {
+    const char c = (char)tolower((u8)peek(ps));
+    u32 digit;
+    if (c >= '0' && c <= '9') {
+      digit = (u32)(c - '0');
+    } else if (c >= 'a' && c <= 'f') {
+      digit = (u32)(c - 'a' + 10);
+    } else {
+      break;
+    }
+    if (digit >= base) {
+      break;
+    }
+    x = x * base + digit;
+    ps->p++;
+  }
+  if (ps->p == start) {
+    return fail(ps, "expected a number");
+  }
+  *out = (Value){(i32)x, false};
+  return true;
+}
+
+static bool symbol(Parser *ps, Value *out) {
+  const char *name = ps->p;
+  const u32 len = ident_length(ps);
+  const u32 scope = (name[0] == '@') ? ps->scope : 0;
+  const AsmSymbol *sym = lookup(ps->as, name, len, scope, false);
+  if (sym == NULL || !sym->defined) {
+    if (ps->pass2) {
+      return fail(ps, "undefined symbol %.*s", (i32)len, name);
+    }
+    *out = (Value){0, true};
+    return true;
+  }
+  out->value = sym->value;
+  out->forward = sym->forward || sym->order >= ps->n_defined;
+  return true;
+}
+
+static bool unary(Parser *ps, Value *out) {
+  skip_spaces(ps);
+  const char c = peek(ps);
+  if (c == '-' || c == '~' || c == '<' || c == '>') {
+    ps->p++;
+    if (!unary(ps, out)) {
+      return false;
+    }
+    if (c == '-') {
+      out->value = -out->value;
+    } else if (c == '~') {
+      out->value = ~out->value;
+    } else if (c == '<') {
+      out->value &= 0xFF;
+    } else {
+      out->value = (out->value >> 8) & 0xFF;
+    }
+    return true;
+  }
+  if (c == '(' || c == '[') {
+    ps->p++;
+    if (!expr(ps, out)) {
+      return false;
+    }
+    skip_spaces(ps);
+    if (peek(ps) != ((c == '(') ? ')' : ']')) {
+      return fail(ps, "expected %c", (c == '(') ? ')' : ']');
+    }
+    ps->p++;
+    return true;
+  }
+  if (c == '*') {
+    ps->p++;
+    *out = (Value){(i32)ps->pc, false};
+    return true;
+  }
+  if (c == '\'') {
+    if (ps->end - ps->p < 3 || ps->p[2] != '\'') {
+      return fail(ps, "invalid character literal");
+    }
+    *out = (Value){(u8)ps->p[1], false};
+    ps->p += 3;
+    return true;
+  }
+  if (c == '$') {
+    ps->p++;
+    return number(ps, 16, out);
+  }
+  if (c == '%') {
+    ps->p++;
+    return number(ps, 2, out);
+  }
+  if (c == '0' && (peek_next(ps) == 'x' || peek_next(ps) == 'X')) {
+    ps->p += 2;
+    return number(ps, 16, out);
+  }
+  if (isdigit((u8)c)) {
+    return number(ps, 10, out);
+  }
+  if (is_ident_start(c)) {
+    return symbol(ps, out);
+  }
+  return fail(ps, "expected an expression");
+}
+
+// Returns the precedence of the binary operator at the current position, or 0
+// `<<` and `>>` are returned as `l` and `r`
+static i32 peek_operator(const Parser *ps, char *op) {
+  *op = peek(ps);
+  switch (*op) {
+  case '|':
+    return 1;
+  case '^':
+    return 2;
+  case '&':
+    return 3;
+  case '<':
+  case '>':
+    if (peek_next(ps) != *op) {
+      return 0;
+    }
+    *op = (*op == '<') ? 'l' : 'r';
+    return 4;
+  case '+':
+  case '-':
+    return 5;
+  case '*':
+  case '/':
+  case '%':
+    return 6;
+  }
+  return 0;
+}
+
+static bool binary(Parser *ps, const i32 min_prec, Value *out) {
+  if (!unary(ps, out)) {
+    return false;
+  }
+  while (true) {
+    skip_spaces(ps);
+    char op;
+    const i32 prec = peek_operator(ps, &op);
+    if (prec == 0 || prec < min_prec) {
+      return true;
+    }
+    ps->p += (op == 'l' || op == 'r') ? 2 : 1;
+    Value rhs;
+    if (!binary(ps, prec + 1, &rhs)) {
+      return false;
+    }
+    const i32 l = out->value;
+    const i32 r = rhs.value;
+    out->forward |= rhs.forward;
+    if ((op == '/' || op == '%') && r == 0) {
+      if (!out->forward) {
+        return fail(ps, "division by zero");
+      }
+      out->value = 0;
+      continue;
+    }
+    switch (op) {
+    case '|':
+      out->value = l | r;
+      break;
+    case '^':
+      out->value = l ^ r;
+      break;
+    case '&':
+      out->value = l & r;
+      break;
+    case 'l':
+      out->value = (i32)((u32)l << (r & 31));
+      break;
+    case 'r':
+      out->value = l >> (r & 31);
+      break;
+    case '+':
+      out->value = l + r;
+      break;
+    case '-':
+      out->value = l - r;
+      break;
+    case '*':
+      out->value = l * r;
+      break;
+    case '/':
+      out->value = l / r;
+      break;
+    case '%':
+      out->value = l % r;
+      break;
+    }
+  }
+}
+
+static bool expr(Parser *ps, Value *out) { return binary(ps, 1, out); }
+
+// An expression that must be known in the first pass, e.g. for `.org`
+static bool known_expr(Parser *ps, Value *out, const char *what) {
+  if (!expr(ps, out)) {
+    return false;
+  }
+  if (out->forward) {
+    return fail(ps, "%s must not use symbols defined after it", what);
+  }
+  return true;
+}
+
+static bool emit(Parser *ps, const u8 *bytes, const u32 n) {
+  if (ps->pc + n > MEM_SIZE) {
+    return fail(ps, "code goes past $FFFF");
+  }
+  if (ps->pass2) {
+    memcpy(&ps->mem[ps->pc], bytes, n);
+    ps->as->lo = (ps->pc < ps->as->lo) ? ps->pc : ps->as->lo;
+    ps->as->hi = (ps->pc + n > ps->as->hi) ? ps->pc + n : ps->as->hi;
+  }
+  ps->pc += n;
+  return true;
+}
+
+static bool emit_byte(Parser *ps, const Value v) {
+  if (ps->pass2 && (v.value < -128 || v.value > 0xFF)) {
+    return fail(ps, "$%X does not fit in a byte", v.value);
+  }
+  const u8 byte = (u8)v.value;
+  return emit(ps, &byte, 1);
+}
+
+static bool emit_word(Parser *ps, const Value v) {
+  if (ps->pass2 && (v.value < -32768 || v.value > 0xFFFF)) {
+    return fail(ps, "$%X does not fit in a word", v.value);
+  }
+  const u8 bytes[2] = {(u8)v.value, (u8)(v.value >> 8)};
+  return emit(ps, bytes, 2);
+}
+
+// Consume `,X` or `,Y` if it is next
+// Returns the index register or 0 if there is none
+static char index_register(Parser *ps) {
+  skip_spaces(ps);
+  if (peek(ps) != ',') {
+    return 0;
+  }
+  const char *save = ps->p;
+  ps->p++;
+  skip_spaces(ps);
+  if (accept_word(ps, "x")) {
+    return 'X';
+  }
+  if (accept_word(ps, "y")) {
+    return 'Y';
+  }
+  ps->p = save;
+  return 0;
+}
+
+static bool at_statement_end(Parser *ps) {
+  skip_spaces(ps);
+  return peek(ps) == '\n' || peek(ps) == ';';
+}
+
+// Parse an indirect operand, `(zp,X)`, `(zp),Y` or `(abs)`, which the caller
+// turns into `(abs,X)` or `(zp)` for the 65C02 instructions that have those
+// Returns false without an error if the parentheses turn out to be part of an
+// expression such as `(1 + 2) * 3`
+static bool indirect(Parser *ps, Value *v, AddrMode *mode, bool *failed) {
+  const char *save = ps->p;
+  ps->p++;
+  if (!expr(ps, v)) {
+    *failed = true;
+    return false;
+  }
+  skip_spaces(ps);
+  if (peek(ps) == ',') {
+    if (index_register(ps) != 'X') {
+      *failed = true;
+      return fail(ps, "expected (zp,X)");
+    }
+    skip_spaces(ps);
+    if (peek(ps) != ')') {
+      *failed = true;
+      return fail(ps, "expected )");
+    }
+    ps->p++;
+    *mode = ADDR_INDX;
+    return true;
+  }
+  if (peek(ps) == ')') {
+    ps->p++;
+    const char index = index_register(ps);
+    if (index == 'Y') {
+      *mode = ADDR_INDY;
+      return true;
+    }
+    if (index == 0 && at_statement_end(ps)) {
+      *mode = ADDR_IND;
+      return true;
+    }
+  }
+  ps->p = save;
+  return false;
+}
+
+static bool instruction(Parser *ps, const u8 mnemonic, const char *name) {
+  const i16 *ops = opcodes[mnemonic];
+  Value v = {0, false};
+  AddrMode mode = ADDR_IMPL;
+  skip_spaces(ps);
+  const char c = peek(ps);
+  bool failed = false;
+  if (at_statement_end(ps)) {
+    mode = (ops[ADDR_A] >= 0) ? ADDR_A : ADDR_IMPL;
+  } else if (ops[ADDR_A] >= 0 && accept_word(ps, "a")) {
+    mode = ADDR_A;
+  } else if (c == '#') {
+    ps->p++;
+    if (!expr(ps, &v)) {
+      return false;
+    }
+    mode = ADDR_IM;
+  } else if (c == '(' && indirect(ps, &v, &mode, &failed)) {
+    // `mode` is one of the indirect modes
+  } else if (failed) {
+    return false;
+  } else {
+    if (!expr(ps, &v)) {
+      return false;
+    }
+    const char index = index_register(ps);
+    if (ops[ADDR_REL] >= 0) {
+      mode = ADDR_REL;
+    } else {
+      const AddrMode zp =
+          (index == 0) ? ADDR_ZP : (index == 'X') ? ADDR_ZPX : ADDR_ZPY;
+      const AddrMode abs =
+          (index == 0) ? ADDR_ABS : (index == 'X') ? ADDR_ABSX : ADDR_ABSY;
+      const bool fits = !v.forward && v.value >= 0 && v.value <= 0xFF;
+      // only use zero page if both passes can tell the operand fits
+      mode = ((fits && ops[zp] >= 0) || ops[abs] < 0) ? zp : abs;
+    }
+  }
+  // the 65C02's `(zp)` and `(abs,X)` are written like `(abs)` and `(zp,X)`
+  if (mode == ADDR_IND && ops[ADDR_IND] < 0) {
+    mode = ADDR_ZPI;
+  } else if (mode == ADDR_INDX && ops[ADDR_INDX] < 0) {
+    mode = ADDR_IAX;
+  }
+  if (ops[mode] < 0) {
+    return fail(ps, "%.3s does not support this addressing mode", name);
+  }
+
+  const u8 opcode = (u8)ops[mode];
+  const u8 length = opcode_table[opcode].length;
+  if (!emit(ps, &opcode, 1)) {
+    return false;
+  }
+  if (mode == ADDR_REL) {
+    // relative to the next instruction
+    const i32 offset = v.value - (i32)(ps->pc + 1);
+    if (ps->pass2 && (offset < -128 || offset > 127)) {
+      return fail(ps, "branch target is %d bytes away", offset);
+    }
+    return emit_byte(ps, (Value){offset, false});
+  }
+  if (ps->pass2 && mode != ADDR_IM && length == 2 &&
+      (v.value < 0 || v.value > 0xFF)) {
+    return fail(ps, "$%X is not a zero page address", v.value);
+  }
+  if (length == 2) {
+    return emit_byte(ps, v);
+  }
+  if (length == 3) {
+    return emit_word(ps, v);
+  }
+  return true;
+}
+
+// `.byte` and friends: a list of expressions and strings
+static bool byte_list(Parser *ps) {
+  do {
+    skip_spaces(ps);
+    if (peek(ps) == '"') {
+      ps->p++;
+      while (peek(ps) != '"') {
+        if (peek(ps) == '\n') {
+          return fail(ps, "unterminated string");
+        }
+        u8 c = (u8)*ps->p++;
+        if (c == '\\') {
+          const char e = peek(ps);
+          ps->p++;
+          c = (e == 'n') ? '\n' : (e == 't') ? '\t' : (e == '0') ? 0 : (u8)e;
+        }
+        if (!emit(ps, &c, 1)) {
+          return false;
+        }
+      }
+      ps->p++;
+    } else {
+      Value v;
+      if (!expr(ps, &v) || !emit_byte(ps, v)) {
+        return false;
+      }
+    }
+    skip_spaces(ps);
+  } while (peek(ps) == ',' && ps->p++);
+  return true;
+}
+
+static bool word_list(Parser *ps) {
+  do {
+    Value v;
+    if (!expr(ps, &v) || !emit_word(ps, v)) {
+      return false;
+    }
+    skip_spaces(ps);
+  } while (peek(ps) == ',' && ps->p++);
+  return true;
+}
+
+static bool fill(Parser *ps, const u32 count, const u8 value) {
+  if (ps->pc + count > MEM_SIZE) {
+    return fail(ps, "code goes past $FFFF");
+  }
+  if (ps->pass2 && count != 0) {
+    memset(&ps->mem[ps->pc], value, count);
+    ps->as->lo = (ps->pc < ps->as->lo) ? ps->pc : ps->as->lo;
+    ps->as->hi = (ps->pc + count > ps->as->hi) ? ps->pc + count : ps->as->hi;
+  }
+  ps->pc += count;
+  return true;
+}
+
+static bool org(Parser *ps) {
+  Value v;
+  if (!known_expr(ps, &v, ".org")) {
+    return false;
+  }
+  if (v.value < 0 || v.value > 0xFFFF) {
+    return fail(ps, "invalid address $%X", v.value);
+  }
+  ps->pc = (u32)v.value;
+  return true;
+}
+
+static bool directive(Parser *ps) {
+  ps->p++;
+  if (accept_word(ps, "org")) {
+    return org(ps);
+  }
+  if (accept_word(ps, "byte") || accept_word(ps, "db") ||
+      accept_word(ps, "text") || accept_word(ps, "ascii")) {
+    return byte_list(ps);
+  }
+  if (accept_word(ps, "word") || accept_word(ps, "dw")) {
+    return word_list(ps);
+  }
+  if (accept_word(ps, "fill") || accept_word(ps, "res")) {
+    Value count;
+    Value value = {0, false};
+    if (!known_expr(ps, &count, ".fill")) {
+      return false;
+    }
+    skip_spaces(ps);
+    if (peek(ps) == ',') {
+      ps->p++;
+      if (!expr(ps, &value)) {
+        return false;
+      }
+    }
+    if (count.value < 0 || count.value > MEM_SIZE) {
+      return fail(ps, "invalid count %d", count.value);
+    }
+    return fill(ps, (u32)count.value, (u8)value.value);
+  }
+  if (accept_word(ps, "align")) {
+    Value align;
+    if (!known_expr(ps, &align, ".align")) {
+      return false;
+    }
+    if (align.value <= 0 || align.value > MEM_SIZE) {
+      return fail(ps, "invalid alignment %d", align.value);
+    }
+    const u32 a = (u32)align.value;
+    return fill(ps, (a - ps->pc % a) % a, 0);
+  }
+  const char *name = ps->p;
+  while (is_ident_char(peek(ps))) {
+    ps->p++;
+  }
+  return fail(ps, "unknown directive .%.*s", (i32)(ps->p - name), name);
+}
+
+// Skip the comment and newline ending a statement
+static bool end_statement(Parser *ps) {
+  skip_spaces(ps);
+  if (peek(ps) == ';') {
+    while (peek(ps) != '\n') {
+      ps->p++;
+    }
+  }
+  if (peek(ps) != '\n') {
+    return fail(ps, "unexpected '%c'", peek(ps));
+  }
+  ps->p++;
+  ps->line++;
+  return true;
+}
+
+// Returns 1 + the mnemonic index of an identifier, or 0
+static u8 find_mnemonic(const char *name, const u32 len) {
+  if (len != 3) {
+    return 0;
+  }
+  const i32 key = pack_mnemonic(name);
+  return (key < 0) ? 0 : mnemonics[key];
+}
+
+static bool statement(Parser *ps) {
+  const bool first_column = is_ident_start(peek(ps));
+  skip_spaces(ps);
+  if (is_ident_start(peek(ps))) {
+    const char *name = ps->p;
+    const u32 len = ident_length(ps);
+    const u8 mnemonic = find_mnemonic(name, len);
+    skip_spaces(ps);
+    const char *after = ps->p;
+    if (peek(ps) == '=' ||
+        (peek(ps) == '.' && (ps->p++, accept_word(ps, "equ") ||
+                                          accept_word(ps, "set")))) {
+      if (peek(ps) == '=') {
+        ps->p++;
+      }
+      Value v;
+      if (!expr(ps, &v) || !define(ps, name, len, v, false)) {
+        return false;
+      }
+      return end_statement(ps);
+    }
+    ps->p = after;
+    const Value pc = {(i32)ps->pc, false};
+    if (peek(ps) == ':') {
+      ps->p++;
+      if (!define(ps, name, len, pc, true)) {
+        return false;
+      }
+    } else if (mnemonic != 0) {
+      if (!instruction(ps, mnemonic - 1, name)) {
+        return false;
+      }
+      return end_statement(ps);
+    } else if (first_column) {
+      if (!define(ps, name, len, pc, true)) {
+        return false;
+      }
+    } else {
+      return fail(ps, "unknown instruction %.*s", (i32)len, name);
+    }
+    // a label may be followed by an instruction or a directive
+    skip_spaces(ps);
+    if (is_ident_start(peek(ps))) {
+      const char *op = ps->p;
+      const u32 op_len = ident_length(ps);
+      const u8 op_mnemonic = find_mnemonic(op, op_len);
+      if (op_mnemonic == 0) {
+        return fail(ps, "unknown instruction %.*s", (i32)op_len, op);
+      }
+      if (!instruction(ps, op_mnemonic - 1, op)) {
+        return false;
+      }
+      return end_statement(ps);
+    }
+  }
+  if (peek(ps) == '.') {
+    if (!directive(ps)) {
+      return false;
+    }
+  } else if (peek(ps) == '*') {
+    ps->p++;
+    skip_spaces(ps);
+    if (peek(ps) != '=') {
+      return fail(ps, "expected *= address");
+    }
+    ps->p++;
+    if (!org(ps)) {
+      return false;
+    }
+  }
+  return end_statement(ps);
+}
+
+void asm_init(Assembler *as) { memset(as, 0, sizeof(Assembler)); }
+
+bool asm_assemble(Assembler *as, const char *src, const usize len, u8 *mem) {
+  build_tables();
+  // forget the symbols of the previous run
+  if (++as->generation == 0) {
+    memset(as->symbols, 0, sizeof(as->symbols));
+    as->generation = 1;
+  }
+  as->n_symbols = 0;
+  as->error[0] = '\0';
+  as->error_line = 0;
+  as->lo = MEM_SIZE;
+  as->hi = 0;
+
+  Parser ps = {as, src, src + len, mem, 1, 0, 0, 0, false};
+  for (usize pass = 0; pass < 2; pass++) {
+    ps.p = src;
+    ps.line = 1;
+    ps.pc = 0;
+    ps.n_defined = 0;
+    ps.scope = 0;
+    ps.pass2 = (pass == 1);
+    while (ps.p < ps.end) {
+      if (!statement(&ps)) {
+        return false;
+      }
+    }
+  }
+  if (as->lo > as->hi) {
+    as->lo = 0;
+    as->hi = 0;
+  }
+  return true;
+}
+
+bool asm_assemble_file(Assembler *as, const char *path, u8 *mem) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    printf("cannot open %s\n", path);
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  const long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *src = malloc((usize)size + 1);
+  if (src == NULL || fread(src, 1, (usize)size, file) != (usize)size) {
+    printf("cannot read %s\n", path);
+    free(src);
+    fclose(file);
+    return false;
+  }
+  fclose(file);
+  const bool ok = asm_assemble(as, src, (usize)size, mem);
+  if (!ok) {
+    printf("%s:%u: %s\n", path, as->error_line, as->error);
+  }
+  free(src);
+  return ok;
+}
+
+bool asm_symbol(const Assembler *as, const char *name, u16 *value) {
+  const AsmSymbol *sym =
+      lookup((Assembler *)as, name, (u32)strlen(name), 0, false);
+  if (sym == NULL || !sym->defined) {
+    return false;
+  }
+  *value = (u16)sym->value;
+  return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Two-pass 6502 assembler.
+//
+// Syntax:
+//   label:                  labels end with `:` or start in the first column
+//   @loop:                  labels starting with `@` are local to the label
+//                           before them
+//   NAME = expr             constants (also `NAME .equ expr`)
+//   lda #<table, ldx $12,y  all addressing modes, `A` or nothing for the
+//   jmp (vector), sta (p),y accumulator, zero page is picked when the operand
+//                           is known to fit by the time it is used
+//   .org expr, *= expr      set the location counter
+//   .byte 1, "text", 'c'    bytes and strings (also `.db`, `.text`)
+//   .word label, $1234      little endian words (also `.dw`)
+//   .fill count[, value]    repeated bytes (also `.res`)
+//   .align n                pad with zeros to a multiple of `n`
+//   ; comment
+//
+// Numbers are decimal, `$hex`, `0xhex`, `%binary` or `'c'`. Expressions have
+// C precedence with `+ - * / % & | ^ << >> ~` and unary `<` (low byte) and `>`
+// (high byte); `*` on its own is the location counter. Use `[ ]` for grouping
+// where `( )` would read as indirect addressing.
+//
+// The source is parsed in place without copying or allocating: symbols are
+// kept in an open addressing table that is recycled between runs by bumping a
+// generation counter, so assembling many small programs in a row costs nothing
+// beyond parsing them.
+
+#define ASM_SYMBOL_SLOTS 8192 // must be a power of two
+#define ASM_ERROR_SIZE 128
+
+typedef struct AsmSymbol {
+  const char *name; // points into the source
+  u32 len;
+  u32 generation; // the slot is free unless this is the current generation
+  u32 scope;      // 1 + slot of the enclosing label for `@` labels, else 0
+  u32 order;      // how many symbols were defined before this one
+  i32 value;
+  bool defined;
+  bool forward; // a constant whose value used symbols defined after it
+} AsmSymbol;
+
+typedef struct Assembler {
+  AsmSymbol symbols[ASM_SYMBOL_SLOTS];
+  u32 generation;
+  usize n_symbols;
+  // the range of addresses written by the last successful run, `lo == hi` if
+  // it wrote nothing
+  u32 lo;
+  u32 hi; // exclusive
+  // where the last failed run stopped
+  u32 error_line;
+  char error[ASM_ERROR_SIZE];
+} Assembler;
+
+void asm_init(Assembler *as);
+
+// Assemble `len` bytes of `src` into `mem`, which must be `MEM_SIZE` bytes
+// Returns false and sets `error` and `error_line` if the source is invalid
+bool asm_assemble(Assembler *as, const char *src, usize len, u8 *mem);
+
+// Read and assemble a file, printing any error with its position
+bool asm_assemble_file(Assembler *as, const char *path, u8 *mem);
+
+// Look up a global symbol of the last run
+// Returns false if there is no such symbol
+bool asm_symbol(const Assembler *as, const char *name, u16 *value);
@@ -0,0 +1,95 @@
+#include "bank.h"
+
+#ifdef EMU_BANKING
+
+bool banks_init(Banks *banks, const u32 size) {
+  *banks = (Banks){0};
+  if (size % BANK_PAGE_SIZE != 0) {
+    return false;
+  }
+  banks->data = calloc(size, 1);
+  if (banks->data == NULL && size != 0) {
+    return false;
+  }
+  banks->size = size;
+  return true;
+}
+
+void banks_free(Banks *banks) {
+  free(banks->data);
+  banks->data = NULL;
+  banks->size = 0;
+}
+
+void bank_attach(Emulator *emu, Banks *banks) {
+  emu->banks = banks;
+  for (u32 page = 0; page < BANK_PAGES; page++) {
+    emu->page_map[page] = page;
+  }
+  bank_refresh(emu);
+}
+
+// Point the tables at what `page_map` says for one page
+static void refresh_page(Emulator *emu, const u32 page) {
+  const u32 entry = emu->page_map[page];
+  const u32 phys = entry & ~BANK_READ_ONLY;
+  u8 *data = (phys < BANK_PAGES)
+                 ? &emu->mem[phys * BANK_PAGE_SIZE]
+                 : &emu->banks->data[(phys - BANK_PAGES) * BANK_PAGE_SIZE];
+  emu->read_pages[page] = data;
+  emu->write_pages[page] = (entry & BANK_READ_ONLY) ? NULL : data;
+}
+
+void bank_refresh(Emulator *emu) {
+  for (u32 page = 0; page < BANK_PAGES; page++) {
+    refresh_page(emu, page);
+  }
+}
+
+// The pages from `*first` up to `*end` if `size` bytes from `addr` are whole
+// pages of the address space
+static bool whole_pages(const u16 addr, const u32 size, u32 *first,
+                        u32 *end) {
+  if (addr % BANK_PAGE_SIZE != 0 || size % BANK_PAGE_SIZE != 0 ||
+      addr + size > MEM_SIZE) {
+    return false;
+  }
+  *first = addr / BANK_PAGE_SIZE;
+  *end = (addr + size) / BANK_PAGE_SIZE;
+  return true;
+}
+
+bool bank_map(Emulator *emu, const u16 addr, const u32 offset, const u32 size,
+              const bool read_only) {
+  const Banks *banks = emu->banks;
+  u32 first;
+  u32 end;
+  if (banks == NULL || !whole_pages(addr, size, &first, &end) ||
+      offset % BANK_PAGE_SIZE != 0 || offset > banks->size ||
+      size > banks->size - offset) {
+    return false;
+  }
+  // bank memory pages are numbered after those of `mem`
+  const u32 phys = BANK_PAGES + offset / BANK_PAGE_SIZE - first;
+  const u32 flags = read_only ? BANK_READ_ONLY : 0;
+  for (u32 page = first; page < end; page++) {
+    emu->page_map[page] = (phys + page) | flags;
+    refresh_page(emu, page);
+  }
+  return true;
+}
+
+bool bank_unmap(Emulator *emu, const u16 addr, const u32 size) {
+  u32 first;
+  u32 end;
+  if (!whole_pages(addr, size, &first, &end)) {
+    return false;
+  }
+  for (u32 page = first; page < end; page++) {
+    emu->page_map[page] = page;
+    refresh_page(emu, page);
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Bank switched memory beyond 64 kB, compiled in with `EMU_BANKING`
+// (`make BANKING=1`).
+//
+// The address space is 256 pages of 256 bytes. Each page is reached through
+// `Emulator.read_pages` and `Emulator.write_pages`, which point either into
+// `Emulator.mem` (every page starts out mapped to its own address there) or
+// into the bank memory of a `Banks`. An access costs one table load more than
+// the flat array wherever it goes, and mapping a bank only rewrites the
+// entries of the pages it covers, so switching a 16 kB bank is 64 table
+// entries however large the bank memory is.
+//
+// What each page is mapped to is kept in `Emulator.page_map`, part of the
+// machine state, and the pointer tables are rebuilt from it. `emu_cold_boot`
+// restores the mapping and copies the bank memory of the boot image, so a
+// boot image carries its banks like the rest of memory. Give each emulator its
+// own `Banks` for that reason. Copies of the machine state alone (library
+// snapshots, recordings) only hold the mapping.
+//
+// Writes to pages mapped read-only do not reach memory: they go to
+// `Banks.on_rom_write` if it is set, which is where cartridges usually decode
+// their bank registers, and are dropped otherwise.
+
+#define BANK_PAGE_SIZE 256
+#define BANK_PAGES (MEM_SIZE / BANK_PAGE_SIZE)
+
+// `Emulator.page_map` entries: the page of `Emulator.mem` or, from
+// `BANK_PAGES` on, the page of bank memory a page is mapped to, with
+// `BANK_READ_ONLY` or'ed in for pages that ignore writes
+#define BANK_READ_ONLY 0x80000000u
+
+typedef struct Banks {
+  u8 *data; // `size` bytes
+  u32 size; // a multiple of `BANK_PAGE_SIZE`
+  // Called instead of writing to a read-only page, may remap pages
+  void (*on_rom_write)(Emulator *emu, u16 addr, u8 byte);
+  void *ctx; // for `on_rom_write`
+} Banks;
+
+// Allocate `size` bytes of zeroed bank memory, a multiple of `BANK_PAGE_SIZE`
+// Returns false if `size` is not a multiple or the allocation fails
+bool banks_init(Banks *banks, u32 size);
+
+void banks_free(Banks *banks);
+
+// Attach `banks` to `emu`, with every page mapped to `Emulator.mem` again
+void bank_attach(Emulator *emu, Banks *banks);
+
+// Map `size` bytes of bank memory from `offset` to the addresses from `addr`
+// Both `addr` and `size` must be multiples of `BANK_PAGE_SIZE`, and the range
+// must fit in the address space and in the bank memory
+// Returns false, mapping nothing, if they are not
+bool bank_map(Emulator *emu, u16 addr, u32 offset, u32 size, bool read_only);
+
+// Map the addresses from `addr` back to the same addresses of `Emulator.mem`
+// Returns false, mapping nothing, if the range is not whole pages within the
+// address space
+bool bank_unmap(Emulator *emu, u16 addr, u32 size);
+
+// Rebuild the pointer tables of `emu` from its `page_map`
+void bank_refresh(Emulator *emu);
@@ -0,0 +1,126 @@
+#include "bank.h"
+#include "common.h"
+#include "emu6502.h"
+
+// Checks bank switching (`make BANKING=1`), which the test programs in tests/
+// only run through the identity mapping: a read-only 16 kB bank at $8000 that
+// the program switches by writing to it, as cartridges do, and a writable bank
+// at $C000. Then checks that `emu_cold_boot` copies the mapping and the bank
+// memory, and that `bank_unmap` restores the flat memory.
+// Exit status is 0 if every check passed, 1 if one failed and 2 on errors.
+
+#define BANK_SIZE 0x4000
+#define N_BANKS 4
+
+// every byte of bank `k` is `PATTERN + k`
+#define PATTERN 0xB0
+
+// the program, run from $0400
+static const u8 program[] = {
+    0xAD, 0x00, 0x80, // LDA $8000   bank 0
+    0x85, 0x10,       // STA $10
+    0xA9, 0x02,       // LDA #2
+    0x8D, 0x00, 0x80, // STA $8000   read-only, selects bank 2
+    0xAD, 0x00, 0x80, // LDA $8000
+    0x85, 0x11,       // STA $11
+    0xA9, 0x55,       // LDA #$55
+    0x8D, 0x00, 0xC0, // STA $C000   writable bank
+    0xAD, 0x00, 0xC0, // LDA $C000
+    0x85, 0x12,       // STA $12
+    0x4C, 0x19, 0x04, // JMP $0419   trap
+};
+
+#define TRAP_ADDR 0x0419
+
+static u32 n_failed = 0;
+
+static void check(const bool ok, const char *what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    n_failed++;
+  }
+}
+
+// the bank register of the cartridge: any write to $8000-$BFFF selects a bank
+static void on_rom_write(Emulator *emu, const u16 addr, const u8 byte) {
+  u32 *n_switches = emu->banks->ctx;
+  (*n_switches)++;
+  (void)addr;
+  bank_map(emu, 0x8000, (u32)(byte % N_BANKS) * BANK_SIZE, BANK_SIZE, true);
+}
+
+i32 main(void) {
+  static Emulator emu;
+  static Banks banks;
+  u32 n_switches = 0;
+  emu_init(&emu, false);
+  if (!banks_init(&banks, N_BANKS * BANK_SIZE)) {
+    printf("cannot allocate bank memory\n");
+    return 2;
+  }
+  for (u32 i = 0; i < banks.size; i++) {
+    banks.data[i] = (u8)(PATTERN + i / BANK_SIZE);
+  }
+  banks.on_rom_write = on_rom_write;
+  banks.ctx = &n_switches;
+  bank_attach(&emu, &banks);
+
+  check(!bank_map(&emu, 0x8010, 0, BANK_SIZE, true),
+        "bank_map accepted an address within a page");
+  check(!bank_map(&emu, 0x8000, 3 * BANK_SIZE, 2 * BANK_SIZE, true),
+        "bank_map accepted a range past the bank memory");
+  check(bank_map(&emu, 0x8000, 0, BANK_SIZE, true), "bank_map of bank 0");
+  // the first 4 kB of bank 3, writable
+  check(bank_map(&emu, 0xC000, 3 * BANK_SIZE, 0x1000, false),
+        "bank_map of bank 3");
+
+  for (u16 i = 0; i < sizeof(program); i++) {
+    emu_write_mem_byte(&emu, (u16)(0x0400 + i), program[i]);
+  }
+  emu_reset(&emu);
+  emu.cpu.pc = 0x0400;
+  emu_run(&emu, 1000);
+
+  check(emu.cpu.pc == TRAP_ADDR, "the program did not reach its trap");
+  check(emu_read_mem_byte(&emu, 0x10) == PATTERN, "bank 0 read at $8000");
+  check(n_switches == 1, "on_rom_write was not called once");
+  check(emu_read_mem_byte(&emu, 0x11) == PATTERN + 2, "bank 2 read at $8000");
+  check(banks.data[2 * BANK_SIZE] == PATTERN + 2,
+        "a write to a read-only page reached bank memory");
+  check(emu_read_mem_byte(&emu, 0x12) == 0x55, "writable bank read back");
+  check(banks.data[3 * BANK_SIZE] == 0x55, "write to bank 3");
+  check(emu.mem[0xC000] == 0, "a write to a bank reached flat memory");
+
+  // a second machine with its own bank memory, booted from the first
+  static Emulator copy;
+  static Banks copy_banks;
+  emu_init(&copy, false);
+  if (!banks_init(&copy_banks, N_BANKS * BANK_SIZE)) {
+    printf("cannot allocate bank memory\n");
+    return 2;
+  }
+  bank_attach(&copy, &copy_banks);
+  emu_cold_boot(&copy, &emu);
+  check(emu_read_mem_byte(&copy, 0x8000) == PATTERN + 2,
+        "cold boot did not keep bank 2 at $8000");
+  check(emu_read_mem_byte(&copy, 0xC000) == 0x55,
+        "cold boot did not copy bank memory");
+  check(copy.read_pages[0x80] == &copy_banks.data[2 * BANK_SIZE],
+        "cold boot left pages pointing at the other machine's banks");
+  emu_write_mem_byte(&emu, 0xC000, 0x66);
+  check(emu_read_mem_byte(&copy, 0xC000) == 0x55,
+        "the copy shares bank memory with its boot image");
+
+  check(bank_unmap(&emu, 0xC000, 0x1000), "bank_unmap");
+  check(emu_read_mem_byte(&emu, 0xC000) == 0, "flat memory after bank_unmap");
+  check(emu_read_mem_byte(&emu, 0x8000) == PATTERN + 2,
+        "bank_unmap changed other pages");
+
+  banks_free(&banks);
+  banks_free(&copy_banks);
+  if (n_failed != 0) {
+    return 1;
+  }
+  printf("PASS bank switching\n");
+  return 0;
+}
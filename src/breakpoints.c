@@ -0,0 +1,116 @@
+#include "breakpoints.h"
+
+#include <ctype.h>
+
+void breakpoints_init(Breakpoints *bp) { memset(bp, 0, sizeof(Breakpoints)); }
+
+void breakpoint_set(Breakpoints *bp, const u16 addr) {
+  bp->pcs[addr >> 6] |= (u64)1 << (addr & 63);
+}
+
+void breakpoint_clear(Breakpoints *bp, const u16 addr) {
+  bp->pcs[addr >> 6] &= ~((u64)1 << (addr & 63));
+}
+
+bool breakpoint_toggle(Breakpoints *bp, const u16 addr) {
+  bp->pcs[addr >> 6] ^= (u64)1 << (addr & 63);
+  return breakpoint_test(bp, addr);
+}
+
+static void mark_pages(Breakpoints *bp, const Watchpoint *w) {
+  for (usize page = w->start >> 8; page <= (usize)(w->end >> 8); page++) {
+    bp->watched_pages[page] |= w->kind;
+  }
+}
+
+bool watchpoint_add(Breakpoints *bp, u16 start, u16 end, const u8 kind) {
+  if (bp->n_watches == MAX_WATCHPOINTS) {
+    return false;
+  }
+  if (start > end) {
+    const u16 tmp = start;
+    start = end;
+    end = tmp;
+  }
+  const Watchpoint w = {start, end, kind};
+  bp->watches[bp->n_watches++] = w;
+  mark_pages(bp, &w);
+  return true;
+}
+
+bool watchpoint_remove(Breakpoints *bp, const u16 start, const u16 end,
+                       const u8 kind) {
+  for (usize i = 0; i < bp->n_watches; i++) {
+    const Watchpoint *w = &bp->watches[i];
+    if (w->start == start && w->end == end && w->kind == kind) {
+      bp->watches[i] = bp->watches[--bp->n_watches];
+      memset(bp->watched_pages, 0, sizeof(bp->watched_pages));
+      for (usize j = 0; j < bp->n_watches; j++) {
+        mark_pages(bp, &bp->watches[j]);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void watchpoint_check_slow(Breakpoints *bp, const u16 addr, const u8 kind) {
+  for (usize i = 0; i < bp->n_watches; i++) {
+    const Watchpoint *w = &bp->watches[i];
+    if ((w->kind & kind) && addr >= w->start && addr <= w->end) {
+      // keep the first hit if an instruction triggers more than one
+      if (!bp->watch_hit) {
+        bp->watch_hit = true;
+        bp->hit_addr = addr;
+        bp->hit_kind = kind;
+      }
+      return;
+    }
+  }
+}
+
+// Parse the address at the start of `str`, setting `*rest` to what follows
+static bool parse_addr_prefix(const char *str, u16 *addr, const char **rest) {
+  if (str[0] == '$') {
+    str++;
+  } else if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X')) {
+    str += 2;
+  }
+  // strtoul would also take a sign or leading spaces
+  if (!isxdigit((unsigned char)str[0])) {
+    return false;
+  }
+  char *end;
+  const unsigned long x = strtoul(str, &end, 16);
+  if (x > 0xFFFF) {
+    return false;
+  }
+  *addr = (u16)x;
+  *rest = end;
+  return true;
+}
+
+bool breakpoint_parse_addr(const char *str, u16 *addr) {
+  const char *rest;
+  return parse_addr_prefix(str, addr, &rest) && *rest == '\0';
+}
+
+bool watchpoint_add_spec(Breakpoints *bp, const char *spec) {
+  u16 start, end;
+  const char *p;
+  if (!parse_addr_prefix(spec, &start, &p)) {
+    return false;
+  }
+  end = start;
+  if (*p == '-' && !parse_addr_prefix(p + 1, &end, &p)) {
+    return false;
+  }
+  u8 kind = WATCH_READ | WATCH_WRITE;
+  if (*p == ':') {
+    kind = 0;
+    for (p++; *p == 'r' || *p == 'w'; p++) {
+      kind |= (*p == 'r') ? WATCH_READ : WATCH_WRITE;
+    }
+  }
+  return *p == '\0' && kind != 0 && watchpoint_add(bp, start, end, kind);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// PC breakpoints and memory watchpoints.
+//
+// Breakpoints are one bit per address, so checking one after every instruction
+// is a shift and a mask. Watchpoints cover address ranges; a per-page mask of
+// the watched access kinds keeps accesses to unwatched pages down to a single
+// byte load, and only accesses to watched pages look at the ranges.
+
+#define WATCH_READ 0b01
+#define WATCH_WRITE 0b10
+
+#define MAX_WATCHPOINTS 64
+
+typedef struct Watchpoint {
+  u16 start; // first watched address
+  u16 end;   // last watched address, inclusive
+  u8 kind;   // `WATCH_READ` and/or `WATCH_WRITE`
+} Watchpoint;
+
+typedef struct Breakpoints {
+  u64 pcs[MEM_SIZE / 64];
+  u8 watched_pages[MEM_SIZE / 256]; // kinds watched anywhere in each page
+  Watchpoint watches[MAX_WATCHPOINTS];
+  usize n_watches;
+  // set when a watchpoint triggers, cleared by `emu_run` when it stops on it
+  bool watch_hit;
+  u16 hit_addr;
+  u8 hit_kind;
+} Breakpoints;
+
+void breakpoints_init(Breakpoints *bp);
+
+// Break before executing the instruction at `addr`
+void breakpoint_set(Breakpoints *bp, u16 addr);
+
+void breakpoint_clear(Breakpoints *bp, u16 addr);
+
+// Returns whether the breakpoint is set after toggling
+bool breakpoint_toggle(Breakpoints *bp, u16 addr);
+
+static inline bool breakpoint_test(const Breakpoints *bp, const u16 addr) {
+  return (bp->pcs[addr >> 6] >> (addr & 63)) & 1;
+}
+
+// Watch accesses of `kind` to addresses `start` to `end` (inclusive)
+// Returns false if there are already `MAX_WATCHPOINTS` watchpoints
+bool watchpoint_add(Breakpoints *bp, u16 start, u16 end, u8 kind);
+
+// Remove the watchpoint with exactly this range and kind
+// Returns false if there is no such watchpoint
+bool watchpoint_remove(Breakpoints *bp, u16 start, u16 end, u8 kind);
+
+// Parse a hexadecimal address, optionally prefixed by `$` or `0x`
+// Returns false if `str` is not a valid address with nothing after it
+bool breakpoint_parse_addr(const char *str, u16 *addr);
+
+// Parse a watchpoint in the form `START[-END][:r|w|rw]` and add it
+// Returns false if `spec` is invalid
+bool watchpoint_add_spec(Breakpoints *bp, const char *spec);
+
+void watchpoint_check_slow(Breakpoints *bp, u16 addr, u8 kind);
+
+// Called by the emulator on every data access
+static inline void watchpoint_check(Breakpoints *bp, const u16 addr,
+                                    const u8 kind) {
+  if (bp->watched_pages[addr >> 8] & kind) {
+    watchpoint_check_slow(bp, addr, kind);
+  }
+}
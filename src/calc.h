@@ -2,53 +2,85 @@
 
 #include "common.h"
 
-struct result_and_carry_u8 {
+// Results of ADC and SBC
+// In decimal mode the NMOS 6502 does not derive N, V and Z from the result it
+// stores, so all flags are computed along with it. The 65C02 fixed N and Z
+// (see "Decimal Mode" by Bruce Clark, appendix B).
+struct adc_result {
   u8 result;
   bool carry;
+  bool overflow;
+  bool negative;
+  bool zero;
 };
 
-static inline struct result_and_carry_u8
-carrying_add_u8(const u8 lhs, const u8 rhs, const bool carry) {
-  const u8 sum = lhs + rhs + carry;
-  const bool carry_out = (sum < lhs || sum < rhs || sum < (carry * 0xFF));
-  return (struct result_and_carry_u8){sum, carry_out};
+// Binary ADC, also SBC with `rhs` inverted
+static inline struct adc_result carrying_add_u8(const u8 lhs, const u8 rhs,
+                                                const bool carry) {
+  const u16 sum = (u16)(lhs + rhs + carry);
+  return (struct adc_result){
+      .result = (u8)sum,
+      .carry = sum > 0xFF,
+      // both operands have the same sign and the result does not
+      .overflow = ((~(lhs ^ rhs) & (lhs ^ sum)) & 0x80) != 0,
+      .negative = (sum & 0x80) != 0,
+      .zero = (u8)sum == 0,
+  };
 }
 
-static inline struct result_and_carry_u8
-carrying_sub_u8(const u8 lhs, const u8 rhs, const bool carry) {
-  const u8 dif = lhs - rhs - carry;
-  const bool carry_out = (dif > lhs && dif > rhs && dif > (carry * 0xFF));
-  return (struct result_and_carry_u8){dif, carry_out};
+static inline struct adc_result carrying_bcd_add_u8(const u8 lhs, const u8 rhs,
+                                                    const bool carry) {
+  i32 lo = (lhs & 0x0F) + (rhs & 0x0F) + carry;
+  if (lo > 0x09) {
+    lo = ((lo + 0x06) & 0x0F) + 0x10;
+  }
+  i32 sum = (lhs & 0xF0) + (rhs & 0xF0) + lo;
+  // N and V come from the sum before the high nibble is adjusted, Z from the
+  // binary sum
+  struct adc_result r = {
+      .overflow = ((~(lhs ^ rhs) & (lhs ^ sum)) & 0x80) != 0,
+      .negative = (sum & 0x80) != 0,
+      .zero = (u8)(lhs + rhs + carry) == 0,
+  };
+  if (sum > 0x9F) {
+    sum += 0x60;
+  }
+  r.result = (u8)sum;
+  r.carry = sum > 0xFF;
+#ifdef EMU_CPU_65C02
+  r.negative = (r.result & 0x80) != 0;
+  r.zero = r.result == 0;
+#endif
+  return r;
 }
 
-static inline struct result_and_carry_u8
-carrying_bcd_add_u8(const u8 lhs, const u8 rhs, const bool carry_in) {
-  // result_lo is lower 4 bits (RTL, from least significant to most significant)
-  // result_hi is higher 4 bits
-  // carry     is the carry value from lower to higher nibble
-  u8 result_lo = (lhs & 0x0F) + (rhs & 0x0F) + carry_in;
-  const u8 carry = (result_lo > 0x09);
-  result_lo %= 0x0A;
-  u8 result_hi = ((lhs & 0xF0)) + ((rhs & 0xF0)) + (u8)(carry << 4);
-  const bool carry_out = (result_hi > 0x90);
-  result_hi %= 0xA0;
-  const u8 result = result_lo | result_hi;
-  return (struct result_and_carry_u8){result, carry_out};
-}
-
-static inline struct result_and_carry_u8
-carrying_bcd_sub_u8(const u8 lhs, const u8 rhs, const bool carry_in) {
-  // result_lo is lower 4 bits (RTL, from least significant to most significant)
-  // result_hi is higher 4 bits
-  // carry     is the carry value from lower to higher nibble
-  u8 result_lo = (lhs & 0x0F) - (rhs & 0x0F) - carry_in;
-  const u8 carry = (result_lo > 0x09);
-  if (carry)
-    result_lo += 0x0A;
-  u8 result_hi = ((lhs & 0xF0)) - ((rhs & 0xF0)) - (u8)(carry << 4);
-  const bool carry_out = (result_hi > 0x90);
-  if (carry_out)
-    result_hi += 0xA0;
-  const u8 result = result_lo | result_hi;
-  return (struct result_and_carry_u8){result, carry_out};
+static inline struct adc_result carrying_bcd_sub_u8(const u8 lhs, const u8 rhs,
+                                                    const bool carry) {
+  // C and V are those of the binary subtraction, and on the NMOS 6502 N and Z
+  // too
+  struct adc_result r = carrying_add_u8(lhs, (u8)~rhs, carry);
+  i32 lo = (lhs & 0x0F) - (rhs & 0x0F) + carry - 1;
+#ifdef EMU_CPU_65C02
+  // adjusts the binary difference instead of the digits
+  i32 dif = lhs - rhs + carry - 1;
+  if (dif < 0) {
+    dif -= 0x60;
+  }
+  if (lo < 0) {
+    dif -= 0x06;
+  }
+  r.result = (u8)dif;
+  r.negative = (r.result & 0x80) != 0;
+  r.zero = r.result == 0;
+#else
+  if (lo < 0) {
+    lo = ((lo - 0x06) & 0x0F) - 0x10;
+  }
+  i32 dif = (lhs & 0xF0) - (rhs & 0xF0) + lo;
+  if (dif < 0) {
+    dif -= 0x60;
+  }
+  r.result = (u8)dif;
+#endif
+  return r;
 }
@@ -0,0 +1,173 @@
+#include "callgraph.h"
+
+#include <inttypes.h>
+
+bool callgraph_init(CallGraph *cg) {
+  memset(cg, 0, sizeof(CallGraph));
+  cg->nodes = malloc(256 * sizeof(CallNode));
+  if (cg->nodes == NULL) {
+    return false;
+  }
+  cg->cap_nodes = 256;
+  cg->nodes[CALLGRAPH_ROOT] = (CallNode){0, CALLGRAPH_ROOT, 0, 0, 0};
+  cg->n_nodes = 1;
+  return true;
+}
+
+void callgraph_free(CallGraph *cg) {
+  free(cg->nodes);
+  cg->nodes = NULL;
+  cg->n_nodes = 0;
+  cg->cap_nodes = 0;
+}
+
+static inline u32 current_node(const CallGraph *cg) {
+  return (cg->depth == 0) ? CALLGRAPH_ROOT : cg->frames[cg->depth - 1].node;
+}
+
+// attribute the cycles since the last event to the running subroutine
+static inline void charge(CallGraph *cg, const u64 cycles) {
+  const u64 n = cycles - cg->charged_until;
+  cg->charged_until = cycles;
+  const u32 node = current_node(cg);
+  cg->nodes[node].self_cycles += n;
+  if (node != CALLGRAPH_ROOT) {
+    cg->subs[cg->nodes[node].addr].exclusive_cycles += n;
+  }
+}
+
+// find the child of `parent` for subroutine `addr`, creating it if needed
+// Returns `CALLGRAPH_ROOT` if there is no memory for a new node
+static u32 child_node(CallGraph *cg, const u32 parent, const u16 addr) {
+  for (u32 i = cg->nodes[parent].first_child; i != 0;
+       i = cg->nodes[i].next_sibling) {
+    if (cg->nodes[i].addr == addr) {
+      return i;
+    }
+  }
+  if (cg->n_nodes == cg->cap_nodes) {
+    CallNode *nodes =
+        realloc(cg->nodes, 2 * cg->cap_nodes * sizeof(CallNode));
+    if (nodes == NULL) {
+      return CALLGRAPH_ROOT;
+    }
+    cg->nodes = nodes;
+    cg->cap_nodes *= 2;
+  }
+  const u32 i = (u32)cg->n_nodes++;
+  cg->nodes[i] = (CallNode){addr, parent, 0, cg->nodes[parent].first_child, 0};
+  cg->nodes[parent].first_child = i;
+  return i;
+}
+
+void callgraph_enter(CallGraph *cg, const u16 addr, const u8 sp,
+                     const u64 cycles) {
+  charge(cg, cycles);
+  SubroutineStats *sub = &cg->subs[addr];
+  sub->calls++;
+  if (cg->depth == CALLGRAPH_MAX_DEPTH) {
+    cg->overflowed++;
+    return;
+  }
+  const u32 node = child_node(cg, current_node(cg), addr);
+  if (node == CALLGRAPH_ROOT) {
+    cg->unallocated++;
+    return;
+  }
+  cg->frames[cg->depth] = (CallFrame){node, sp, cycles};
+  cg->depth++;
+  sub->active++;
+}
+
+void callgraph_return(CallGraph *cg, const u8 sp, const u64 cycles) {
+  charge(cg, cycles);
+  while (cg->depth != 0 && cg->frames[cg->depth - 1].sp <= sp) {
+    const CallFrame *frame = &cg->frames[cg->depth - 1];
+    SubroutineStats *sub = &cg->subs[cg->nodes[frame->node].addr];
+    sub->active--;
+    // only the outermost frame of a recursive subroutine counts
+    if (sub->active == 0) {
+      sub->inclusive_cycles += cycles - frame->entry_cycles;
+    }
+    cg->depth--;
+  }
+}
+
+void callgraph_finish(CallGraph *cg, const u64 cycles) {
+  charge(cg, cycles);
+  // frames that are still running count up to now
+  for (usize i = 0; i < cg->depth; i++) {
+    const CallFrame *frame = &cg->frames[i];
+    SubroutineStats *sub = &cg->subs[cg->nodes[frame->node].addr];
+    bool outermost = true;
+    for (usize j = 0; j < i; j++) {
+      if (cg->nodes[cg->frames[j].node].addr == cg->nodes[frame->node].addr) {
+        outermost = false;
+      }
+    }
+    if (outermost) {
+      sub->inclusive_cycles += cycles - frame->entry_cycles;
+    }
+    sub->active = 0;
+  }
+  cg->depth = 0;
+}
+
+static const CallGraph *sort_cg;
+
+static i32 compare_subs(const void *lhs, const void *rhs) {
+  const u16 l = *(const u16 *)lhs;
+  const u16 r = *(const u16 *)rhs;
+  const u64 l_cycles = sort_cg->subs[l].inclusive_cycles;
+  const u64 r_cycles = sort_cg->subs[r].inclusive_cycles;
+  if (l_cycles != r_cycles) {
+    return (l_cycles < r_cycles) ? 1 : -1;
+  }
+  return (l < r) ? -1 : 1;
+}
+
+void callgraph_report(const CallGraph *cg, FILE *out) {
+  static u16 subs[MEM_SIZE];
+  usize n = 0;
+  for (usize i = 0; i < MEM_SIZE; i++) {
+    if (cg->subs[i].calls != 0) {
+      subs[n++] = (u16)i;
+    }
+  }
+  sort_cg = cg;
+  qsort(subs, n, sizeof(u16), compare_subs);
+
+  fprintf(out, "SUB\tCALLS\t\tINCLUSIVE\tEXCLUSIVE\n");
+  for (usize i = 0; i < n; i++) {
+    const SubroutineStats *s = &cg->subs[subs[i]];
+    fprintf(out, "%04X\t%-12" PRIu64 "\t%-12" PRIu64 "\t%" PRIu64 "\n",
+            subs[i], s->calls, s->inclusive_cycles, s->exclusive_cycles);
+  }
+  if (cg->overflowed != 0) {
+    fprintf(out, "%u calls deeper than %d frames were not tracked\n",
+            cg->overflowed, CALLGRAPH_MAX_DEPTH);
+  }
+  if (cg->unallocated != 0) {
+    fprintf(out, "%u calls were not tracked, out of memory for call paths\n",
+            cg->unallocated);
+  }
+}
+
+void callgraph_write_collapsed(const CallGraph *cg, FILE *out) {
+  u16 path[CALLGRAPH_MAX_DEPTH];
+  for (usize i = 0; i < cg->n_nodes; i++) {
+    const CallNode *node = &cg->nodes[i];
+    if (node->self_cycles == 0) {
+      continue;
+    }
+    usize depth = 0;
+    for (u32 j = (u32)i; j != CALLGRAPH_ROOT; j = cg->nodes[j].parent) {
+      path[depth++] = cg->nodes[j].addr;
+    }
+    fprintf(out, "root");
+    while (depth != 0) {
+      fprintf(out, ";sub_%04X", path[--depth]);
+    }
+    fprintf(out, " %" PRIu64 "\n", node->self_cycles);
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Call-graph profiler.
+//
+// Keeps a shadow call stack next to the real one, pushed on JSR and popped on
+// RTS. A frame is popped once SP has risen back to (or above) the value it had
+// before the JSR, rather than on every RTS. This way RTS used as an indirect
+// jump (pushing an address and returning to it) does not pop anything, and
+// code that discards return addresses from the stack unwinds every frame it
+// skipped over.
+
+#define CALLGRAPH_MAX_DEPTH 256
+
+// Node 0 is the root, i.e. code running outside of any subroutine
+#define CALLGRAPH_ROOT 0
+
+// One distinct call path
+typedef struct CallNode {
+  u16 addr; // entry address of the subroutine
+  u32 parent;
+  u32 first_child;
+  u32 next_sibling;
+  u64 self_cycles;
+} CallNode;
+
+typedef struct CallFrame {
+  u32 node;
+  u8 sp; // SP before the JSR
+  u64 entry_cycles;
+} CallFrame;
+
+typedef struct SubroutineStats {
+  u64 calls;
+  u64 inclusive_cycles;
+  u64 exclusive_cycles;
+  u32 active; // number of frames of this subroutine on the shadow stack
+} SubroutineStats;
+
+typedef struct CallGraph {
+  CallFrame frames[CALLGRAPH_MAX_DEPTH];
+  usize depth;
+  u32 overflowed; // frames not pushed because the shadow stack was full
+  u32 unallocated; // frames not pushed for lack of memory for a new node
+  u64 charged_until; // cycles before this have been attributed
+  CallNode *nodes;
+  usize n_nodes;
+  usize cap_nodes;
+  SubroutineStats subs[MEM_SIZE]; // indexed by entry address
+} CallGraph;
+
+// Returns false if the call paths cannot be allocated
+bool callgraph_init(CallGraph *cg);
+
+void callgraph_free(CallGraph *cg);
+
+// Called by the emulator on JSR, before the return address is pushed
+// `sp` is the stack pointer before the JSR, `cycles` the cycle count before it
+void callgraph_enter(CallGraph *cg, u16 addr, u8 sp, u64 cycles);
+
+// Called by the emulator on RTS, after the return address is pulled
+// `sp` is the stack pointer after the RTS, `cycles` the cycle count after it
+void callgraph_return(CallGraph *cg, u8 sp, u64 cycles);
+
+// Attribute cycles up to `cycles` to the currently running subroutine
+// Call before reporting
+void callgraph_finish(CallGraph *cg, u64 cycles);
+
+// Print subroutines sorted by inclusive cycles
+void callgraph_report(const CallGraph *cg, FILE *out);
+
+// Write every call path with its self cycles in the collapsed stack format
+// accepted by flamegraph.pl, speedscope and similar tools, one path per line:
+// `root;sub_0800;sub_1000 1234`
+void callgraph_write_collapsed(const CallGraph *cg, FILE *out);
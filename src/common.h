@@ -22,8 +22,24 @@ typedef double f64;
 typedef size_t usize;
 typedef ssize_t isize;
 
-static inline u16 swap_bytes(const u16 data) {
-  return ((data << 8) & 0xff00) | ((data >> 8) & 0x00ff);
+// Read a little endian word, as the 6502 stores them, from any address
+// `memcpy` compiles to a single unaligned load on hosts that allow them
+// (x86-64, aarch64), and only big endian hosts pay for a byte swap
+static inline u16 read_le16(const u8 *p) {
+  u16 word;
+  memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap16(word);
+#endif
+  return word;
+}
+
+// Write a little endian word to any address
+static inline void write_le16(u8 *p, u16 word) {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap16(word);
+#endif
+  memcpy(p, &word, sizeof(word));
 }
 
 #define TODO()                                                                 \
@@ -0,0 +1,489 @@
+#include "debugger.h"
+#include "disasm.h"
+#include "heatmap.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// the left column holds the registers, code and log panes, the right column
+// the stack and memory panes, and the status lines go across the bottom
+#define LEFT_WIDTH 26
+#define REGS_HEIGHT 10
+#define LOG_HEIGHT 6
+#define STACK_HEIGHT 10
+#define STATUS_HEIGHT 2
+#define MIN_COLS 80
+#define MIN_LINES 24
+
+// column of the first byte in the stack and memory panes
+#define BYTES_X 6
+
+static const char help[] = "n:step r:run N u:until c:cont b:break w:watch "
+                           "g:goto d:diff arrows/PgUp/PgDn:memory q:quit";
+
+static u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+// Forget what is on screen so that the next frame repaints everything
+static void invalidate(Debugger *dbg) {
+  memset(dbg->reg_cells, 0, sizeof(dbg->reg_cells));
+  memset(dbg->stack_cells, 0, sizeof(dbg->stack_cells));
+  memset(dbg->memory_cells, 0, sizeof(dbg->memory_cells));
+  dbg->stack_shown = -1;
+  dbg->memory_shown = -1;
+  // no drawn line can start with \x01, so these never match
+  for (usize i = 0; i < DEBUGGER_MAX_ROWS; i++) {
+    strcpy(dbg->code_lines[i], "\x01");
+    strcpy(dbg->log_lines_shown[i], "\x01");
+  }
+  strcpy(dbg->status_shown[0], "\x01");
+  strcpy(dbg->status_shown[1], "\x01");
+}
+
+static WINDOW *new_pane(const i32 height, const i32 width, const i32 y,
+                        const i32 x, const char *title) {
+  WINDOW *win = newwin(height, width, y, x);
+  box(win, 0, 0);
+  mvwprintw(win, 0, 2, " %s ", title);
+  return win;
+}
+
+// (Re)create the panes for the current terminal size
+static void layout(Debugger *dbg) {
+  WINDOW **windows[] = {&dbg->regs,  &dbg->code,   &dbg->log,
+                        &dbg->stack, &dbg->memory, &dbg->status};
+  for (usize i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+    if (*windows[i] != NULL) {
+      delwin(*windows[i]);
+      *windows[i] = NULL;
+    }
+  }
+  erase();
+  refresh();
+  invalidate(dbg);
+
+  dbg->too_small = COLS < MIN_COLS || LINES < MIN_LINES;
+  if (dbg->too_small) {
+    dbg->status = newwin(LINES, COLS, 0, 0);
+  } else {
+    const i32 lines = LINES - STATUS_HEIGHT;
+    const i32 right = COLS - LEFT_WIDTH;
+    dbg->regs = new_pane(REGS_HEIGHT, LEFT_WIDTH, 0, 0, "Registers");
+    dbg->code = new_pane(lines - REGS_HEIGHT - LOG_HEIGHT, LEFT_WIDTH,
+                         REGS_HEIGHT, 0, "Code");
+    dbg->log = new_pane(LOG_HEIGHT, LEFT_WIDTH, lines - LOG_HEIGHT, 0, "Log");
+    dbg->stack = new_pane(STACK_HEIGHT, right, 0, LEFT_WIDTH, "Stack");
+    dbg->memory =
+        new_pane(lines - STACK_HEIGHT, right, STACK_HEIGHT, LEFT_WIDTH, "Memory");
+    dbg->status = newwin(STATUS_HEIGHT, COLS, lines, 0);
+
+    static const char *const names[] = {"PC", "SP", "A", "X", "Y"};
+    for (i32 i = 0; i < 5; i++) {
+      mvwprintw(dbg->regs, 1 + i, 1, "%s", names[i]);
+    }
+    mvwprintw(dbg->regs, 6, 1, "N V B D I Z C");
+    mvwprintw(dbg->regs, 8, 1, "CYC");
+  }
+  keypad(dbg->status, true);
+}
+
+// Draw `value` with `fmt` if it differs from what the cell shows, highlighting
+// it if it changed since the previous frame and `highlight` is set
+static void draw_cell(WINDOW *win, const i32 y, const i32 x, DebuggerCell *cell,
+                      const u64 value, const char *fmt, attr_t attr,
+                      const bool highlight) {
+  if (highlight && cell->drawn && cell->value != value) {
+    attr |= A_REVERSE;
+  }
+  if (cell->drawn && cell->value == value && cell->attr == attr) {
+    return;
+  }
+  wattr_set(win, attr, 0, NULL);
+  mvwprintw(win, y, x, fmt, value);
+  wattr_set(win, A_NORMAL, 0, NULL);
+  cell->value = value;
+  cell->attr = attr;
+  cell->drawn = true;
+}
+
+// Draw `text` padded to `width` if it differs from the line on screen
+static void draw_line(WINDOW *win, const i32 y, const i32 x, const i32 width,
+                      char *shown, const char *text) {
+  if (strcmp(shown, text) == 0) {
+    return;
+  }
+  mvwprintw(win, y, x, "%-*.*s", width, width, text);
+  snprintf(shown, DEBUGGER_LINE_WIDTH, "%s", text);
+}
+
+static i32 pane_rows(WINDOW *win) {
+  const i32 rows = getmaxy(win) - 2;
+  if (rows < 0) {
+    return 0;
+  }
+  return (rows > DEBUGGER_MAX_ROWS) ? DEBUGGER_MAX_ROWS : rows;
+}
+
+static void draw_regs(Debugger *dbg, const Emulator *emu) {
+  WINDOW *win = dbg->regs;
+  const CPU *cpu = &emu->cpu;
+  DebuggerCell *cells = dbg->reg_cells;
+  const u64 values[] = {cpu->pc, cpu->sp, cpu->a, cpu->x, cpu->y};
+  for (i32 i = 0; i < 5; i++) {
+    draw_cell(win, 1 + i, 5, &cells[i * 2], values[i],
+              (i == 0) ? "%04" PRIX64 : "%02" PRIX64, A_NORMAL, true);
+    draw_cell(win, 1 + i, 11, &cells[i * 2 + 1], values[i], "%-5" PRIu64,
+              A_NORMAL, true);
+  }
+  const bool flags[] = {cpu->sr.bits.n, cpu->sr.bits.v, cpu->sr.bits.b,
+                        cpu->sr.bits.d, cpu->sr.bits.i, cpu->sr.bits.z,
+                        cpu->sr.bits.c};
+  for (i32 i = 0; i < 7; i++) {
+    draw_cell(win, 7, 1 + i * 2, &cells[10 + i], flags[i], "%" PRIu64,
+              A_NORMAL, true);
+  }
+  draw_cell(win, 8, 5, &cells[17], emu->cycles, "%-19" PRIu64, A_NORMAL,
+            false);
+}
+
+static void draw_code(Debugger *dbg, const Emulator *emu) {
+  const i32 rows = pane_rows(dbg->code);
+  u16 addr = emu->cpu.pc;
+  for (i32 row = 0; row < rows; row++) {
+    char instr[DISASM_MAX_LEN];
+    const u8 bytes[3] = {emu_read_mem_byte(emu, addr),
+                         emu_read_mem_byte(emu, (u16)(addr + 1)),
+                         emu_read_mem_byte(emu, (u16)(addr + 2))};
+    const u16 len = (u16)disasm_bytes(bytes, addr, instr);
+    char line[DEBUGGER_LINE_WIDTH];
+    snprintf(line, sizeof(line), "%c%c%04X %s", (row == 0) ? '>' : ' ',
+             breakpoint_test(emu->breakpoints, addr) ? '*' : ' ', addr, instr);
+    draw_line(dbg->code, 1 + row, 1, LEFT_WIDTH - 2, dbg->code_lines[row],
+              line);
+    addr += len;
+  }
+}
+
+static void draw_log(Debugger *dbg) {
+  const i32 rows = pane_rows(dbg->log);
+  for (i32 row = 0; row < rows; row++) {
+    const i64 i = (i64)dbg->n_log_lines - rows + row;
+    const char *line = (i < 0) ? "" : dbg->log_lines[i % DEBUGGER_LOG_LINES];
+    draw_line(dbg->log, 1 + row, 1, LEFT_WIDTH - 2, dbg->log_lines_shown[row],
+              line);
+  }
+}
+
+// Draw `rows` rows of 16 bytes starting at `base`, underlining `mark`
+static void draw_bytes(WINDOW *win, const Emulator *emu, DebuggerCell *cells,
+                       const i32 rows, const u16 base, const u16 mark) {
+  for (i32 row = 0; row < rows; row++) {
+    for (i32 i = 0; i < 16; i++) {
+      const u16 addr = (u16)(base + row * 16 + i);
+      draw_cell(win, 1 + row, BYTES_X + i * 3, &cells[row * 16 + i],
+                emu_read_mem_byte(emu, addr), "%02" PRIX64,
+                (addr == mark) ? A_UNDERLINE : A_NORMAL, true);
+    }
+  }
+}
+
+// Draw the address labels of a byte pane whose base address changed and forget
+// its cells, which now show other addresses
+static void scroll_bytes(WINDOW *win, DebuggerCell *cells, const i32 rows,
+                         const u16 base) {
+  memset(cells, 0, sizeof(DebuggerCell) * 16 * (usize)rows);
+  for (i32 row = 0; row < rows; row++) {
+    mvwprintw(win, 1 + row, 1, "%04X", (u16)(base + row * 16));
+  }
+}
+
+static void draw_stack(Debugger *dbg, const Emulator *emu) {
+  const i32 rows = pane_rows(dbg->stack);
+  // keep the row with SP in the middle of the pane
+  i32 first_row = (emu->cpu.sp >> 4) - rows / 2;
+  if (first_row > 16 - rows) {
+    first_row = 16 - rows;
+  }
+  if (first_row < 0) {
+    first_row = 0;
+  }
+  const u16 base = (u16)(STACK_FLOOR + first_row * 16);
+  if (dbg->stack_shown != base) {
+    scroll_bytes(dbg->stack, dbg->stack_cells, rows, base);
+    dbg->stack_shown = base;
+  }
+  draw_bytes(dbg->stack, emu, dbg->stack_cells, rows, base,
+             STACK_FLOOR | emu->cpu.sp);
+}
+
+static void draw_memory(Debugger *dbg, const Emulator *emu) {
+  const i32 rows = pane_rows(dbg->memory);
+  if (dbg->memory_shown != dbg->memory_base) {
+    scroll_bytes(dbg->memory, dbg->memory_cells, rows, dbg->memory_base);
+    dbg->memory_shown = dbg->memory_base;
+  }
+  draw_bytes(dbg->memory, emu, dbg->memory_cells, rows, dbg->memory_base,
+             emu->cpu.pc);
+}
+
+static void draw(Debugger *dbg, const Emulator *emu) {
+  if (dbg->too_small) {
+    werase(dbg->status);
+    mvwprintw(dbg->status, 0, 0, "Terminal too small, need %dx%d", MIN_COLS,
+              MIN_LINES);
+    wrefresh(dbg->status);
+    return;
+  }
+  draw_regs(dbg, emu);
+  draw_code(dbg, emu);
+  draw_log(dbg);
+  draw_stack(dbg, emu);
+  draw_memory(dbg, emu);
+  const i32 width =
+      (COLS < DEBUGGER_LINE_WIDTH) ? COLS - 1 : DEBUGGER_LINE_WIDTH - 1;
+  draw_line(dbg->status, 0, 0, width, dbg->status_shown[0], dbg->message);
+  draw_line(dbg->status, 1, 0, width, dbg->status_shown[1], help);
+  wnoutrefresh(dbg->regs);
+  wnoutrefresh(dbg->code);
+  wnoutrefresh(dbg->log);
+  wnoutrefresh(dbg->stack);
+  wnoutrefresh(dbg->memory);
+  wnoutrefresh(dbg->status);
+  doupdate();
+}
+
+// Move the log messages of the last instruction into the log ring buffer
+static void drain_log(Debugger *dbg, Emulator *emu) {
+  const char *line = emu->log_buf;
+  while (*line != '\0') {
+    const char *newline = strchr(line, '\n');
+    const usize len = (newline != NULL) ? (usize)(newline - line) : strlen(line);
+    snprintf(dbg->log_lines[dbg->n_log_lines % DEBUGGER_LOG_LINES],
+             DEBUGGER_LINE_WIDTH, "%.*s", (i32)len, line);
+    dbg->n_log_lines++;
+    line += len + (newline != NULL);
+  }
+  emu->log_buf[0] = '\0';
+}
+
+static void log_line(Debugger *dbg, const char *line) {
+  snprintf(dbg->log_lines[dbg->n_log_lines % DEBUGGER_LOG_LINES],
+           DEBUGGER_LINE_WIDTH, "%s", line);
+  dbg->n_log_lines++;
+}
+
+// Log the memory ranges written since `cycle`
+static void log_changes(Debugger *dbg, const Emulator *emu, const u64 cycle) {
+  HeatmapRange ranges[DEBUGGER_LOG_LINES];
+  const usize n =
+      heatmap_changed_since(emu->heatmap, cycle, ranges, DEBUGGER_LOG_LINES);
+  char line[DEBUGGER_LINE_WIDTH];
+  snprintf(line, sizeof(line), "%zu changed since %" PRIu64, n, cycle);
+  log_line(dbg, line);
+  for (usize i = 0; i < n && i < DEBUGGER_LOG_LINES; i++) {
+    snprintf(line, sizeof(line), "%04X-%04X @%" PRIu64, ranges[i].start,
+             ranges[i].end - 1, ranges[i].last_write);
+    log_line(dbg, line);
+  }
+  snprintf(dbg->message, sizeof(dbg->message),
+           "%zu ranges changed since cycle %" PRIu64 ", see the log", n, cycle);
+}
+
+// Read a line into `buf` on the status line
+// Returns false if the line is empty
+static bool prompt(Debugger *dbg, const char *text, char *buf, const i32 len) {
+  WINDOW *win = dbg->status;
+  wmove(win, 0, 0);
+  wclrtoeol(win);
+  mvwprintw(win, 0, 0, "%s", text);
+  echo();
+  curs_set(1);
+  wgetnstr(win, buf, len - 1);
+  noecho();
+  curs_set(0);
+  strcpy(dbg->status_shown[0], "\x01");
+  return buf[0] != '\0';
+}
+
+// Check for a key press without waiting
+// Returns true if a key other than a terminal resize was pressed
+static bool poll_key(Debugger *dbg) {
+  nodelay(dbg->status, true);
+  const i32 key = wgetch(dbg->status);
+  nodelay(dbg->status, false);
+  if (key == KEY_RESIZE) {
+    layout(dbg);
+    return false;
+  }
+  return key != ERR;
+}
+
+// Execute `n` instructions one by one, collecting their log messages
+static void run_instructions(Debugger *dbg, Emulator *emu, const u64 n) {
+  const u64 frame_ns = 1000000000 / DEBUGGER_FPS;
+  u64 next_frame = now_ns() + frame_ns;
+  EmuStop stop = EMU_STOP_LIMIT;
+  bool paused = false;
+  u64 i = 0;
+  while (i < n && stop == EMU_STOP_LIMIT) {
+    stop = emu_run(emu, 1);
+    drain_log(dbg, emu);
+    i++;
+    if ((i & 1023) == 0 && now_ns() >= next_frame) {
+      snprintf(dbg->message, sizeof(dbg->message),
+               "Running, %" PRIu64 " instructions left, press any key to pause",
+               n - i);
+      draw(dbg, emu);
+      if (poll_key(dbg)) {
+        paused = true;
+        break;
+      }
+      next_frame = now_ns() + frame_ns;
+    }
+  }
+  if (stop != EMU_STOP_LIMIT) {
+    emu_describe_stop(dbg->message, sizeof(dbg->message), emu, stop);
+  } else {
+    snprintf(dbg->message, sizeof(dbg->message),
+             "%s %" PRIu64 " instruction%s, now at %04X after %" PRIu64
+             " cycles",
+             paused ? "Paused after" : "Ran", i, (i == 1) ? "" : "s",
+             emu->cpu.pc, emu->cycles);
+  }
+}
+
+// Run at full speed until a breakpoint or watchpoint triggers, the emulator
+// halts or a key is pressed
+static void run_free(Debugger *dbg, Emulator *emu) {
+  const u64 frame_ns = 1000000000 / DEBUGGER_FPS;
+  u64 next_frame = now_ns() + frame_ns;
+  emu->debug_output = false;
+  snprintf(dbg->message, sizeof(dbg->message),
+           "Running, press any key to pause");
+  EmuStop stop;
+  bool paused = false;
+  while ((stop = emu_run(emu, DEBUGGER_SLICE_CYCLES)) == EMU_STOP_LIMIT) {
+    if (now_ns() >= next_frame) {
+      draw(dbg, emu);
+      if (poll_key(dbg)) {
+        paused = true;
+        break;
+      }
+      next_frame = now_ns() + frame_ns;
+    }
+  }
+  emu->debug_output = true;
+  if (paused) {
+    snprintf(dbg->message, sizeof(dbg->message),
+             "Paused at %04X after %" PRIu64 " cycles", emu->cpu.pc,
+             emu->cycles);
+  } else {
+    emu_describe_stop(dbg->message, sizeof(dbg->message), emu, stop);
+  }
+}
+
+void debugger_run(Debugger *dbg, Emulator *emu) {
+  memset(dbg, 0, sizeof(Debugger));
+  initscr();
+  cbreak();
+  noecho();
+  curs_set(0);
+  layout(dbg);
+  snprintf(dbg->message, sizeof(dbg->message), "Stopped at %04X",
+           emu->cpu.pc);
+
+  Breakpoints *bp = emu->breakpoints;
+  while (true) {
+    draw(dbg, emu);
+    const i32 key = wgetch(dbg->status);
+    const i32 page = dbg->too_small ? 16 : pane_rows(dbg->memory) * 16;
+    char buf[32];
+    u16 addr;
+    if (key == 'q') {
+      break;
+    } else if (key == KEY_RESIZE) {
+      layout(dbg);
+    } else if (key == 'n') {
+      run_instructions(dbg, emu, 1);
+    } else if (key == 'r') {
+      if (prompt(dbg, "instructions to run: ", buf, sizeof(buf))) {
+        run_instructions(dbg, emu, strtoull(buf, NULL, 10));
+      }
+    } else if (key == 'c') {
+      run_free(dbg, emu);
+    } else if (key == 'u') {
+      if (!prompt(dbg, "run until address: ", buf, sizeof(buf))) {
+        continue;
+      }
+      if (!breakpoint_parse_addr(buf, &addr)) {
+        snprintf(dbg->message, sizeof(dbg->message), "invalid address: %s",
+                 buf);
+        continue;
+      }
+      // a temporary breakpoint, unless there already is one
+      const bool temporary = !breakpoint_test(bp, addr);
+      breakpoint_set(bp, addr);
+      run_free(dbg, emu);
+      if (temporary) {
+        breakpoint_clear(bp, addr);
+      }
+    } else if (key == 'b') {
+      if (!prompt(dbg, "breakpoint address: ", buf, sizeof(buf))) {
+        continue;
+      }
+      if (breakpoint_parse_addr(buf, &addr)) {
+        snprintf(dbg->message, sizeof(dbg->message), "breakpoint at %04X %s",
+                 addr, breakpoint_toggle(bp, addr) ? "set" : "cleared");
+      } else {
+        snprintf(dbg->message, sizeof(dbg->message), "invalid address: %s",
+                 buf);
+      }
+    } else if (key == 'w') {
+      if (!prompt(dbg, "watch START[-END][:r|w|rw]: ", buf, sizeof(buf))) {
+        continue;
+      }
+      if (watchpoint_add_spec(bp, buf)) {
+        snprintf(dbg->message, sizeof(dbg->message), "watchpoint added");
+      } else {
+        snprintf(dbg->message, sizeof(dbg->message), "invalid watchpoint: %s",
+                 buf);
+      }
+    } else if (key == 'd') {
+      // empty for the cycle of the previous diff
+      u64 since = dbg->diff_since;
+      if (prompt(dbg, "changed since cycle: ", buf, sizeof(buf))) {
+        char *end;
+        since = strtoull(buf, &end, 10);
+        if (*end != '\0') {
+          snprintf(dbg->message, sizeof(dbg->message), "invalid cycle: %s",
+                   buf);
+          continue;
+        }
+      }
+      log_changes(dbg, emu, since);
+      dbg->diff_since = emu->cycles;
+    } else if (key == 'g') {
+      if (!prompt(dbg, "show memory at: ", buf, sizeof(buf))) {
+        continue;
+      }
+      if (breakpoint_parse_addr(buf, &addr)) {
+        dbg->memory_base = addr & 0xFFF0;
+      } else {
+        snprintf(dbg->message, sizeof(dbg->message), "invalid address: %s",
+                 buf);
+      }
+    } else if (key == KEY_UP) {
+      dbg->memory_base -= 16;
+    } else if (key == KEY_DOWN) {
+      dbg->memory_base += 16;
+    } else if (key == KEY_PPAGE) {
+      dbg->memory_base -= (u16)page;
+    } else if (key == KEY_NPAGE) {
+      dbg->memory_base += (u16)page;
+    }
+  }
+  endwin();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "breakpoints.h"
+#include "common.h"
+#include "emu6502.h"
+
+#include <ncurses.h>
+
+// Interactive ncurses debugger.
+//
+// The screen is split into registers, code, log, stack and memory panes. Every
+// pane remembers what it last drew in each cell and only repaints the cells
+// whose value changed, so a frame in which nothing happened costs next to
+// nothing. Values that changed since the previous frame are highlighted.
+//
+// When running freely (continue, run-until and long run-N commands) the
+// emulator executes in slices of `DEBUGGER_SLICE_CYCLES` and the screen is
+// only redrawn and the keyboard only polled `DEBUGGER_FPS` times a second.
+
+#define DEBUGGER_FPS 30
+#define DEBUGGER_SLICE_CYCLES 100000
+
+#define DEBUGGER_MAX_ROWS 128
+#define DEBUGGER_LINE_WIDTH 128
+#define DEBUGGER_LOG_LINES 64
+
+// What was last drawn in one cell of a pane
+typedef struct DebuggerCell {
+  u64 value;
+  attr_t attr;
+  bool drawn; // false if the cell must be repainted regardless of its value
+} DebuggerCell;
+
+// Registers pane: PC, SP, A, X, Y (hex and decimal), the 7 flags and cycles
+#define DEBUGGER_REG_CELLS 18
+
+typedef struct Debugger {
+  WINDOW *regs;
+  WINDOW *code;
+  WINDOW *log;
+  WINDOW *stack;
+  WINDOW *memory;
+  WINDOW *status;
+  bool too_small; // the terminal is too small for the panes
+  DebuggerCell reg_cells[DEBUGGER_REG_CELLS];
+  // stack and memory cells are indexed by position on screen
+  DebuggerCell stack_cells[256];
+  i32 stack_shown; // first stack address on screen, -1 if none
+  DebuggerCell memory_cells[DEBUGGER_MAX_ROWS * 16];
+  u16 memory_base;  // first address of the memory pane, a multiple of 16
+  i32 memory_shown; // `memory_base` when the memory pane was drawn, or -1
+  char code_lines[DEBUGGER_MAX_ROWS][DEBUGGER_LINE_WIDTH];
+  char log_lines_shown[DEBUGGER_MAX_ROWS][DEBUGGER_LINE_WIDTH];
+  char status_shown[2][DEBUGGER_LINE_WIDTH];
+  // ring buffer of the emulator's log messages
+  char log_lines[DEBUGGER_LOG_LINES][DEBUGGER_LINE_WIDTH];
+  usize n_log_lines; // total number of lines ever logged
+  u64 diff_since;    // cycle of the last memory diff, the default of the next
+  char message[DEBUGGER_LINE_WIDTH];
+} Debugger;
+
+// Run the debugger until the user quits
+// The emulator must have `breakpoints` and `heatmap` attached and
+// `debug_output` enabled
+void debugger_run(Debugger *dbg, Emulator *emu);
@@ -0,0 +1,85 @@
+#include "disasm.h"
+
+typedef struct ModeFormat {
+  const char *prefix; // between the mnemonic and the operand
+  u8 digits;          // hex digits of the operand
+  const char *suffix;
+  const char *generic; // the operand in `disasm_opcode`
+} ModeFormat;
+
+static const ModeFormat formats[] = {
+    [ADDR_IMPL] = {"", 0, "", ""},
+    [ADDR_A] = {" A", 0, "", " A"},
+    [ADDR_IM] = {" #$", 2, "", " #imm"},
+    [ADDR_ZP] = {" $", 2, "", " zp"},
+    [ADDR_ZPX] = {" $", 2, ",X", " zp,X"},
+    [ADDR_ZPY] = {" $", 2, ",Y", " zp,Y"},
+    [ADDR_ABS] = {" $", 4, "", " abs"},
+    [ADDR_ABSX] = {" $", 4, ",X", " abs,X"},
+    [ADDR_ABSY] = {" $", 4, ",Y", " abs,Y"},
+    [ADDR_IND] = {" ($", 4, ")", " (abs)"},
+    [ADDR_INDX] = {" ($", 2, ",X)", " (zp,X)"},
+    [ADDR_INDY] = {" ($", 2, "),Y", " (zp),Y"},
+    [ADDR_REL] = {" $", 4, "", " rel"},
+    [ADDR_ZPI] = {" ($", 2, ")", " (zp)"},
+    [ADDR_IAX] = {" ($", 4, ",X)", " (abs,X)"},
+};
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char *append(char *out, const char *str) {
+  while (*str != '\0') {
+    *out++ = *str++;
+  }
+  return out;
+}
+
+static char *append_hex(char *out, const u16 x, const u8 digits) {
+  for (u8 i = digits; i > 0; i--) {
+    *out++ = hex_digits[(x >> ((i - 1) * 4)) & 0xF];
+  }
+  return out;
+}
+
+usize disasm_instr(const u8 *mem, const u16 addr, char out[DISASM_MAX_LEN]) {
+  const u8 bytes[3] = {mem[addr], mem[(u16)(addr + 1)], mem[(u16)(addr + 2)]};
+  return disasm_bytes(bytes, addr, out);
+}
+
+usize disasm_bytes(const u8 bytes[3], const u16 addr,
+                   char out[DISASM_MAX_LEN]) {
+  const u8 opcode = bytes[0];
+  const OpcodeInfo *info = &opcode_table[opcode];
+  char *p = out;
+  if (info->length == 0) {
+    p = append(p, ".byte $");
+    p = append_hex(p, opcode, 2);
+    *p = '\0';
+    return 1;
+  }
+  const ModeFormat *format = &formats[info->mode];
+  u16 operand = bytes[1];
+  if (info->length == 3) {
+    operand |= (u16)(bytes[2] << 8);
+  } else if (info->mode == ADDR_REL) {
+    // relative to the next instruction
+    operand = (u16)(addr + 2 + (i8)operand);
+  }
+  p = append(p, info->mnemonic);
+  p = append(p, format->prefix);
+  p = append_hex(p, operand, format->digits);
+  p = append(p, format->suffix);
+  *p = '\0';
+  return info->length;
+}
+
+void disasm_opcode(const u8 opcode, char out[DISASM_MAX_LEN]) {
+  const OpcodeInfo *info = &opcode_table[opcode];
+  if (info->length == 0) {
+    strcpy(out, "???");
+    return;
+  }
+  char *p = append(out, info->mnemonic);
+  p = append(p, formats[info->mode].generic);
+  *p = '\0';
+}
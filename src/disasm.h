@@ -0,0 +1,27 @@
+#pragma once
+
+#include "common.h"
+#include "opcode.h"
+
+// Disassembler built on `opcode_table`.
+//
+// Formatting is done by hand instead of through printf, so disassembling a
+// whole trace or profile costs a table lookup and a few byte copies per
+// instruction.
+
+// Longest disassembled instruction, e.g. `LDA ($12),Y`, including the NUL
+#define DISASM_MAX_LEN 16
+
+// Disassemble the instruction at `addr` into `out`
+// Unknown opcodes are shown as `.byte $XX`
+// Returns the length of the instruction in bytes
+usize disasm_instr(const u8 *mem, u16 addr, char out[DISASM_MAX_LEN]);
+
+// Disassemble the instruction at `addr` whose bytes (at least 3, as many as
+// the longest instruction) are in `bytes`, for memory that is not one flat
+// array, see `bank.h`
+usize disasm_bytes(const u8 bytes[3], u16 addr, char out[DISASM_MAX_LEN]);
+
+// Describe an opcode without its operand, e.g. `LDA (zp),Y`
+// Unknown opcodes are shown as `???`
+void disasm_opcode(u8 opcode, char out[DISASM_MAX_LEN]);
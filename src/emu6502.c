@@ -1,10 +1,17 @@
 #include "emu6502.h"
+#include "bank.h"
 #include "calc.h"
-
-#include <arm/endian.h>
-#include <ncurses.h>
+#include "breakpoints.h"
+#include "callgraph.h"
+#include "heatmap.h"
+#include "profile.h"
+#include "stackguard.h"
+#include "record.h"
+#include "stats.h"
+#include "trace.h"
+
+#include <inttypes.h>
 #include <stdarg.h>
-#include <sys/_endian.h>
 
 #define LPRINTF(EMU, ...)                                                      \
   if (EMU->debug_output) {                                                     \
@@ -13,20 +20,21 @@
     sprintf(buff, __VA_ARGS__);                                                \
   }
 
-void mem_init(u8 *mem) { bzero(mem, MEM_SIZE); }
+void mem_init(u8 *mem) { memset(mem, 0, MEM_SIZE); }
 
 void cpu_reset_sr(CPU *cpu) { cpu->sr.byte = 0; }
 
 void cpu_reset(CPU *cpu) {
-  cpu->pc = 0xFFFC;
-  cpu->sp = 0xFF;
-  cpu_reset_sr(cpu);
+  cpu->pc = 0;
+  cpu->sp = 0xFD;
+  cpu->sr.byte = SR_UNUSED;
+  cpu->sr.bits.i = true;
 }
 
 static inline char zero_or_one(const u8 x) { return (x == 0) ? '0' : '1'; }
 
 void cpu_debug_print(const CPU *cpu) {
-  printw("REG\tHEX\tDEC(u)\tDEC(i)\n"
+  printf("REG\tHEX\tDEC(u)\tDEC(i)\n"
          "PC:\t%04X\t%u\t%d\n"
          "SP:\t%02X\t%u\t%d\n"
          "A:\t%02X\t%u\t%d\n"
@@ -46,29 +54,189 @@ void emu_init(Emulator *emu, bool debug_output) {
   cpu_reset(&emu->cpu);
   mem_init(emu->mem);
   emu->cycles = 0;
+  emu->n_instructions = 0;
+  emu->n_interrupts = 0;
+  emu->n_halts = 0;
   emu->is_running = true;
+  emu->interrupts = 0;
   emu->debug_output = debug_output;
+  emu->tracer = NULL;
+  emu->profiler = NULL;
+  emu->callgraph = NULL;
+  emu->stats = NULL;
+  emu->fusion = false;
+  emu->breakpoints = NULL;
+  emu->recorder = NULL;
+  emu->heatmap = NULL;
+  emu->stack_guard = NULL;
+#ifdef EMU_BANKING
+  bank_attach(emu, NULL);
+#endif
+}
+
+// Log an input from the host if a recorder is attached
+static inline void note_input(Emulator *emu, RecordEvent event) {
+  if (emu->recorder != NULL) {
+    event.cycle = emu->cycles;
+    event.halted = !emu->is_running;
+    recorder_note(emu->recorder, &event);
+  }
+}
+
+void emu_reset(Emulator *emu) {
+  note_input(emu, (RecordEvent){.kind = RECORD_RESET});
+  cpu_reset(&emu->cpu);
+  emu->cpu.pc = emu_read_mem_word(emu, RESET_VECTOR);
+  emu->interrupts = 0;
+  emu->is_running = true;
+  // the reset sequence takes as long as an interrupt
+  emu->cycles += 7;
+}
+
+void emu_cold_boot(Emulator *emu, const Emulator *boot) {
+  memcpy(emu, boot, offsetof(Emulator, log_buf));
+  emu->log_buf[0] = '\0';
+#ifdef EMU_BANKING
+  if (emu->banks != NULL && boot->banks != NULL && emu->banks != boot->banks) {
+    memcpy(emu->banks->data, boot->banks->data,
+           (emu->banks->size < boot->banks->size) ? emu->banks->size
+                                                  : boot->banks->size);
+  }
+  bank_refresh(emu);
+#endif
+}
+
+void emu_nmi(Emulator *emu) {
+  note_input(emu, (RecordEvent){.kind = RECORD_NMI});
+  emu->interrupts |= EMU_INT_NMI;
+}
+
+void emu_set_irq(Emulator *emu, const bool asserted) {
+  note_input(emu, (RecordEvent){.kind = asserted ? RECORD_IRQ_ON
+                                                 : RECORD_IRQ_OFF});
+  if (asserted) {
+    emu->interrupts |= EMU_INT_IRQ;
+  } else {
+    emu->interrupts &= (u8)~EMU_INT_IRQ;
+  }
+}
+
+// Bus timing. By default `emu_tick` charges the base cycles of an instruction
+// from `opcode_table` up front and handlers only add penalties, which is all
+// that matters for throughput. Built with `EMU_CYCLE_EXACT` defined, every bus
+// access instead takes its own cycle as it happens, including the dummy reads
+// and writes the 6502 makes while it is busy internally, so `emu->cycles` is
+// exact at each access. Both modes run the same handlers below; only these
+// primitives differ.
+#ifdef EMU_CYCLE_EXACT
+#define BUS_CYCLE(EMU) ((EMU)->cycles++)
+#else
+#define BUS_CYCLE(EMU)
+#endif
+
+// A bus access whose value the CPU ignores
+// Nothing is attached to the bus that could observe it, so it only takes its
+// cycle
+static inline void dummy_access(Emulator *emu, const u16 addr) {
+  (void)addr;
+  BUS_CYCLE(emu);
+}
+
+// Memory as the CPU sees it. With `EMU_BANKING` every access goes through the
+// page tables of `bank.h`, otherwise `mem` is the whole address space.
+
+// the byte at `addr`, without taking a bus cycle
+static inline u8 peek(const Emulator *emu, const u16 addr) {
+#ifdef EMU_BANKING
+  return emu->read_pages[addr >> 8][addr & 0xFF];
+#else
+  return emu->mem[addr];
+#endif
+}
+
+// write the byte at `addr`, without taking a bus cycle
+static inline void poke(Emulator *emu, const u16 addr, const u8 byte) {
+#ifdef EMU_BANKING
+  u8 *page = emu->write_pages[addr >> 8];
+  if (__builtin_expect(page == NULL, 0)) {
+    // read-only, see `Banks.on_rom_write`
+    if (emu->banks != NULL && emu->banks->on_rom_write != NULL) {
+      emu->banks->on_rom_write(emu, addr, byte);
+    }
+    return;
+  }
+  page[addr & 0xFF] = byte;
+#else
+  emu->mem[addr] = byte;
+#endif
 }
 
 // fetch 1 byte from memory on position of PC
 static inline u8 fetch_byte(Emulator *emu) {
-  u8 data = emu->mem[emu->cpu.pc];
+  BUS_CYCLE(emu);
+  u8 data = peek(emu, emu->cpu.pc);
   emu->cpu.pc++;
   return data;
 }
 
+// A little endian word at `addr`, in one load unless it wraps around from
+// $FFFF to $0000 like the 6502's address bus, or with `EMU_BANKING` crosses
+// into a page that may be mapped elsewhere
+static inline u16 mem_word(const Emulator *emu, const u16 addr) {
+#ifdef EMU_BANKING
+  if (__builtin_expect((addr & 0xFF) == 0xFF, 0)) {
+    return (u16)(peek(emu, addr) | peek(emu, (u16)(addr + 1)) << 8);
+  }
+  return read_le16(&emu->read_pages[addr >> 8][addr & 0xFF]);
+#else
+  if (__builtin_expect(addr == 0xFFFF, 0)) {
+    return (u16)(emu->mem[0xFFFF] | emu->mem[0] << 8);
+  }
+  return read_le16(&emu->mem[addr]);
+#endif
+}
+
 // fetch 2 bytes from memory on position of PC
-// swap bytes if host is big endian
 static inline u16 fetch_word(Emulator *emu) {
-  // 6502 uses little endian
-  u16 data = emu->mem[emu->cpu.pc];
-  emu->cpu.pc++;
-  data |= emu->mem[emu->cpu.pc] << 8;
-  emu->cpu.pc++;
+#ifdef EMU_CYCLE_EXACT
+  // one bus cycle each
+  u16 data = fetch_byte(emu);
+  data |= fetch_byte(emu) << 8;
+#else
+  const u16 data = mem_word(emu, emu->cpu.pc);
+  emu->cpu.pc += 2;
+#endif
+  return data;
+}
 
-  data = ntohs(data);
+// read 1 byte of data from memory
+// every load performed by an instruction (as opposed to fetching the
+// instruction itself) goes through here
+static inline u8 load_byte(Emulator *emu, const u16 addr) {
+  BUS_CYCLE(emu);
+  if (emu->breakpoints != NULL) {
+    watchpoint_check(emu->breakpoints, addr, WATCH_READ);
+  }
+  if (emu->heatmap != NULL) {
+    heatmap_read(emu->heatmap, addr);
+  }
+  return peek(emu, addr);
+}
 
-  return data;
+// write 1 byte to memory
+// every store performed by an instruction goes through here
+static inline void store_byte(Emulator *emu, const u16 addr, const u8 byte) {
+  BUS_CYCLE(emu);
+  if (emu->tracer != NULL) {
+    trace_note_write(emu->tracer, addr, byte);
+  }
+  if (emu->breakpoints != NULL) {
+    watchpoint_check(emu->breakpoints, addr, WATCH_WRITE);
+  }
+  if (emu->heatmap != NULL) {
+    heatmap_write(emu->heatmap, addr, emu->cycles, true);
+  }
+  poke(emu, addr, byte);
 }
 
 // result of an address fetch which leads to a page cross (which will cause one
@@ -78,19 +246,45 @@ struct addr_fetch_result {
   bool page_crossed;
 };
 
+// the extra cycle of a load whose indexed address crossed a page boundary,
+// which stores and read-modify-writes always spend (see `fixup_cycle`)
+static inline void page_cross_penalty(Emulator *emu) {
+  emu->cycles++;
+  if (emu->stats != NULL) {
+    opcode_stats_page_cross(emu->stats);
+  }
+}
+
+// count the outcome of a conditional branch
+static inline void count_branch(Emulator *emu, const bool taken) {
+  if (emu->stats != NULL) {
+    opcode_stats_branch(emu->stats, taken);
+  }
+}
+
 // get an address on the position of PC by addressing mode Zero Page
 static inline u16 fetch_addr_zp(Emulator *emu) { return fetch_byte(emu); }
 
 // get an address on the position of PC by addressing mode Zero Page X
+// the index wraps around within the zero page
 static inline u16 fetch_addr_zpx(Emulator *emu) {
-  const u16 addr0 = fetch_byte(emu) + emu->cpu.x;
-  return emu_read_mem_word(emu, addr0);
+  const u8 addr0 = fetch_byte(emu);
+  dummy_access(emu, addr0); // while adding X
+  return (u8)(addr0 + emu->cpu.x);
 }
 
 // get an address on the position of PC by addressing mode Zero Page Y
 static inline u16 fetch_addr_zpy(Emulator *emu) {
-  const u16 addr0 = fetch_byte(emu);
-  return emu_read_mem_word(emu, addr0 + emu->cpu.y);
+  const u8 addr0 = fetch_byte(emu);
+  dummy_access(emu, addr0); // while adding Y
+  return (u8)(addr0 + emu->cpu.y);
+}
+
+// read a pointer from the zero page, wrapping around within it
+static inline u16 load_zp_word(Emulator *emu, const u8 addr) {
+  u16 data = load_byte(emu, addr);
+  data |= load_byte(emu, (u8)(addr + 1)) << 8;
+  return data;
 }
 
 // get an address on the position of PC by addressing mode Absolute
@@ -114,19 +308,52 @@ static inline struct addr_fetch_result fetch_addr_absy(Emulator *emu) {
 
 // get an address on the position of PC by addressing mode (Indirect,X)
 static inline u16 fetch_addr_indx(Emulator *emu) {
-  const u16 addr0 = fetch_word(emu) + emu->cpu.x;
-  const u16 addr1 = emu_read_mem_word(emu, addr0);
-  return addr1;
+  const u8 addr0 = fetch_byte(emu);
+  dummy_access(emu, addr0); // while adding X
+  return load_zp_word(emu, (u8)(addr0 + emu->cpu.x));
 }
 
 // get an address on the position of PC by addressing mode (Indirect),Y
 static inline struct addr_fetch_result fetch_addr_indy(Emulator *emu) {
-  const u16 addr0 = fetch_word(emu);
-  const u16 addr1 = emu_read_mem_word(emu, addr0) + emu->cpu.y;
+  const u16 addr0 = load_zp_word(emu, fetch_byte(emu));
+  const u16 addr1 = addr0 + emu->cpu.y;
   const bool page_crossed = ((addr0 & 0xFF00) != (addr1 & 0xFF00));
   return (struct addr_fetch_result){addr1, page_crossed};
 }
 
+// Indexed stores and read-modify-writes always spend the cycle that reads
+// (without effect) from the address before the carry into its high byte
+static inline u16 fixup_cycle(Emulator *emu,
+                              const struct addr_fetch_result result) {
+  dummy_access(emu, result.page_crossed ? (u16)(result.addr - 0x100)
+                                        : result.addr);
+  return result.addr;
+}
+
+// The address of ASL, LSR, ROL and ROR abs,X, which the NMOS 6502 handles like
+// any other read-modify-write and the 65C02 like a load, only spending the
+// fixup cycle when the index crosses a page
+static inline u16 fetch_addr_shift_absx(Emulator *emu) {
+#ifdef EMU_CPU_65C02
+  const auto result = fetch_addr_absx(emu);
+  if (result.page_crossed) {
+    page_cross_penalty(emu);
+  }
+  return result.addr;
+#else
+  return fixup_cycle(emu, fetch_addr_absx(emu));
+#endif
+}
+
+// Read-modify-write: the 6502 writes the unmodified value back while it
+// computes the result
+static inline void modify(Emulator *emu, const u16 addr,
+                          u8 (*op)(Emulator *, u8)) {
+  const u8 x = load_byte(emu, addr);
+  dummy_access(emu, addr);
+  store_byte(emu, addr, op(emu, x));
+}
+
 // update flags in the CPU according to a byte
 static inline void set_nz_flags(Emulator *emu, const u8 byte) {
   emu->cpu.sr.bits.z = (byte == 0);
@@ -167,32 +394,48 @@ static inline void cmp_y(Emulator *emu, const u8 rhs) {
   cmp(emu, emu->cpu.y, rhs);
 }
 
+// Set the flags and A after ADC or SBC
+static inline void set_adc_result(Emulator *emu, const struct adc_result r) {
+  LPRINTF(emu, "= %02X(s) ... %1X(c)\n", r.result, r.carry);
+  emu->cpu.a = r.result;
+  emu->cpu.sr.bits.c = r.carry;
+  emu->cpu.sr.bits.v = r.overflow;
+  emu->cpu.sr.bits.n = r.negative;
+  emu->cpu.sr.bits.z = r.zero;
+}
+
+// The 65C02 spends an extra cycle on decimal ADC and SBC to fix N and Z
+static inline void decimal_cycle(Emulator *emu) {
+#ifdef EMU_CPU_65C02
+  if (emu->cpu.sr.bits.d) {
+    emu->cycles++;
+  }
+#else
+  (void)emu;
+#endif
+}
+
 static inline void op_adc(Emulator *emu, const u8 rhs) {
-  const auto f = emu->cpu.sr.bits.d ? carrying_bcd_add_u8 : carrying_add_u8;
-  const auto sum_carry = f(emu->cpu.a, rhs, emu->cpu.sr.bits.c);
-  LPRINTF(
-      emu,
-      "%02X(a) + %02X(m) + %01X(c) = %02X(s) ... %1X(c)\ndecimal mode: %s\n",
-      emu->cpu.a, rhs, emu->cpu.sr.bits.c, sum_carry.result, sum_carry.carry,
-      emu->cpu.sr.bits.d ? "on" : "off");
-  set_nz_flags_a(emu);
-  emu->cpu.sr.bits.c = sum_carry.carry;
-  emu->cpu.sr.bits.v = sum_carry.carry;
-  emu->cpu.a = sum_carry.result;
+  LPRINTF(emu, "%02X(a) + %02X(m) + %01X(c) decimal mode: %s\n", emu->cpu.a,
+          rhs, emu->cpu.sr.bits.c, emu->cpu.sr.bits.d ? "on" : "off");
+  decimal_cycle(emu);
+  set_adc_result(emu, emu->cpu.sr.bits.d
+                          ? carrying_bcd_add_u8(emu->cpu.a, rhs,
+                                                emu->cpu.sr.bits.c)
+                          : carrying_add_u8(emu->cpu.a, rhs,
+                                            emu->cpu.sr.bits.c));
 }
 
+// A - M - (1 - C), i.e. the carry is clear when the subtraction borrows
 static inline void op_sbc(Emulator *emu, const u8 rhs) {
-  const auto f = emu->cpu.sr.bits.d ? carrying_bcd_sub_u8 : carrying_sub_u8;
-  const auto dif_carry = f(emu->cpu.a, rhs, emu->cpu.sr.bits.c);
-  LPRINTF(
-      emu,
-      "%02X(a) - %02X(m) - %01X(c) = %02X(s) ... %1X(c)\ndecimal mode: %s\n",
-      emu->cpu.a, rhs, emu->cpu.sr.bits.c, dif_carry.result, dif_carry.carry,
-      emu->cpu.sr.bits.d ? "on" : "off");
-  set_nz_flags_a(emu);
-  emu->cpu.sr.bits.c = dif_carry.carry;
-  emu->cpu.sr.bits.v = dif_carry.carry;
-  emu->cpu.a = dif_carry.result;
+  LPRINTF(emu, "%02X(a) - %02X(m) - %01X(!c) decimal mode: %s\n", emu->cpu.a,
+          rhs, !emu->cpu.sr.bits.c, emu->cpu.sr.bits.d ? "on" : "off");
+  decimal_cycle(emu);
+  set_adc_result(emu, emu->cpu.sr.bits.d
+                          ? carrying_bcd_sub_u8(emu->cpu.a, rhs,
+                                                emu->cpu.sr.bits.c)
+                          : carrying_add_u8(emu->cpu.a, (u8)~rhs,
+                                            emu->cpu.sr.bits.c));
 }
 
 static inline void op_and(Emulator *emu, const u8 rhs) {
@@ -211,7 +454,6 @@ static inline void op_eor(Emulator *emu, const u8 rhs) {
 }
 
 static inline void op_bit(Emulator *emu, const u8 x) {
-  cpu_reset_sr(&emu->cpu);
   emu->cpu.sr.bits.n = (x & 0b10000000) >> 7;
   emu->cpu.sr.bits.v = (x & 0b01000000) >> 6;
   emu->cpu.sr.bits.z = ((x & emu->cpu.a) == 0);
@@ -230,13 +472,28 @@ static inline u8 op_asl(Emulator *emu, const u8 x) {
 // Returns the result value.
 static inline u8 op_lsr(Emulator *emu, const u8 x) {
   const u8 result = (x >> 1);
-  cpu_reset_sr(&emu->cpu);
   emu->cpu.sr.bits.n = false;
   emu->cpu.sr.bits.z = (result == 0);
   emu->cpu.sr.bits.c = ((x & 0b00000001) != 0);
   return result;
 }
 
+// Performs DEC operation
+// Returns the result value.
+static inline u8 op_dec(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x - 1);
+  set_nz_flags(emu, result);
+  return result;
+}
+
+// Performs INC operation
+// Returns the result value.
+static inline u8 op_inc(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x + 1);
+  set_nz_flags(emu, result);
+  return result;
+}
+
 // Performs ROL operation
 // Returns the result value.
 static inline u8 op_rol(Emulator *emu, const u8 x) {
@@ -255,19 +512,106 @@ static inline u8 op_ror(Emulator *emu, const u8 x) {
   return result;
 }
 
+#ifdef EMU_CPU_6502X
+// The read-modify-write undocumented opcodes: a shift or increment in memory
+// followed by an operation on A with the result
+
+static inline u8 op_slo(Emulator *emu, const u8 x) {
+  const u8 result = op_asl(emu, x);
+  op_ora(emu, result);
+  return result;
+}
+
+static inline u8 op_rla(Emulator *emu, const u8 x) {
+  const u8 result = op_rol(emu, x);
+  op_and(emu, result);
+  return result;
+}
+
+static inline u8 op_sre(Emulator *emu, const u8 x) {
+  const u8 result = op_lsr(emu, x);
+  op_eor(emu, result);
+  return result;
+}
+
+static inline u8 op_rra(Emulator *emu, const u8 x) {
+  const u8 result = op_ror(emu, x);
+  op_adc(emu, result);
+  return result;
+}
+
+static inline u8 op_dcp(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x - 1);
+  cmp_a(emu, result);
+  return result;
+}
+
+static inline u8 op_isc(Emulator *emu, const u8 x) {
+  const u8 result = (u8)(x + 1);
+  op_sbc(emu, result);
+  return result;
+}
+
+static inline void op_lax(Emulator *emu, const u8 x) {
+  emu->cpu.a = x;
+  emu->cpu.x = x;
+  set_nz_flags(emu, x);
+}
+
+// AND #imm then ROR A, with C and V taken from bits 6 and 5 of the result,
+// and in decimal mode an adjustment of each digit like after an ADC
+static inline void op_arr(Emulator *emu, const u8 rhs) {
+  const u8 x = emu->cpu.a & rhs;
+  u8 result = (x >> 1) | (u8)(emu->cpu.sr.bits.c << 7);
+  set_nz_flags(emu, result);
+  if (!emu->cpu.sr.bits.d) {
+    emu->cpu.sr.bits.c = (result >> 6) & 1;
+    emu->cpu.sr.bits.v = ((result >> 6) ^ (result >> 5)) & 1;
+    emu->cpu.a = result;
+    return;
+  }
+  // N and Z are those of the binary result, V compares bit 6 before and after
+  emu->cpu.sr.bits.v = ((x ^ result) >> 6) & 1;
+  if ((x & 0x0F) + (x & 0x01) > 0x05) {
+    result = (u8)((result & 0xF0) | ((result + 0x06) & 0x0F));
+  }
+  emu->cpu.sr.bits.c = (x >> 4) + ((x >> 4) & 0x01) > 0x05;
+  if (emu->cpu.sr.bits.c) {
+    result = (u8)(result + 0x60);
+  }
+  emu->cpu.a = result;
+}
+#endif
+
+#ifdef EMU_CPU_65C02
+// TSB: set the bits of A in memory, Z from the bits they had in common
+static inline u8 op_tsb(Emulator *emu, const u8 x) {
+  emu->cpu.sr.bits.z = ((x & emu->cpu.a) == 0);
+  return x | emu->cpu.a;
+}
+
+// TRB: clear the bits of A in memory, Z from the bits they had in common
+static inline u8 op_trb(Emulator *emu, const u8 x) {
+  emu->cpu.sr.bits.z = ((x & emu->cpu.a) == 0);
+  return x & (u8)~emu->cpu.a;
+}
+
+// get an address on the position of PC by addressing mode (Zero Page)
+static inline u16 fetch_addr_zpi(Emulator *emu) {
+  return load_zp_word(emu, fetch_byte(emu));
+}
+#endif
+
 // Performs a branch operation by relative addressing mode.
 // Will fetch a byte forward.
-// Also increments cycle by 1 or 2.
-// Still requires cycle to increment by 2 outside of this function.
+// Also increments cycle by 1 or 2, on top of the base cycles of the branch,
+// which are the dummy reads of the 6502 while it adds the offset.
 // Returns target address.
 static inline u16 branch_rel(Emulator *emu) {
-  const u16 current = emu->cpu.pc - 1;
-  const u8 addr_rel = fetch_byte(emu);
-  const u16 target_addr = ((addr_rel & 0b10000000) == 0)
-                              // positive
-                              ? current + addr_rel
-                              // negative
-                              : current - (0xFF - addr_rel + 1);
+  const i8 offset = (i8)fetch_byte(emu);
+  // relative to the next instruction
+  const u16 target_addr = (u16)(emu->cpu.pc + offset);
+  count_branch(emu, true);
   emu->cycles++;
   if ((emu->cpu.pc & 0xFF00) != (target_addr & 0xFF00)) {
     emu->cycles++;
@@ -277,240 +621,322 @@ static inline u16 branch_rel(Emulator *emu) {
 }
 
 static inline void stack_push(Emulator *emu, const u8 byte) {
-  emu->mem[0x0100 | (u16)emu->cpu.sp] = byte;
+  if (emu->stack_guard != NULL) {
+    stack_guard_push(emu->stack_guard, emu->cpu.sp, emu->cycles);
+  }
+  store_byte(emu, 0x0100 | (u16)emu->cpu.sp, byte);
   emu->cpu.sp--;
 }
 
 static inline u8 stack_pull(Emulator *emu) {
+  if (emu->stack_guard != NULL) {
+    stack_guard_pull(emu->stack_guard, emu->cpu.sp, emu->cycles);
+  }
   emu->cpu.sp++;
   const u16 p = 0x0100 | (u16)emu->cpu.sp;
-  return emu->mem[p];
+  return load_byte(emu, p);
 }
 
-// Push the current values of SR and PC onto the stack
-// Used for function call
-static inline void push_callstack(Emulator *emu) {
-  const u16 pc = emu->cpu.pc;
+// Push a return address, high byte first so it ends up little endian
+static inline void push_pc(Emulator *emu, const u16 pc) {
   LPRINTF(emu, "PC pushed: %04X\n", pc);
-  stack_push(emu, pc & 0x00FF);
-  stack_push(emu, pc >> 8);
-  stack_push(emu, emu->cpu.sr.byte);
+  stack_push(emu, (u8)(pc >> 8));
+  stack_push(emu, (u8)pc);
 }
 
-// Pull the value of SR and PC from the stack.
-// Used for function return
-static inline void pull_callstack(Emulator *emu) {
-  emu->cpu.sr.byte = stack_pull(emu);
-  u16 pc = (u16)(stack_pull(emu) << 8);
-  pc |= stack_pull(emu);
-  emu->cpu.pc = pc;
+static inline u16 pull_pc(Emulator *emu) {
+  u16 pc = stack_pull(emu);
+  pc |= (u16)(stack_pull(emu) << 8);
   LPRINTF(emu, "PC pulled: %04X\n", pc);
+  return pc;
+}
+
+// Push PC and SR and jump to the handler in `vector`
+// `b` is `SR_B` for BRK and 0 for hardware interrupts
+static inline void enter_interrupt(Emulator *emu, const u16 vector,
+                                   const u8 b) {
+  push_pc(emu, emu->cpu.pc);
+  stack_push(emu, emu->cpu.sr.byte | SR_UNUSED | b);
+  emu->cpu.sr.bits.i = true;
+#ifdef EMU_CPU_65C02
+  // handlers start in binary mode
+  emu->cpu.sr.bits.d = false;
+#endif
+  u16 pc = load_byte(emu, vector);
+  pc |= load_byte(emu, vector + 1) << 8;
+  emu->cpu.pc = pc;
+}
+
+// SR pulled by PLP and RTI, B and the unused bit are not real flags
+static inline void pull_sr(Emulator *emu) {
+  emu->cpu.sr.byte = (u8)((stack_pull(emu) & ~SR_B) | SR_UNUSED);
+}
+
+// Enter the handler of a pending interrupt unless it is masked
+// Returns true if an interrupt was taken
+static bool take_interrupt(Emulator *emu) {
+  u16 vector;
+  if ((emu->interrupts & EMU_INT_NMI) != 0) {
+    emu->interrupts &= (u8)~EMU_INT_NMI;
+    LPRINTF(emu, "NMI\n");
+    vector = NMI_VECTOR;
+  } else if (!emu->cpu.sr.bits.i) {
+    LPRINTF(emu, "IRQ\n");
+    vector = IRQ_VECTOR;
+  } else {
+    return false;
+  }
+  emu->n_interrupts++;
+  if (emu->tracer != NULL) {
+    trace_note_interrupt(emu->tracer,
+                         (vector == NMI_VECTOR) ? EMU_INT_NMI : EMU_INT_IRQ);
+  }
+#ifdef EMU_CYCLE_EXACT
+  // the opcode fetch that is thrown away and the operand read of BRK
+  dummy_access(emu, emu->cpu.pc);
+  dummy_access(emu, emu->cpu.pc);
+#else
+  emu->cycles += 7;
+#endif
+  enter_interrupt(emu, vector, 0);
+  return true;
 }
 
 void emu_print_stack(const Emulator *emu) {
-  printw("\t_0 _1 _2 _3 _4 _5 _6 _7 _8 _9 _A _B _C _D _E _F\n");
-  for (usize i = STACK_FLOOR; i <= STACK_LIMIT; i += 16) {
-    printw("%04X\t%02X %02X %02X %02X %02X %02X %02X %02X "
-           "%02X %02X %02X %02X %02X %02X %02X %02X\n",
-           (u16)i, emu->mem[i], emu->mem[i + 1], emu->mem[i + 2],
-           emu->mem[i + 3], emu->mem[i + 4], emu->mem[i + 5], emu->mem[i + 6],
-           emu->mem[i + 7], emu->mem[i + 8], emu->mem[i + 9], emu->mem[i + 10],
-           emu->mem[i + 11], emu->mem[i + 12], emu->mem[i + 13],
-           emu->mem[i + 14], emu->mem[i + 15]);
+  printf("\t_0 _1 _2 _3 _4 _5 _6 _7 _8 _9 _A _B _C _D _E _F\n");
+  for (u16 row = STACK_FLOOR; row <= STACK_LIMIT; row += 16) {
+    printf("%04X\t", row);
+    for (u16 i = 0; i < 16; i++) {
+      printf("%02X%c", peek(emu, (u16)(row + i)), (i == 15) ? '\n' : ' ');
+    }
   }
 }
 
 u8 emu_read_mem_byte(const Emulator *emu, const u16 addr) {
-  return emu->mem[addr];
+  return peek(emu, addr);
 }
 
 u16 emu_read_mem_word(const Emulator *emu, const u16 addr) {
-  // 6502 uses little endian
-  u16 data = emu->mem[addr];
-  data |= emu->mem[addr + 1] << 8;
+  return mem_word(emu, addr);
+}
 
-  data = htons(data);
+void emu_write_mem_byte(Emulator *emu, const u16 addr, const u8 byte) {
+  note_input(emu, (RecordEvent){.kind = RECORD_WRITE, .addr = addr,
+                                .value = byte});
+  if (emu->heatmap != NULL) {
+    heatmap_write(emu->heatmap, addr, emu->cycles, false);
+  }
+#ifdef EMU_BANKING
+  emu->read_pages[addr >> 8][addr & 0xFF] = byte;
+#else
+  emu->mem[addr] = byte;
+#endif
+}
 
-  return data;
+void emu_set_cpu(Emulator *emu, const CPU *cpu) {
+  note_input(emu, (RecordEvent){.kind = RECORD_CPU, .cpu = *cpu});
+  emu->cpu = *cpu;
+}
+
+// Count an instruction whose opcode was just fetched and charge its cycles
+static inline void begin_instruction(Emulator *emu, const u8 opcode) {
+  emu->n_instructions++;
+#ifdef EMU_CYCLE_EXACT
+  // instructions without operands read the next byte anyway
+  if (opcode_table[opcode].length == 1) {
+    dummy_access(emu, emu->cpu.pc);
+  }
+#else
+  // the base cycles, handlers only add the penalties for page crosses and taken
+  // branches
+  emu->cycles += opcode_table[opcode].cycles;
+#endif
 }
 
 void emu_tick(Emulator *emu) {
-#define PRINT_STAT(...)                                                        \
-  if (emu->debug_output) {                                                     \
-    printw(""__VA_ARGS__);                                                     \
-    printw("Opcode:\t0x%02X\n"                                                 \
-           "Addr:\t0x%04X\n"                                                   \
-           "Cycles:\t%llu\n"                                                   \
-           "CPU status:\n",                                                    \
-           opcode, emu->cpu.pc - 1, emu->cycles);                              \
-    cpu_debug_print(&emu->cpu);                                                \
-    printw("Stack:\n");                                                        \
-    emu_print_stack(emu);                                                      \
-    printw("log: -----------\n%s----------\n", emu->log_buf);                  \
-    bzero(&emu->log_buf, LOG_BUF_SIZE);                                        \
+// Superinstructions: if the next instruction is `NEXT`, run its handler right
+// away instead of going back through the dispatch switch.
+#define FUSE(NEXT, LABEL)                                                      \
+  if (emu->fusion && peek(emu, emu->cpu.pc) == (NEXT)) {                       \
+    fetch_byte(emu);                                                           \
+    begin_instruction(emu, NEXT);                                              \
+    goto LABEL;                                                                \
   }
 
+  if (emu->tracer != NULL) {
+    trace_start(emu->tracer);
+  }
+  // the profile charges an interrupt entry to the handler's first instruction
+  const u64 tick_start = emu->cycles;
+  if (emu->interrupts != 0 && take_interrupt(emu) &&
+      emu->breakpoints != NULL &&
+      breakpoint_test(emu->breakpoints, emu->cpu.pc)) {
+    // stop before the handler so `emu_run` sees the breakpoint on its entry;
+    // the next tick runs it, adding the entry to its trace record and profile
+    if (emu->tracer != NULL) {
+      trace_hold(emu->tracer);
+    }
+    if (emu->profiler != NULL) {
+      profile_charge(emu->profiler, emu->cpu.pc, emu->cycles - tick_start);
+    }
+    return;
+  }
+  const u16 pc = emu->cpu.pc;
+  const u64 cycles_before = emu->cycles;
   const u8 opcode = fetch_byte(emu);
+  if (emu->tracer != NULL) {
+    trace_begin(emu->tracer, pc, opcode);
+  }
+  if (emu->stats != NULL) {
+    opcode_stats_begin(emu->stats, opcode);
+  }
+  if (emu->heatmap != NULL) {
+    heatmap_exec(emu->heatmap, pc);
+  }
 
+  begin_instruction(emu, opcode);
   switch (opcode) {
   // ADC
+  fused_adc_im:
   case OPCODE_ADC_IM: {
     const u8 rhs = fetch_byte(emu);
     op_adc(emu, rhs);
-    emu->cycles += 2;
   } break;
   case OPCODE_ADC_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    op_adc(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    op_adc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ADC_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    op_adc(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_adc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ADC_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    op_adc(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_adc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ADC_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_adc(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_adc(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_ADC_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_adc(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_adc(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_ADC_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    op_adc(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    op_adc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ADC_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_adc(emu, emu->mem[result.addr]);
-    emu->cycles += 5;
+    op_adc(emu, load_byte(emu, result.addr));
   } break;
 
   // AND
   case OPCODE_AND_IM: {
     const u8 rhs = fetch_byte(emu);
     op_and(emu, rhs);
-    emu->cycles += 2;
   } break;
   case OPCODE_AND_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    op_and(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    op_and(emu, load_byte(emu, addr));
   } break;
   case OPCODE_AND_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    op_and(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_and(emu, load_byte(emu, addr));
   } break;
   case OPCODE_AND_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    op_and(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_and(emu, load_byte(emu, addr));
   } break;
   case OPCODE_AND_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_and(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_and(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_AND_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_and(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_and(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_AND_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    op_and(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    op_and(emu, load_byte(emu, addr));
   } break;
   case OPCODE_AND_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_and(emu, emu->mem[result.addr]);
-    emu->cycles += 5;
+    op_and(emu, load_byte(emu, result.addr));
   } break;
 
     // ASL
   case OPCODE_ASL_A: {
     emu->cpu.a = op_asl(emu, emu->cpu.a);
-    emu->cycles += 2;
   } break;
   case OPCODE_ASL_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->mem[addr] = op_asl(emu, emu->mem[addr]);
-    emu->cycles += 5;
+    modify(emu, addr, op_asl);
   } break;
   case OPCODE_ASL_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    emu->mem[addr] = op_asl(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_asl);
   } break;
   case OPCODE_ASL_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    emu->mem[addr] = op_asl(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_asl);
   } break;
   case OPCODE_ASL_ABSX: {
-    const u16 addr = fetch_addr_absx(emu).addr;
-    emu->mem[addr] = op_asl(emu, emu->mem[addr]);
-    emu->cycles += 7;
+    const u16 addr = fetch_addr_shift_absx(emu);
+    modify(emu, addr, op_asl);
   } break;
 
     // BCC
   case OPCODE_BCC_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.c == false) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BCC: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BCC: not jumped\n");
     }
   } break;
 
     // BCS
   case OPCODE_BCS_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.c == true) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BCS: 0x%04X\n", target_addr);
     } else {
-      emu->cpu.pc++;
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BCS: not jumped\n");
     }
   } break;
 
     // BEQ
+  fused_beq_rel:
   case OPCODE_BEQ_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.z == true) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BEQ: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BEQ: not jumped\n");
     }
   } break;
@@ -518,77 +944,92 @@ void emu_tick(Emulator *emu) {
     // BIT
   case OPCODE_BIT_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    op_bit(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    op_bit(emu, load_byte(emu, addr));
   } break;
 
     // BIT
   case OPCODE_BIT_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    op_bit(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_bit(emu, load_byte(emu, addr));
   } break;
 
     // BMI
   case OPCODE_BMI_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.n == true) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BMI: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BMI: not jumped\n");
     }
   } break;
 
     // BNE
+  fused_bne_rel:
   case OPCODE_BNE_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.z == false) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BNE: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BNE: not jumped\n");
     }
   } break;
 
     // BPL
   case OPCODE_BPL_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.n == false) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BPL: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BPL: not jumped\n");
     }
   } break;
 
     // BRK
   case OPCODE_BRK: {
+    // with no handler installed there is nothing sensible to run, so treat BRK
+    // as the end of the program
+    if (emu_read_mem_word(emu, IRQ_VECTOR) == 0) {
+      LPRINTF(emu, "Halted (BRK without a handler)\n");
+      emu->is_running = false;
+      emu->n_halts++;
+#ifdef EMU_CYCLE_EXACT
+      // the rest of the BRK, so both modes agree on the cycles
+      emu->cycles += 5;
+#endif
+      break;
+    }
     LPRINTF(emu, "Interrupted (BRK)\n");
-    cpu_reset_sr(&emu->cpu);
-    push_callstack(emu);
-    emu->cpu.sr.bits.i = true;
-    emu->is_running = false;
+    // BRK skips the byte after it, which handlers may use as an argument
+    emu->cpu.pc++;
+    enter_interrupt(emu, IRQ_VECTOR, SR_B);
   } break;
 
     // BVC
   case OPCODE_BVC_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.v == false) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BVC: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BVC: not jumped\n");
     }
   } break;
 
     // BVS
   case OPCODE_BVS_REL: {
-    emu->cycles += 2;
     if (emu->cpu.sr.bits.v == true) {
       const u16 target_addr = branch_rel(emu);
       LPRINTF(emu, "BVS: 0x%04X\n", target_addr);
     } else {
+      fetch_byte(emu); // the offset
+      count_branch(emu, false);
       LPRINTF(emu, "BVS: not jumped\n");
     }
   } break;
@@ -596,255 +1037,208 @@ void emu_tick(Emulator *emu) {
     // CLC
   case OPCODE_CLC: {
     emu->cpu.sr.bits.c = false;
-    emu->cycles += 2;
+    FUSE(OPCODE_ADC_IM, fused_adc_im);
   } break;
 
     // CLD
   case OPCODE_CLD: {
     emu->cpu.sr.bits.d = false;
-    emu->cycles += 2;
   } break;
 
     // CLI
   case OPCODE_CLI: {
     emu->cpu.sr.bits.i = false;
-    emu->cycles += 2;
   } break;
 
     // CLV
   case OPCODE_CLV: {
     emu->cpu.sr.bits.v = false;
-    emu->cycles += 2;
   } break;
 
     // CMP
   case OPCODE_CMP_IM: {
     const u8 byte = fetch_byte(emu);
     cmp_a(emu, byte);
-    emu->cycles += 2;
+    FUSE(OPCODE_BNE_REL, fused_bne_rel);
+    FUSE(OPCODE_BEQ_REL, fused_beq_rel);
   } break;
   case OPCODE_CMP_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    cmp_a(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    cmp_a(emu, load_byte(emu, addr));
   } break;
   case OPCODE_CMP_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    cmp_a(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    cmp_a(emu, load_byte(emu, addr));
   } break;
   case OPCODE_CMP_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    cmp_a(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    cmp_a(emu, load_byte(emu, addr));
   } break;
   case OPCODE_CMP_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cpu.pc++;
+      page_cross_penalty(emu);
     }
-    cmp_a(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    cmp_a(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_CMP_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cpu.pc++;
+      page_cross_penalty(emu);
     }
-    cmp_a(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    cmp_a(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_CMP_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    cmp_a(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    cmp_a(emu, load_byte(emu, addr));
   } break;
   case OPCODE_CMP_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cpu.pc++;
+      page_cross_penalty(emu);
     }
-    cmp_a(emu, emu->mem[result.addr]);
-    emu->cycles += 5;
+    cmp_a(emu, load_byte(emu, result.addr));
   } break;
 
     // CPX
+  fused_cpx_im:
   case OPCODE_CPX_IM: {
     const u8 byte = fetch_byte(emu);
     cmp_x(emu, byte);
-    emu->cycles += 2;
+    FUSE(OPCODE_BNE_REL, fused_bne_rel);
+    FUSE(OPCODE_BEQ_REL, fused_beq_rel);
   } break;
   case OPCODE_CPX_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    cmp_x(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    cmp_x(emu, load_byte(emu, addr));
   } break;
   case OPCODE_CPX_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    cmp_x(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    cmp_x(emu, load_byte(emu, addr));
   } break;
 
     // CPY
+  fused_cpy_im:
   case OPCODE_CPY_IM: {
     const u8 byte = fetch_byte(emu);
     cmp_y(emu, byte);
-    emu->cycles += 2;
+    FUSE(OPCODE_BNE_REL, fused_bne_rel);
+    FUSE(OPCODE_BEQ_REL, fused_beq_rel);
   } break;
   case OPCODE_CPY_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    cmp_y(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    cmp_y(emu, load_byte(emu, addr));
   } break;
   case OPCODE_CPY_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    cmp_y(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    cmp_y(emu, load_byte(emu, addr));
   } break;
 
     // DEC
   case OPCODE_DEC_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    u8 *byte = &emu->mem[addr];
-    (*byte)--;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 3;
+    modify(emu, addr, op_dec);
   } break;
   case OPCODE_DEC_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    u8 *byte = &emu->mem[addr];
-    (*byte)--;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 3;
+    modify(emu, addr, op_dec);
   } break;
   case OPCODE_DEC_ABS: {
     const u16 addr = fetch_word(emu);
-    u8 *byte = &emu->mem[addr];
-    (*byte)--;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 4;
+    modify(emu, addr, op_dec);
   } break;
   case OPCODE_DEC_ABSX: {
-    const auto result = fetch_addr_absx(emu);
-    if (result.page_crossed) {
-      emu->cycles++;
-    }
-    u8 *byte = &emu->mem[result.addr];
-    (*byte)--;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 4;
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_dec);
   } break;
 
     // INX
   case OPCODE_INX: {
-    emu->cpu.x--;
+    emu->cpu.x++;
     set_nz_flags_x(emu);
-    emu->cycles += 2;
+    FUSE(OPCODE_CPX_IM, fused_cpx_im);
   } break;
 
     // INY
   case OPCODE_INY: {
-    emu->cpu.y--;
+    emu->cpu.y++;
     set_nz_flags_y(emu);
-    emu->cycles += 2;
+    FUSE(OPCODE_CPY_IM, fused_cpy_im);
   } break;
 
     // INC
   case OPCODE_INC_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    u8 *byte = &emu->mem[addr];
-    (*byte)++;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 3;
+    modify(emu, addr, op_inc);
   } break;
   case OPCODE_INC_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    u8 *byte = &emu->mem[addr];
-    (*byte)++;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 3;
+    modify(emu, addr, op_inc);
   } break;
   case OPCODE_INC_ABS: {
     const u16 addr = fetch_word(emu);
-    u8 *byte = &emu->mem[addr];
-    (*byte)++;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 4;
+    modify(emu, addr, op_inc);
   } break;
   case OPCODE_INC_ABSX: {
-    const auto result = fetch_addr_absx(emu);
-    if (result.page_crossed) {
-      emu->cycles++;
-    }
-    u8 *byte = &emu->mem[result.addr];
-    (*byte)++;
-    set_nz_flags(emu, *byte);
-    emu->cycles += 4;
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_inc);
   } break;
 
     // DEX
   case OPCODE_DEX: {
-    emu->cpu.x++;
+    emu->cpu.x--;
     set_nz_flags_x(emu);
-    emu->cycles += 2;
+    FUSE(OPCODE_BNE_REL, fused_bne_rel);
   } break;
 
     // DEY
   case OPCODE_DEY: {
-    emu->cpu.y++;
+    emu->cpu.y--;
     set_nz_flags_y(emu);
-    emu->cycles += 2;
+    FUSE(OPCODE_BNE_REL, fused_bne_rel);
   } break;
 
     // EOR
   case OPCODE_EOR_IM: {
     const u8 rhs = fetch_byte(emu);
     op_eor(emu, rhs);
-    emu->cycles += 2;
   } break;
   case OPCODE_EOR_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    op_eor(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    op_eor(emu, load_byte(emu, addr));
   } break;
   case OPCODE_EOR_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    op_eor(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_eor(emu, load_byte(emu, addr));
   } break;
   case OPCODE_EOR_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    op_eor(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_eor(emu, load_byte(emu, addr));
   } break;
   case OPCODE_EOR_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_eor(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_eor(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_EOR_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_eor(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_eor(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_EOR_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    op_eor(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    op_eor(emu, load_byte(emu, addr));
   } break;
   case OPCODE_EOR_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_eor(emu, emu->mem[result.addr]);
-    emu->cycles += 5;
+    op_eor(emu, load_byte(emu, result.addr));
   } break;
 
     // JMP
@@ -852,79 +1246,88 @@ void emu_tick(Emulator *emu) {
     u16 addr = fetch_word(emu);
     LPRINTF(emu, "JMP_ABS: 0x%04x\n", addr);
     emu->cpu.pc = addr;
-    emu->cycles += 3;
   } break;
   case OPCODE_JMP_IND: {
-    u16 addr0 = fetch_word(emu);
-    u16 addr = emu_read_mem_word(emu, addr0);
+    const u16 addr0 = fetch_word(emu);
+#ifdef EMU_CPU_65C02
+    // the 65C02 carries into the high byte of the pointer, which takes a cycle
+    dummy_access(emu, emu->cpu.pc - 1);
+    u16 addr = load_byte(emu, addr0);
+    addr |= load_byte(emu, (u16)(addr0 + 1)) << 8;
+#else
+    u16 addr = load_byte(emu, addr0);
+    // the NMOS 6502 does not carry into the high byte of the pointer, so
+    // JMP ($12FF) reads the target from $12FF and $1200
+    addr |= load_byte(emu, (addr0 & 0xFF00) | (u8)(addr0 + 1)) << 8;
+#endif
     LPRINTF(emu, "JMP_IND: 0x%04x\n", addr);
     emu->cpu.pc = addr;
-    emu->cycles += 5;
   } break;
 
     // JSR
   case OPCODE_JSR_ABS: {
-    const u16 jmp_addr = fetch_word(emu);
-    push_callstack(emu);
+    // the high byte of the target is only fetched after pushing the address
+    // of that byte, which RTS adds 1 to
+    const u8 sp = emu->cpu.sp;
+    u16 jmp_addr = fetch_byte(emu);
+    dummy_access(emu, 0x0100 | sp);
+    push_pc(emu, emu->cpu.pc);
+    jmp_addr |= fetch_byte(emu) << 8;
+    if (emu->callgraph != NULL) {
+      callgraph_enter(emu->callgraph, jmp_addr, sp, cycles_before);
+    }
+    if (emu->stack_guard != NULL) {
+      stack_guard_enter(emu->stack_guard, jmp_addr, sp);
+    }
     LPRINTF(emu, "JSR_ABS: 0x%04x\n", jmp_addr);
     emu->cpu.pc = jmp_addr;
-    emu->cycles += 6;
   } break;
 
     // NOP
   case OPCODE_NOP: {
-    emu->cycles += 2;
   } break;
 
     // ORA
   case OPCODE_ORA_IM: {
     const u8 rhs = fetch_byte(emu);
     op_ora(emu, rhs);
-    emu->cycles += 2;
   } break;
   case OPCODE_ORA_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    op_ora(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    op_ora(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ORA_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    op_ora(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_ora(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ORA_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    op_ora(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_ora(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ORA_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_ora(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_ora(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_ORA_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_ora(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_ora(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_ORA_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    op_ora(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    op_ora(emu, load_byte(emu, addr));
   } break;
   case OPCODE_ORA_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_ora(emu, emu->mem[result.addr]);
-    emu->cycles += 5;
+    op_ora(emu, load_byte(emu, result.addr));
   } break;
 
     // LDA
@@ -932,58 +1335,52 @@ void emu_tick(Emulator *emu) {
     const u8 data = fetch_byte(emu);
     emu->cpu.a = data;
     set_nz_flags_a(emu);
-    emu->cycles += 2;
+    FUSE(OPCODE_STA_ZP, fused_sta_zp);
+    FUSE(OPCODE_STA_ABS, fused_sta_abs);
   } break;
   case OPCODE_LDA_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->cpu.a = emu->mem[addr];
+    emu->cpu.a = load_byte(emu, addr);
     set_nz_flags_a(emu);
-    emu->cycles += 3;
   } break;
   case OPCODE_LDA_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    emu->cpu.a = emu->mem[addr];
+    emu->cpu.a = load_byte(emu, addr);
     set_nz_flags_a(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDA_ABS: {
     u16 addr = fetch_word(emu);
-    emu->cpu.a = emu->mem[addr];
+    emu->cpu.a = load_byte(emu, addr);
     set_nz_flags_a(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDA_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    emu->cpu.a = emu->mem[result.addr];
+    emu->cpu.a = load_byte(emu, result.addr);
     set_nz_flags_a(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDA_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    emu->cpu.a = emu->mem[result.addr];
+    emu->cpu.a = load_byte(emu, result.addr);
     set_nz_flags_a(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDA_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    emu->cpu.a = emu->mem[addr];
+    emu->cpu.a = load_byte(emu, addr);
     set_nz_flags_a(emu);
-    emu->cycles += 6;
   } break;
   case OPCODE_LDA_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    emu->cpu.a = emu->mem[result.addr];
+    emu->cpu.a = load_byte(emu, result.addr);
     set_nz_flags_a(emu);
-    emu->cycles += 5;
   } break;
 
     // LDX
@@ -991,34 +1388,29 @@ void emu_tick(Emulator *emu) {
     u8 data = fetch_byte(emu);
     emu->cpu.x = data;
     set_nz_flags_x(emu);
-    emu->cycles += 2;
   } break;
   case OPCODE_LDX_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->cpu.x = emu->mem[addr];
+    emu->cpu.x = load_byte(emu, addr);
     set_nz_flags_x(emu);
-    emu->cycles += 3;
   } break;
   case OPCODE_LDX_ZPY: {
     const u16 addr = fetch_addr_zpy(emu);
-    emu->cpu.x = emu->mem[addr];
+    emu->cpu.x = load_byte(emu, addr);
     set_nz_flags_x(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDX_ABS: {
     u16 addr = fetch_word(emu);
-    emu->cpu.x = emu->mem[addr];
+    emu->cpu.x = load_byte(emu, addr);
     set_nz_flags_x(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDX_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    emu->cpu.x = emu->mem[result.addr];
+    emu->cpu.x = load_byte(emu, result.addr);
     set_nz_flags_x(emu);
-    emu->cycles += 4;
   } break;
 
     // LDY
@@ -1026,346 +1418,808 @@ void emu_tick(Emulator *emu) {
     u8 data = fetch_byte(emu);
     emu->cpu.y = data;
     set_nz_flags_y(emu);
-    emu->cycles += 2;
   } break;
   case OPCODE_LDY_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->cpu.y = emu->mem[addr];
+    emu->cpu.y = load_byte(emu, addr);
     set_nz_flags_y(emu);
-    emu->cycles += 3;
   } break;
-  case OPCODE_LDY_ZPY: {
-    const u16 addr = fetch_addr_zpy(emu);
-    emu->cpu.y = emu->mem[addr];
+  case OPCODE_LDY_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    emu->cpu.y = load_byte(emu, addr);
     set_nz_flags_y(emu);
-    emu->cycles += 4;
   } break;
   case OPCODE_LDY_ABS: {
     u16 addr = fetch_word(emu);
-    emu->cpu.y = emu->mem[addr];
+    emu->cpu.y = load_byte(emu, addr);
     set_nz_flags_y(emu);
-    emu->cycles += 4;
   } break;
-  case OPCODE_LDY_ABSY: {
-    const auto result = fetch_addr_absy(emu);
+  case OPCODE_LDY_ABSX: {
+    const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    emu->cpu.y = emu->mem[result.addr];
+    emu->cpu.y = load_byte(emu, result.addr);
     set_nz_flags_y(emu);
-    emu->cycles += 4;
   } break;
 
     // LSR
   case OPCODE_LSR_A: {
     emu->cpu.a = op_lsr(emu, emu->cpu.a);
-    emu->cycles += 2;
   } break;
   case OPCODE_LSR_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->mem[addr] = op_lsr(emu, emu->mem[addr]);
-    emu->cycles += 5;
+    modify(emu, addr, op_lsr);
   } break;
   case OPCODE_LSR_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    emu->mem[addr] = op_lsr(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_lsr);
   } break;
   case OPCODE_LSR_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    emu->mem[addr] = op_lsr(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_lsr);
   } break;
   case OPCODE_LSR_ABSX: {
-    const u16 addr = fetch_addr_absx(emu).addr;
-    emu->mem[addr] = op_lsr(emu, emu->mem[addr]);
-    emu->cycles += 7;
+    const u16 addr = fetch_addr_shift_absx(emu);
+    modify(emu, addr, op_lsr);
   } break;
 
     // PHA
   case OPCODE_PHA: {
     stack_push(emu, emu->cpu.a);
-    emu->cycles += 3;
   } break;
 
     // PHP
   case OPCODE_PHP: {
-    stack_push(emu, emu->cpu.sr.byte);
-    emu->cycles += 3;
+    stack_push(emu, emu->cpu.sr.byte | SR_B | SR_UNUSED);
   } break;
 
     // PLA
   case OPCODE_PLA: {
+    dummy_access(emu, 0x0100 | emu->cpu.sp);
     emu->cpu.a = stack_pull(emu);
+    set_nz_flags_a(emu);
   } break;
 
     // PLP
   case OPCODE_PLP: {
-    const u8 sr = stack_pull(emu);
-    emu->cpu.sr.byte = sr;
-    emu->cycles += 4;
+    dummy_access(emu, 0x0100 | emu->cpu.sp);
+    pull_sr(emu);
   } break;
 
     // ROL
   case OPCODE_ROL_A: {
     emu->cpu.a = op_rol(emu, emu->cpu.a);
-    emu->cycles += 2;
   } break;
   case OPCODE_ROL_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->mem[addr] = op_rol(emu, emu->mem[addr]);
-    emu->cycles += 5;
+    modify(emu, addr, op_rol);
   } break;
   case OPCODE_ROL_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    emu->mem[addr] = op_rol(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_rol);
   } break;
   case OPCODE_ROL_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    emu->mem[addr] = op_rol(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_rol);
   } break;
   case OPCODE_ROL_ABSX: {
-    const u16 addr = fetch_addr_absx(emu).addr;
-    emu->mem[addr] = op_rol(emu, emu->mem[addr]);
-    emu->cycles += 7;
+    const u16 addr = fetch_addr_shift_absx(emu);
+    modify(emu, addr, op_rol);
   } break;
 
     // ROR
   case OPCODE_ROR_A: {
     emu->cpu.a = op_ror(emu, emu->cpu.a);
-    emu->cycles += 2;
   } break;
   case OPCODE_ROR_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->mem[addr] = op_ror(emu, emu->mem[addr]);
-    emu->cycles += 5;
+    modify(emu, addr, op_ror);
   } break;
   case OPCODE_ROR_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    emu->mem[addr] = op_ror(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_ror);
   } break;
   case OPCODE_ROR_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    emu->mem[addr] = op_ror(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    modify(emu, addr, op_ror);
   } break;
   case OPCODE_ROR_ABSX: {
-    const u16 addr = fetch_addr_absx(emu).addr;
-    emu->mem[addr] = op_ror(emu, emu->mem[addr]);
-    emu->cycles += 7;
+    const u16 addr = fetch_addr_shift_absx(emu);
+    modify(emu, addr, op_ror);
   } break;
 
     // RTI
   case OPCODE_RTI: {
-    pull_callstack(emu);
-    emu->cpu.sr.bits.i = false;
-    emu->is_running = true;
+    dummy_access(emu, 0x0100 | emu->cpu.sp);
+    pull_sr(emu);
+    emu->cpu.pc = pull_pc(emu);
   } break;
 
     // RTS
   case OPCODE_RTS: {
-    pull_callstack(emu);
-    emu->cycles += 6;
+    dummy_access(emu, 0x0100 | emu->cpu.sp);
+    emu->cpu.pc = pull_pc(emu);
+    dummy_access(emu, emu->cpu.pc); // while adding 1
+    emu->cpu.pc++;
+    if (emu->callgraph != NULL) {
+      callgraph_return(emu->callgraph, emu->cpu.sp, emu->cycles);
+    }
+    if (emu->stack_guard != NULL) {
+      stack_guard_return(emu->stack_guard, emu->cpu.sp);
+    }
   } break;
 
   // SBC
+  fused_sbc_im:
   case OPCODE_SBC_IM: {
     const u8 rhs = fetch_byte(emu);
     op_sbc(emu, rhs);
-    emu->cycles += 2;
   } break;
   case OPCODE_SBC_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    op_sbc(emu, emu->mem[addr]);
-    emu->cycles += 3;
+    op_sbc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_SBC_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    op_sbc(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_sbc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_SBC_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    op_sbc(emu, emu->mem[addr]);
-    emu->cycles += 4;
+    op_sbc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_SBC_ABSX: {
     const auto result = fetch_addr_absx(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_sbc(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_sbc(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_SBC_ABSY: {
     const auto result = fetch_addr_absy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_sbc(emu, emu->mem[result.addr]);
-    emu->cycles += 4;
+    op_sbc(emu, load_byte(emu, result.addr));
   } break;
   case OPCODE_SBC_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    op_sbc(emu, emu->mem[addr]);
-    emu->cycles += 6;
+    op_sbc(emu, load_byte(emu, addr));
   } break;
   case OPCODE_SBC_INDY: {
     const auto result = fetch_addr_indy(emu);
     if (result.page_crossed) {
-      emu->cycles++;
+      page_cross_penalty(emu);
     }
-    op_sbc(emu, emu->mem[result.addr]);
-    emu->cycles += 5;
+    op_sbc(emu, load_byte(emu, result.addr));
   } break;
 
     // SEC
   case OPCODE_SEC: {
     emu->cpu.sr.bits.c = true;
-    emu->cycles += 2;
+    FUSE(OPCODE_SBC_IM, fused_sbc_im);
   } break;
 
     // SED
   case OPCODE_SED: {
     emu->cpu.sr.bits.d = true;
-    emu->cycles += 2;
   } break;
 
     // SEI
   case OPCODE_SEI: {
     emu->cpu.sr.bits.i = true;
-    emu->cycles += 2;
   } break;
 
     // STA
+  fused_sta_zp:
   case OPCODE_STA_ZP: {
     const u16 addr = fetch_addr_zp(emu);
-    emu->mem[addr] = emu->cpu.a;
-    emu->cycles += 3;
+    store_byte(emu, addr, emu->cpu.a);
   } break;
   case OPCODE_STA_ZPX: {
     const u16 addr = fetch_addr_zpx(emu);
-    emu->mem[addr] = emu->cpu.a;
-    emu->cycles += 4;
+    store_byte(emu, addr, emu->cpu.a);
   } break;
+  fused_sta_abs:
   case OPCODE_STA_ABS: {
     const u16 addr = fetch_addr_abs(emu);
-    emu->mem[addr] = emu->cpu.a;
-    emu->cycles += 4;
+    store_byte(emu, addr, emu->cpu.a);
   } break;
   case OPCODE_STA_ABSX: {
-    const auto result = fetch_addr_absx(emu);
-    if (result.page_crossed) {
-      emu->cycles++;
-    }
-    emu->mem[result.addr] = emu->cpu.a;
-    emu->cycles += 5;
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    store_byte(emu, addr, emu->cpu.a);
   } break;
   case OPCODE_STA_ABSY: {
-    const auto result = fetch_addr_absy(emu);
-    if (result.page_crossed) {
-      emu->cycles++;
-    }
-    emu->mem[result.addr] = emu->cpu.a;
-    emu->cycles += 5;
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    store_byte(emu, addr, emu->cpu.a);
   } break;
   case OPCODE_STA_INDX: {
     const u16 addr = fetch_addr_indx(emu);
-    emu->mem[addr] = emu->cpu.a;
-    emu->cycles += 6;
+    store_byte(emu, addr, emu->cpu.a);
   } break;
   case OPCODE_STA_INDY: {
-    const auto result = fetch_addr_indy(emu);
-    if (result.page_crossed) {
-      emu->cycles++;
-    }
-    emu->mem[result.addr] = emu->cpu.a;
-    emu->cycles += 6;
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    store_byte(emu, addr, emu->cpu.a);
   } break;
 
     // STX
   case OPCODE_STX_ZP: {
     u16 addr = fetch_byte(emu);
-    emu->mem[addr] = emu->cpu.x;
-    emu->cycles += 3;
+    store_byte(emu, addr, emu->cpu.x);
   } break;
   case OPCODE_STX_ZPY: {
-    u16 addr = fetch_byte(emu) + emu->cpu.y;
-    emu->mem[addr] = emu->cpu.x;
-    emu->cycles += 4;
+    u16 addr = fetch_addr_zpy(emu);
+    store_byte(emu, addr, emu->cpu.x);
   } break;
   case OPCODE_STX_ABS: {
     u16 addr = fetch_word(emu);
-    emu->mem[addr] = emu->cpu.x;
-    emu->cycles += 4;
+    store_byte(emu, addr, emu->cpu.x);
   } break;
 
     // STY
   case OPCODE_STY_ZP: {
     u16 addr = fetch_byte(emu);
-    emu->mem[addr] = emu->cpu.y;
-    emu->cycles += 3;
+    store_byte(emu, addr, emu->cpu.y);
   } break;
   case OPCODE_STY_ZPX: {
-    u16 addr = fetch_byte(emu) + emu->cpu.x;
-    emu->mem[addr] = emu->cpu.y;
-    emu->cycles += 4;
+    u16 addr = fetch_addr_zpx(emu);
+    store_byte(emu, addr, emu->cpu.y);
   } break;
   case OPCODE_STY_ABS: {
     u16 addr = fetch_word(emu);
-    emu->mem[addr] = emu->cpu.y;
-    emu->cycles += 4;
+    store_byte(emu, addr, emu->cpu.y);
   } break;
 
     // TAX
   case OPCODE_TAX: {
     emu->cpu.x = emu->cpu.a;
     set_nz_flags_x(emu);
-    emu->cycles += 2;
   } break;
 
     // TAY
   case OPCODE_TAY: {
     emu->cpu.y = emu->cpu.a;
     set_nz_flags_y(emu);
-    emu->cycles += 2;
   } break;
 
     // TSX
   case OPCODE_TSX: {
     emu->cpu.x = (u8)emu->cpu.sp;
     set_nz_flags_x(emu);
-    emu->cycles += 2;
   } break;
 
     // TXA
   case OPCODE_TXA: {
     emu->cpu.a = emu->cpu.x;
     set_nz_flags_a(emu);
-    emu->cycles += 2;
   } break;
 
     // TXS
   case OPCODE_TXS: {
     emu->cpu.sp = emu->cpu.x;
-    emu->cycles += 2;
   } break;
 
     // TYA
   case OPCODE_TYA: {
     emu->cpu.a = emu->cpu.y;
     set_nz_flags_y(emu);
-    emu->cycles += 2;
   } break;
 
+#ifdef EMU_CPU_6502X
+    // SLO
+  case OPCODE_SLO_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_slo);
+  } break;
+  case OPCODE_SLO_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    modify(emu, addr, op_slo);
+  } break;
+  case OPCODE_SLO_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_slo);
+  } break;
+  case OPCODE_SLO_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_slo);
+  } break;
+  case OPCODE_SLO_ABSY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    modify(emu, addr, op_slo);
+  } break;
+  case OPCODE_SLO_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    modify(emu, addr, op_slo);
+  } break;
+  case OPCODE_SLO_INDY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    modify(emu, addr, op_slo);
+  } break;
+
+    // RLA
+  case OPCODE_RLA_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_rla);
+  } break;
+  case OPCODE_RLA_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    modify(emu, addr, op_rla);
+  } break;
+  case OPCODE_RLA_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_rla);
+  } break;
+  case OPCODE_RLA_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_rla);
+  } break;
+  case OPCODE_RLA_ABSY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    modify(emu, addr, op_rla);
+  } break;
+  case OPCODE_RLA_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    modify(emu, addr, op_rla);
+  } break;
+  case OPCODE_RLA_INDY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    modify(emu, addr, op_rla);
+  } break;
+
+    // SRE
+  case OPCODE_SRE_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_sre);
+  } break;
+  case OPCODE_SRE_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    modify(emu, addr, op_sre);
+  } break;
+  case OPCODE_SRE_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_sre);
+  } break;
+  case OPCODE_SRE_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_sre);
+  } break;
+  case OPCODE_SRE_ABSY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    modify(emu, addr, op_sre);
+  } break;
+  case OPCODE_SRE_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    modify(emu, addr, op_sre);
+  } break;
+  case OPCODE_SRE_INDY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    modify(emu, addr, op_sre);
+  } break;
+
+    // RRA
+  case OPCODE_RRA_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_rra);
+  } break;
+  case OPCODE_RRA_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    modify(emu, addr, op_rra);
+  } break;
+  case OPCODE_RRA_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_rra);
+  } break;
+  case OPCODE_RRA_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_rra);
+  } break;
+  case OPCODE_RRA_ABSY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    modify(emu, addr, op_rra);
+  } break;
+  case OPCODE_RRA_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    modify(emu, addr, op_rra);
+  } break;
+  case OPCODE_RRA_INDY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    modify(emu, addr, op_rra);
+  } break;
+
+    // DCP
+  case OPCODE_DCP_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_dcp);
+  } break;
+  case OPCODE_DCP_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    modify(emu, addr, op_dcp);
+  } break;
+  case OPCODE_DCP_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_dcp);
+  } break;
+  case OPCODE_DCP_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_dcp);
+  } break;
+  case OPCODE_DCP_ABSY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    modify(emu, addr, op_dcp);
+  } break;
+  case OPCODE_DCP_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    modify(emu, addr, op_dcp);
+  } break;
+  case OPCODE_DCP_INDY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    modify(emu, addr, op_dcp);
+  } break;
+
+    // ISC
+  case OPCODE_ISC_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_isc);
+  } break;
+  case OPCODE_ISC_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    modify(emu, addr, op_isc);
+  } break;
+  case OPCODE_ISC_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_isc);
+  } break;
+  case OPCODE_ISC_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    modify(emu, addr, op_isc);
+  } break;
+  case OPCODE_ISC_ABSY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absy(emu));
+    modify(emu, addr, op_isc);
+  } break;
+  case OPCODE_ISC_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    modify(emu, addr, op_isc);
+  } break;
+  case OPCODE_ISC_INDY: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_indy(emu));
+    modify(emu, addr, op_isc);
+  } break;
+
+    // SAX
+  case OPCODE_SAX_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    store_byte(emu, addr, emu->cpu.a & emu->cpu.x);
+  } break;
+  case OPCODE_SAX_ZPY: {
+    const u16 addr = fetch_addr_zpy(emu);
+    store_byte(emu, addr, emu->cpu.a & emu->cpu.x);
+  } break;
+  case OPCODE_SAX_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    store_byte(emu, addr, emu->cpu.a & emu->cpu.x);
+  } break;
+  case OPCODE_SAX_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    store_byte(emu, addr, emu->cpu.a & emu->cpu.x);
+  } break;
+
+    // LAX
+  case OPCODE_LAX_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    op_lax(emu, load_byte(emu, addr));
+  } break;
+  case OPCODE_LAX_ZPY: {
+    const u16 addr = fetch_addr_zpy(emu);
+    op_lax(emu, load_byte(emu, addr));
+  } break;
+  case OPCODE_LAX_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    op_lax(emu, load_byte(emu, addr));
+  } break;
+  case OPCODE_LAX_ABSY: {
+    const auto result = fetch_addr_absy(emu);
+    if (result.page_crossed) {
+      page_cross_penalty(emu);
+    }
+    op_lax(emu, load_byte(emu, result.addr));
+  } break;
+  case OPCODE_LAX_INDX: {
+    const u16 addr = fetch_addr_indx(emu);
+    op_lax(emu, load_byte(emu, addr));
+  } break;
+  case OPCODE_LAX_INDY: {
+    const auto result = fetch_addr_indy(emu);
+    if (result.page_crossed) {
+      page_cross_penalty(emu);
+    }
+    op_lax(emu, load_byte(emu, result.addr));
+  } break;
+
+    // ANC: AND #imm with C copied from N
+  case OPCODE_ANC_IM:
+  case OPCODE_ANC_IM_2B: {
+    op_and(emu, fetch_byte(emu));
+    emu->cpu.sr.bits.c = emu->cpu.sr.bits.n;
+  } break;
+
+    // ALR: AND #imm then LSR A
+  case OPCODE_ALR_IM: {
+    emu->cpu.a = op_lsr(emu, emu->cpu.a & fetch_byte(emu));
+  } break;
+
+    // ARR
+  case OPCODE_ARR_IM: {
+    op_arr(emu, fetch_byte(emu));
+  } break;
+
+    // SBX: X = (A & X) - #imm, setting the flags like CMP
+  case OPCODE_SBX_IM: {
+    const u8 rhs = fetch_byte(emu);
+    const u8 lhs = emu->cpu.a & emu->cpu.x;
+    cmp(emu, lhs, rhs);
+    emu->cpu.x = (u8)(lhs - rhs);
+  } break;
+
+    // SBC #imm
+  case OPCODE_SBC_IM_EB: {
+    op_sbc(emu, fetch_byte(emu));
+  } break;
+
+    // NOPs, which read their operand like a load
+  case OPCODE_NOP_1A:
+  case OPCODE_NOP_3A:
+  case OPCODE_NOP_5A:
+  case OPCODE_NOP_7A:
+  case OPCODE_NOP_DA:
+  case OPCODE_NOP_FA: {
+  } break;
+  case OPCODE_NOP_80:
+  case OPCODE_NOP_82:
+  case OPCODE_NOP_89:
+  case OPCODE_NOP_C2:
+  case OPCODE_NOP_E2: {
+    fetch_byte(emu);
+  } break;
+  case OPCODE_NOP_04:
+  case OPCODE_NOP_44:
+  case OPCODE_NOP_64: {
+    load_byte(emu, fetch_addr_zp(emu));
+  } break;
+  case OPCODE_NOP_14:
+  case OPCODE_NOP_34:
+  case OPCODE_NOP_54:
+  case OPCODE_NOP_74:
+  case OPCODE_NOP_D4:
+  case OPCODE_NOP_F4: {
+    load_byte(emu, fetch_addr_zpx(emu));
+  } break;
+  case OPCODE_NOP_0C: {
+    load_byte(emu, fetch_addr_abs(emu));
+  } break;
+  case OPCODE_NOP_1C:
+  case OPCODE_NOP_3C:
+  case OPCODE_NOP_5C:
+  case OPCODE_NOP_7C:
+  case OPCODE_NOP_DC:
+  case OPCODE_NOP_FC: {
+    const auto result = fetch_addr_absx(emu);
+    if (result.page_crossed) {
+      page_cross_penalty(emu);
+    }
+    load_byte(emu, result.addr);
+  } break;
+#endif
+
+#ifdef EMU_CPU_65C02
+    // BRA
+  case OPCODE_BRA_REL: {
+    const u16 target_addr = branch_rel(emu);
+    LPRINTF(emu, "BRA: 0x%04X\n", target_addr);
+  } break;
+
+    // STZ
+  case OPCODE_STZ_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    store_byte(emu, addr, 0);
+  } break;
+  case OPCODE_STZ_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    store_byte(emu, addr, 0);
+  } break;
+  case OPCODE_STZ_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    store_byte(emu, addr, 0);
+  } break;
+  case OPCODE_STZ_ABSX: {
+    const u16 addr = fixup_cycle(emu, fetch_addr_absx(emu));
+    store_byte(emu, addr, 0);
+  } break;
+
+    // PHX, PHY, PLX, PLY
+  case OPCODE_PHX: {
+    stack_push(emu, emu->cpu.x);
+  } break;
+  case OPCODE_PHY: {
+    stack_push(emu, emu->cpu.y);
+  } break;
+  case OPCODE_PLX: {
+    dummy_access(emu, 0x0100 | emu->cpu.sp);
+    emu->cpu.x = stack_pull(emu);
+    set_nz_flags_x(emu);
+  } break;
+  case OPCODE_PLY: {
+    dummy_access(emu, 0x0100 | emu->cpu.sp);
+    emu->cpu.y = stack_pull(emu);
+    set_nz_flags_y(emu);
+  } break;
+
+    // TSB, TRB
+  case OPCODE_TSB_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_tsb);
+  } break;
+  case OPCODE_TSB_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_tsb);
+  } break;
+  case OPCODE_TRB_ZP: {
+    const u16 addr = fetch_addr_zp(emu);
+    modify(emu, addr, op_trb);
+  } break;
+  case OPCODE_TRB_ABS: {
+    const u16 addr = fetch_addr_abs(emu);
+    modify(emu, addr, op_trb);
+  } break;
+
+    // INC A, DEC A
+  case OPCODE_INC_A: {
+    emu->cpu.a = op_inc(emu, emu->cpu.a);
+  } break;
+  case OPCODE_DEC_A: {
+    emu->cpu.a = op_dec(emu, emu->cpu.a);
+  } break;
+
+    // BIT
+  case OPCODE_BIT_IM: {
+    // only Z, there is no memory for N and V to come from
+    emu->cpu.sr.bits.z = ((fetch_byte(emu) & emu->cpu.a) == 0);
+  } break;
+  case OPCODE_BIT_ZPX: {
+    const u16 addr = fetch_addr_zpx(emu);
+    op_bit(emu, load_byte(emu, addr));
+  } break;
+  case OPCODE_BIT_ABSX: {
+    const auto result = fetch_addr_absx(emu);
+    if (result.page_crossed) {
+      page_cross_penalty(emu);
+    }
+    op_bit(emu, load_byte(emu, result.addr));
+  } break;
+
+    // (zp)
+  case OPCODE_ORA_ZPI: {
+    op_ora(emu, load_byte(emu, fetch_addr_zpi(emu)));
+  } break;
+  case OPCODE_AND_ZPI: {
+    op_and(emu, load_byte(emu, fetch_addr_zpi(emu)));
+  } break;
+  case OPCODE_EOR_ZPI: {
+    op_eor(emu, load_byte(emu, fetch_addr_zpi(emu)));
+  } break;
+  case OPCODE_ADC_ZPI: {
+    op_adc(emu, load_byte(emu, fetch_addr_zpi(emu)));
+  } break;
+  case OPCODE_STA_ZPI: {
+    store_byte(emu, fetch_addr_zpi(emu), emu->cpu.a);
+  } break;
+  case OPCODE_LDA_ZPI: {
+    emu->cpu.a = load_byte(emu, fetch_addr_zpi(emu));
+    set_nz_flags_a(emu);
+  } break;
+  case OPCODE_CMP_ZPI: {
+    cmp_a(emu, load_byte(emu, fetch_addr_zpi(emu)));
+  } break;
+  case OPCODE_SBC_ZPI: {
+    op_sbc(emu, load_byte(emu, fetch_addr_zpi(emu)));
+  } break;
+
+    // JMP (abs,X)
+  case OPCODE_JMP_IAX: {
+    const u16 addr0 = fetch_word(emu);
+    dummy_access(emu, emu->cpu.pc - 1); // while adding X
+    const u16 ptr = addr0 + emu->cpu.x;
+    u16 addr = load_byte(emu, ptr);
+    addr |= load_byte(emu, (u16)(ptr + 1)) << 8;
+    LPRINTF(emu, "JMP_IAX: 0x%04x\n", addr);
+    emu->cpu.pc = addr;
+  } break;
+#endif
+
   default: {
     emu->is_running = false;
+    emu->n_halts++;
+#ifdef EMU_CYCLE_EXACT
+    // unknown opcodes have no cycles in `opcode_table`, give back the fetch so
+    // both modes agree
+    emu->cycles--;
+#endif
     LPRINTF(emu, "Illegal opcode: 0x%02X\n", opcode);
   } break;
   }
-  PRINT_STAT("", opcode);
-  return;
+  if (emu->tracer != NULL) {
+    trace_end(emu->tracer, emu);
+  }
+  if (emu->profiler != NULL) {
+    profile_record(emu->profiler, pc, emu->cycles - tick_start);
+  }
+  if (emu->stats != NULL) {
+    opcode_stats_end(emu->stats, emu->cycles - cycles_before);
+  }
+}
+
+EmuStop emu_run(Emulator *emu, const u64 max_cycles) {
+  const u64 end = emu->cycles + max_cycles;
+  Breakpoints *bp = emu->breakpoints;
+  StackGuard *guard = emu->stack_guard;
+  if (bp == NULL && (guard == NULL || !guard->trap)) {
+    while (emu->cycles < end) {
+      if (!emu->is_running) {
+        return EMU_STOP_HALT;
+      }
+      emu_tick(emu);
+    }
+    return emu->is_running ? EMU_STOP_LIMIT : EMU_STOP_HALT;
+  }
+  while (emu->cycles < end) {
+    if (!emu->is_running) {
+      return EMU_STOP_HALT;
+    }
+    emu_tick(emu);
+    if (guard != NULL && guard->wrap_hit) {
+      guard->wrap_hit = false;
+      return EMU_STOP_STACK;
+    }
+    if (bp == NULL) {
+      continue;
+    }
+    if (bp->watch_hit) {
+      bp->watch_hit = false;
+      return EMU_STOP_WATCHPOINT;
+    }
+    if (breakpoint_test(bp, emu->cpu.pc)) {
+      return EMU_STOP_BREAKPOINT;
+    }
+  }
+  return emu->is_running ? EMU_STOP_LIMIT : EMU_STOP_HALT;
+}
+
+void emu_describe_stop(char *buf, const usize len, const Emulator *emu,
+                       const EmuStop stop) {
+  switch (stop) {
+  case EMU_STOP_HALT:
+    snprintf(buf, len, "Emulator halted at %" PRIu64 " cycles", emu->cycles);
+    break;
+  case EMU_STOP_BREAKPOINT:
+    snprintf(buf, len, "Breakpoint at %04X after %" PRIu64 " cycles",
+             emu->cpu.pc, emu->cycles);
+    break;
+  case EMU_STOP_WATCHPOINT:
+    snprintf(buf, len,
+             "Watchpoint: %s %04X, now at %04X after %" PRIu64 " cycles",
+             (emu->breakpoints->hit_kind == WATCH_READ) ? "read of"
+                                                        : "write to",
+             emu->breakpoints->hit_addr, emu->cpu.pc, emu->cycles);
+    break;
+  case EMU_STOP_STACK:
+    snprintf(buf, len, "Stack %s, now at %04X after %" PRIu64 " cycles",
+             (emu->stack_guard->last_wrap == STACK_WRAP_OVERFLOW)
+                 ? "overflow"
+                 : "underflow",
+             emu->cpu.pc, emu->cycles);
+    break;
+  case EMU_STOP_LIMIT:
+    snprintf(buf, len, "Stopped after %" PRIu64 " cycles", emu->cycles);
+    break;
+  }
 }
@@ -1,12 +1,26 @@
+#pragma once
+
 #include "common.h"
 #include "opcode.h"
 
 // 64 kB
 #define MEM_SIZE 65536
+// `Emulator.mem` is aligned to host pages (up to 16 kB) so that program images
+// can be mapped straight into it, see `loader.h`
+#define MEM_ALIGN 16384
 
 #define STACK_FLOOR 0x0100
 #define STACK_LIMIT 0x01FF
 
+// where the CPU finds the addresses of its handlers
+#define NMI_VECTOR 0xFFFA
+#define RESET_VECTOR 0xFFFC
+#define IRQ_VECTOR 0xFFFE // also used by BRK
+
+// bits of SR as it is pushed onto the stack
+#define SR_B 0x10      // set when pushed by BRK or PHP, clear for IRQ and NMI
+#define SR_UNUSED 0x20 // always reads as 1
+
 typedef struct CPU {
   u16 pc; // Program Counter
   u8 sp;  // Stack Pointer
@@ -15,28 +29,91 @@ typedef struct CPU {
   u8 y;   // Register Y
   union {
     u8 byte;
+    // in the order of the 6502, from bit 0 to bit 7
     struct {
-      bool n : 1;
-      bool v : 1;
-      bool _ : 1;
-      bool b : 1;
-      bool d : 1;
-      bool i : 1;
-      bool z : 1;
       bool c : 1;
+      bool z : 1;
+      bool i : 1;
+      bool d : 1;
+      bool b : 1;
+      bool _ : 1;
+      bool v : 1;
+      bool n : 1;
     } bits;
   } sr;
 } CPU;
 
 #define LOG_BUF_SIZE 1024
 
+// interrupt lines, see `emu_nmi` and `emu_set_irq`
+#define EMU_INT_NMI 0x01
+#define EMU_INT_IRQ 0x02
+
+struct Tracer;
+struct Profiler;
+struct CallGraph;
+struct OpcodeStats;
+struct Breakpoints;
+struct Recorder;
+struct Heatmap;
+struct StackGuard;
+struct Banks;
+
 typedef struct Emulator {
+  _Alignas(MEM_ALIGN) u8 mem[MEM_SIZE];
   CPU cpu;
-  u8 mem[MEM_SIZE];
   u64 cycles;
+  // instructions executed (each one of a fused sequence), interrupts taken
+  // and halts, for monitoring (see `monitor.h`)
+  u64 n_instructions;
+  u64 n_interrupts;
+  u64 n_halts;
   bool is_running;
+  // pending `EMU_INT_*` bits, checked before each instruction
+  u8 interrupts;
+  // Append log messages for each instruction to `log_buf`, which must then be
+  // emptied after every instruction (see `debugger.h`)
   bool debug_output;
+  // Run common instruction sequences (e.g. DEX/BNE, CMP #/BNE, LDA #/STA) as
+  // fused handlers, so a single `emu_tick` may execute up to three
+  // instructions. Cycles and flags are exactly the same as unfused, but the
+  // instructions after the first bypass the tracer, profiler, call graph,
+  // statistics and breakpoints, so only enable it when none of them is
+  // attached.
+  bool fusion;
+#ifdef EMU_BANKING
+  // what each page of 256 bytes is mapped to, see `bank.h`
+  u32 page_map[256];
+#endif
+  // everything from here on is not part of the machine state copied by
+  // `emu_cold_boot`
   char log_buf[LOG_BUF_SIZE];
+  // Records every executed instruction if not NULL, see `trace.h`
+  struct Tracer *tracer;
+  // Counts cycles and executions per PC if not NULL, see `profile.h`
+  struct Profiler *profiler;
+  // Shadow call stack for profiling subroutines if not NULL, see `callgraph.h`
+  struct CallGraph *callgraph;
+  // Counts opcodes, opcode pairs and penalties if not NULL, see `stats.h`
+  struct OpcodeStats *stats;
+  // Breakpoints and watchpoints checked by `emu_run` if not NULL, see
+  // `breakpoints.h`
+  struct Breakpoints *breakpoints;
+  // Logs inputs from the host if not NULL, see `record.h`
+  struct Recorder *recorder;
+  // Counts accesses per address and tracks changed memory if not NULL, see
+  // `heatmap.h`
+  struct Heatmap *heatmap;
+  // Watches stack depth and wraps if not NULL, see `stackguard.h`
+  struct StackGuard *stack_guard;
+#ifdef EMU_BANKING
+  // where each page is read from and written to, NULL for writes to read-only
+  // pages, built from `page_map` (see `bank.h`)
+  u8 *read_pages[256];
+  u8 *write_pages[256];
+  // Bank memory if not NULL, set with `bank_attach`
+  struct Banks *banks;
+#endif
 } Emulator;
 
 // Initialize the memory
@@ -46,17 +123,38 @@ void mem_init(u8 *mem);
 // Resets the CPU flags to all zeros
 void cpu_reset_sr(CPU *cpu);
 
-// Resets the CPU to its initial state
+// Resets the registers to their state after a reset
+// PC is left at 0 since it comes from memory, see `emu_reset`
 void cpu_reset(CPU *cpu);
 
-// Outputs the registers and status flags of a CPU
+// Prints the registers and status flags of a CPU to stdout
 // Output has newline characters
 void cpu_debug_print(const CPU *cpu);
 
 // Initialize the emulator
+// Call `emu_reset` once the program is in memory to start it
 void emu_init(Emulator *emu, bool debug_output);
 
-// Outputs the stack (memory address 0x0100 ~ 0x01FF)
+// Reset the CPU and jump to the address in the reset vector
+void emu_reset(Emulator *emu);
+
+// Restore the machine state (memory, registers, cycles and interrupts) of
+// `boot`, typically an emulator prepared once with a ROM loaded and
+// `emu_reset` called. The state is one flat block, so this is a single memcpy;
+// `emu`'s log and attached instrumentation are kept. With `EMU_BANKING` the
+// page mapping is part of that block and the bank memory of `boot` is copied
+// to that of `emu`, see `bank.h`.
+void emu_cold_boot(Emulator *emu, const Emulator *boot);
+
+// Trigger a non-maskable interrupt, taken before the next instruction
+void emu_nmi(Emulator *emu);
+
+// Set the level of the IRQ line
+// While asserted an interrupt is taken before every instruction that runs with
+// the I flag clear, so the device must release it once it has been serviced
+void emu_set_irq(Emulator *emu, bool asserted);
+
+// Prints the stack (memory address 0x0100 ~ 0x01FF) to stdout
 // Output has newline characters
 void emu_print_stack(const Emulator *emu);
 
@@ -64,6 +162,34 @@ void emu_print_stack(const Emulator *emu);
 u8 emu_read_mem_byte(const Emulator *emu, u16 addr);
 // Read 2 bytes of data from memory on address `addr`
 u16 emu_read_mem_word(const Emulator *emu, u16 addr);
+// Write a byte of data to memory on address `addr` like a debugger would:
+// read-only pages are patched rather than left alone, and watchpoints and
+// bank registers do not see it
+void emu_write_mem_byte(Emulator *emu, u16 addr, u8 byte);
+
+// Set the registers from outside the program, e.g. from a debugger
+void emu_set_cpu(Emulator *emu, const CPU *cpu);
 
-// Execute one instruction
+// Execute one instruction, or one fused sequence if `fusion` is enabled
+// An interrupt is taken first if one is pending; if its handler starts on a
+// breakpoint, the tick returns there before running any instruction
 void emu_tick(Emulator *emu);
+
+// Why `emu_run` returned
+typedef enum EmuStop {
+  EMU_STOP_LIMIT,      // ran for the requested number of cycles
+  EMU_STOP_HALT,       // the emulator halted
+  EMU_STOP_BREAKPOINT, // PC reached a breakpoint
+  EMU_STOP_WATCHPOINT, // an instruction accessed a watched address
+  EMU_STOP_STACK,      // SP wrapped with a trapping stack guard attached
+} EmuStop;
+
+// Execute instructions until at least `max_cycles` cycles have passed, the
+// emulator halts, or a breakpoint or watchpoint triggers
+// A breakpoint on the PC the run starts from does not trigger, so a stopped
+// run can be resumed by calling this again
+EmuStop emu_run(Emulator *emu, u64 max_cycles);
+
+// Describe why `emu_run` stopped, on one line without a newline
+void emu_describe_stop(char *buf, usize len, const Emulator *emu,
+                       EmuStop stop);
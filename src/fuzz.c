@@ -0,0 +1,454 @@
+#include "common.h"
+#include "disasm.h"
+#include "emu6502.h"
+#include "opcode.h"
+#include "refmodel.h"
+
+#include <inttypes.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+// Differential fuzzer: runs random machine states and instruction streams
+// through both `emu_tick` and the reference model in `refmodel.h`, comparing
+// registers, flags, cycles, halting and memory writes after every step.
+//
+// A step is one `emu_tick`, which runs up to three instructions when
+// superinstructions are fused; the reference model runs instructions until it
+// has spent as many cycles. Half the cases run with fusion and the streams are
+// biased towards the instructions that fuse. The first failing case is shrunk
+// to the fewest steps, the fewest non-zero bytes and the simplest registers
+// that still fail, and printed with a disassembly.
+//
+// Every case is generated from `--seed` and its own number alone, so
+// `--case N` reruns a reported case. Cases are split across `--jobs` forked
+// processes, one per core by default.
+// Exit status is 0 if every case agreed, 1 if one did not and 2 on errors.
+
+#define MAX_STEPS 64
+// forked processes, each keeps a pid on the stack of the parent
+#define MAX_JOBS 1024
+// instructions the reference model may run for one `emu_tick`
+#define MAX_FUSED 3
+#define MAX_TOUCHED (MAX_STEPS * MAX_FUSED * REF_MAX_ACCESSES)
+
+typedef struct FuzzCase {
+  u8 mem[MEM_SIZE];
+  CPU cpu;
+  bool fusion;
+  usize steps;
+  // IRQ is asserted for the one step, NMI raised before it, -1 for none
+  i32 irq_step;
+  i32 nmi_step;
+} FuzzCase;
+
+// What a run of a case did
+typedef struct FuzzRun {
+  bool failed;
+  usize step; // of the first disagreement
+  char what[256];
+  // addresses the reference model read or wrote, for shrinking
+  u16 touched[MAX_TOUCHED];
+  usize n_touched;
+  // PC of every instruction the reference model ran, for the report
+  u16 pcs[MAX_STEPS * MAX_FUSED];
+  usize n_pcs;
+} FuzzRun;
+
+static Emulator emu;
+static u8 ref_mem[MEM_SIZE];
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--cases N] [--steps N] [--seed N] [--jobs N] "
+         "[--case N]\n",
+         name);
+}
+
+// Parse a whole decimal number
+static bool parse_u64(const char *str, u64 *n) {
+  char *end;
+  *n = strtoull(str, &end, 10);
+  return end != str && *end == '\0' && str[0] != '-';
+}
+
+static u64 splitmix64(u64 *state) {
+  u64 z = (*state += 0x9E3779B97F4A7C15);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+  return z ^ (z >> 31);
+}
+
+// the first instructions of every superinstruction in `emu_tick`, and the
+// ones that follow them
+static const u8 fusable[] = {
+    OPCODE_LDA_IM, OPCODE_STA_ZP, OPCODE_STA_ABS, OPCODE_CMP_IM,
+    OPCODE_BNE_REL, OPCODE_BEQ_REL, OPCODE_DEX, OPCODE_DEY,
+    OPCODE_INX, OPCODE_INY, OPCODE_CPX_IM, OPCODE_CPY_IM,
+    OPCODE_CLC, OPCODE_ADC_IM, OPCODE_SEC, OPCODE_SBC_IM,
+};
+
+static void generate(FuzzCase *c, const u64 seed, const u64 number,
+                     const usize steps) {
+  u64 rng = seed ^ (number * 0xD1B54A32D192ED03);
+  for (usize i = 0; i < MEM_SIZE; i += 8) {
+    const u64 r = splitmix64(&rng);
+    memcpy(&c->mem[i], &r, 8);
+  }
+  const u64 r = splitmix64(&rng);
+  c->cpu.pc = (u16)r;
+  c->cpu.sp = (u8)(r >> 16);
+  c->cpu.a = (u8)(r >> 24);
+  c->cpu.x = (u8)(r >> 32);
+  c->cpu.y = (u8)(r >> 40);
+  c->cpu.sr.byte = (u8)((u8)(r >> 48) & ~SR_B) | SR_UNUSED;
+  c->fusion = (r >> 56) & 1;
+  c->steps = steps;
+  c->irq_step = ((r >> 57) & 7) == 0 ? (i32)((r >> 60) % steps) : -1;
+  const u64 r2 = splitmix64(&rng);
+  c->nmi_step = (r2 & 7) == 0 ? (i32)((r2 >> 8) % steps) : -1;
+
+  // documented instructions from PC on, so most steps run something;
+  // branches and jumps lead off into the random bytes
+  u16 at = c->cpu.pc;
+  for (usize i = 0; i < steps; i++) {
+    u64 pick = splitmix64(&rng);
+    u8 opcode;
+    if ((pick & 3) == 0) {
+      opcode = fusable[(pick >> 2) % sizeof(fusable)];
+    } else {
+      do {
+        opcode = (u8)(pick >> 8);
+        pick = splitmix64(&rng);
+      } while (opcode_table[opcode].length == 0);
+    }
+    c->mem[at] = opcode;
+    at = (u16)(at + opcode_table[opcode].length);
+  }
+}
+
+static usize append_diff(char *buf, usize len, const char *name,
+                         const u32 emu_value, const u32 ref_value) {
+  if (emu_value == ref_value) {
+    return len;
+  }
+  const i32 n = snprintf(&buf[len], 256 - len, "%s%s emu $%X ref $%X",
+                         (len == 0) ? "" : ", ", name, emu_value, ref_value);
+  return (n < 0) ? len : ((len + (usize)n < 256) ? len + (usize)n : 255);
+}
+
+// Run a case through both engines
+// If `snapshot` is not NULL it receives the state before step `at`, as a case
+// of the remaining steps
+static void run_case(const FuzzCase *c, const bool every_byte, FuzzRun *run,
+                     const usize at, FuzzCase *snapshot) {
+  memcpy(emu.mem, c->mem, MEM_SIZE);
+  emu.cpu = c->cpu;
+  emu.cycles = 0;
+  emu.is_running = true;
+  emu.interrupts = 0;
+  emu.fusion = c->fusion;
+  memcpy(ref_mem, c->mem, MEM_SIZE);
+  RefCpu ref;
+  ref_init(&ref, &c->cpu, ref_mem);
+  run->failed = false;
+  run->n_touched = 0;
+  run->n_pcs = 0;
+
+  for (usize step = 0; step < c->steps && emu.is_running; step++) {
+    if (snapshot != NULL && step == at) {
+      memcpy(snapshot->mem, ref_mem, MEM_SIZE);
+      snapshot->cpu = (CPU){.pc = ref.pc, .sp = ref.sp, .a = ref.a,
+                            .x = ref.x, .y = ref.y, .sr.byte = ref.p};
+      snapshot->fusion = c->fusion;
+      snapshot->steps = c->steps - at;
+      snapshot->irq_step = (c->irq_step >= (i32)at) ? c->irq_step - (i32)at
+                                                     : -1;
+      snapshot->nmi_step = (c->nmi_step >= (i32)at) ? c->nmi_step - (i32)at
+                                                     : -1;
+    }
+    if ((i32)step == c->irq_step) {
+      emu_set_irq(&emu, true);
+      ref.interrupts |= EMU_INT_IRQ;
+    }
+    if ((i32)step == c->nmi_step) {
+      emu_nmi(&emu);
+      ref.interrupts |= EMU_INT_NMI;
+    }
+
+    emu_tick(&emu);
+    usize n = 0;
+    usize n_writes = 0;
+    u16 writes[MAX_FUSED * REF_MAX_ACCESSES];
+    do {
+      run->pcs[run->n_pcs++] = ref.pc;
+      ref_step(&ref);
+      for (usize i = 0; i < ref.n_accesses; i++) {
+        run->touched[run->n_touched++] = ref.accesses[i].addr;
+        if (ref.accesses[i].write) {
+          writes[n_writes++] = ref.accesses[i].addr;
+        }
+      }
+      n++;
+    } while (!ref.halted && ref.cycles < emu.cycles && n < MAX_FUSED);
+    emu_set_irq(&emu, false);
+    ref.interrupts &= (u8)~EMU_INT_IRQ;
+
+    usize len = 0;
+    run->what[0] = '\0';
+    len = append_diff(run->what, len, "PC", emu.cpu.pc, ref.pc);
+    len = append_diff(run->what, len, "SP", emu.cpu.sp, ref.sp);
+    len = append_diff(run->what, len, "A", emu.cpu.a, ref.a);
+    len = append_diff(run->what, len, "X", emu.cpu.x, ref.x);
+    len = append_diff(run->what, len, "Y", emu.cpu.y, ref.y);
+    len = append_diff(run->what, len, "P", emu.cpu.sr.byte, ref.p);
+    len = append_diff(run->what, len, "cycles", (u32)emu.cycles,
+                      (u32)ref.cycles);
+    len = append_diff(run->what, len, "halted", !emu.is_running, ref.halted);
+    for (usize i = 0; i < n_writes; i++) {
+      const u16 addr = writes[i];
+      if (emu.mem[addr] != ref_mem[addr]) {
+        char name[16];
+        snprintf(name, sizeof(name), "$%04X", addr);
+        len = append_diff(run->what, len, name, emu.mem[addr], ref_mem[addr]);
+        break;
+      }
+    }
+    if (len == 0 && every_byte && memcmp(emu.mem, ref_mem, MEM_SIZE) != 0) {
+      // a write the reference model did not make
+      for (usize addr = 0; addr < MEM_SIZE; addr++) {
+        if (emu.mem[addr] != ref_mem[addr]) {
+          char name[16];
+          snprintf(name, sizeof(name), "$%04X", (u16)addr);
+          len = append_diff(run->what, len, name, emu.mem[addr],
+                            ref_mem[addr]);
+          break;
+        }
+      }
+    }
+    if (len != 0) {
+      run->failed = true;
+      run->step = step;
+      return;
+    }
+  }
+  if (!every_byte && memcmp(emu.mem, ref_mem, MEM_SIZE) != 0) {
+    // find the step with every byte checked
+    run_case(c, true, run, at, NULL);
+  }
+}
+
+// Keep `candidate` in `c` if it still fails
+static bool try_shrink(FuzzCase *c, const FuzzCase *candidate, FuzzRun *run) {
+  static FuzzRun trial;
+  run_case(candidate, true, &trial, 0, NULL);
+  if (!trial.failed) {
+    return false;
+  }
+  if (c != candidate) {
+    memcpy(c, candidate, sizeof(FuzzCase));
+  }
+  memcpy(run, &trial, sizeof(FuzzRun));
+  return true;
+}
+
+// Shrink a failing case in place: first to start as late and stop as early as
+// possible, then to as few non-zero bytes and as simple registers as possible
+static void shrink(FuzzCase *c, FuzzRun *run) {
+  static FuzzCase candidate;
+  static FuzzRun ignored;
+  c->steps = run->step + 1;
+  try_shrink(c, c, run);
+  for (usize at = run->step; at > 0; at--) {
+    run_case(c, true, &ignored, at, &candidate);
+    if (try_shrink(c, &candidate, run)) {
+      break;
+    }
+  }
+  c->steps = run->step + 1;
+
+  // only the bytes the reference model used
+  memcpy(&candidate, c, sizeof(FuzzCase));
+  memset(candidate.mem, 0, MEM_SIZE);
+  for (usize i = 0; i < run->n_touched; i++) {
+    candidate.mem[run->touched[i]] = c->mem[run->touched[i]];
+  }
+  try_shrink(c, &candidate, run);
+  static u16 touched[MAX_TOUCHED];
+  const usize n_touched = run->n_touched;
+  memcpy(touched, run->touched, n_touched * sizeof(u16));
+  for (usize i = 0; i < n_touched; i++) {
+    if (c->mem[touched[i]] != 0) {
+      memcpy(&candidate, c, sizeof(FuzzCase));
+      candidate.mem[touched[i]] = 0;
+      try_shrink(c, &candidate, run);
+    }
+  }
+
+  memcpy(&candidate, c, sizeof(FuzzCase));
+  candidate.fusion = false;
+  try_shrink(c, &candidate, run);
+  memcpy(&candidate, c, sizeof(FuzzCase));
+  candidate.irq_step = -1;
+  candidate.nmi_step = -1;
+  try_shrink(c, &candidate, run);
+  u8 *regs[] = {&candidate.cpu.a, &candidate.cpu.x, &candidate.cpu.y};
+  for (usize i = 0; i < 3; i++) {
+    memcpy(&candidate, c, sizeof(FuzzCase));
+    *regs[i] = 0;
+    try_shrink(c, &candidate, run);
+  }
+  memcpy(&candidate, c, sizeof(FuzzCase));
+  candidate.cpu.sp = 0xFF;
+  try_shrink(c, &candidate, run);
+  memcpy(&candidate, c, sizeof(FuzzCase));
+  candidate.cpu.sr.byte = SR_UNUSED;
+  try_shrink(c, &candidate, run);
+}
+
+static void print_case(const FuzzCase *c, const FuzzRun *run,
+                       const u64 number) {
+  printf("case %" PRIu64 " disagrees at step %zu: %s\n", number, run->step,
+         run->what);
+  printf("  start: PC=$%04X SP=$%02X A=$%02X X=$%02X Y=$%02X P=$%02X, "
+         "fusion %s",
+         c->cpu.pc, c->cpu.sp, c->cpu.a, c->cpu.x, c->cpu.y, c->cpu.sr.byte,
+         c->fusion ? "on" : "off");
+  if (c->irq_step >= 0) {
+    printf(", IRQ at step %d", c->irq_step);
+  }
+  if (c->nmi_step >= 0) {
+    printf(", NMI at step %d", c->nmi_step);
+  }
+  printf("\n  memory, all other bytes zero:");
+  usize on_line = 0;
+  for (usize addr = 0; addr < MEM_SIZE; addr++) {
+    if (c->mem[addr] == 0) {
+      on_line = 0;
+      continue;
+    }
+    if (on_line % 8 == 0) {
+      printf("\n    $%04zX:", addr);
+    }
+    printf(" %02X", c->mem[addr]);
+    on_line++;
+  }
+  printf("\n  ran:\n");
+  for (usize i = 0; i < run->n_pcs; i++) {
+    char text[DISASM_MAX_LEN];
+    disasm_instr(c->mem, run->pcs[i], text);
+    printf("    $%04X  %s\n", run->pcs[i], text);
+  }
+}
+
+// Run cases `first` to `end`, returns false after reporting the first failure
+static bool fuzz(const u64 seed, const u64 first, const u64 end,
+                 const usize steps) {
+  static FuzzCase c;
+  static FuzzRun run;
+  for (u64 number = first; number < end; number++) {
+    generate(&c, seed, number, steps);
+    run_case(&c, false, &run, 0, NULL);
+    if (run.failed) {
+      shrink(&c, &run);
+      print_case(&c, &run, number);
+      return false;
+    }
+  }
+  return true;
+}
+
+i32 main(i32 argc, char *argv[]) {
+  u64 cases = 1000000;
+  usize steps = 16;
+  u64 seed = (u64)time(NULL);
+  i64 jobs = sysconf(_SC_NPROCESSORS_ONLN);
+  i64 only_case = -1;
+
+  for (i32 i = 1; i < argc; i++) {
+    u64 n;
+    if (strcmp(argv[i], "--cases") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &cases) || cases == 0) {
+        printf("invalid number of cases: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--steps") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &n) || n == 0 || n > MAX_STEPS) {
+        printf("--steps must be 1 to %d\n", MAX_STEPS);
+        return 2;
+      }
+      steps = (usize)n;
+    } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &seed)) {
+        printf("invalid seed: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &n) || n == 0 || n > MAX_JOBS) {
+        printf("--jobs must be 1 to %d\n", MAX_JOBS);
+        return 2;
+      }
+      jobs = (i64)n;
+    } else if (strcmp(argv[i], "--case") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &n) || n >= INT64_MAX) {
+        printf("invalid case number: %s\n", argv[i]);
+        return 2;
+      }
+      only_case = (i64)n;
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  emu_init(&emu, false);
+  if (only_case >= 0) {
+    return fuzz(seed, (u64)only_case, (u64)only_case + 1, steps) ? 0 : 1;
+  }
+  if (jobs < 1) {
+    jobs = 1;
+  }
+
+  printf("%s, seed %" PRIu64 ", %" PRIu64 " cases of %zu steps on %" PRIi64
+         " jobs\n",
+         CPU_NAME, seed, cases, steps, jobs);
+  fflush(stdout);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pid_t pids[jobs];
+  for (i64 job = 0; job < jobs; job++) {
+    pids[job] = fork();
+    if (pids[job] < 0) {
+      printf("fork failed\n");
+      return 2;
+    }
+    if (pids[job] == 0) {
+      const u64 first = cases * (u64)job / (u64)jobs;
+      const u64 last = cases * (u64)(job + 1) / (u64)jobs;
+      exit(fuzz(seed, first, last, steps) ? 0 : 1);
+    }
+  }
+  bool passed = true;
+  for (i64 done = 0; done < jobs; done++) {
+    i32 status;
+    const pid_t pid = wait(&status);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      // one reproducer is enough
+      passed = false;
+      for (i64 job = 0; job < jobs; job++) {
+        if (pids[job] != pid) {
+          kill(pids[job], SIGTERM);
+        }
+      }
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  if (!passed) {
+    printf("FAIL (rerun with --seed %" PRIu64 " --case N)\n", seed);
+    return 1;
+  }
+  const f64 seconds = (f64)(end.tv_sec - start.tv_sec) +
+                      (f64)(end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("PASS: %" PRIu64 " cases in %.2fs (%.1f million per minute)\n", cases,
+         seconds, (f64)cases / seconds * 60 / 1e6);
+  return 0;
+}
@@ -0,0 +1,572 @@
+#include "gdbstub.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// a debugger going away must not kill the emulator with SIGPIPE
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define GDB_REG_A 0
+#define GDB_REG_X 1
+#define GDB_REG_Y 2
+#define GDB_REG_P 3
+#define GDB_REG_SP 4
+#define GDB_REG_PC 5
+
+static const char target_xml[] =
+    "<?xml version=\"1.0\"?>"
+    "<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+    "<target version=\"1.0\">"
+    "<feature name=\"org.emu6502.cpu\">"
+    "<reg name=\"a\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"x\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"y\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"p\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>"
+    "<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+    "</feature>"
+    "</target>";
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static i32 hex_value(const char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// parse a hexadecimal number, advancing `*p` past it
+static u64 parse_hex(const char **p) {
+  u64 x = 0;
+  i32 digit;
+  while ((digit = hex_value(**p)) >= 0) {
+    x = (x << 4) | (u64)digit;
+    (*p)++;
+  }
+  return x;
+}
+
+static char *put_hex_byte(char *out, const u8 byte) {
+  out[0] = hex_digits[byte >> 4];
+  out[1] = hex_digits[byte & 0xF];
+  return out + 2;
+}
+
+bool gdbstub_listen(GdbStub *stub, const char *spec) {
+  memset(stub, 0, sizeof(GdbStub));
+  stub->fd = -1;
+  if (strchr(spec, '/') != NULL) {
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(spec) >= sizeof(addr.sun_path)) {
+      printf("gdb: socket path too long: %s\n", spec);
+      return false;
+    }
+    strcpy(addr.sun_path, spec);
+    unlink(spec);
+    stub->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (stub->listen_fd < 0 ||
+        bind(stub->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      perror("gdb");
+      return false;
+    }
+    strcpy(stub->unix_path, spec);
+  } else {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((u16)atoi(spec));
+    stub->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (stub->listen_fd < 0) {
+      perror("gdb");
+      return false;
+    }
+    const i32 yes = 1;
+    setsockopt(stub->listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    if (bind(stub->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+      perror("gdb");
+      return false;
+    }
+  }
+  if (listen(stub->listen_fd, 1) != 0) {
+    perror("gdb");
+    return false;
+  }
+  return true;
+}
+
+void gdbstub_close(GdbStub *stub) {
+  if (stub->fd >= 0) {
+    close(stub->fd);
+    stub->fd = -1;
+  }
+  if (stub->listen_fd >= 0) {
+    close(stub->listen_fd);
+    stub->listen_fd = -1;
+  }
+  if (stub->unix_path[0] != '\0') {
+    unlink(stub->unix_path);
+    stub->unix_path[0] = '\0';
+  }
+}
+
+// Returns the next byte from the connection, or -1 if it was closed
+static i32 read_byte(GdbStub *stub) {
+  if (stub->in_pos == stub->in_len) {
+    const isize n = read(stub->fd, stub->in, sizeof(stub->in));
+    if (n <= 0) {
+      return -1;
+    }
+    stub->in_len = (usize)n;
+    stub->in_pos = 0;
+  }
+  return stub->in[stub->in_pos++];
+}
+
+static bool has_input(GdbStub *stub) {
+  if (stub->in_pos != stub->in_len) {
+    return true;
+  }
+  struct pollfd pfd = {stub->fd, POLLIN, 0};
+  return poll(&pfd, 1, 0) > 0;
+}
+
+static void write_all(GdbStub *stub, const char *data, usize len) {
+  while (len != 0) {
+    const isize n = send(stub->fd, data, len, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    data += n;
+    len -= (usize)n;
+  }
+}
+
+static void send_packet(GdbStub *stub, const char *data) {
+  static char frame[GDB_PACKET_SIZE * 2 + 4];
+  usize len = 0;
+  u8 checksum = 0;
+  frame[len++] = '$';
+  for (const char *c = data; *c != '\0'; c++) {
+    if (*c == '$' || *c == '#' || *c == '}' || *c == '*') {
+      frame[len++] = '}';
+      checksum += '}';
+      frame[len++] = (char)(*c ^ 0x20);
+      checksum += (u8)(*c ^ 0x20);
+    } else {
+      frame[len++] = *c;
+      checksum += (u8)*c;
+    }
+  }
+  frame[len++] = '#';
+  put_hex_byte(&frame[len], checksum);
+  len += 2;
+  write_all(stub, frame, len);
+}
+
+// Read packets until one with a valid checksum arrives, acknowledging it
+// ^C outside of a packet is returned as the packet "\x03"
+// Returns false if the connection was closed
+static bool read_packet(GdbStub *stub) {
+  while (true) {
+    i32 c = read_byte(stub);
+    if (c < 0) {
+      return false;
+    }
+    if (c == 0x03) {
+      strcpy(stub->packet, "\x03");
+      return true;
+    }
+    if (c != '$') {
+      continue; // acks and noise
+    }
+    usize len = 0;
+    u8 checksum = 0;
+    while ((c = read_byte(stub)) >= 0 && c != '#') {
+      checksum += (u8)c;
+      if (c == '}') {
+        c = read_byte(stub);
+        if (c < 0) {
+          return false;
+        }
+        checksum += (u8)c;
+        c ^= 0x20;
+      }
+      if (len < GDB_PACKET_SIZE - 1) {
+        stub->packet[len++] = (char)c;
+      }
+    }
+    const i32 hi = read_byte(stub);
+    const i32 lo = read_byte(stub);
+    if (c < 0 || hi < 0 || lo < 0) {
+      return false;
+    }
+    stub->packet[len] = '\0';
+    const i32 hi_value = hex_value((char)hi);
+    const i32 lo_value = hex_value((char)lo);
+    const bool valid = hi_value >= 0 && lo_value >= 0 &&
+                       (hi_value << 4 | lo_value) == checksum;
+    if (!stub->no_ack) {
+      write_all(stub, valid ? "+" : "-", 1);
+    }
+    if (valid) {
+      return true;
+    }
+  }
+}
+
+static u8 read_reg(const Emulator *emu, const u64 n) {
+  switch (n) {
+  case GDB_REG_A:
+    return emu->cpu.a;
+  case GDB_REG_X:
+    return emu->cpu.x;
+  case GDB_REG_Y:
+    return emu->cpu.y;
+  case GDB_REG_P:
+    return emu->cpu.sr.byte;
+  case GDB_REG_SP:
+    return emu->cpu.sp;
+  }
+  return 0;
+}
+
+static void set_reg(CPU *cpu, const u64 n, const u64 value) {
+  switch (n) {
+  case GDB_REG_A:
+    cpu->a = (u8)value;
+    break;
+  case GDB_REG_X:
+    cpu->x = (u8)value;
+    break;
+  case GDB_REG_Y:
+    cpu->y = (u8)value;
+    break;
+  case GDB_REG_P:
+    cpu->sr.byte = (u8)value;
+    break;
+  case GDB_REG_SP:
+    cpu->sp = (u8)value;
+    break;
+  case GDB_REG_PC:
+    cpu->pc = (u16)value;
+    break;
+  }
+}
+
+// Resume at `pc`, through `emu_set_cpu` so a recording sees the change
+static void set_pc(Emulator *emu, const u16 pc) {
+  CPU cpu = emu->cpu;
+  cpu.pc = pc;
+  emu_set_cpu(emu, &cpu);
+}
+
+// register values are sent in target (little endian) byte order
+static u64 swap_pc_bytes(const u64 x) { return ((x & 0xFF) << 8) | (x >> 8); }
+
+// Reply for a stopped target
+static void stop_reply(GdbStub *stub, const Emulator *emu, const EmuStop stop) {
+  if (stop == EMU_STOP_HALT) {
+    send_packet(stub, "W00");
+  } else if (stop == EMU_STOP_WATCHPOINT) {
+    const Breakpoints *bp = emu->breakpoints;
+    snprintf(stub->reply, sizeof(stub->reply), "T05%s:%04x;",
+             (bp->hit_kind == WATCH_READ) ? "rwatch" : "watch", bp->hit_addr);
+    send_packet(stub, stub->reply);
+  } else {
+    send_packet(stub, "S05");
+  }
+}
+
+// Run until stopped by a breakpoint, watchpoint, halt or ^C from the debugger
+// Returns false if the connection was closed
+static bool cont(GdbStub *stub, Emulator *emu) {
+  EmuStop stop;
+  while ((stop = emu_run(emu, GDB_RUN_SLICE_CYCLES)) == EMU_STOP_LIMIT) {
+    if (has_input(stub)) {
+      const i32 c = read_byte(stub);
+      if (c < 0) {
+        return false;
+      }
+      if (c == 0x03) {
+        send_packet(stub, "S02");
+        return true;
+      }
+    }
+  }
+  stop_reply(stub, emu, stop);
+  return true;
+}
+
+static void handle_breakpoint(GdbStub *stub, Emulator *emu, const bool insert) {
+  const char *p = &stub->packet[1];
+  const u64 type = parse_hex(&p);
+  if (*p++ != ',') {
+    send_packet(stub, "E01");
+    return;
+  }
+  const u16 addr = (u16)parse_hex(&p);
+  u64 len = 1;
+  if (*p == ',') {
+    p++;
+    len = parse_hex(&p);
+  }
+  Breakpoints *bp = emu->breakpoints;
+  if (type == 0 || type == 1) {
+    if (insert) {
+      breakpoint_set(bp, addr);
+    } else {
+      breakpoint_clear(bp, addr);
+    }
+    send_packet(stub, "OK");
+    return;
+  }
+  if (type > 4) {
+    send_packet(stub, "");
+    return;
+  }
+  static const u8 kinds[] = {0, 0, WATCH_WRITE, WATCH_READ,
+                             WATCH_READ | WATCH_WRITE};
+  const u16 end = (u16)(addr + (len == 0 ? 0 : len - 1));
+  const bool ok = insert ? watchpoint_add(bp, addr, end, kinds[type])
+                         : watchpoint_remove(bp, addr, end, kinds[type]);
+  send_packet(stub, ok ? "OK" : "E01");
+}
+
+static void handle_read_memory(GdbStub *stub, const Emulator *emu) {
+  const char *p = &stub->packet[1];
+  const u64 addr = parse_hex(&p);
+  if (*p++ != ',') {
+    send_packet(stub, "E01");
+    return;
+  }
+  u64 len = parse_hex(&p);
+  if (len > (sizeof(stub->reply) - 1) / 2) {
+    len = (sizeof(stub->reply) - 1) / 2;
+  }
+  char *out = stub->reply;
+  for (u64 i = 0; i < len; i++) {
+    out = put_hex_byte(out, emu_read_mem_byte(emu, (u16)(addr + i)));
+  }
+  *out = '\0';
+  send_packet(stub, stub->reply);
+}
+
+static void handle_write_memory(GdbStub *stub, Emulator *emu) {
+  const char *p = &stub->packet[1];
+  const u64 addr = parse_hex(&p);
+  if (*p++ != ',') {
+    send_packet(stub, "E01");
+    return;
+  }
+  const u64 len = parse_hex(&p);
+  if (*p++ != ':') {
+    send_packet(stub, "E01");
+    return;
+  }
+  for (u64 i = 0; i < len; i++) {
+    const i32 hi = hex_value(p[0]);
+    const i32 lo = hex_value(p[1]);
+    if (hi < 0 || lo < 0) {
+      send_packet(stub, "E01");
+      return;
+    }
+    emu_write_mem_byte(emu, (u16)(addr + i), (u8)(hi << 4 | lo));
+    p += 2;
+  }
+  send_packet(stub, "OK");
+}
+
+static void handle_query(GdbStub *stub) {
+  const char *q = stub->packet;
+  if (strncmp(q, "qSupported", 10) == 0) {
+    snprintf(stub->reply, sizeof(stub->reply),
+             "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+",
+             GDB_PACKET_SIZE - 1);
+    send_packet(stub, stub->reply);
+  } else if (strncmp(q, "qXfer:features:read:target.xml:", 31) == 0) {
+    const char *p = q + 31;
+    const u64 offset = parse_hex(&p);
+    u64 len = (*p == ',') ? (p++, parse_hex(&p)) : 0;
+    const u64 total = sizeof(target_xml) - 1;
+    if (offset >= total) {
+      send_packet(stub, "l");
+      return;
+    }
+    if (len > total - offset) {
+      len = total - offset;
+    }
+    if (len > sizeof(stub->reply) / 2) {
+      len = sizeof(stub->reply) / 2;
+    }
+    stub->reply[0] = (offset + len == total) ? 'l' : 'm';
+    memcpy(&stub->reply[1], &target_xml[offset], len);
+    stub->reply[len + 1] = '\0';
+    send_packet(stub, stub->reply);
+  } else if (strcmp(q, "QStartNoAckMode") == 0) {
+    send_packet(stub, "OK");
+    stub->no_ack = true;
+  } else if (strcmp(q, "qAttached") == 0) {
+    send_packet(stub, "1");
+  } else if (strcmp(q, "qC") == 0) {
+    send_packet(stub, "QC1");
+  } else if (strcmp(q, "qfThreadInfo") == 0) {
+    send_packet(stub, "m1");
+  } else if (strcmp(q, "qsThreadInfo") == 0) {
+    send_packet(stub, "l");
+  } else {
+    send_packet(stub, "");
+  }
+}
+
+// Handle one packet
+// Returns false when the session is over
+static bool handle_packet(GdbStub *stub, Emulator *emu) {
+  const char *p = &stub->packet[1];
+  switch (stub->packet[0]) {
+  case 0x03:
+    send_packet(stub, "S02");
+    break;
+  case '?':
+    send_packet(stub, "S05");
+    break;
+  case 'g': {
+    char *out = stub->reply;
+    for (u64 i = GDB_REG_A; i <= GDB_REG_SP; i++) {
+      out = put_hex_byte(out, read_reg(emu, i));
+    }
+    out = put_hex_byte(out, (u8)emu->cpu.pc);
+    out = put_hex_byte(out, (u8)(emu->cpu.pc >> 8));
+    *out = '\0';
+    send_packet(stub, stub->reply);
+  } break;
+  case 'G': {
+    // A X Y P SP and PC low, high, in register order
+    u8 bytes[GDB_REG_PC + 2];
+    bool valid = strlen(p) >= 2 * sizeof(bytes);
+    for (usize i = 0; valid && i < sizeof(bytes); i++) {
+      const i32 hi = hex_value(p[2 * i]);
+      const i32 lo = hex_value(p[2 * i + 1]);
+      valid = hi >= 0 && lo >= 0;
+      bytes[i] = (u8)(hi << 4 | lo);
+    }
+    if (!valid) {
+      send_packet(stub, "E01");
+      break;
+    }
+    CPU cpu = emu->cpu;
+    for (u64 i = GDB_REG_A; i <= GDB_REG_SP; i++) {
+      set_reg(&cpu, i, bytes[i]);
+    }
+    set_reg(&cpu, GDB_REG_PC,
+            (u64)(bytes[GDB_REG_PC] | bytes[GDB_REG_PC + 1] << 8));
+    // through the emulator, so a recording sees it, as one change
+    emu_set_cpu(emu, &cpu);
+    send_packet(stub, "OK");
+  } break;
+  case 'p': {
+    const u64 n = parse_hex(&p);
+    if (n == GDB_REG_PC) {
+      char *out = put_hex_byte(stub->reply, (u8)emu->cpu.pc);
+      out = put_hex_byte(out, (u8)(emu->cpu.pc >> 8));
+      *out = '\0';
+    } else if (n < GDB_REG_PC) {
+      *put_hex_byte(stub->reply, read_reg(emu, n)) = '\0';
+    } else {
+      strcpy(stub->reply, "E01");
+    }
+    send_packet(stub, stub->reply);
+  } break;
+  case 'P': {
+    const u64 n = parse_hex(&p);
+    if (*p++ != '=' || n > GDB_REG_PC) {
+      send_packet(stub, "E01");
+      break;
+    }
+    const u64 value = parse_hex(&p);
+    CPU cpu = emu->cpu;
+    set_reg(&cpu, n, (n == GDB_REG_PC) ? swap_pc_bytes(value) : value);
+    // through the emulator, so a recording sees it
+    emu_set_cpu(emu, &cpu);
+    send_packet(stub, "OK");
+  } break;
+  case 'm':
+    handle_read_memory(stub, emu);
+    break;
+  case 'M':
+    handle_write_memory(stub, emu);
+    break;
+  case 'c':
+    if (*p != '\0') {
+      set_pc(emu, (u16)parse_hex(&p));
+    }
+    return cont(stub, emu);
+  case 's':
+    if (*p != '\0') {
+      set_pc(emu, (u16)parse_hex(&p));
+    }
+    if (emu->is_running) {
+      emu_tick(emu);
+    }
+    if (emu->breakpoints->watch_hit) {
+      emu->breakpoints->watch_hit = false;
+      stop_reply(stub, emu, EMU_STOP_WATCHPOINT);
+    } else {
+      stop_reply(stub, emu, emu->is_running ? EMU_STOP_LIMIT : EMU_STOP_HALT);
+    }
+    break;
+  case 'Z':
+    handle_breakpoint(stub, emu, true);
+    break;
+  case 'z':
+    handle_breakpoint(stub, emu, false);
+    break;
+  case 'H':
+    send_packet(stub, "OK");
+    break;
+  case 'q':
+  case 'Q':
+    handle_query(stub);
+    break;
+  case 'D':
+    send_packet(stub, "OK");
+    return false;
+  case 'k':
+    return false;
+  default:
+    send_packet(stub, "");
+    break;
+  }
+  return true;
+}
+
+void gdbstub_serve(GdbStub *stub, Emulator *emu) {
+  stub->fd = accept(stub->listen_fd, NULL, NULL);
+  if (stub->fd < 0) {
+    perror("gdb");
+    return;
+  }
+#ifdef SO_NOSIGPIPE
+  const i32 yes = 1;
+  setsockopt(stub->fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+  stub->no_ack = false;
+  stub->in_len = 0;
+  stub->in_pos = 0;
+  while (read_packet(stub) && handle_packet(stub, emu))
+    ;
+  close(stub->fd);
+  stub->fd = -1;
+}
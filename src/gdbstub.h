@@ -0,0 +1,45 @@
+#pragma once
+
+#include "breakpoints.h"
+#include "common.h"
+#include "emu6502.h"
+
+// GDB remote serial protocol server.
+//
+// Serves one debugger connection over a Unix domain socket or a local TCP
+// port. Registers are numbered 0 A, 1 X, 2 Y, 3 P (status), 4 SP (8 bits each)
+// and 5 PC (16 bits, little endian); `qXfer:features:read` describes them to
+// front-ends that ask. Supports reading and writing registers and memory,
+// software and hardware breakpoints (Z0/Z1), watchpoints (Z2/Z3/Z4), step,
+// continue and interrupting with ^C.
+//
+// While the target runs the emulator executes in slices of
+// `GDB_RUN_SLICE_CYCLES` and the socket is only polled between slices, so a
+// continued target runs at full speed.
+
+#define GDB_PACKET_SIZE 4096
+#define GDB_RUN_SLICE_CYCLES 1000000
+
+typedef struct GdbStub {
+  i32 listen_fd;
+  i32 fd; // the connection, -1 if none
+  bool no_ack;
+  char unix_path[108]; // path to unlink on close, empty for TCP
+  usize in_len;
+  usize in_pos;
+  u8 in[GDB_PACKET_SIZE];
+  char packet[GDB_PACKET_SIZE];
+  char reply[GDB_PACKET_SIZE];
+} GdbStub;
+
+// Start listening on `spec`, which is either a path (anything containing a
+// `/`) for a Unix domain socket or a TCP port number on 127.0.0.1
+// Returns false and prints the reason on failure
+bool gdbstub_listen(GdbStub *stub, const char *spec);
+
+// Wait for a debugger to connect and serve it until it detaches, kills the
+// target or disconnects
+// The emulator must have `breakpoints` attached
+void gdbstub_serve(GdbStub *stub, Emulator *emu);
+
+void gdbstub_close(GdbStub *stub);
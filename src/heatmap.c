@@ -0,0 +1,86 @@
+#include "heatmap.h"
+
+#include <inttypes.h>
+
+void heatmap_init(Heatmap *heatmap, const bool blocks) {
+  memset(heatmap, 0, sizeof(Heatmap));
+  heatmap->shift = blocks ? HEATMAP_BLOCK_SHIFT : 0;
+}
+
+void heatmap_write_csv(const Heatmap *heatmap, FILE *file) {
+  const u32 n = MEM_SIZE >> heatmap->shift;
+  fprintf(file, "addr,reads,writes,execs\n");
+  for (u32 i = 0; i < n; i++) {
+    if (heatmap->reads[i] != 0 || heatmap->writes[i] != 0 ||
+        heatmap->execs[i] != 0) {
+      fprintf(file, "%04X,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+              i << heatmap->shift, heatmap->reads[i], heatmap->writes[i],
+              heatmap->execs[i]);
+    }
+  }
+}
+
+// number of bits of `x`, its logarithm rounded up
+static u32 bit_length(const u64 x) {
+  return (x == 0) ? 0 : 64 - (u32)__builtin_clzll(x);
+}
+
+// `count` scaled to 0..255 by its logarithm relative to `max`
+static u8 brightness(const u64 count, const u64 max) {
+  if (count == 0) {
+    return 0;
+  }
+  // anything accessed at all stays visible
+  return (u8)(48 + 207 * bit_length(count) / bit_length(max));
+}
+
+static u64 max_count(const u64 *counts, const u32 n) {
+  u64 max = 0;
+  for (u32 i = 0; i < n; i++) {
+    max = (counts[i] > max) ? counts[i] : max;
+  }
+  return max;
+}
+
+void heatmap_write_ppm(const Heatmap *heatmap, FILE *file) {
+  const u32 n = MEM_SIZE >> heatmap->shift;
+  const u64 max_reads = max_count(heatmap->reads, n);
+  const u64 max_writes = max_count(heatmap->writes, n);
+  const u64 max_execs = max_count(heatmap->execs, n);
+  fprintf(file, "P6\n256 256\n255\n");
+  for (u32 addr = 0; addr < MEM_SIZE; addr++) {
+    const u32 i = addr >> heatmap->shift;
+    const u8 pixel[3] = {brightness(heatmap->writes[i], max_writes),
+                         brightness(heatmap->reads[i], max_reads),
+                         brightness(heatmap->execs[i], max_execs)};
+    fwrite(pixel, 1, sizeof(pixel), file);
+  }
+}
+
+usize heatmap_changed_since(const Heatmap *heatmap, const u64 cycle,
+                            HeatmapRange *out, const usize max) {
+  usize n = 0;
+  bool in_range = false;
+  for (u32 block = 0; block < HEATMAP_BLOCKS; block++) {
+    const u64 written_at = heatmap->written_at[block];
+    if (written_at == 0 || written_at - 1 < cycle) {
+      in_range = false;
+      continue;
+    }
+    if (!in_range) {
+      if (n < max) {
+        out[n] = (HeatmapRange){.start = (u16)(block << HEATMAP_BLOCK_SHIFT)};
+      }
+      n++;
+      in_range = true;
+    }
+    if (n <= max) {
+      HeatmapRange *range = &out[n - 1];
+      range->end = (block + 1) << HEATMAP_BLOCK_SHIFT;
+      if (written_at - 1 > range->last_write) {
+        range->last_write = written_at - 1;
+      }
+    }
+  }
+  return n;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Memory access heatmap and dirty memory tracking.
+//
+// Counts the reads and writes instructions make and the instructions executed
+// at every address, or for lower overhead per 16 byte block, whose counters
+// fit in a few cache lines per page. Counting is an increment of a flat table
+// at the access sites of `emu_tick` (`load_byte`, `store_byte` and the opcode
+// fetch). The counts are exported as CSV or as a 256x256 PPM image with one
+// row per page, red for writes, green for reads and blue for executes.
+//
+// Every 16 byte block also remembers the cycle it was last written at, by an
+// instruction or by `emu_write_mem_byte`, so "what changed since cycle T" is a
+// scan of 4096 entries whatever happened in between, see
+// `heatmap_changed_since`.
+
+// bytes counted together in block mode, and tracked together for changes
+#define HEATMAP_BLOCK_SHIFT 4
+#define HEATMAP_BLOCKS (MEM_SIZE >> HEATMAP_BLOCK_SHIFT)
+
+typedef struct Heatmap {
+  u32 shift; // 0 to count each address, `HEATMAP_BLOCK_SHIFT` for blocks
+  u64 reads[MEM_SIZE];
+  u64 writes[MEM_SIZE];
+  u64 execs[MEM_SIZE];
+  // 1 + the cycle each block was last written at, 0 if it never was
+  u64 written_at[HEATMAP_BLOCKS];
+} Heatmap;
+
+// Addresses that changed since a cycle, see `heatmap_changed_since`
+typedef struct HeatmapRange {
+  u16 start;
+  u32 end;         // exclusive
+  u64 last_write;  // cycle of the latest write in the range
+} HeatmapRange;
+
+// Clear all counters, counting per 16 byte block if `blocks`
+void heatmap_init(Heatmap *heatmap, bool blocks);
+
+// Called by the emulator on every load of an instruction
+static inline void heatmap_read(Heatmap *heatmap, const u16 addr) {
+  heatmap->reads[addr >> heatmap->shift]++;
+}
+
+// Called by the emulator on every change to memory, `count` is false for
+// writes from outside the program, which are not counted as writes
+static inline void heatmap_write(Heatmap *heatmap, const u16 addr,
+                                 const u64 cycle, const bool count) {
+  if (count) {
+    heatmap->writes[addr >> heatmap->shift]++;
+  }
+  heatmap->written_at[addr >> HEATMAP_BLOCK_SHIFT] = cycle + 1;
+}
+
+// Called by the emulator before executing the instruction at `pc`
+static inline void heatmap_exec(Heatmap *heatmap, const u16 pc) {
+  heatmap->execs[pc >> heatmap->shift]++;
+}
+
+// Write the counters of every address or block that was accessed as CSV
+void heatmap_write_csv(const Heatmap *heatmap, FILE *file);
+
+// Write a 256x256 binary PPM image, brightness on a log scale
+void heatmap_write_ppm(const Heatmap *heatmap, FILE *file);
+
+// The 16 byte blocks written at or after `cycle`, adjacent ones merged into
+// ranges, in address order
+// Returns the number of ranges, of which the first `max` are stored in `out`
+usize heatmap_changed_since(const Heatmap *heatmap, u64 cycle,
+                            HeatmapRange *out, usize max);
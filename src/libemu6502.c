@@ -0,0 +1,152 @@
+#include "libemu6502.h"
+#include "bank.h"
+#include "common.h"
+#include "emu6502.h"
+#include "loader.h"
+#include "record.h"
+
+// The handle is the emulator itself, only the name is public
+struct Emu6502 {
+  Emulator emu;
+  char error[LOADER_ERROR_SIZE]; // of the last failed `emu6502_load_file`
+};
+
+// the machine state, everything `emu_cold_boot` copies
+#define SNAPSHOT_SIZE offsetof(Emulator, log_buf)
+
+int emu6502_api_version(void) { return EMU6502_API_VERSION; }
+
+const char *emu6502_cpu_name(void) { return CPU_NAME; }
+
+size_t emu6502_size(void) { return sizeof(Emu6502); }
+
+size_t emu6502_align(void) { return _Alignof(Emu6502); }
+
+Emu6502 *emu6502_init(void *storage) {
+  Emu6502 *handle = storage;
+  emu_init(&handle->emu, false);
+  handle->error[0] = '\0';
+  // nothing can be attached through this API, so fusion is always safe
+  handle->emu.fusion = true;
+  return handle;
+}
+
+Emu6502 *emu6502_create(void) {
+  // the size of an aligned struct is a multiple of its alignment
+  void *storage = aligned_alloc(_Alignof(Emu6502), sizeof(Emu6502));
+  return (storage == NULL) ? NULL : emu6502_init(storage);
+}
+
+void emu6502_destroy(Emu6502 *emu) {
+  if (emu == NULL) {
+    return;
+  }
+  emu6502_record_stop(emu);
+  free(emu);
+}
+
+bool emu6502_load(Emu6502 *emu, const uint16_t addr, const void *data,
+                  const size_t len) {
+  if (len > MEM_SIZE - addr) {
+    return false;
+  }
+  const u8 *bytes = data;
+  for (usize i = 0; i < len; i++) {
+    emu_write_mem_byte(&emu->emu, (u16)(addr + i), bytes[i]);
+  }
+  return true;
+}
+
+bool emu6502_load_file(Emu6502 *emu, const char *path, const int32_t addr) {
+  LoadedImage loaded;
+  const bool ok = loader_load(&emu->emu, path, loader_format_from_path(path),
+                              addr, &loaded);
+  memcpy(emu->error, loaded.error, sizeof(emu->error));
+  return ok;
+}
+
+const char *emu6502_error(const Emu6502 *emu) { return emu->error; }
+
+void emu6502_reset(Emu6502 *emu) { emu_reset(&emu->emu); }
+
+Emu6502Stop emu6502_run(Emu6502 *emu, const uint64_t cycles) {
+  return (emu_run(&emu->emu, cycles) == EMU_STOP_HALT) ? EMU6502_STOP_HALT
+                                                       : EMU6502_STOP_LIMIT;
+}
+
+uint64_t emu6502_cycles(const Emu6502 *emu) { return emu->emu.cycles; }
+
+uint8_t emu6502_read(const Emu6502 *emu, const uint16_t addr) {
+  return emu_read_mem_byte(&emu->emu, addr);
+}
+
+void emu6502_write(Emu6502 *emu, const uint16_t addr, const uint8_t byte) {
+  emu_write_mem_byte(&emu->emu, addr, byte);
+}
+
+Emu6502Regs emu6502_get_regs(const Emu6502 *emu) {
+  const CPU *cpu = &emu->emu.cpu;
+  return (Emu6502Regs){cpu->pc, cpu->sp, cpu->a, cpu->x, cpu->y, cpu->sr.byte};
+}
+
+void emu6502_set_regs(Emu6502 *emu, const Emu6502Regs regs) {
+  CPU cpu = {
+      .pc = regs.pc, .sp = regs.sp, .a = regs.a, .x = regs.x, .y = regs.y};
+  cpu.sr.byte = (u8)((regs.sr & ~SR_B) | SR_UNUSED);
+  emu_set_cpu(&emu->emu, &cpu);
+}
+
+void emu6502_nmi(Emu6502 *emu) { emu_nmi(&emu->emu); }
+
+void emu6502_set_irq(Emu6502 *emu, const bool asserted) {
+  emu_set_irq(&emu->emu, asserted);
+}
+
+size_t emu6502_snapshot_size(void) { return SNAPSHOT_SIZE; }
+
+bool emu6502_save(const Emu6502 *emu, void *buf, const size_t len) {
+  if (len != SNAPSHOT_SIZE) {
+    return false;
+  }
+  memcpy(buf, &emu->emu, SNAPSHOT_SIZE);
+  return true;
+}
+
+bool emu6502_restore(Emu6502 *emu, const void *buf, const size_t len) {
+  if (len != SNAPSHOT_SIZE) {
+    return false;
+  }
+  memcpy(&emu->emu, buf, SNAPSHOT_SIZE);
+#ifdef EMU_BANKING
+  // no banks can be attached through this API, so only the tables change
+  bank_refresh(&emu->emu);
+#endif
+  return true;
+}
+
+bool emu6502_record_start(Emu6502 *emu, const char *path) {
+  if (emu->emu.recorder != NULL) {
+    return false;
+  }
+  Recorder *rec = malloc(sizeof(Recorder));
+  if (rec == NULL) {
+    return false;
+  }
+  if (!recorder_open(rec, path, &emu->emu)) {
+    free(rec);
+    return false;
+  }
+  emu->emu.recorder = rec;
+  return true;
+}
+
+bool emu6502_record_stop(Emu6502 *emu) {
+  Recorder *rec = emu->emu.recorder;
+  if (rec == NULL) {
+    return false;
+  }
+  emu->emu.recorder = NULL;
+  const bool ok = recorder_close(rec, &emu->emu);
+  free(rec);
+  return ok;
+}
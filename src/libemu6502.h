@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The public API of `libemu6502.so` and `libemu6502.a`, for driving the
+// emulator from another program.
+//
+// An emulator is an opaque `Emu6502`, created with `emu6502_create` or placed
+// in caller-owned storage with `emu6502_init`. Nothing after that allocates
+// except `emu6502_record_start`: running, memory and register access and
+// snapshots only touch the emulator and the buffers passed in, so an emulator
+// can be stepped from a scheduler or a real-time thread. Separate emulators
+// share no state and can run on separate threads.
+//
+// This header only depends on the C standard library and the library does not
+// link ncurses. Functions are only added, never changed, and
+// `EMU6502_API_VERSION` is raised when they are. Snapshots are tied to the
+// build of the library that made them (CPU variant and build flags included),
+// and `emu6502_restore` rejects those of another size.
+
+#define EMU6502_API_VERSION 3
+
+#if defined(__GNUC__)
+#define EMU6502_API __attribute__((visibility("default")))
+#else
+#define EMU6502_API
+#endif
+
+typedef struct Emu6502 Emu6502;
+
+typedef struct Emu6502Regs {
+  uint16_t pc;
+  uint8_t sp;
+  uint8_t a;
+  uint8_t x;
+  uint8_t y;
+  uint8_t sr; // as pushed onto the stack, N V - B D I Z C from bit 7 down
+} Emu6502Regs;
+
+// Why `emu6502_run` returned
+typedef enum Emu6502Stop {
+  EMU6502_STOP_LIMIT, // ran for the requested number of cycles
+  EMU6502_STOP_HALT,  // the emulator halted
+} Emu6502Stop;
+
+// `EMU6502_API_VERSION` of the library
+EMU6502_API int emu6502_api_version(void);
+
+// The CPU variant the library was built for: "6502", "6502X" or "65C02"
+EMU6502_API const char *emu6502_cpu_name(void);
+
+// Size and alignment of the storage `emu6502_init` needs
+EMU6502_API size_t emu6502_size(void);
+EMU6502_API size_t emu6502_align(void);
+
+// Initialize an emulator in `storage` of `emu6502_size` bytes aligned to
+// `emu6502_align`, with memory cleared and the CPU reset
+EMU6502_API Emu6502 *emu6502_init(void *storage);
+
+// Allocate and initialize an emulator, NULL if the allocation fails
+EMU6502_API Emu6502 *emu6502_create(void);
+// Free an emulator made by `emu6502_create`, nothing if `emu` is NULL
+EMU6502_API void emu6502_destroy(Emu6502 *emu);
+
+// Copy `len` bytes to memory from `addr`
+// Returns false, copying nothing, if they do not fit below $10000
+EMU6502_API bool emu6502_load(Emu6502 *emu, uint16_t addr, const void *data,
+                              size_t len);
+
+// Load an image file: raw (at the top of memory unless `addr` is not -1),
+// Commodore `.prg` or Intel HEX (`.hex`, `.ihx`), chosen by extension
+// Returns false if it cannot be read or does not fit; `emu6502_error` then
+// says why (nothing is printed)
+EMU6502_API bool emu6502_load_file(Emu6502 *emu, const char *path,
+                                   int32_t addr);
+
+// Reset the CPU and jump to the address in the reset vector
+EMU6502_API void emu6502_reset(Emu6502 *emu);
+
+// Run until at least `cycles` cycles have passed or the emulator halts
+EMU6502_API Emu6502Stop emu6502_run(Emu6502 *emu, uint64_t cycles);
+
+// Cycles run since the emulator was initialized
+EMU6502_API uint64_t emu6502_cycles(const Emu6502 *emu);
+
+EMU6502_API uint8_t emu6502_read(const Emu6502 *emu, uint16_t addr);
+EMU6502_API void emu6502_write(Emu6502 *emu, uint16_t addr, uint8_t byte);
+
+EMU6502_API Emu6502Regs emu6502_get_regs(const Emu6502 *emu);
+// B and the unused bit of `sr` are not flags and are ignored
+EMU6502_API void emu6502_set_regs(Emu6502 *emu, Emu6502Regs regs);
+
+// Trigger a non-maskable interrupt, taken before the next instruction
+EMU6502_API void emu6502_nmi(Emu6502 *emu);
+// Set the level of the IRQ line
+EMU6502_API void emu6502_set_irq(Emu6502 *emu, bool asserted);
+
+// Size of a snapshot: memory, registers, cycles and pending interrupts
+EMU6502_API size_t emu6502_snapshot_size(void);
+// Write a snapshot to `buf` of `len` bytes
+// Returns false if `len` is not `emu6502_snapshot_size`
+EMU6502_API bool emu6502_save(const Emu6502 *emu, void *buf, size_t len);
+// Restore a snapshot made by `emu6502_save`
+// Returns false, leaving the emulator as it was, if `len` is not
+// `emu6502_snapshot_size`
+EMU6502_API bool emu6502_restore(Emu6502 *emu, const void *buf, size_t len);
+
+// Since version 2
+
+// Record every input given through this API from now on (`emu6502_write`,
+// `emu6502_load`, `emu6502_load_file`, `emu6502_set_regs`, `emu6502_reset`
+// and the interrupts), with the current state, to the file at `path`;
+// `emu6502 --replay PATH` reproduces the run
+// Loaded bytes are logged one write each, so load before starting a
+// recording where possible
+// `emu6502_restore` is not an input that can be recorded, start a new
+// recording after it
+// Returns false if it cannot be created or a recording is already running
+EMU6502_API bool emu6502_record_start(Emu6502 *emu, const char *path);
+// Finish and close the recording, also done by `emu6502_destroy`
+// Returns false if there is none or it could not be written completely
+EMU6502_API bool emu6502_record_stop(Emu6502 *emu);
+
+// Since version 3
+
+// Why the last `emu6502_load_file` failed, "" if it succeeded
+EMU6502_API const char *emu6502_error(const Emu6502 *emu);
@@ -0,0 +1,261 @@
+#include "loader.h"
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ImageFormat loader_format_from_path(const char *path) {
+  const char *ext = strrchr(path, '.');
+  if (ext == NULL) {
+    return IMAGE_RAW;
+  }
+  if (strcasecmp(ext, ".prg") == 0) {
+    return IMAGE_PRG;
+  }
+  if (strcasecmp(ext, ".hex") == 0 || strcasecmp(ext, ".ihx") == 0) {
+    return IMAGE_HEX;
+  }
+  return IMAGE_RAW;
+}
+
+static bool fail(LoadedImage *out, const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(out->error, LOADER_ERROR_SIZE, fmt, args);
+  va_end(args);
+  return false;
+}
+
+static void extend_range(LoadedImage *out, const u32 lo, const u32 hi) {
+  out->lo = (lo < out->lo) ? lo : out->lo;
+  out->hi = (hi > out->hi) ? hi : out->hi;
+}
+
+// Whether images can go straight into `emu->mem`, i.e. nothing attached needs
+// to see the writes and every address is where the CPU sees it
+static bool direct(const Emulator *emu) {
+#ifdef EMU_BANKING
+  (void)emu;
+  return false;
+#else
+  return emu->heatmap == NULL && emu->recorder == NULL;
+#endif
+}
+
+// Copy `len` bytes to memory from `addr`, which they fit below $10000
+static void store(Emulator *emu, const u16 addr, const u8 *data,
+                  const usize len) {
+  if (direct(emu)) {
+    memcpy(&emu->mem[addr], data, len);
+    return;
+  }
+  for (usize i = 0; i < len; i++) {
+    emu_write_mem_byte(emu, (u16)(addr + i), data[i]);
+  }
+}
+
+// Put `size` bytes at `offset` of the file at `addr`, mapping whole host
+// pages where the file and memory are both page aligned
+static bool load_bytes(Emulator *emu, const i32 fd, const char *path,
+                       const off_t offset, const usize size, const u16 addr,
+                       LoadedImage *out) {
+  if (addr + size > MEM_SIZE) {
+    return fail(out, "%s: %zu bytes do not fit at $%04X", path, size, addr);
+  }
+  u8 *dst = &emu->mem[addr];
+  const usize page = (usize)sysconf(_SC_PAGESIZE);
+  usize done = 0;
+  if (!direct(emu)) {
+    // through a buffer, so every byte goes through `emu_write_mem_byte`
+    u8 buf[4096];
+    while (done < size) {
+      const usize left = size - done;
+      const isize n = pread(fd, buf, (left < sizeof(buf)) ? left : sizeof(buf),
+                            offset + (off_t)done);
+      if (n <= 0) {
+        return fail(out, "%s: read failed", path);
+      }
+      store(emu, (u16)(addr + done), buf, (usize)n);
+      done += (usize)n;
+    }
+  } else if ((uintptr_t)dst % page == 0 && (usize)offset % page == 0) {
+    // a partial last page would zero the rest of it, so it is read instead
+    const usize len = size / page * page;
+    if (len != 0 && mmap(dst, len, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_FIXED, fd, offset) != MAP_FAILED) {
+      done = len;
+      out->mapped += len;
+    }
+  }
+  while (done < size) {
+    const isize n = pread(fd, dst + done, size - done, offset + (off_t)done);
+    if (n <= 0) {
+      return fail(out, "%s: read failed", path);
+    }
+    done += (usize)n;
+  }
+  if (size != 0) {
+    extend_range(out, addr, addr + (u32)size);
+  }
+  return true;
+}
+
+static i32 hex_digit(const char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Returns -1 if there are not two hex digits at `p`
+static i32 hex_byte(const char *p, const char *end) {
+  if (end - p < 2) {
+    return -1;
+  }
+  const i32 hi = hex_digit(p[0]);
+  const i32 lo = hex_digit(p[1]);
+  return (hi < 0 || lo < 0) ? -1 : (hi << 4 | lo);
+}
+
+static bool load_hex(Emulator *emu, const char *path, const char *src,
+                     const usize len, LoadedImage *out) {
+  const char *p = src;
+  const char *end = src + len;
+  u32 base = 0; // from extended address records
+  u32 line = 1;
+  while (p < end) {
+    if (*p == '\n') {
+      line++;
+      p++;
+      continue;
+    }
+    if (isspace((u8)*p)) {
+      p++;
+      continue;
+    }
+    if (*p != ':') {
+      return fail(out, "%s:%u: expected ':'", path, line);
+    }
+    p++;
+    // length, address (2 bytes), type, data, checksum
+    u8 record[5 + 255];
+    const i32 count = hex_byte(p, end);
+    if (count < 0) {
+      return fail(out, "%s:%u: invalid record", path, line);
+    }
+    u8 sum = 0;
+    for (i32 i = 0; i < count + 5; i++) {
+      const i32 byte = hex_byte(p, end);
+      if (byte < 0) {
+        return fail(out, "%s:%u: invalid record", path, line);
+      }
+      record[i] = (u8)byte;
+      sum = (u8)(sum + byte);
+      p += 2;
+    }
+    if (sum != 0) {
+      return fail(out, "%s:%u: checksum mismatch", path, line);
+    }
+    const u32 addr = base + (u32)(record[1] << 8 | record[2]);
+    const u8 *data = &record[4];
+    switch (record[3]) {
+    case 0x00: // data
+      if (addr + (u32)count > MEM_SIZE) {
+        return fail(out, "%s:%u: data past $FFFF", path, line);
+      }
+      store(emu, (u16)addr, data, (usize)count);
+      if (count != 0) {
+        extend_range(out, addr, addr + (u32)count);
+      }
+      break;
+    case 0x01: // end of file
+      return true;
+    case 0x02: // extended segment address
+    case 0x04: // extended linear address
+      if (count != 2) {
+        return fail(out, "%s:%u: invalid address record", path, line);
+      }
+      base = (u32)(data[0] << 8 | data[1]) << ((record[3] == 0x02) ? 4 : 16);
+      break;
+    case 0x03: // start segment address, CS:IP
+      if (count != 4) {
+        return fail(out, "%s:%u: invalid start address record", path, line);
+      }
+      out->entry = (i32)((u32)(data[0] << 8 | data[1]) * 16 +
+                         (u32)(data[2] << 8 | data[3])) &
+                   0xFFFF;
+      break;
+    case 0x05: // start linear address
+      if (count != 4) {
+        return fail(out, "%s:%u: invalid start address record", path, line);
+      }
+      out->entry = data[2] << 8 | data[3];
+      break;
+    default:
+      return fail(out, "%s:%u: unknown record type %02X", path, line,
+                  record[3]);
+    }
+  }
+  return true;
+}
+
+bool loader_load(Emulator *emu, const char *path, const ImageFormat format,
+                 const i32 addr, LoadedImage *out) {
+  *out = (LoadedImage){MEM_SIZE, 0, -1, 0, ""};
+  const i32 fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return fail(out, "cannot open %s", path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return fail(out, "cannot read %s", path);
+  }
+  const usize size = (usize)st.st_size;
+  bool ok;
+  if (format == IMAGE_RAW) {
+    if (size > MEM_SIZE) {
+      ok = fail(out, "%s: %zu bytes do not fit in memory", path, size);
+    } else {
+      const u16 at = (u16)((addr >= 0) ? addr : (i32)(MEM_SIZE - size));
+      ok = load_bytes(emu, fd, path, 0, size, at, out);
+    }
+  } else if (format == IMAGE_PRG) {
+    u8 header[2];
+    ok = size >= 2 && pread(fd, header, 2, 0) == 2;
+    if (!ok) {
+      fail(out, "%s: missing load address", path);
+    } else {
+      const u16 at = (u16)((addr >= 0) ? addr : (header[0] | header[1] << 8));
+      ok = load_bytes(emu, fd, path, 2, size - 2, at, out);
+    }
+  } else {
+    const char *src = (size == 0) ? NULL
+                                  : mmap(NULL, size, PROT_READ, MAP_PRIVATE,
+                                         fd, 0);
+    if (src == MAP_FAILED) {
+      ok = fail(out, "cannot read %s", path);
+    } else {
+      ok = load_hex(emu, path, src, size, out);
+      if (src != NULL) {
+        munmap((void *)src, size);
+      }
+    }
+  }
+  close(fd);
+  if (out->lo > out->hi) {
+    out->lo = 0;
+    out->hi = 0;
+  }
+  return ok;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Loads program and ROM images from disk into emulator memory.
+//
+// Raw images (and the parts of `.prg` files that happen to line up) are mapped
+// with `mmap` straight over `Emulator.mem` a host page at a time instead of
+// being copied through stdio: the kernel shares the file's page cache pages
+// with the emulator until the program writes to them, at which point that page
+// alone is copied (MAP_PRIVATE), so the file itself is never modified. Pieces
+// that don't cover a whole host page, or that are not page aligned in both the
+// file and memory, are read with `pread`. Intel HEX files are mapped read-only
+// and parsed in place.
+//
+// A mapping stays in place until something is loaded over it or the process
+// exits; loading a new image into the same emulator simply replaces it. Until
+// then the pages the program has not written keep reading the file, so images
+// must not change while they are loaded: bytes rewritten in place show up in
+// the emulator's memory, and reading past the end of a truncated file raises
+// SIGBUS. Replace an image by renaming a new file over it, which leaves the
+// old one to the mappings that use it.
+//
+// Nothing is mapped while a heatmap or a recorder is attached or in `BANKING`
+// builds; the bytes are read and stored with `emu_write_mem_byte` instead, so
+// the heatmap and the recording see them and they land wherever the CPU sees
+// their addresses.
+
+typedef enum ImageFormat {
+  IMAGE_RAW, // bytes as they are
+  IMAGE_PRG, // Commodore program file, a little endian load address and bytes
+  IMAGE_HEX, // Intel HEX
+} ImageFormat;
+
+#define LOADER_ERROR_SIZE 256
+
+typedef struct LoadedImage {
+  // the range of addresses written, `hi` is exclusive
+  u32 lo;
+  u32 hi;
+  i32 entry;    // start address given by the image itself, -1 if none
+  usize mapped; // bytes mapped rather than read
+  char error[LOADER_ERROR_SIZE]; // why loading failed, empty otherwise
+} LoadedImage;
+
+// Guess the format from the extension: `.prg`, `.hex`/`.ihx`, or raw
+ImageFormat loader_format_from_path(const char *path);
+
+// Load an image into the emulator's memory
+// `addr` overrides the load address of raw and `.prg` images if not -1; raw
+// images are loaded at the top of memory by default, like a ROM holding the
+// vectors, and Intel HEX records always go where they say
+// Returns false and sets `out->error` if the image cannot be read or does not
+// fit in memory
+bool loader_load(Emulator *emu, const char *path, ImageFormat format, i32 addr,
+                 LoadedImage *out);
+
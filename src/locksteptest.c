@@ -0,0 +1,83 @@
+#include "common.h"
+#include "emu6502.h"
+#include "trace.h"
+
+// Checks `trace_lockstep`: two emulators running the same program must not
+// diverge, and with one operand changed in the second one the diff must point
+// at the first instruction whose result differs.
+// Exit status is 0 if every check passed and 1 if one failed.
+
+// the program, run from $0400
+static const u8 program[] = {
+    0xA2, 0x00,       // LDX #0
+    0x8A,             // TXA          loop
+    0x9D, 0x00, 0x02, // STA $0200,X
+    0xE8,             // INX
+    0xE0, 0x10,       // CPX #16
+    0xD0, 0xF7,       // BNE loop
+    0x4C, 0x0B, 0x04, // JMP $040B    trap
+};
+
+// the planted divergence: CPX #8 instead of CPX #16
+#define PLANTED_ADDR 0x0408
+#define PLANTED_BYTE 0x08
+
+// the first CPX with X = 8: LDX, then 7 loops of 5 instructions, TXA, STA, INX
+#define DIVERGED_AT 39
+#define DIVERGED_PC 0x0407
+
+static u32 n_failed = 0;
+
+static void check(const bool ok, const char *what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    n_failed++;
+  }
+}
+
+static void load(Emulator *emu, Tracer *tracer) {
+  emu_init(emu, false);
+  // a fused sequence would be traced as a single instruction
+  emu->fusion = false;
+  for (u16 i = 0; i < sizeof(program); i++) {
+    emu_write_mem_byte(emu, (u16)(0x0400 + i), program[i]);
+  }
+  emu_reset(emu);
+  emu->cpu.pc = 0x0400;
+  tracer_init(tracer);
+  emu->tracer = tracer;
+}
+
+i32 main(void) {
+  static Emulator lhs, rhs;
+  static Tracer lhs_tracer, rhs_tracer;
+  static TraceDiff diff;
+
+  load(&lhs, &lhs_tracer);
+  load(&rhs, &rhs_tracer);
+  trace_diff_init(&diff, 4);
+  check(!trace_lockstep(&lhs, &rhs, 1000, &diff),
+        "identical programs diverged");
+  check(diff.index == 1000, "the instruction budget was not used up");
+
+  load(&lhs, &lhs_tracer);
+  load(&rhs, &rhs_tracer);
+  emu_write_mem_byte(&rhs, PLANTED_ADDR, PLANTED_BYTE);
+  trace_diff_init(&diff, 4);
+  check(trace_lockstep(&lhs, &rhs, 1000, &diff),
+        "the planted divergence was not found");
+  check(diff.diverged_at == DIVERGED_AT, "wrong instruction reported");
+  check(diff.diff_flags == TRACE_DIFF_FLAGS, "wrong difference reported");
+  check(diff.trailing[0][0].pc == DIVERGED_PC &&
+            diff.trailing[1][0].pc == DIVERGED_PC,
+        "wrong address reported");
+  check(diff.n_trailing[0] == 5 && diff.n_trailing[1] == 5,
+        "the trailing context was not collected");
+
+  if (n_failed != 0) {
+    trace_diff_report(&diff, stdout, "lhs", "rhs");
+    return 1;
+  }
+  printf("PASS lockstep diff\n");
+  return 0;
+}
@@ -1,9 +1,23 @@
+#include "assembler.h"
+#include "breakpoints.h"
 #include "calc.h"
+#include "callgraph.h"
+#include "debugger.h"
+#include "gdbstub.h"
+#include "heatmap.h"
+#include "loader.h"
+#include "monitor.h"
 #include "common.h"
 #include "emu6502.h"
 #include "opcode.h"
+#include "profile.h"
+#include "record.h"
+#include "stackguard.h"
+#include "stats.h"
+#include "trace.h"
 
-#include <ncurses.h>
+#include <inttypes.h>
+#include <signal.h>
 #include <stdio.h>
 #include <time.h>
 #include <unistd.h>
@@ -14,7 +28,7 @@ typedef struct MemWriter {
 } MemWriter;
 
 MemWriter memw_init(u8 *mem) {
-  MemWriter memw = {mem, 0xFFFC};
+  MemWriter memw = {mem, 0};
   return memw;
 }
 
@@ -23,107 +37,412 @@ void mem_write_byte(MemWriter *memw, u8 byte) {
   memw->head++;
 }
 
+// little endian, like the 6502
 void mem_write_word(MemWriter *memw, u16 word) {
-  memw->mem[memw->head] = (u8)(word >> 8);
-  memw->head++;
   memw->mem[memw->head] = (u8)word;
   memw->head++;
+  memw->mem[memw->head] = (u8)(word >> 8);
+  memw->head++;
+}
+
+// The demo program run when no other program is given
+static void write_builtin_program(MemWriter *writer) {
+  // the reset vector
+  writer->head = RESET_VECTOR;
+  mem_write_word(writer, 0x0800);
+
+  writer->head = 0x0800;
+  mem_write_byte(writer, OPCODE_JSR_ABS); // JSR 0x1000
+  mem_write_word(writer, 0x1000);
+  mem_write_byte(writer, OPCODE_JMP_ABS); // JMP 0x0800
+  mem_write_word(writer, 0x0800);
+
+  writer->head = 0x1000;
+  mem_write_byte(writer, OPCODE_LDA_IM); // LDA $0
+  mem_write_byte(writer, 0x00);
+  mem_write_byte(writer, OPCODE_SED);    // SED ; enable decimal mode
+  mem_write_byte(writer, OPCODE_ADC_IM); // ADC $1
+  mem_write_byte(writer, 0x01);
+  mem_write_byte(writer, OPCODE_BCS_REL); // BCS +4 ; branch if carry set
+  mem_write_byte(writer, 4);
+  mem_write_byte(writer, OPCODE_BCC_REL); // BCC +3 ; branch if carry clear
+  mem_write_byte(writer, 3);
+  mem_write_byte(writer, OPCODE_RTS);     // RTS
+  mem_write_byte(writer, OPCODE_JMP_ABS); // JMP 0x1000
+  mem_write_word(writer, 0x1000);
+}
+
+#define MAX_IMAGES 16
+
+typedef struct ImageArg {
+  const char *path;
+  i32 addr; // -1 for the image's default
+} ImageArg;
+
+// Parse `FILE[@ADDR]`
+static bool parse_image_arg(char *arg, ImageArg *image) {
+  image->path = arg;
+  image->addr = -1;
+  char *at = strrchr(arg, '@');
+  if (at == NULL) {
+    return true;
+  }
+  u16 addr;
+  if (!breakpoint_parse_addr(at + 1, &addr)) {
+    return false;
+  }
+  *at = '\0';
+  image->addr = addr;
+  return true;
+}
+
+// Put the program in memory and reset the CPU
+// Returns false if a source or an image cannot be loaded
+static bool load_program(Emulator *emu, const char *asm_path,
+                         const ImageArg *images, const usize n_images,
+                         i32 reset_addr) {
+  // without `--reset`, start where the first image starts unless an image
+  // names its own start address or brings a reset vector
+  i32 start = -1;
+  bool has_vector = false;
+  if (asm_path != NULL) {
+    static Assembler assembler;
+    asm_init(&assembler);
+    if (!asm_assemble_file(&assembler, asm_path, emu->mem)) {
+      return false;
+    }
+    start = (i32)assembler.lo;
+    has_vector = assembler.lo <= RESET_VECTOR && assembler.hi >= 0xFFFE;
+  }
+  for (usize i = 0; i < n_images; i++) {
+    const ImageFormat format = loader_format_from_path(images[i].path);
+    LoadedImage loaded;
+    if (!loader_load(emu, images[i].path, format, images[i].addr, &loaded)) {
+      printf("%s\n", loaded.error);
+      return false;
+    }
+    if (start < 0) {
+      start = (i32)loaded.lo;
+    }
+    if (loaded.entry >= 0 && reset_addr < 0) {
+      reset_addr = loaded.entry;
+    }
+    has_vector |= loaded.lo <= RESET_VECTOR && loaded.hi >= 0xFFFE;
+  }
+  MemWriter writer = memw_init(emu->mem);
+  if (asm_path == NULL && n_images == 0) {
+    write_builtin_program(&writer);
+  }
+  if (reset_addr < 0 && !has_vector && start >= 0) {
+    reset_addr = start;
+  }
+  if (reset_addr >= 0) {
+    writer.head = RESET_VECTOR;
+    mem_write_word(&writer, (u16)reset_addr);
+  }
+  emu_reset(emu);
+  return true;
+}
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_sigint(i32 sig) {
+  (void)sig;
+  interrupted = 1;
+}
+
+// Flush everything attached to the emulator before exiting
+static void finish(Emulator *emu, const char *profile_path,
+                   const char *callgraph_path, const char *stats_path,
+                   const char *heatmap_path) {
+  if (emu->recorder != NULL && !recorder_close(emu->recorder, emu)) {
+    printf("cannot finish the recording\n");
+  }
+  if (emu->tracer != NULL && !tracer_close(emu->tracer)) {
+    printf("cannot finish the trace\n");
+  }
+  if (emu->profiler != NULL) {
+    FILE *file = fopen(profile_path, "w");
+    if (file == NULL) {
+      printf("cannot create profile report: %s\n", profile_path);
+      return;
+    }
+    profiler_report(emu->profiler, emu->mem, file, 50);
+    fclose(file);
+  }
+  if (emu->callgraph != NULL) {
+    callgraph_finish(emu->callgraph, emu->cycles);
+    FILE *file = fopen(callgraph_path, "w");
+    if (file == NULL) {
+      printf("cannot create call graph: %s\n", callgraph_path);
+      return;
+    }
+    callgraph_write_collapsed(emu->callgraph, file);
+    fclose(file);
+    callgraph_report(emu->callgraph, stdout);
+  }
+  if (emu->stats != NULL) {
+    FILE *file = fopen(stats_path, "w");
+    if (file == NULL) {
+      printf("cannot create opcode statistics: %s\n", stats_path);
+      return;
+    }
+    opcode_stats_write_csv(emu->stats, file);
+    fclose(file);
+    opcode_stats_report(emu->stats, stdout, 20);
+  }
+  if (emu->stack_guard != NULL) {
+    stack_guard_finish(emu->stack_guard);
+    stack_guard_report(emu->stack_guard, stdout, 20);
+  }
+  // the debugger attaches a heatmap of its own, which is not written
+  if (emu->heatmap != NULL && heatmap_path != NULL) {
+    FILE *file = fopen(heatmap_path, "wb");
+    if (file == NULL) {
+      printf("cannot create heatmap: %s\n", heatmap_path);
+      return;
+    }
+    const char *ext = strrchr(heatmap_path, '.');
+    if (ext != NULL && strcmp(ext, ".ppm") == 0) {
+      heatmap_write_ppm(emu->heatmap, file);
+    } else {
+      heatmap_write_csv(emu->heatmap, file);
+    }
+    fclose(file);
+  }
 }
 
 i32 main(i32 argc, char *argv[]) {
 
   bool dbg = false;
+  bool fusion = true;
+  const char *trace_path = NULL;
+  const char *profile_path = NULL;
+  const char *callgraph_path = NULL;
+  const char *stats_path = NULL;
+  const char *heatmap_path = NULL;
+  bool heatmap_blocks = false;
+  bool stack_guard = false;
+  bool stack_trap = false;
+  static Breakpoints breakpoints;
+  bool use_breakpoints = false;
+  const char *gdb_spec = NULL;
+  const char *asm_path = NULL;
+  const char *monitor_name = NULL;
+  const char *record_path = NULL;
+  const char *replay_path = NULL;
+  ImageArg images[MAX_IMAGES];
+  usize n_images = 0;
+  i32 reset_addr = -1;
+  breakpoints_init(&breakpoints);
 
   for (i32 i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--dbg") == 0) {
       dbg = true;
+    } else if (strcmp(argv[i], "--no-fusion") == 0) {
+      fusion = false;
+    } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+      trace_path = argv[++i];
+    } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+      profile_path = argv[++i];
+    } else if (strcmp(argv[i], "--callgraph") == 0 && i + 1 < argc) {
+      callgraph_path = argv[++i];
+    } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+      stats_path = argv[++i];
+    } else if (strcmp(argv[i], "--heatmap") == 0 && i + 1 < argc) {
+      heatmap_path = argv[++i];
+    } else if (strcmp(argv[i], "--heatmap-blocks") == 0) {
+      heatmap_blocks = true;
+    } else if (strcmp(argv[i], "--stack-guard") == 0) {
+      stack_guard = true;
+    } else if (strcmp(argv[i], "--stack-trap") == 0) {
+      stack_guard = true;
+      stack_trap = true;
+    } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (strcmp(argv[i], "--monitor") == 0 && i + 1 < argc) {
+      monitor_name = argv[++i];
+    } else if (strcmp(argv[i], "--asm") == 0 && i + 1 < argc) {
+      asm_path = argv[++i];
+    } else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc) {
+      if (n_images == MAX_IMAGES) {
+        printf("too many images, at most %d\n", MAX_IMAGES);
+        return 1;
+      }
+      if (!parse_image_arg(argv[++i], &images[n_images++])) {
+        printf("invalid load address: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--reset") == 0 && i + 1 < argc) {
+      u16 addr;
+      if (!breakpoint_parse_addr(argv[++i], &addr)) {
+        printf("invalid reset address: %s\n", argv[i]);
+        return 1;
+      }
+      reset_addr = addr;
+    } else if (strcmp(argv[i], "--gdb") == 0 && i + 1 < argc) {
+      gdb_spec = argv[++i];
+    } else if (strcmp(argv[i], "--break") == 0 && i + 1 < argc) {
+      u16 addr;
+      if (!breakpoint_parse_addr(argv[++i], &addr)) {
+        printf("invalid breakpoint: %s\n", argv[i]);
+        return 1;
+      }
+      breakpoint_set(&breakpoints, addr);
+      use_breakpoints = true;
+    } else if (strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+      if (!watchpoint_add_spec(&breakpoints, argv[++i])) {
+        printf("invalid watchpoint: %s\n", argv[i]);
+        return 1;
+      }
+      use_breakpoints = true;
     } else {
       printf("invalid argument: %s\n", argv[i]);
       return 1;
     }
   }
 
-  Emulator emu;
+  static Emulator emu;
   emu_init(&emu, dbg);
-  MemWriter writer = memw_init(emu.mem);
-
-  // starts on 0xFFFC by default
-  mem_write_byte(&writer, OPCODE_JMP_ABS); // JMP 0x0800
-  mem_write_word(&writer, 0x0800);
-
-  writer.head = 0x0800;
-  mem_write_byte(&writer, OPCODE_JSR_ABS); // JSR 0x1000
-  mem_write_word(&writer, 0x1000);
-  mem_write_byte(&writer, OPCODE_JMP_ABS); // JMP 0x0800
-  mem_write_word(&writer, 0x0800);
-
-  writer.head = 0x1000;
-  mem_write_byte(&writer, OPCODE_LDA_IM); // LDA $0
-  mem_write_byte(&writer, 0x00);
-  mem_write_byte(&writer, OPCODE_SED);    // SED ; enable decimal mode
-  mem_write_byte(&writer, OPCODE_ADC_IM); // ADC $1
-  mem_write_byte(&writer, 0x01);
-  mem_write_byte(&writer, OPCODE_BCS_REL); // BCS +4 ; branch if carry set
-  mem_write_byte(&writer, 4);
-  mem_write_byte(&writer, OPCODE_BCC_REL); // BCC +3 ; branch if carry clear
-  mem_write_byte(&writer, 3);
-  mem_write_byte(&writer, OPCODE_RTS);     // RTS
-  mem_write_byte(&writer, OPCODE_JMP_ABS); // JMP 0x1000
-  mem_write_word(&writer, 0x1000);
+
+  static Tracer tracer;
+  if (trace_path != NULL) {
+    if (!tracer_open(&tracer, trace_path)) {
+      printf("cannot create trace file: %s\n", trace_path);
+      return 1;
+    }
+    emu.tracer = &tracer;
+  }
+
+  static Profiler profiler;
+  if (profile_path != NULL) {
+    profiler_init(&profiler);
+    emu.profiler = &profiler;
+  }
+
+  static CallGraph callgraph;
+  if (callgraph_path != NULL) {
+    if (!callgraph_init(&callgraph)) {
+      printf("cannot allocate the call graph\n");
+      return 1;
+    }
+    emu.callgraph = &callgraph;
+  }
+
+  static OpcodeStats stats;
+  if (stats_path != NULL) {
+    opcode_stats_init(&stats);
+    emu.stats = &stats;
+  }
+
+  // the debugger shows what changed in memory between two points
+  static Heatmap heatmap;
+  if (heatmap_path != NULL || dbg) {
+    heatmap_init(&heatmap, heatmap_blocks);
+    emu.heatmap = &heatmap;
+  }
+
+  static StackGuard guard;
+  if (stack_guard) {
+    stack_guard_init(&guard, stack_trap);
+    emu.stack_guard = &guard;
+  }
+
+  // the debuggers can arm breakpoints at any time
+  if (use_breakpoints || dbg || gdb_spec != NULL) {
+    emu.breakpoints = &breakpoints;
+  }
+
+  // fused instructions would skip single-stepping and instrumentation
+  emu.fusion = fusion && !dbg && emu.tracer == NULL && emu.profiler == NULL &&
+               emu.callgraph == NULL && emu.stats == NULL &&
+               emu.heatmap == NULL && emu.stack_guard == NULL &&
+               emu.breakpoints == NULL;
+
+  static Replayer replayer;
+  if (replay_path != NULL) {
+    // the recording brings the machine state, `debug_output` and `fusion`
+    // stay as set above unless the recorded run did not fuse
+    if (!replayer_open(&replayer, replay_path, &emu)) {
+      printf("cannot replay %s\n", replay_path);
+      return 1;
+    }
+  } else if (!load_program(&emu, asm_path, images, n_images, reset_addr)) {
+    return 1;
+  }
+
+  static Recorder recorder;
+  if (record_path != NULL) {
+    if (!recorder_open(&recorder, record_path, &emu)) {
+      printf("cannot record to %s\n", record_path);
+      return 1;
+    }
+    emu.recorder = &recorder;
+  }
 
   printf("initialized\n");
 
-  if (dbg) {
-    initscr();
-    noecho();
-    while (true) {
-      clear();
-      emu_tick(&emu);
-      refresh();
-      if (emu.is_running) {
-        printw("\nPress n to tick forward 1 instruction\n");
-        while (getch() != 'n')
-          ;
-      } else {
-        printw("\nEmulation halted, press q to quit\n");
-        while (getch() != 'q')
-          ;
-        break;
-      }
+  if (gdb_spec != NULL) {
+    static GdbStub stub;
+    if (!gdbstub_listen(&stub, gdb_spec)) {
+      return 1;
     }
-    endwin();
+    printf("waiting for gdb on %s\n", gdb_spec);
+    gdbstub_serve(&stub, &emu);
+    gdbstub_close(&stub);
+    finish(&emu, profile_path, callgraph_path, stats_path, heatmap_path);
+  } else if (dbg) {
+    static Debugger debugger;
+    debugger_run(&debugger, &emu);
+    finish(&emu, profile_path, callgraph_path, stats_path, heatmap_path);
   } else {
-    clock_t prev_time = clock();
-    // don't print cycle number for the first seconds or so.
-    while (true) {
-      if (!emu.is_running) {
-        printf("Emulator halted at %llu cycles\n", emu.cycles);
-        return 0;
-      }
-      emu_tick(&emu);
-      if (emu.cycles % 100000000 == 0 || emu.cycles % 100000000 == 1) {
-        break;
-      }
+    static Monitor monitor;
+    if (monitor_name != NULL && !monitor_open(&monitor, monitor_name)) {
+      return 1;
     }
+    signal(SIGINT, on_sigint);
+    clock_t prev_time = clock();
     u64 prev_cycles = emu.cycles;
-    while (true) {
-      if (!emu.is_running) {
-        printf("Emulator halted at %llu cycles\n", emu.cycles);
-        return 0;
+    // don't print the clock speed for the first slice, which includes warm up
+    bool first = true;
+    EmuStop stop = EMU_STOP_LIMIT;
+    while (stop == EMU_STOP_LIMIT && !interrupted && !replayer.finished) {
+      if (replay_path != NULL) {
+        stop = replay_run(&replayer, &emu, 100000000);
+      } else if (monitor_name != NULL) {
+        stop = monitor_run(&monitor, &emu, 100000000);
+      } else {
+        stop = emu_run(&emu, 100000000);
       }
-      emu_tick(&emu);
-      // sometimes in a repeating loop the number could not be reached because
-      // some loops are even-numbered cycles, therefore requiring the
-      // `... == 0 || ... == 1`
-      if (emu.cycles % 100000000 == 0 || emu.cycles % 100000000 == 1) {
+      if (!first) {
         clock_t current_time = clock();
         f64 d = (f64)(current_time - prev_time) / (f64)CLOCKS_PER_SEC;
         f64 clock_speed =
             (f64)(emu.cycles - prev_cycles) * (1.0f / d) / 10000000.0f;
         printf("%.2lf\tMHz\n", clock_speed);
-        prev_time = current_time;
-        prev_cycles = emu.cycles;
       }
+      first = false;
+      prev_time = clock();
+      prev_cycles = emu.cycles;
+    }
+    if (interrupted) {
+      printf("Emulator interrupted at %" PRIu64 " cycles\n", emu.cycles);
+    } else if (replayer.finished) {
+      printf("Replay finished at %" PRIu64 " cycles, %s\n", emu.cycles,
+             replayer.matched ? "the state matches the recording"
+                              : "the state differs from the recording");
+    } else {
+      char msg[128];
+      emu_describe_stop(msg, sizeof(msg), &emu, stop);
+      printf("%s\n", msg);
+    }
+    finish(&emu, profile_path, callgraph_path, stats_path, heatmap_path);
+    monitor_close(&monitor);
+    replayer_close(&replayer);
+    if (replayer.finished && !replayer.matched) {
+      return 1;
     }
   }
 }
@@ -0,0 +1,194 @@
+#include "monitor.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// readers give up after this many torn copies in a row
+#define MAX_READ_TRIES 1000
+
+static bool valid_name(const char *name) {
+  const usize len = strlen(name);
+  if (len == 0 || len >= MONITOR_NAME_SIZE) {
+    return false;
+  }
+  for (usize i = 0; i < len; i++) {
+    const char c = name[i];
+    if (!isalnum((unsigned char)c) && c != '-' && c != '_' && c != '.') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+// Whether the object `shm_name` was created by a process that is still running
+// An object that is not complete yet is taken as stale
+static bool in_use(const char *shm_name, i32 *pid) {
+  const i32 fd = shm_open(shm_name, O_RDONLY, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (usize)st.st_size < sizeof(MonitorShared)) {
+    close(fd);
+    return false;
+  }
+  const MonitorShared *shared =
+      mmap(NULL, sizeof(MonitorShared), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (shared == MAP_FAILED) {
+    return false;
+  }
+  bool alive = false;
+  if (shared->magic == MONITOR_MAGIC) {
+    *pid = shared->pid;
+    alive = kill(*pid, 0) == 0 || errno != ESRCH;
+  }
+  munmap((void *)shared, sizeof(MonitorShared));
+  return alive;
+}
+
+bool monitor_open(Monitor *mon, const char *name) {
+  mon->shared = NULL;
+  if (!valid_name(name)) {
+    printf("invalid monitor name: %s\n", name);
+    return false;
+  }
+  snprintf(mon->shm_name, sizeof(mon->shm_name), "/%s%s", MONITOR_PREFIX,
+           name);
+  i32 pid;
+  if (in_use(mon->shm_name, &pid)) {
+    printf("monitor name in use: %s (pid %d)\n", name, pid);
+    return false;
+  }
+  // a stale object left by a process that did not exit cleanly
+  shm_unlink(mon->shm_name);
+  const i32 fd = shm_open(mon->shm_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0) {
+    printf("cannot create shared memory %s\n", mon->shm_name);
+    return false;
+  }
+  if (ftruncate(fd, sizeof(MonitorShared)) != 0) {
+    printf("cannot size shared memory %s\n", mon->shm_name);
+    close(fd);
+    shm_unlink(mon->shm_name);
+    return false;
+  }
+  void *p = mmap(NULL, sizeof(MonitorShared), PROT_READ | PROT_WRITE,
+                 MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    printf("cannot map shared memory %s\n", mon->shm_name);
+    shm_unlink(mon->shm_name);
+    return false;
+  }
+  mon->shared = p;
+  mon->shared->version = MONITOR_VERSION;
+  mon->shared->pid = getpid();
+  snprintf(mon->shared->name, MONITOR_NAME_SIZE, "%s", name);
+  atomic_store_explicit(&mon->shared->seq, 0, memory_order_relaxed);
+  // last, readers ignore the object until it is complete
+  atomic_thread_fence(memory_order_release);
+  mon->shared->magic = MONITOR_MAGIC;
+  return true;
+}
+
+void monitor_close(Monitor *mon) {
+  if (mon->shared != NULL) {
+    munmap(mon->shared, sizeof(MonitorShared));
+    shm_unlink(mon->shm_name);
+    mon->shared = NULL;
+  }
+}
+
+void monitor_publish(Monitor *mon, const Emulator *emu) {
+  MonitorShared *shared = mon->shared;
+  const MonitorSample sample = {
+      .time_ns = now_ns(),
+      .cycles = emu->cycles,
+      .n_instructions = emu->n_instructions,
+      .n_interrupts = emu->n_interrupts,
+      .n_halts = emu->n_halts,
+      .cpu = emu->cpu,
+      .running = emu->is_running,
+  };
+  const u32 seq = atomic_load_explicit(&shared->seq, memory_order_relaxed);
+  atomic_store_explicit(&shared->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  shared->sample = sample;
+  atomic_store_explicit(&shared->seq, seq + 2, memory_order_release);
+}
+
+EmuStop monitor_run(Monitor *mon, Emulator *emu, const u64 max_cycles) {
+  const u64 end = emu->cycles + max_cycles;
+  EmuStop stop = EMU_STOP_LIMIT;
+  while (stop == EMU_STOP_LIMIT && emu->cycles < end) {
+    const u64 left = end - emu->cycles;
+    stop = emu_run(emu, (left < MONITOR_SLICE_CYCLES) ? left
+                                                      : MONITOR_SLICE_CYCLES);
+    monitor_publish(mon, emu);
+  }
+  return stop;
+}
+
+const MonitorShared *monitor_map(const char *name) {
+  char shm_name[MONITOR_NAME_SIZE + sizeof(MONITOR_PREFIX) + 1];
+  if (!valid_name(name)) {
+    return NULL;
+  }
+  snprintf(shm_name, sizeof(shm_name), "/%s%s", MONITOR_PREFIX, name);
+  const i32 fd = shm_open(shm_name, O_RDONLY, 0);
+  if (fd < 0) {
+    return NULL;
+  }
+  // `monitor_open` sizes the object after creating it, and touching a mapping
+  // past the end of the object raises SIGBUS
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (usize)st.st_size < sizeof(MonitorShared)) {
+    close(fd);
+    return NULL;
+  }
+  void *p = mmap(NULL, sizeof(MonitorShared), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  const MonitorShared *shared = p;
+  if (shared->magic != MONITOR_MAGIC || shared->version != MONITOR_VERSION) {
+    munmap(p, sizeof(MonitorShared));
+    return NULL;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  return shared;
+}
+
+void monitor_unmap(const MonitorShared *shared) {
+  munmap((void *)shared, sizeof(MonitorShared));
+}
+
+bool monitor_read(const MonitorShared *shared, MonitorSample *out) {
+  for (u32 i = 0; i < MAX_READ_TRIES; i++) {
+    const u32 before =
+        atomic_load_explicit(&shared->seq, memory_order_acquire);
+    if ((before & 1) != 0) {
+      continue;
+    }
+    *out = shared->sample;
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&shared->seq, memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+  return false;
+}
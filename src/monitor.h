@@ -0,0 +1,80 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+#include <stdatomic.h>
+
+// Publishing the state of running emulators to other processes, for
+// `emu6502-top`.
+//
+// Each monitored emulator owns a small POSIX shared memory object named
+// `/emu6502-NAME` holding a `MonitorShared`. The thread running the emulator
+// copies registers and counters into it between slices of `emu_run` (see
+// `monitor_run`), which costs a few dozen stores per slice and nothing per
+// instruction beyond the counters `emu_tick` always keeps. Readers never
+// block it: the sample is guarded by a sequence lock, so a reader copies it
+// and retries if the sequence number was odd (a write in progress) or changed
+// while it was copying.
+//
+// Rates (MHz, instructions and interrupts per second) are left to the reader,
+// which divides the difference of two samples by the difference of their
+// `time_ns`.
+
+#define MONITOR_MAGIC 0x32303536 // "6502" in memory
+#define MONITOR_VERSION 1
+#define MONITOR_PREFIX "emu6502-"
+#define MONITOR_NAME_SIZE 32
+
+// cycles between two publications in `monitor_run`, a few milliseconds
+#define MONITOR_SLICE_CYCLES 1000000
+
+typedef struct MonitorSample {
+  u64 time_ns; // CLOCK_MONOTONIC when it was published
+  u64 cycles;
+  u64 n_instructions;
+  u64 n_interrupts;
+  u64 n_halts;
+  CPU cpu;
+  bool running;
+} MonitorSample;
+
+typedef struct MonitorShared {
+  u32 magic;   // `MONITOR_MAGIC`
+  u32 version; // `MONITOR_VERSION`
+  i32 pid;     // of the emulating process
+  char name[MONITOR_NAME_SIZE];
+  // odd while `sample` is being written
+  _Atomic u32 seq;
+  MonitorSample sample;
+} MonitorShared;
+
+typedef struct Monitor {
+  MonitorShared *shared;
+  char shm_name[MONITOR_NAME_SIZE + sizeof(MONITOR_PREFIX) + 1];
+} Monitor;
+
+// Create the shared memory object for `name` (letters, digits, `-`, `_` and
+// `.`), replacing a stale one of the same name left by a process that is gone
+// Returns false, printing why, if it cannot be created or a running process
+// publishes under the same name
+bool monitor_open(Monitor *mon, const char *name);
+
+// Remove the shared memory object
+void monitor_close(Monitor *mon);
+
+// Publish the registers and counters of `emu`
+void monitor_publish(Monitor *mon, const Emulator *emu);
+
+// `emu_run`, publishing every `MONITOR_SLICE_CYCLES` and when it returns
+EmuStop monitor_run(Monitor *mon, Emulator *emu, u64 max_cycles);
+
+// Map the shared memory object for `name` read-only
+// Returns NULL if there is none or it is not a monitor of this version
+const MonitorShared *monitor_map(const char *name);
+
+void monitor_unmap(const MonitorShared *shared);
+
+// Copy a consistent sample
+// Returns false if none could be read, e.g. the process died while writing
+bool monitor_read(const MonitorShared *shared, MonitorSample *out);
@@ -0,0 +1,23 @@
+#include "opcode.h"
+
+// instruction length by addressing mode
+#define LENGTH_IMPL 1
+#define LENGTH_A 1
+#define LENGTH_IM 2
+#define LENGTH_ZP 2
+#define LENGTH_ZPX 2
+#define LENGTH_ZPY 2
+#define LENGTH_ABS 3
+#define LENGTH_ABSX 3
+#define LENGTH_ABSY 3
+#define LENGTH_IND 3
+#define LENGTH_INDX 2
+#define LENGTH_INDY 2
+#define LENGTH_REL 2
+#define LENGTH_ZPI 2
+#define LENGTH_IAX 3
+
+#define OPCODE_INFO(NAME, OPCODE, MNEMONIC, MODE, CYCLES)                      \
+  [OPCODE] = {#MNEMONIC, ADDR_##MODE, LENGTH_##MODE, CYCLES},
+
+const OpcodeInfo opcode_table[256] = {OPCODE_VARIANT_LIST(OPCODE_INFO)};
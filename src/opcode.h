@@ -1,3 +1,7 @@
+#pragma once
+
+#include "common.h"
+
 // reference: https://www.masswerk.at/6502/6502_instruction_set.html
 
 // A:    Accumulator
@@ -5,213 +9,357 @@
 // ZP:   Zero Page
 // ZPX:  Zero Page, X
 // ZPY:  Zero Page, Y
+// ZPI:  (Zero Page), 65C02 only
 // ABS:  Absolute
 // ABSX: Absolute, X
 // ABSY: Absolute, Y
+// IND:  Indirect
 // INDX: (Indirect, X)
 // INDY: (Indirect), Y
-// Rel:  Relative
-// :     Implied
-
-#define OPCODE_ADC_IM 0x69
-#define OPCODE_ADC_ZP 0x65
-#define OPCODE_ADC_ZPX 0x75
-#define OPCODE_ADC_ABS 0x6D
-#define OPCODE_ADC_ABSX 0x7D
-#define OPCODE_ADC_ABSY 0x79
-#define OPCODE_ADC_INDX 0x61
-#define OPCODE_ADC_INDY 0x71
-
-#define OPCODE_AND_IM 0x29
-#define OPCODE_AND_ZP 0x25
-#define OPCODE_AND_ZPX 0x35
-#define OPCODE_AND_ABS 0x2D
-#define OPCODE_AND_ABSX 0x3D
-#define OPCODE_AND_ABSY 0x39
-#define OPCODE_AND_INDX 0x21
-#define OPCODE_AND_INDY 0x31
-
-#define OPCODE_ASL_A 0x0A
-#define OPCODE_ASL_ZP 0x06
-#define OPCODE_ASL_ZPX 0x16
-#define OPCODE_ASL_ABS 0x0E
-#define OPCODE_ASL_ABSX 0x1E
-
-#define OPCODE_BCC_REL 0x90
-
-#define OPCODE_BCS_REL 0xB0
-
-#define OPCODE_BEQ_REL 0xF0
-
-#define OPCODE_BIT_ZP 0x24
-#define OPCODE_BIT_ABS 0x2C
-
-#define OPCODE_BMI_REL 0x30
-
-#define OPCODE_BNE_REL 0xD0
-
-#define OPCODE_BPL_REL 0x10
-
-#define OPCODE_BRK 0x00
-
-#define OPCODE_BVC_REL 0x50
-
-#define OPCODE_BVS_REL 0x70
-
-#define OPCODE_CLC 0x18
-#define OPCODE_CLD 0xD8
-#define OPCODE_CLI 0x58
-#define OPCODE_CLV 0xB8
-
-#define OPCODE_CMP_IM 0xC9
-#define OPCODE_CMP_ZP 0xC5
-#define OPCODE_CMP_ZPX 0xD5
-#define OPCODE_CMP_ABS 0xCD
-#define OPCODE_CMP_ABSX 0xDD
-#define OPCODE_CMP_ABSY 0xD9
-#define OPCODE_CMP_INDX 0xC1
-#define OPCODE_CMP_INDY 0xD1
-
-#define OPCODE_CPX_IM 0xE0
-#define OPCODE_CPX_ZP 0xE4
-#define OPCODE_CPX_ABS 0xEC
-
-#define OPCODE_CPY_IM 0xC0
-#define OPCODE_CPY_ZP 0xC4
-#define OPCODE_CPY_ABS 0xCC
-
-#define OPCODE_DEC_ZP 0xC6
-#define OPCODE_DEC_ZPX 0xD6
-#define OPCODE_DEC_ABS 0xCE
-#define OPCODE_DEC_ABSX 0xDE
-
-#define OPCODE_DEX 0xCA
-
-#define OPCODE_DEY 0x88
-
-#define OPCODE_EOR_IM 0x49
-#define OPCODE_EOR_ZP 0x45
-#define OPCODE_EOR_ZPX 0x55
-#define OPCODE_EOR_ABS 0x4D
-#define OPCODE_EOR_ABSX 0x5D
-#define OPCODE_EOR_ABSY 0x59
-#define OPCODE_EOR_INDX 0x41
-#define OPCODE_EOR_INDY 0x51
-
-#define OPCODE_INC_ZP 0xE6
-#define OPCODE_INC_ZPX 0xF6
-#define OPCODE_INC_ABS 0xEE
-#define OPCODE_INC_ABSX 0xFE
-
-#define OPCODE_INX 0xE8
-
-#define OPCODE_INY 0xC8
-
-#define OPCODE_JMP_ABS 0x4C
-#define OPCODE_JMP_IND 0x6C
-
-#define OPCODE_JSR_ABS 0x20
-
-#define OPCODE_NOP 0xEA
-
-#define OPCODE_ORA_IM 0x09
-#define OPCODE_ORA_ZP 0x05
-#define OPCODE_ORA_ZPX 0x15
-#define OPCODE_ORA_ABS 0x0D
-#define OPCODE_ORA_ABSX 0x1D
-#define OPCODE_ORA_ABSY 0x19
-#define OPCODE_ORA_INDX 0x01
-#define OPCODE_ORA_INDY 0x11
-
-#define OPCODE_LDA_IM 0xA9
-#define OPCODE_LDA_ZP 0xA5
-#define OPCODE_LDA_ZPX 0xB5
-#define OPCODE_LDA_ABS 0xAD
-#define OPCODE_LDA_ABSX 0xBD
-#define OPCODE_LDA_ABSY 0xB9
-#define OPCODE_LDA_INDX 0xA1
-#define OPCODE_LDA_INDY 0xB1
-
-#define OPCODE_LDX_IM 0xA2
-#define OPCODE_LDX_ZP 0xA6
-#define OPCODE_LDX_ZPY 0xB6
-#define OPCODE_LDX_ABS 0xAE
-#define OPCODE_LDX_ABSY 0xBE
-
-#define OPCODE_LDY_IM 0xA0
-#define OPCODE_LDY_ZP 0xA4
-#define OPCODE_LDY_ZPY 0xB4
-#define OPCODE_LDY_ABS 0xAC
-#define OPCODE_LDY_ABSY 0xBC
-
-#define OPCODE_LSR_A 0x4A
-#define OPCODE_LSR_ZP 0x46
-#define OPCODE_LSR_ZPX 0x56
-#define OPCODE_LSR_ABS 0x4E
-#define OPCODE_LSR_ABSX 0x5E
-
-#define OPCODE_PHA 0x48
-
-#define OPCODE_PHP 0x08
-
-#define OPCODE_PLA 0x68
-
-#define OPCODE_PLP 0x28
-
-#define OPCODE_ROL_A 0x2A
-#define OPCODE_ROL_ZP 0x26
-#define OPCODE_ROL_ZPX 0x36
-#define OPCODE_ROL_ABS 0x2E
-#define OPCODE_ROL_ABSX 0x3E
-
-#define OPCODE_ROR_A 0x6A
-#define OPCODE_ROR_ZP 0x66
-#define OPCODE_ROR_ZPX 0x76
-#define OPCODE_ROR_ABS 0x6E
-#define OPCODE_ROR_ABSX 0x7E
-
-#define OPCODE_RTI 0x40
-#define OPCODE_RTS 0x60
-
-#define OPCODE_SBC_IM 0xE9
-#define OPCODE_SBC_ZP 0xE5
-#define OPCODE_SBC_ZPX 0xF5
-#define OPCODE_SBC_ABS 0xED
-#define OPCODE_SBC_ABSX 0xFD
-#define OPCODE_SBC_ABSY 0xF9
-#define OPCODE_SBC_INDX 0xE1
-#define OPCODE_SBC_INDY 0xF1
-
-#define OPCODE_SEC 0x38
-
-#define OPCODE_SED 0xF8
-
-#define OPCODE_SEI 0x78
-
-#define OPCODE_STA_ZP 0x85
-#define OPCODE_STA_ZPX 0x95
-#define OPCODE_STA_ABS 0x8D
-#define OPCODE_STA_ABSX 0x9D
-#define OPCODE_STA_ABSY 0x99
-#define OPCODE_STA_INDX 0x81
-#define OPCODE_STA_INDY 0x91
-
-#define OPCODE_STX_ZP 0x86
-#define OPCODE_STX_ZPY 0x96
-#define OPCODE_STX_ABS 0x8E
-
-#define OPCODE_STY_ZP 0x84
-#define OPCODE_STY_ZPX 0x94
-#define OPCODE_STY_ABS 0x8C
-
-#define OPCODE_TAX 0xAA
-
-#define OPCODE_TAY 0xA8
-
-#define OPCODE_TSX 0xBA
-
-#define OPCODE_TXA 0x8A
-
-#define OPCODE_TXS 0x9A
-
-#define OPCODE_TYA 0x98
+// IAX:  (Absolute, X), 65C02 only
+// REL:  Relative
+// IMPL: Implied
+
+// The single source of truth for the instruction set, one entry per opcode:
+// X(NAME, OPCODE, MNEMONIC, MODE, CYCLES)
+// `CYCLES` is the base cycle count, without the extra cycle of indexed loads
+// crossing a page boundary or the extra cycles of taken branches
+#define OPCODE_LIST(X)                                                         \
+  X(ADC_IM, 0x69, ADC, IM, 2)                                                  \
+  X(ADC_ZP, 0x65, ADC, ZP, 3)                                                  \
+  X(ADC_ZPX, 0x75, ADC, ZPX, 4)                                                \
+  X(ADC_ABS, 0x6D, ADC, ABS, 4)                                                \
+  X(ADC_ABSX, 0x7D, ADC, ABSX, 4)                                              \
+  X(ADC_ABSY, 0x79, ADC, ABSY, 4)                                              \
+  X(ADC_INDX, 0x61, ADC, INDX, 6)                                              \
+  X(ADC_INDY, 0x71, ADC, INDY, 5)                                              \
+  X(AND_IM, 0x29, AND, IM, 2)                                                  \
+  X(AND_ZP, 0x25, AND, ZP, 3)                                                  \
+  X(AND_ZPX, 0x35, AND, ZPX, 4)                                                \
+  X(AND_ABS, 0x2D, AND, ABS, 4)                                                \
+  X(AND_ABSX, 0x3D, AND, ABSX, 4)                                              \
+  X(AND_ABSY, 0x39, AND, ABSY, 4)                                              \
+  X(AND_INDX, 0x21, AND, INDX, 6)                                              \
+  X(AND_INDY, 0x31, AND, INDY, 5)                                              \
+  X(ASL_A, 0x0A, ASL, A, 2)                                                    \
+  X(ASL_ZP, 0x06, ASL, ZP, 5)                                                  \
+  X(ASL_ZPX, 0x16, ASL, ZPX, 6)                                                \
+  X(ASL_ABS, 0x0E, ASL, ABS, 6)                                                \
+  X(ASL_ABSX, 0x1E, ASL, ABSX, CYCLES_SHIFT_ABSX)                              \
+  X(BCC_REL, 0x90, BCC, REL, 2)                                                \
+  X(BCS_REL, 0xB0, BCS, REL, 2)                                                \
+  X(BEQ_REL, 0xF0, BEQ, REL, 2)                                                \
+  X(BIT_ZP, 0x24, BIT, ZP, 3)                                                  \
+  X(BIT_ABS, 0x2C, BIT, ABS, 4)                                                \
+  X(BMI_REL, 0x30, BMI, REL, 2)                                                \
+  X(BNE_REL, 0xD0, BNE, REL, 2)                                                \
+  X(BPL_REL, 0x10, BPL, REL, 2)                                                \
+  X(BRK, 0x00, BRK, IMPL, 7)                                                   \
+  X(BVC_REL, 0x50, BVC, REL, 2)                                                \
+  X(BVS_REL, 0x70, BVS, REL, 2)                                                \
+  X(CLC, 0x18, CLC, IMPL, 2)                                                   \
+  X(CLD, 0xD8, CLD, IMPL, 2)                                                   \
+  X(CLI, 0x58, CLI, IMPL, 2)                                                   \
+  X(CLV, 0xB8, CLV, IMPL, 2)                                                   \
+  X(CMP_IM, 0xC9, CMP, IM, 2)                                                  \
+  X(CMP_ZP, 0xC5, CMP, ZP, 3)                                                  \
+  X(CMP_ZPX, 0xD5, CMP, ZPX, 4)                                                \
+  X(CMP_ABS, 0xCD, CMP, ABS, 4)                                                \
+  X(CMP_ABSX, 0xDD, CMP, ABSX, 4)                                              \
+  X(CMP_ABSY, 0xD9, CMP, ABSY, 4)                                              \
+  X(CMP_INDX, 0xC1, CMP, INDX, 6)                                              \
+  X(CMP_INDY, 0xD1, CMP, INDY, 5)                                              \
+  X(CPX_IM, 0xE0, CPX, IM, 2)                                                  \
+  X(CPX_ZP, 0xE4, CPX, ZP, 3)                                                  \
+  X(CPX_ABS, 0xEC, CPX, ABS, 4)                                                \
+  X(CPY_IM, 0xC0, CPY, IM, 2)                                                  \
+  X(CPY_ZP, 0xC4, CPY, ZP, 3)                                                  \
+  X(CPY_ABS, 0xCC, CPY, ABS, 4)                                                \
+  X(DEC_ZP, 0xC6, DEC, ZP, 5)                                                  \
+  X(DEC_ZPX, 0xD6, DEC, ZPX, 6)                                                \
+  X(DEC_ABS, 0xCE, DEC, ABS, 6)                                                \
+  X(DEC_ABSX, 0xDE, DEC, ABSX, 7)                                              \
+  X(DEX, 0xCA, DEX, IMPL, 2)                                                   \
+  X(DEY, 0x88, DEY, IMPL, 2)                                                   \
+  X(EOR_IM, 0x49, EOR, IM, 2)                                                  \
+  X(EOR_ZP, 0x45, EOR, ZP, 3)                                                  \
+  X(EOR_ZPX, 0x55, EOR, ZPX, 4)                                                \
+  X(EOR_ABS, 0x4D, EOR, ABS, 4)                                                \
+  X(EOR_ABSX, 0x5D, EOR, ABSX, 4)                                              \
+  X(EOR_ABSY, 0x59, EOR, ABSY, 4)                                              \
+  X(EOR_INDX, 0x41, EOR, INDX, 6)                                              \
+  X(EOR_INDY, 0x51, EOR, INDY, 5)                                              \
+  X(INC_ZP, 0xE6, INC, ZP, 5)                                                  \
+  X(INC_ZPX, 0xF6, INC, ZPX, 6)                                                \
+  X(INC_ABS, 0xEE, INC, ABS, 6)                                                \
+  X(INC_ABSX, 0xFE, INC, ABSX, 7)                                              \
+  X(INX, 0xE8, INX, IMPL, 2)                                                   \
+  X(INY, 0xC8, INY, IMPL, 2)                                                   \
+  X(JMP_ABS, 0x4C, JMP, ABS, 3)                                                \
+  X(JMP_IND, 0x6C, JMP, IND, CYCLES_JMP_IND)                                   \
+  X(JSR_ABS, 0x20, JSR, ABS, 6)                                                \
+  X(NOP, 0xEA, NOP, IMPL, 2)                                                   \
+  X(ORA_IM, 0x09, ORA, IM, 2)                                                  \
+  X(ORA_ZP, 0x05, ORA, ZP, 3)                                                  \
+  X(ORA_ZPX, 0x15, ORA, ZPX, 4)                                                \
+  X(ORA_ABS, 0x0D, ORA, ABS, 4)                                                \
+  X(ORA_ABSX, 0x1D, ORA, ABSX, 4)                                              \
+  X(ORA_ABSY, 0x19, ORA, ABSY, 4)                                              \
+  X(ORA_INDX, 0x01, ORA, INDX, 6)                                              \
+  X(ORA_INDY, 0x11, ORA, INDY, 5)                                              \
+  X(LDA_IM, 0xA9, LDA, IM, 2)                                                  \
+  X(LDA_ZP, 0xA5, LDA, ZP, 3)                                                  \
+  X(LDA_ZPX, 0xB5, LDA, ZPX, 4)                                                \
+  X(LDA_ABS, 0xAD, LDA, ABS, 4)                                                \
+  X(LDA_ABSX, 0xBD, LDA, ABSX, 4)                                              \
+  X(LDA_ABSY, 0xB9, LDA, ABSY, 4)                                              \
+  X(LDA_INDX, 0xA1, LDA, INDX, 6)                                              \
+  X(LDA_INDY, 0xB1, LDA, INDY, 5)                                              \
+  X(LDX_IM, 0xA2, LDX, IM, 2)                                                  \
+  X(LDX_ZP, 0xA6, LDX, ZP, 3)                                                  \
+  X(LDX_ZPY, 0xB6, LDX, ZPY, 4)                                                \
+  X(LDX_ABS, 0xAE, LDX, ABS, 4)                                                \
+  X(LDX_ABSY, 0xBE, LDX, ABSY, 4)                                              \
+  X(LDY_IM, 0xA0, LDY, IM, 2)                                                  \
+  X(LDY_ZP, 0xA4, LDY, ZP, 3)                                                  \
+  X(LDY_ZPX, 0xB4, LDY, ZPX, 4)                                                \
+  X(LDY_ABS, 0xAC, LDY, ABS, 4)                                                \
+  X(LDY_ABSX, 0xBC, LDY, ABSX, 4)                                              \
+  X(LSR_A, 0x4A, LSR, A, 2)                                                    \
+  X(LSR_ZP, 0x46, LSR, ZP, 5)                                                  \
+  X(LSR_ZPX, 0x56, LSR, ZPX, 6)                                                \
+  X(LSR_ABS, 0x4E, LSR, ABS, 6)                                                \
+  X(LSR_ABSX, 0x5E, LSR, ABSX, CYCLES_SHIFT_ABSX)                              \
+  X(PHA, 0x48, PHA, IMPL, 3)                                                   \
+  X(PHP, 0x08, PHP, IMPL, 3)                                                   \
+  X(PLA, 0x68, PLA, IMPL, 4)                                                   \
+  X(PLP, 0x28, PLP, IMPL, 4)                                                   \
+  X(ROL_A, 0x2A, ROL, A, 2)                                                    \
+  X(ROL_ZP, 0x26, ROL, ZP, 5)                                                  \
+  X(ROL_ZPX, 0x36, ROL, ZPX, 6)                                                \
+  X(ROL_ABS, 0x2E, ROL, ABS, 6)                                                \
+  X(ROL_ABSX, 0x3E, ROL, ABSX, CYCLES_SHIFT_ABSX)                              \
+  X(ROR_A, 0x6A, ROR, A, 2)                                                    \
+  X(ROR_ZP, 0x66, ROR, ZP, 5)                                                  \
+  X(ROR_ZPX, 0x76, ROR, ZPX, 6)                                                \
+  X(ROR_ABS, 0x6E, ROR, ABS, 6)                                                \
+  X(ROR_ABSX, 0x7E, ROR, ABSX, CYCLES_SHIFT_ABSX)                              \
+  X(RTI, 0x40, RTI, IMPL, 6)                                                   \
+  X(RTS, 0x60, RTS, IMPL, 6)                                                   \
+  X(SBC_IM, 0xE9, SBC, IM, 2)                                                  \
+  X(SBC_ZP, 0xE5, SBC, ZP, 3)                                                  \
+  X(SBC_ZPX, 0xF5, SBC, ZPX, 4)                                                \
+  X(SBC_ABS, 0xED, SBC, ABS, 4)                                                \
+  X(SBC_ABSX, 0xFD, SBC, ABSX, 4)                                              \
+  X(SBC_ABSY, 0xF9, SBC, ABSY, 4)                                              \
+  X(SBC_INDX, 0xE1, SBC, INDX, 6)                                              \
+  X(SBC_INDY, 0xF1, SBC, INDY, 5)                                              \
+  X(SEC, 0x38, SEC, IMPL, 2)                                                   \
+  X(SED, 0xF8, SED, IMPL, 2)                                                   \
+  X(SEI, 0x78, SEI, IMPL, 2)                                                   \
+  X(STA_ZP, 0x85, STA, ZP, 3)                                                  \
+  X(STA_ZPX, 0x95, STA, ZPX, 4)                                                \
+  X(STA_ABS, 0x8D, STA, ABS, 4)                                                \
+  X(STA_ABSX, 0x9D, STA, ABSX, 5)                                              \
+  X(STA_ABSY, 0x99, STA, ABSY, 5)                                              \
+  X(STA_INDX, 0x81, STA, INDX, 6)                                              \
+  X(STA_INDY, 0x91, STA, INDY, 6)                                              \
+  X(STX_ZP, 0x86, STX, ZP, 3)                                                  \
+  X(STX_ZPY, 0x96, STX, ZPY, 4)                                                \
+  X(STX_ABS, 0x8E, STX, ABS, 4)                                                \
+  X(STY_ZP, 0x84, STY, ZP, 3)                                                  \
+  X(STY_ZPX, 0x94, STY, ZPX, 4)                                                \
+  X(STY_ABS, 0x8C, STY, ABS, 4)                                                \
+  X(TAX, 0xAA, TAX, IMPL, 2)                                                   \
+  X(TAY, 0xA8, TAY, IMPL, 2)                                                   \
+  X(TSX, 0xBA, TSX, IMPL, 2)                                                   \
+  X(TXA, 0x8A, TXA, IMPL, 2)                                                   \
+  X(TXS, 0x9A, TXS, IMPL, 2)                                                   \
+  X(TYA, 0x98, TYA, IMPL, 2)
+
+// The stable undocumented opcodes of the NMOS 6502, added by `EMU_CPU_6502X`
+// (see "No More Secrets", the NMOS 6510 unintended opcodes reference). The
+// unstable ones (ANE, LXA, SHA, SHX, SHY, TAS, LAS) and the JAM opcodes are
+// left out and halt like unknown opcodes.
+#define OPCODE_LIST_6502X(X)                                                   \
+  X(SLO_ZP, 0x07, SLO, ZP, 5)                                                  \
+  X(SLO_ZPX, 0x17, SLO, ZPX, 6)                                                \
+  X(SLO_ABS, 0x0F, SLO, ABS, 6)                                                \
+  X(SLO_ABSX, 0x1F, SLO, ABSX, 7)                                              \
+  X(SLO_ABSY, 0x1B, SLO, ABSY, 7)                                              \
+  X(SLO_INDX, 0x03, SLO, INDX, 8)                                              \
+  X(SLO_INDY, 0x13, SLO, INDY, 8)                                              \
+  X(RLA_ZP, 0x27, RLA, ZP, 5)                                                  \
+  X(RLA_ZPX, 0x37, RLA, ZPX, 6)                                                \
+  X(RLA_ABS, 0x2F, RLA, ABS, 6)                                                \
+  X(RLA_ABSX, 0x3F, RLA, ABSX, 7)                                              \
+  X(RLA_ABSY, 0x3B, RLA, ABSY, 7)                                              \
+  X(RLA_INDX, 0x23, RLA, INDX, 8)                                              \
+  X(RLA_INDY, 0x33, RLA, INDY, 8)                                              \
+  X(SRE_ZP, 0x47, SRE, ZP, 5)                                                  \
+  X(SRE_ZPX, 0x57, SRE, ZPX, 6)                                                \
+  X(SRE_ABS, 0x4F, SRE, ABS, 6)                                                \
+  X(SRE_ABSX, 0x5F, SRE, ABSX, 7)                                              \
+  X(SRE_ABSY, 0x5B, SRE, ABSY, 7)                                              \
+  X(SRE_INDX, 0x43, SRE, INDX, 8)                                              \
+  X(SRE_INDY, 0x53, SRE, INDY, 8)                                              \
+  X(RRA_ZP, 0x67, RRA, ZP, 5)                                                  \
+  X(RRA_ZPX, 0x77, RRA, ZPX, 6)                                                \
+  X(RRA_ABS, 0x6F, RRA, ABS, 6)                                                \
+  X(RRA_ABSX, 0x7F, RRA, ABSX, 7)                                              \
+  X(RRA_ABSY, 0x7B, RRA, ABSY, 7)                                              \
+  X(RRA_INDX, 0x63, RRA, INDX, 8)                                              \
+  X(RRA_INDY, 0x73, RRA, INDY, 8)                                              \
+  X(DCP_ZP, 0xC7, DCP, ZP, 5)                                                  \
+  X(DCP_ZPX, 0xD7, DCP, ZPX, 6)                                                \
+  X(DCP_ABS, 0xCF, DCP, ABS, 6)                                                \
+  X(DCP_ABSX, 0xDF, DCP, ABSX, 7)                                              \
+  X(DCP_ABSY, 0xDB, DCP, ABSY, 7)                                              \
+  X(DCP_INDX, 0xC3, DCP, INDX, 8)                                              \
+  X(DCP_INDY, 0xD3, DCP, INDY, 8)                                              \
+  X(ISC_ZP, 0xE7, ISC, ZP, 5)                                                  \
+  X(ISC_ZPX, 0xF7, ISC, ZPX, 6)                                                \
+  X(ISC_ABS, 0xEF, ISC, ABS, 6)                                                \
+  X(ISC_ABSX, 0xFF, ISC, ABSX, 7)                                              \
+  X(ISC_ABSY, 0xFB, ISC, ABSY, 7)                                              \
+  X(ISC_INDX, 0xE3, ISC, INDX, 8)                                              \
+  X(ISC_INDY, 0xF3, ISC, INDY, 8)                                              \
+  X(SAX_ZP, 0x87, SAX, ZP, 3)                                                  \
+  X(SAX_ZPY, 0x97, SAX, ZPY, 4)                                                \
+  X(SAX_ABS, 0x8F, SAX, ABS, 4)                                                \
+  X(SAX_INDX, 0x83, SAX, INDX, 6)                                              \
+  X(LAX_ZP, 0xA7, LAX, ZP, 3)                                                  \
+  X(LAX_ZPY, 0xB7, LAX, ZPY, 4)                                                \
+  X(LAX_ABS, 0xAF, LAX, ABS, 4)                                                \
+  X(LAX_ABSY, 0xBF, LAX, ABSY, 4)                                              \
+  X(LAX_INDX, 0xA3, LAX, INDX, 6)                                              \
+  X(LAX_INDY, 0xB3, LAX, INDY, 5)                                              \
+  X(ANC_IM, 0x0B, ANC, IM, 2)                                                  \
+  X(ANC_IM_2B, 0x2B, ANC, IM, 2)                                               \
+  X(ALR_IM, 0x4B, ALR, IM, 2)                                                  \
+  X(ARR_IM, 0x6B, ARR, IM, 2)                                                  \
+  X(SBX_IM, 0xCB, SBX, IM, 2)                                                  \
+  X(SBC_IM_EB, 0xEB, SBC, IM, 2)                                               \
+  X(NOP_1A, 0x1A, NOP, IMPL, 2)                                                \
+  X(NOP_3A, 0x3A, NOP, IMPL, 2)                                                \
+  X(NOP_5A, 0x5A, NOP, IMPL, 2)                                                \
+  X(NOP_7A, 0x7A, NOP, IMPL, 2)                                                \
+  X(NOP_DA, 0xDA, NOP, IMPL, 2)                                                \
+  X(NOP_FA, 0xFA, NOP, IMPL, 2)                                                \
+  X(NOP_80, 0x80, NOP, IM, 2)                                                  \
+  X(NOP_82, 0x82, NOP, IM, 2)                                                  \
+  X(NOP_89, 0x89, NOP, IM, 2)                                                  \
+  X(NOP_C2, 0xC2, NOP, IM, 2)                                                  \
+  X(NOP_E2, 0xE2, NOP, IM, 2)                                                  \
+  X(NOP_04, 0x04, NOP, ZP, 3)                                                  \
+  X(NOP_44, 0x44, NOP, ZP, 3)                                                  \
+  X(NOP_64, 0x64, NOP, ZP, 3)                                                  \
+  X(NOP_14, 0x14, NOP, ZPX, 4)                                                 \
+  X(NOP_34, 0x34, NOP, ZPX, 4)                                                 \
+  X(NOP_54, 0x54, NOP, ZPX, 4)                                                 \
+  X(NOP_74, 0x74, NOP, ZPX, 4)                                                 \
+  X(NOP_D4, 0xD4, NOP, ZPX, 4)                                                 \
+  X(NOP_F4, 0xF4, NOP, ZPX, 4)                                                 \
+  X(NOP_0C, 0x0C, NOP, ABS, 4)                                                 \
+  X(NOP_1C, 0x1C, NOP, ABSX, 4)                                                \
+  X(NOP_3C, 0x3C, NOP, ABSX, 4)                                                \
+  X(NOP_5C, 0x5C, NOP, ABSX, 4)                                                \
+  X(NOP_7C, 0x7C, NOP, ABSX, 4)                                                \
+  X(NOP_DC, 0xDC, NOP, ABSX, 4)                                                \
+  X(NOP_FC, 0xFC, NOP, ABSX, 4)
+
+// The instructions and addressing modes the CMOS 65C02 adds, used instead of
+// `OPCODE_LIST_6502X` by `EMU_CPU_65C02`. The Rockwell and WDC bit
+// instructions (RMB, SMB, BBR, BBS) and WAI/STP are not included, and the
+// opcodes the 65C02 leaves undefined halt like on the other variants.
+#define OPCODE_LIST_65C02(X)                                                   \
+  X(BRA_REL, 0x80, BRA, REL, 2)                                                \
+  X(STZ_ZP, 0x64, STZ, ZP, 3)                                                  \
+  X(STZ_ZPX, 0x74, STZ, ZPX, 4)                                                \
+  X(STZ_ABS, 0x9C, STZ, ABS, 4)                                                \
+  X(STZ_ABSX, 0x9E, STZ, ABSX, 5)                                              \
+  X(PHX, 0xDA, PHX, IMPL, 3)                                                   \
+  X(PHY, 0x5A, PHY, IMPL, 3)                                                   \
+  X(PLX, 0xFA, PLX, IMPL, 4)                                                   \
+  X(PLY, 0x7A, PLY, IMPL, 4)                                                   \
+  X(TRB_ZP, 0x14, TRB, ZP, 5)                                                  \
+  X(TRB_ABS, 0x1C, TRB, ABS, 6)                                                \
+  X(TSB_ZP, 0x04, TSB, ZP, 5)                                                  \
+  X(TSB_ABS, 0x0C, TSB, ABS, 6)                                                \
+  X(INC_A, 0x1A, INC, A, 2)                                                    \
+  X(DEC_A, 0x3A, DEC, A, 2)                                                    \
+  X(BIT_IM, 0x89, BIT, IM, 2)                                                  \
+  X(BIT_ZPX, 0x34, BIT, ZPX, 4)                                                \
+  X(BIT_ABSX, 0x3C, BIT, ABSX, 4)                                              \
+  X(ORA_ZPI, 0x12, ORA, ZPI, 5)                                                \
+  X(AND_ZPI, 0x32, AND, ZPI, 5)                                                \
+  X(EOR_ZPI, 0x52, EOR, ZPI, 5)                                                \
+  X(ADC_ZPI, 0x72, ADC, ZPI, 5)                                                \
+  X(STA_ZPI, 0x92, STA, ZPI, 5)                                                \
+  X(LDA_ZPI, 0xB2, LDA, ZPI, 5)                                                \
+  X(CMP_ZPI, 0xD2, CMP, ZPI, 5)                                                \
+  X(SBC_ZPI, 0xF2, SBC, ZPI, 5)                                                \
+  X(JMP_IAX, 0x7C, JMP, IAX, 6)
+
+// The CPU variant is chosen at compile time: the NMOS 6502 with only the
+// documented instructions by default, `EMU_CPU_6502X` for the NMOS 6502 with
+// its stable undocumented opcodes, or `EMU_CPU_65C02` for the CMOS 65C02. The
+// variant's opcodes are in `opcode_table` and have handlers in `emu_tick`,
+// and the others are compiled out, so the interpreter never checks the variant
+// at run time.
+#if defined(EMU_CPU_65C02)
+#define CPU_NAME "65C02"
+#define OPCODE_VARIANT_LIST(X) OPCODE_LIST(X) OPCODE_LIST_65C02(X)
+#elif defined(EMU_CPU_6502X)
+#define CPU_NAME "6502X"
+#define OPCODE_VARIANT_LIST(X) OPCODE_LIST(X) OPCODE_LIST_6502X(X)
+#else
+#define CPU_NAME "6502"
+#define OPCODE_VARIANT_LIST(X) OPCODE_LIST(X)
+#endif
+
+// cycles of instructions the 65C02 changed
+#ifdef EMU_CPU_65C02
+#define CYCLES_JMP_IND 6    // no longer wraps within the page
+#define CYCLES_SHIFT_ABSX 6 // plus 1 on a page cross, like loads
+#else
+#define CYCLES_JMP_IND 5
+#define CYCLES_SHIFT_ABSX 7
+#endif
+
+// `OPCODE_<NAME>` for every opcode of every variant, values of different
+// variants may be the same
+#define OPCODE_ENUM(NAME, OPCODE, MNEMONIC, MODE, CYCLES) OPCODE_##NAME = OPCODE,
+enum {
+  OPCODE_LIST(OPCODE_ENUM) OPCODE_LIST_6502X(OPCODE_ENUM)
+      OPCODE_LIST_65C02(OPCODE_ENUM)
+};
+#undef OPCODE_ENUM
+
+typedef enum AddrMode {
+  ADDR_IMPL,
+  ADDR_A,
+  ADDR_IM,
+  ADDR_ZP,
+  ADDR_ZPX,
+  ADDR_ZPY,
+  ADDR_ABS,
+  ADDR_ABSX,
+  ADDR_ABSY,
+  ADDR_IND,
+  ADDR_INDX,
+  ADDR_INDY,
+  ADDR_REL,
+  ADDR_ZPI, // (zp), 65C02 only
+  ADDR_IAX, // (abs,X), 65C02 only
+} AddrMode;
+
+typedef struct OpcodeInfo {
+  char mnemonic[4]; // empty for opcodes not in `OPCODE_VARIANT_LIST`
+  u8 mode;          // `AddrMode`
+  u8 length;        // in bytes, including the opcode, 0 if not in the list
+  u8 cycles;        // base cycle count
+} OpcodeInfo;
+
+// `OPCODE_VARIANT_LIST` indexed by opcode
+extern const OpcodeInfo opcode_table[256];
@@ -0,0 +1,99 @@
+#include "profile.h"
+#include "disasm.h"
+
+#include <inttypes.h>
+
+void profiler_init(Profiler *profiler) { memset(profiler, 0, sizeof(Profiler)); }
+
+static const Profiler *sort_profiler;
+
+// sort addresses by cycles spent, descending, ties broken by address
+static i32 compare_pcs(const void *lhs, const void *rhs) {
+  const u16 l = *(const u16 *)lhs;
+  const u16 r = *(const u16 *)rhs;
+  const u64 l_cycles = sort_profiler->pcs[l].cycles;
+  const u64 r_cycles = sort_profiler->pcs[r].cycles;
+  if (l_cycles != r_cycles) {
+    return (l_cycles < r_cycles) ? 1 : -1;
+  }
+  return (l < r) ? -1 : 1;
+}
+
+static inline f64 percent(const u64 x, const u64 total) {
+  return (total == 0) ? 0.0 : (f64)x * 100.0 / (f64)total;
+}
+
+static void print_hotspots(const Profiler *profiler, const u8 *mem, FILE *out,
+                           const usize top_n, const u64 total_cycles) {
+  static u16 pcs[MEM_SIZE];
+  usize n = 0;
+  for (usize i = 0; i < MEM_SIZE; i++) {
+    if (profiler->pcs[i].count != 0) {
+      pcs[n++] = (u16)i;
+    }
+  }
+  sort_profiler = profiler;
+  qsort(pcs, n, sizeof(u16), compare_pcs);
+
+  fprintf(out, "ADDR\t%%CYCLES\tCYCLES\t\tCOUNT\t\tAVG\tINSTRUCTION\n");
+  for (usize i = 0; i < n && i < top_n; i++) {
+    const ProfileEntry *e = &profiler->pcs[pcs[i]];
+    char instr[DISASM_MAX_LEN];
+    disasm_instr(mem, pcs[i], instr);
+    fprintf(out,
+            "%04X\t%6.2lf\t%-12" PRIu64 "\t%-12" PRIu64 "\t%.2lf\t%s\n",
+            pcs[i], percent(e->cycles, total_cycles), e->cycles, e->count,
+            (f64)e->cycles / (f64)e->count, instr);
+  }
+}
+
+static void print_page_heatmap(const Profiler *profiler, FILE *out,
+                               const u64 total_cycles) {
+  u64 pages[256] = {0};
+  u64 max = 0;
+  for (usize i = 0; i < MEM_SIZE; i++) {
+    pages[i >> 8] += profiler->pcs[i].cycles;
+  }
+  for (usize i = 0; i < 256; i++) {
+    max = (pages[i] > max) ? pages[i] : max;
+  }
+
+  // one character per page, rows are the high nibble of the page number
+  static const char shades[] = " .:-=+*#%@";
+  fprintf(out, "\ncycles per page (row: high nibble, column: low nibble)\n");
+  fprintf(out, "\t0123456789ABCDEF\n");
+  for (usize row = 0; row < 16; row++) {
+    fprintf(out, "%X_\t", (u32)row);
+    for (usize col = 0; col < 16; col++) {
+      const u64 x = pages[row * 16 + col];
+      usize shade = 0;
+      if (x != 0) {
+        shade = 1 + (usize)((f64)x / (f64)max * (f64)(sizeof(shades) - 3));
+      }
+      fputc(shades[shade], out);
+    }
+    fputc('\n', out);
+  }
+
+  fprintf(out, "\nPAGE\t%%CYCLES\tCYCLES\n");
+  for (usize i = 0; i < 256; i++) {
+    if (pages[i] != 0) {
+      fprintf(out, "%02X__\t%6.2lf\t%" PRIu64 "\n", (u32)i,
+              percent(pages[i], total_cycles), pages[i]);
+    }
+  }
+}
+
+void profiler_report(const Profiler *profiler, const u8 *mem, FILE *out,
+                     const usize top_n) {
+  u64 total_cycles = 0;
+  u64 total_count = 0;
+  for (usize i = 0; i < MEM_SIZE; i++) {
+    total_cycles += profiler->pcs[i].cycles;
+    total_count += profiler->pcs[i].count;
+  }
+  fprintf(out, "%" PRIu64 " instructions, %" PRIu64 " cycles\n\n", total_count,
+          total_cycles);
+  print_hotspots(profiler, mem, out, top_n, total_cycles);
+  print_page_heatmap(profiler, out, total_cycles);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Flat per-PC profiler.
+//
+// Every address has a slot holding the number of times an instruction starting
+// there was executed and the cycles spent in it, so recording a sample is two
+// additions and the profiler can stay on in production. The cycles of an
+// interrupt entry are charged to the first instruction of the handler, so the
+// cycles of all slots add up to the cycles the emulator ran.
+
+typedef struct ProfileEntry {
+  u64 cycles;
+  u64 count;
+} ProfileEntry;
+
+typedef struct Profiler {
+  ProfileEntry pcs[MEM_SIZE];
+} Profiler;
+
+// Clear all counters
+void profiler_init(Profiler *profiler);
+
+// Called by the emulator after executing the instruction at `pc`
+static inline void profile_record(Profiler *profiler, const u16 pc,
+                                  const u64 cycles) {
+  profiler->pcs[pc].cycles += cycles;
+  profiler->pcs[pc].count++;
+}
+
+// Called by the emulator for cycles spent before running the instruction at
+// `pc`, without counting an execution
+static inline void profile_charge(Profiler *profiler, const u16 pc,
+                                  const u64 cycles) {
+  profiler->pcs[pc].cycles += cycles;
+}
+
+// Print the `top_n` addresses with the most cycles spent and the instructions
+// at them, disassembled from `mem`, followed by a heatmap of cycles spent per
+// 256 byte page
+void profiler_report(const Profiler *profiler, const u8 *mem, FILE *out,
+                     usize top_n);
@@ -0,0 +1,588 @@
+#include "assembler.h"
+#include "breakpoints.h"
+#include "common.h"
+#include "disasm.h"
+#include "emu6502.h"
+#include "loader.h"
+#include "opcode.h"
+
+// Recompiles the code of a ROM image to C ahead of time, see `aot.h`.
+//
+// Code is traced from the entry points through `opcode_table`: every
+// instruction reachable through fall-through, branches, JMP and JSR (whose
+// return address is reachable too) is found, and a basic block starts at every
+// entry point and jump target and after every block ending instruction. Each
+// block becomes a C function that checks its bytes are unchanged, runs its
+// instructions and sets PC to wherever execution continues. Jumps through
+// pointers, RTS and RTI end a block with a target that is looked up at run
+// time. BRK and the instructions only some CPU variants have are left to the
+// interpreter, as is anything outside the image.
+//
+// Entry points are given with `--entry`, and the reset, NMI and IRQ vectors
+// are used if the image contains them. Sources (`.s`) are assembled first and
+// their `start` symbol is an entry point too. `--name` names the `AotProgram`
+// (`aot_program` by default), so several programs can be linked together.
+// Exit status is 0 on success and 2 on errors.
+
+#define MAX_ENTRIES 64
+
+// an instruction of a block
+typedef struct Instr {
+  u16 addr;
+  u8 opcode;
+  const OpcodeInfo *info;
+  u16 operand; // the byte or word after the opcode, the target for branches
+  u16 next;    // address of the following instruction
+} Instr;
+
+static u8 mem[MEM_SIZE];
+static u32 image_lo;
+static u32 image_hi; // exclusive
+static bool seen[MEM_SIZE];
+static bool leader[MEM_SIZE];
+// the instructions of the documented NMOS 6502, the ones that are compiled
+static bool documented[256];
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--load-addr ADDR] [--entry ADDR]... [--name NAME] IMAGE "
+         "OUTPUT.c\n",
+         name);
+}
+
+static bool is(const Instr *in, const char *mnemonic) {
+  return memcmp(in->info->mnemonic, mnemonic, 3) == 0;
+}
+
+// Decode the instruction at `addr`
+// Returns false if it is unknown or not entirely inside the image
+static bool decode(const u16 addr, Instr *in) {
+  const OpcodeInfo *info = &opcode_table[mem[addr]];
+  if (info->length == 0 || addr < image_lo ||
+      (u32)addr + info->length > image_hi) {
+    return false;
+  }
+  *in = (Instr){.addr = addr, .opcode = mem[addr], .info = info};
+  in->next = (u16)(addr + info->length);
+  if (info->length == 2) {
+    in->operand = mem[addr + 1];
+  } else if (info->length == 3) {
+    in->operand = (u16)(mem[addr + 1] | mem[addr + 2] << 8);
+  }
+  if (info->mode == ADDR_REL) {
+    in->operand = (u16)(in->next + (i8)in->operand);
+  }
+  return true;
+}
+
+// Whether a compiled block can run `in`
+static bool compiled(const Instr *in) {
+  return documented[in->opcode] && !is(in, "BRK");
+}
+
+// Whether `in` ends a block: it transfers control, or it may unmask an
+// interrupt, which must be taken before the next instruction
+static bool ends_block(const Instr *in) {
+  return in->info->mode == ADDR_REL || is(in, "JMP") || is(in, "JSR") ||
+         is(in, "RTS") || is(in, "RTI") || is(in, "BRK") || is(in, "CLI") ||
+         is(in, "PLP");
+}
+
+// Find every instruction reachable from `entry` and mark where blocks start
+static void trace(const u16 entry) {
+  static u16 stack[MEM_SIZE];
+  usize n = 0;
+  leader[entry] = true;
+  stack[n++] = entry;
+  while (n > 0) {
+    u16 addr = stack[--n];
+    Instr in;
+    while (!seen[addr] && decode(addr, &in)) {
+      seen[addr] = true;
+      if (in.info->mode == ADDR_REL ||
+          (is(&in, "JMP") && in.info->mode == ADDR_ABS) || is(&in, "JSR")) {
+        leader[in.operand] = true;
+        stack[n++] = in.operand;
+      }
+      if (is(&in, "BRK")) {
+        // RTI returns past the padding byte
+        leader[(u16)(in.addr + 2)] = true;
+        stack[n++] = (u16)(in.addr + 2);
+      }
+      if (is(&in, "JMP") || is(&in, "RTS") || is(&in, "RTI") ||
+          is(&in, "BRK") || is(&in, "BRA")) {
+        break;
+      }
+      if (ends_block(&in) || !compiled(&in)) {
+        leader[in.next] = true;
+      }
+      addr = in.next;
+    }
+  }
+}
+
+// The addresses a store of `in` may write, as an inclusive range
+static void store_range(const Instr *in, u32 *lo, u32 *hi) {
+  switch (in->info->mode) {
+  case ADDR_ZP:
+  case ADDR_ABS:
+    *lo = *hi = in->operand;
+    return;
+  case ADDR_ZPX:
+  case ADDR_ZPY:
+    *lo = 0x00;
+    *hi = 0xFF;
+    return;
+  case ADDR_ABSX:
+  case ADDR_ABSY:
+    *lo = in->operand;
+    *hi = (u32)in->operand + 0xFF;
+    if (*hi > 0xFFFF) {
+      *lo = 0;
+      *hi = 0xFFFF;
+    }
+    return;
+  case ADDR_IMPL: // pushes
+    *lo = 0x0100;
+    *hi = 0x01FF;
+    return;
+  default:
+    *lo = 0;
+    *hi = 0xFFFF;
+    return;
+  }
+}
+
+static bool writes_memory(const Instr *in) {
+  return is(in, "STA") || is(in, "STX") || is(in, "STY") || is(in, "PHA") ||
+         is(in, "PHP") ||
+         ((is(in, "ASL") || is(in, "LSR") || is(in, "ROL") || is(in, "ROR") ||
+           is(in, "INC") || is(in, "DEC")) &&
+          in->info->mode != ADDR_A);
+}
+
+// Declare `addr`, the effective address of `in`, adding the page cross cycle
+// if `penalty`
+static void emit_addr(FILE *out, const Instr *in, const bool penalty) {
+  const u16 x = in->operand;
+  switch (in->info->mode) {
+  case ADDR_ZP:
+  case ADDR_ABS:
+    fprintf(out, "    const u16 addr = 0x%04X;\n", x);
+    break;
+  case ADDR_ZPX:
+    fprintf(out, "    const u16 addr = (u8)(0x%02X + cpu->x);\n", x);
+    break;
+  case ADDR_ZPY:
+    fprintf(out, "    const u16 addr = (u8)(0x%02X + cpu->y);\n", x);
+    break;
+  case ADDR_ABSX:
+  case ADDR_ABSY:
+    fprintf(out, "    const u16 addr = (u16)(0x%04X + cpu->%c);\n", x,
+            (in->info->mode == ADDR_ABSX) ? 'x' : 'y');
+    if (penalty) {
+      fprintf(out, "    emu->cycles += aot_cross(0x%04X, addr);\n", x);
+    }
+    break;
+  case ADDR_INDX:
+    fprintf(out,
+            "    const u16 addr = aot_zp_word(emu, (u8)(0x%02X + cpu->x));\n",
+            x);
+    break;
+  case ADDR_INDY:
+    fprintf(out, "    const u16 base = aot_zp_word(emu, 0x%02X);\n", x);
+    fprintf(out, "    const u16 addr = (u16)(base + cpu->y);\n");
+    if (penalty) {
+      fprintf(out, "    emu->cycles += aot_cross(base, addr);\n");
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+// The operand of a load, after `emit_addr`
+static const char *load_operand(const Instr *in, char buf[8]) {
+  if (in->info->mode == ADDR_IM) {
+    snprintf(buf, 8, "0x%02X", (u8)in->operand);
+    return buf;
+  }
+  return "emu->mem[addr]";
+}
+
+// Emit the operation of a load, e.g. `cpu->a = m; aot_nz(...)`
+static void emit_load(FILE *out, const Instr *in, const char *m) {
+  const char *reg = is(in, "LDA") ? "a" : is(in, "LDX") ? "x" : "y";
+  if (is(in, "LDA") || is(in, "LDX") || is(in, "LDY")) {
+    fprintf(out, "    cpu->%s = %s;\n    aot_nz(emu, cpu->%s);\n", reg, m, reg);
+  } else if (is(in, "AND") || is(in, "ORA") || is(in, "EOR")) {
+    const char op = is(in, "AND") ? '&' : is(in, "ORA") ? '|' : '^';
+    fprintf(out, "    cpu->a %c= %s;\n    aot_nz(emu, cpu->a);\n", op, m);
+  } else if (is(in, "ADC")) {
+    fprintf(out, "    aot_adc(emu, %s);\n", m);
+  } else if (is(in, "SBC")) {
+    fprintf(out, "    aot_sbc(emu, %s);\n", m);
+  } else if (is(in, "BIT")) {
+    fprintf(out, "    aot_bit(emu, %s);\n", m);
+  } else {
+    const char *lhs = is(in, "CMP") ? "a" : is(in, "CPX") ? "x" : "y";
+    fprintf(out, "    aot_cmp(emu, cpu->%s, %s);\n", lhs, m);
+  }
+}
+
+static bool is_load(const Instr *in) {
+  return is(in, "LDA") || is(in, "LDX") || is(in, "LDY") || is(in, "AND") ||
+         is(in, "ORA") || is(in, "EOR") || is(in, "ADC") || is(in, "SBC") ||
+         is(in, "BIT") || is(in, "CMP") || is(in, "CPX") || is(in, "CPY");
+}
+
+// Emit the condition of a branch
+static const char *branch_condition(const Instr *in) {
+  static const struct {
+    const char *mnemonic;
+    const char *condition;
+  } branches[] = {
+      {"BCC", "!cpu->sr.bits.c"}, {"BCS", "cpu->sr.bits.c"},
+      {"BNE", "!cpu->sr.bits.z"}, {"BEQ", "cpu->sr.bits.z"},
+      {"BPL", "!cpu->sr.bits.n"}, {"BMI", "cpu->sr.bits.n"},
+      {"BVC", "!cpu->sr.bits.v"}, {"BVS", "cpu->sr.bits.v"},
+  };
+  for (usize i = 0; i < sizeof(branches) / sizeof(branches[0]); i++) {
+    if (is(in, branches[i].mnemonic)) {
+      return branches[i].condition;
+    }
+  }
+  return "false";
+}
+
+// Emit the instructions that are neither loads nor stores
+static void emit_other(FILE *out, const Instr *in) {
+  static const struct {
+    const char *mnemonic;
+    const char *code;
+  } simple[] = {
+      {"INX", "cpu->x++;\n    aot_nz(emu, cpu->x);"},
+      {"INY", "cpu->y++;\n    aot_nz(emu, cpu->y);"},
+      {"DEX", "cpu->x--;\n    aot_nz(emu, cpu->x);"},
+      {"DEY", "cpu->y--;\n    aot_nz(emu, cpu->y);"},
+      {"TAX", "cpu->x = cpu->a;\n    aot_nz(emu, cpu->x);"},
+      {"TAY", "cpu->y = cpu->a;\n    aot_nz(emu, cpu->y);"},
+      {"TXA", "cpu->a = cpu->x;\n    aot_nz(emu, cpu->a);"},
+      {"TYA", "cpu->a = cpu->y;\n    aot_nz(emu, cpu->a);"},
+      {"TSX", "cpu->x = cpu->sp;\n    aot_nz(emu, cpu->x);"},
+      {"TXS", "cpu->sp = cpu->x;"},
+      {"CLC", "cpu->sr.bits.c = false;"},
+      {"SEC", "cpu->sr.bits.c = true;"},
+      {"CLD", "cpu->sr.bits.d = false;"},
+      {"SED", "cpu->sr.bits.d = true;"},
+      {"CLI", "cpu->sr.bits.i = false;"},
+      {"SEI", "cpu->sr.bits.i = true;"},
+      {"CLV", "cpu->sr.bits.v = false;"},
+      {"PHA", "aot_push(emu, cpu->a);"},
+      {"PHP", "aot_push(emu, cpu->sr.byte | SR_B | SR_UNUSED);"},
+      {"PLA", "cpu->a = aot_pull(emu);\n    aot_nz(emu, cpu->a);"},
+      {"PLP", "aot_pull_sr(emu);"},
+      {"NOP", ""},
+  };
+  for (usize i = 0; i < sizeof(simple) / sizeof(simple[0]); i++) {
+    if (is(in, simple[i].mnemonic)) {
+      if (simple[i].code[0] != '\0') {
+        fprintf(out, "    %s\n", simple[i].code);
+      }
+      return;
+    }
+  }
+}
+
+// Emit the instruction that ends a block, which sets PC
+// Returns false if `in` does not end a block
+static bool emit_end(FILE *out, const Instr *in) {
+  if (in->info->mode == ADDR_REL) {
+    fprintf(out, "    aot_branch(emu, %s, 0x%04X, 0x%04X);\n",
+            branch_condition(in), in->next, in->operand);
+  } else if (is(in, "JMP") && in->info->mode == ADDR_ABS) {
+    fprintf(out, "    cpu->pc = 0x%04X;\n", in->operand);
+  } else if (is(in, "JMP")) {
+#ifdef EMU_CPU_65C02
+    const u16 hi = (u16)(in->operand + 1);
+#else
+    // the NMOS 6502 does not carry into the high byte of the pointer
+    const u16 hi = (u16)((in->operand & 0xFF00) | (u8)(in->operand + 1));
+#endif
+    fprintf(out,
+            "    cpu->pc = (u16)(emu->mem[0x%04X] | emu->mem[0x%04X] << 8);\n",
+            in->operand, hi);
+  } else if (is(in, "JSR")) {
+    // the high byte of the target is read after the pushes, like the 6502
+    const u16 ret = (u16)(in->addr + 2);
+    fprintf(out, "    aot_push(emu, 0x%02X);\n    aot_push(emu, 0x%02X);\n",
+            ret >> 8, ret & 0xFF);
+    fprintf(out, "    cpu->pc = (u16)(0x%02X | emu->mem[0x%04X] << 8);\n",
+            in->operand & 0xFF, ret);
+  } else if (is(in, "RTS")) {
+    fprintf(out, "    const u8 lo = aot_pull(emu);\n"
+                 "    cpu->pc = (u16)((lo | aot_pull(emu) << 8) + 1);\n");
+  } else if (is(in, "RTI")) {
+    fprintf(out, "    aot_pull_sr(emu);\n"
+                 "    const u8 lo = aot_pull(emu);\n"
+                 "    cpu->pc = (u16)(lo | aot_pull(emu) << 8);\n");
+  } else if (is(in, "CLI") || is(in, "PLP")) {
+    emit_other(out, in);
+    fprintf(out, "    cpu->pc = 0x%04X;\n", in->next);
+  } else {
+    return false;
+  }
+  fprintf(out, "    return true;\n");
+  return true;
+}
+
+// Emit one instruction of a block ending at `end`
+// Returns false if the block must end after it because it may have
+// overwritten the instructions that follow
+static bool emit_instr(FILE *out, const Instr *in, const u16 end) {
+  char text[DISASM_MAX_LEN];
+  disasm_instr(mem, in->addr, text);
+  fprintf(out, "  // $%04X %s\n  {\n", in->addr, text);
+  fprintf(out, "    emu->cycles += %u;\n    emu->n_instructions++;\n",
+          in->info->cycles);
+  if (emit_end(out, in)) {
+    fprintf(out, "  }\n");
+    return false;
+  }
+
+  char buf[8];
+  const bool rmw = (is(in, "ASL") || is(in, "LSR") || is(in, "ROL") ||
+                    is(in, "ROR") || is(in, "INC") || is(in, "DEC"));
+  if (is_load(in)) {
+    emit_addr(out, in, true);
+    emit_load(out, in, load_operand(in, buf));
+  } else if (is(in, "STA") || is(in, "STX") || is(in, "STY")) {
+    emit_addr(out, in, false);
+    fprintf(out, "    emu->mem[addr] = cpu->%c;\n", in->info->mnemonic[2] | 0x20);
+  } else if (rmw && in->info->mode == ADDR_A) {
+    fprintf(out, "    cpu->a = aot_%c%c%c(emu, cpu->a);\n",
+            in->info->mnemonic[0] | 0x20, in->info->mnemonic[1] | 0x20,
+            in->info->mnemonic[2] | 0x20);
+  } else if (rmw) {
+#ifdef EMU_CPU_65C02
+    // shifts on abs,X only pay for a page cross, INC and DEC always do
+    emit_addr(out, in, !is(in, "INC") && !is(in, "DEC"));
+#else
+    emit_addr(out, in, false);
+#endif
+    fprintf(out, "    emu->mem[addr] = aot_%c%c%c(emu, emu->mem[addr]);\n",
+            in->info->mnemonic[0] | 0x20, in->info->mnemonic[1] | 0x20,
+            in->info->mnemonic[2] | 0x20);
+  } else {
+    emit_other(out, in);
+  }
+
+  // a store over the instructions still to run in this block ends it there
+  bool more = true;
+  if (writes_memory(in) && in->next < end) {
+    u32 lo;
+    u32 hi;
+    store_range(in, &lo, &hi);
+    if (lo == hi && lo >= in->next && lo < end) {
+      fprintf(out, "    cpu->pc = 0x%04X;\n    return true;\n", in->next);
+      more = false;
+    } else if (hi >= in->next && lo < end) {
+      if (in->info->mode == ADDR_IMPL) {
+        // a push, which has no `addr`
+        fprintf(out, "    cpu->pc = 0x%04X;\n    return true;\n", in->next);
+        more = false;
+      } else {
+        fprintf(out,
+                "    if ((u16)(addr - 0x%04X) < %u) {\n"
+                "      cpu->pc = 0x%04X;\n      return true;\n    }\n",
+                in->next, end - in->next, in->next);
+      }
+    }
+  }
+  fprintf(out, "  }\n");
+  return more;
+}
+
+// Emit the block starting at `start`
+static void emit_block(FILE *out, const u16 start, usize *n_instrs) {
+  static Instr instrs[MEM_SIZE];
+  usize n = 0;
+  u16 addr = start;
+  Instr in;
+  // up to the next leader or an instruction that is not compiled
+  while ((n == 0 || !leader[addr]) && decode(addr, &in) && compiled(&in)) {
+    instrs[n++] = in;
+    addr = in.next;
+    if (ends_block(&in) || addr < start) {
+      break;
+    }
+  }
+  const u16 end = instrs[n - 1].next;
+  *n_instrs += n;
+
+  fprintf(out, "\n// $%04X-$%04X\n", start, (u16)(end - 1));
+  fprintf(out, "static bool block_%04X(Emulator *emu) {\n", start);
+  fprintf(out, "  static const u8 code[] = {");
+  for (u16 a = start; a != end; a++) {
+    fprintf(out, "%s0x%02X", (a == start) ? "" : ", ", mem[a]);
+  }
+  fprintf(out, "};\n");
+  fprintf(out, "  if (memcmp(&emu->mem[0x%04X], code, sizeof(code)) != 0) {\n"
+               "    return false;\n  }\n",
+          start);
+  fprintf(out, "  CPU *cpu = &emu->cpu;\n");
+  for (usize i = 0; i < n; i++) {
+    if (!emit_instr(out, &instrs[i], end)) {
+      fprintf(out, "}\n");
+      return;
+    }
+  }
+  fprintf(out, "  cpu->pc = 0x%04X;\n  return true;\n}\n", end);
+}
+
+// Whether a block is compiled at `addr`
+static bool has_block(const u16 addr) {
+  Instr in;
+  return leader[addr] && seen[addr] && decode(addr, &in) && compiled(&in);
+}
+
+static bool write_program(const char *path, const char *source,
+                          const char *name, usize *n_blocks,
+                          usize *n_instrs) {
+  FILE *out = fopen(path, "w");
+  if (out == NULL) {
+    printf("cannot create %s\n", path);
+    return false;
+  }
+  fprintf(out, "// Generated by emu6502-recomp from %s, do not edit\n\n",
+          source);
+  fprintf(out, "#include \"aot.h\"\n\n");
+#if defined(EMU_CPU_65C02)
+  fprintf(out, "#ifndef EMU_CPU_65C02\n");
+#elif defined(EMU_CPU_6502X)
+  fprintf(out, "#ifndef EMU_CPU_6502X\n");
+#else
+  fprintf(out, "#if defined(EMU_CPU_6502X) || defined(EMU_CPU_65C02)\n");
+#endif
+  fprintf(out, "#error \"recompiled for the %s\"\n#endif\n", CPU_NAME);
+
+  for (u32 addr = 0; addr < MEM_SIZE; addr++) {
+    if (has_block((u16)addr)) {
+      emit_block(out, (u16)addr, n_instrs);
+      (*n_blocks)++;
+    }
+  }
+
+  fprintf(out, "\nstatic AotBlock lookup(const u16 pc) {\n  switch (pc) {\n");
+  for (u32 addr = 0; addr < MEM_SIZE; addr++) {
+    if (has_block((u16)addr)) {
+      fprintf(out, "  case 0x%04X:\n    return block_%04X;\n", addr, addr);
+    }
+  }
+  fprintf(out, "  default:\n    return NULL;\n  }\n}\n");
+  fprintf(out, "\nconst AotProgram %s = {\"%s\", lookup};\n", name, CPU_NAME);
+  if (fclose(out) != 0) {
+    printf("cannot write %s\n", path);
+    return false;
+  }
+  return true;
+}
+
+// Add the address in `vector` as an entry point if the image contains both
+static void add_vector(const u16 vector, u16 *entries, usize *n_entries) {
+  if (vector >= image_lo && vector + 2u <= image_hi) {
+    const u16 addr = (u16)(mem[vector] | mem[vector + 1] << 8);
+    if (addr >= image_lo && addr < image_hi && *n_entries < MAX_ENTRIES) {
+      entries[(*n_entries)++] = addr;
+    }
+  }
+}
+
+i32 main(i32 argc, char *argv[]) {
+  const char *paths[2] = {NULL, NULL};
+  usize n_paths = 0;
+  i32 load_addr = -1;
+  const char *name = "aot_program";
+  u16 entries[MAX_ENTRIES];
+  usize n_entries = 0;
+
+  for (i32 i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--load-addr") == 0 && i + 1 < argc) {
+      u16 addr;
+      if (!breakpoint_parse_addr(argv[++i], &addr)) {
+        printf("invalid address: %s\n", argv[i]);
+        return 2;
+      }
+      load_addr = addr;
+    } else if (strcmp(argv[i], "--entry") == 0 && i + 1 < argc) {
+      if (n_entries == MAX_ENTRIES ||
+          !breakpoint_parse_addr(argv[++i], &entries[n_entries])) {
+        printf("invalid entry point: %s\n", argv[i]);
+        return 2;
+      }
+      n_entries++;
+    } else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc) {
+      name = argv[++i];
+    } else if (n_paths < 2 && argv[i][0] != '-') {
+      paths[n_paths++] = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  if (n_paths != 2) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  static Emulator emu;
+  emu_init(&emu, false);
+  const char *ext = strrchr(paths[0], '.');
+  if (ext != NULL && strcmp(ext, ".s") == 0) {
+    static Assembler assembler;
+    asm_init(&assembler);
+    if (!asm_assemble_file(&assembler, paths[0], emu.mem)) {
+      return 2;
+    }
+    image_lo = assembler.lo;
+    image_hi = assembler.hi;
+    u16 addr;
+    if (asm_symbol(&assembler, "start", &addr) && n_entries < MAX_ENTRIES) {
+      entries[n_entries++] = addr;
+    }
+  } else {
+    LoadedImage loaded;
+    if (!loader_load(&emu, paths[0], loader_format_from_path(paths[0]),
+                     load_addr, &loaded)) {
+      printf("%s\n", loaded.error);
+      return 2;
+    }
+    image_lo = loaded.lo;
+    image_hi = loaded.hi;
+    if (loaded.entry >= 0 && n_entries < MAX_ENTRIES) {
+      entries[n_entries++] = (u16)loaded.entry;
+    }
+  }
+  memcpy(mem, emu.mem, MEM_SIZE);
+  add_vector(RESET_VECTOR, entries, &n_entries);
+  add_vector(NMI_VECTOR, entries, &n_entries);
+  add_vector(IRQ_VECTOR, entries, &n_entries);
+  if (n_entries == 0) {
+    printf("%s: no entry points, give them with --entry\n", paths[0]);
+    return 2;
+  }
+
+#define DOCUMENTED(NAME, OPCODE, MNEMONIC, MODE, CYCLES) documented[OPCODE] = true;
+  OPCODE_LIST(DOCUMENTED)
+#undef DOCUMENTED
+  for (usize i = 0; i < n_entries; i++) {
+    trace(entries[i]);
+  }
+  usize n_blocks = 0;
+  usize n_instrs = 0;
+  if (!write_program(paths[1], paths[0], name, &n_blocks, &n_instrs)) {
+    return 2;
+  }
+  printf("%s: %zu blocks, %zu instructions from %zu entry points\n", paths[1],
+         n_blocks, n_instrs, n_entries);
+  return 0;
+}
@@ -0,0 +1,298 @@
+#include "record.h"
+#include "bank.h"
+
+// bit of the kind byte set for events noted while halted
+#define RECORD_HALTED 0x80
+
+// the machine state, everything `emu_cold_boot` copies
+#define STATE_SIZE offsetof(Emulator, log_buf)
+
+#define HEADER_SIZE 24
+
+// longest encoded event: kind, a 10 byte varint and a hash
+#define MAX_EVENT_SIZE 24
+
+static void put_u32(u8 *p, const u32 x) {
+  for (usize i = 0; i < 4; i++) {
+    p[i] = (u8)(x >> (8 * i));
+  }
+}
+
+static void encode_header(u8 header[HEADER_SIZE]) {
+  memset(header, 0, HEADER_SIZE);
+  memcpy(header, RECORD_MAGIC, 8);
+  put_u32(header + 8, RECORD_VERSION);
+  put_u32(header + 12, (u32)STATE_SIZE);
+  memcpy(header + 16, CPU_NAME, strlen(CPU_NAME));
+}
+
+// FNV-1a
+static u64 hash_bytes(u64 hash, const void *data, const usize len) {
+  const u8 *p = data;
+  for (usize i = 0; i < len; i++) {
+    hash = (hash ^ p[i]) * 0x100000001B3;
+  }
+  return hash;
+}
+
+u64 record_state_hash(const Emulator *emu) {
+  // field by field, padding bytes are not state
+  const CPU *cpu = &emu->cpu;
+  const u8 regs[] = {(u8)cpu->pc, (u8)(cpu->pc >> 8), cpu->sp, cpu->a,
+                     cpu->x,      cpu->y,             cpu->sr.byte,
+                     emu->interrupts, emu->is_running};
+  u64 hash = 0xCBF29CE484222325;
+  for (u16 page = 0; page < MEM_SIZE / 256; page++) {
+    u8 bytes[256];
+    for (u16 i = 0; i < 256; i++) {
+      bytes[i] = emu_read_mem_byte(emu, (u16)(page << 8 | i));
+    }
+    hash = hash_bytes(hash, bytes, sizeof(bytes));
+  }
+  hash = hash_bytes(hash, regs, sizeof(regs));
+  return hash_bytes(hash, &emu->cycles, sizeof(emu->cycles));
+}
+
+bool recorder_open(Recorder *rec, const char *path, const Emulator *emu) {
+  rec->file = NULL;
+  rec->last_cycle = emu->cycles;
+  rec->n_events = 0;
+  rec->buf_len = 0;
+  rec->failed = false;
+#ifdef EMU_BANKING
+  if (emu->banks != NULL) {
+    return false;
+  }
+#endif
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  u8 header[HEADER_SIZE];
+  encode_header(header);
+  if (fwrite(header, 1, HEADER_SIZE, file) != HEADER_SIZE ||
+      fwrite(emu, 1, STATE_SIZE, file) != STATE_SIZE) {
+    fclose(file);
+    return false;
+  }
+  rec->file = file;
+  return true;
+}
+
+static void put_varint(u8 *buf, usize *len, u64 x) {
+  while (x >= 0x80) {
+    buf[(*len)++] = (u8)(x | 0x80);
+    x >>= 7;
+  }
+  buf[(*len)++] = (u8)x;
+}
+
+// Write out the buffered events, remembering in `failed` if that fails
+static void recorder_flush(Recorder *rec) {
+  if (rec->buf_len != 0 &&
+      fwrite(rec->buf, 1, rec->buf_len, rec->file) != rec->buf_len) {
+    rec->failed = true;
+  }
+  rec->buf_len = 0;
+}
+
+void recorder_note(Recorder *rec, const RecordEvent *event) {
+  if (rec->buf_len + MAX_EVENT_SIZE > RECORD_BUF_SIZE) {
+    recorder_flush(rec);
+  }
+  u8 *buf = rec->buf;
+  usize len = rec->buf_len;
+  buf[len++] = (u8)event->kind | (event->halted ? RECORD_HALTED : 0);
+  put_varint(buf, &len, event->cycle - rec->last_cycle);
+  switch (event->kind) {
+  case RECORD_WRITE:
+    buf[len++] = (u8)event->addr;
+    buf[len++] = (u8)(event->addr >> 8);
+    buf[len++] = event->value;
+    break;
+  case RECORD_CPU:
+    buf[len++] = (u8)event->cpu.pc;
+    buf[len++] = (u8)(event->cpu.pc >> 8);
+    buf[len++] = event->cpu.sp;
+    buf[len++] = event->cpu.a;
+    buf[len++] = event->cpu.x;
+    buf[len++] = event->cpu.y;
+    buf[len++] = event->cpu.sr.byte;
+    break;
+  case RECORD_END:
+    for (usize i = 0; i < 8; i++) {
+      buf[len++] = (u8)(event->hash >> (8 * i));
+    }
+    break;
+  default:
+    break;
+  }
+  rec->buf_len = len;
+  rec->last_cycle = event->cycle;
+  rec->n_events++;
+}
+
+bool recorder_close(Recorder *rec, const Emulator *emu) {
+  if (rec->file == NULL) {
+    return false;
+  }
+  const RecordEvent end = {.kind = RECORD_END,
+                           .cycle = emu->cycles,
+                           .halted = !emu->is_running,
+                           .hash = record_state_hash(emu)};
+  recorder_note(rec, &end);
+  recorder_flush(rec);
+  const bool closed = fclose(rec->file) == 0;
+  rec->file = NULL;
+  return !rec->failed && closed;
+}
+
+static bool get_varint(FILE *file, u64 *x) {
+  *x = 0;
+  for (u32 shift = 0; shift < 64; shift += 7) {
+    const i32 c = fgetc(file);
+    if (c == EOF) {
+      return false;
+    }
+    *x |= (u64)(c & 0x7F) << shift;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Read the next event into `rep->next`
+static void read_event(Replayer *rep) {
+  u8 operands[8];
+  RecordEvent *e = &rep->next;
+  u64 delta;
+  const i32 byte = fgetc(rep->file);
+  rep->has_next = false;
+  const i32 kind = byte & ~RECORD_HALTED;
+  if (byte == EOF || kind > RECORD_END || !get_varint(rep->file, &delta)) {
+    return;
+  }
+  *e = (RecordEvent){.kind = (RecordKind)kind,
+                     .cycle = rep->last_cycle + delta,
+                     .halted = (byte & RECORD_HALTED) != 0};
+  const usize n = (kind == RECORD_WRITE) ? 3
+                  : (kind == RECORD_CPU) ? 7
+                  : (kind == RECORD_END) ? 8
+                                         : 0;
+  if (fread(operands, 1, n, rep->file) != n) {
+    return;
+  }
+  if (kind == RECORD_WRITE) {
+    e->addr = (u16)(operands[0] | operands[1] << 8);
+    e->value = operands[2];
+  } else if (kind == RECORD_CPU) {
+    e->cpu = (CPU){.pc = (u16)(operands[0] | operands[1] << 8),
+                   .sp = operands[2],
+                   .a = operands[3],
+                   .x = operands[4],
+                   .y = operands[5]};
+    e->cpu.sr.byte = operands[6];
+  } else if (kind == RECORD_END) {
+    for (usize i = 0; i < 8; i++) {
+      e->hash |= (u64)operands[i] << (8 * i);
+    }
+  }
+  rep->last_cycle = e->cycle;
+  rep->has_next = true;
+}
+
+bool replayer_open(Replayer *rep, const char *path, Emulator *emu) {
+  *rep = (Replayer){0};
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return false;
+  }
+  u8 header[HEADER_SIZE];
+  u8 expected[HEADER_SIZE];
+  encode_header(expected);
+  // host settings, chosen for what is attached now rather than when recording
+  const bool fusion = emu->fusion;
+  const bool debug_output = emu->debug_output;
+  const bool ok = fread(header, 1, HEADER_SIZE, file) == HEADER_SIZE &&
+                  memcmp(header, expected, HEADER_SIZE) == 0 &&
+                  fread(emu, 1, STATE_SIZE, file) == STATE_SIZE;
+  // fused runs stop on a subset of the boundaries unfused runs stop on, so
+  // only a run recorded with fusion replays exactly with it
+  emu->fusion = fusion && emu->fusion;
+  emu->debug_output = debug_output;
+  if (!ok) {
+    fclose(file);
+    return false;
+  }
+#ifdef EMU_BANKING
+  bank_refresh(emu);
+#endif
+  rep->file = file;
+  rep->last_cycle = emu->cycles;
+  read_event(rep);
+  return true;
+}
+
+void replayer_close(Replayer *rep) {
+  if (rep->file != NULL) {
+    fclose(rep->file);
+    rep->file = NULL;
+  }
+}
+
+// Apply an event through the same function that recorded it
+static void apply(Replayer *rep, Emulator *emu, const RecordEvent *e) {
+  switch (e->kind) {
+  case RECORD_NMI:
+    emu_nmi(emu);
+    break;
+  case RECORD_IRQ_ON:
+  case RECORD_IRQ_OFF:
+    emu_set_irq(emu, e->kind == RECORD_IRQ_ON);
+    break;
+  case RECORD_RESET:
+    emu_reset(emu);
+    break;
+  case RECORD_WRITE:
+    emu_write_mem_byte(emu, e->addr, e->value);
+    break;
+  case RECORD_CPU:
+    emu_set_cpu(emu, &e->cpu);
+    break;
+  case RECORD_END:
+    rep->finished = true;
+    rep->matched = e->hash == record_state_hash(emu);
+    break;
+  }
+}
+
+EmuStop replay_run(Replayer *rep, Emulator *emu, const u64 max_cycles) {
+  const u64 end = emu->cycles + max_cycles;
+  while (!rep->finished) {
+    while (rep->has_next && rep->next.cycle <= emu->cycles) {
+      // the halt it came after is still to run, it takes no cycles
+      if (rep->next.halted && emu->is_running &&
+          rep->next.cycle == emu->cycles) {
+        emu_tick(emu);
+        continue;
+      }
+      const RecordEvent e = rep->next;
+      read_event(rep);
+      apply(rep, emu, &e);
+    }
+    if (rep->finished || emu->cycles >= end) {
+      break;
+    }
+    const u64 until =
+        (rep->has_next && rep->next.cycle < end) ? rep->next.cycle : end;
+    const EmuStop stop = emu_run(emu, until - emu->cycles);
+    // a halted emulator may still be reset by the next event
+    if (stop != EMU_STOP_LIMIT &&
+        !(stop == EMU_STOP_HALT && rep->has_next &&
+          rep->next.cycle <= emu->cycles)) {
+      return stop;
+    }
+  }
+  return EMU_STOP_LIMIT;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Deterministic record and replay of what the host does to an emulator.
+//
+// The emulator itself is deterministic, so a run is reproduced by its starting
+// state and every input from outside `emu_tick`: `emu_nmi`, `emu_set_irq`,
+// `emu_reset`, `emu_set_cpu` and `emu_write_mem_byte` (which is how host input
+// should be put into memory, writing `Emulator.mem` directly is not seen).
+// With a `Recorder` attached each of them is logged with the cycle count it
+// happened at. Nothing is logged per instruction, so a recorder can stay
+// attached in production.
+//
+// A recording is the machine state the recorder was opened with followed by
+// the events, each a kind byte, the cycles since the previous event as a
+// LEB128 varint and its operands, so most events take two to five bytes. It
+// ends with the final cycle count and a hash of the final machine state, which
+// a replay checks to confirm it reproduced the run bit for bit.
+//
+// An instruction that halts the emulator takes no cycles, so the kind byte of
+// events noted while halted has bit 7 set, and a replay runs up to the halt
+// before applying them rather than just up to their cycle.
+//
+// A replay stops at the first instruction boundary at or after the cycle of
+// each event, which is where it was recorded unless the replay fuses
+// instructions the recorded run did not, so a replay only keeps fusion on if
+// the recorded run had it on. Recording runs stepped through `aot_step`
+// replay exactly only with fusion off.
+
+#define RECORD_MAGIC "E65RECRD"
+#define RECORD_VERSION 2
+
+// Bytes buffered before they are written to the file
+#define RECORD_BUF_SIZE 4096
+
+typedef enum RecordKind {
+  RECORD_NMI,
+  RECORD_IRQ_ON,
+  RECORD_IRQ_OFF,
+  RECORD_RESET,
+  RECORD_WRITE, // `addr` and `value`
+  RECORD_CPU,   // `cpu`
+  RECORD_END,   // `hash` of the final machine state
+} RecordKind;
+
+typedef struct RecordEvent {
+  RecordKind kind;
+  u64 cycle;
+  bool halted; // noted after the emulator halted
+  u16 addr;
+  u8 value;
+  CPU cpu;
+  u64 hash;
+} RecordEvent;
+
+typedef struct Recorder {
+  FILE *file;
+  u64 last_cycle;
+  u64 n_events;
+  bool failed; // a write to the file failed, the recording is incomplete
+  usize buf_len;
+  u8 buf[RECORD_BUF_SIZE];
+} Recorder;
+
+typedef struct Replayer {
+  FILE *file;
+  u64 last_cycle;
+  RecordEvent next;
+  bool has_next; // false at the end of the recording or on a read error
+  bool finished; // the END event was reached
+  bool matched;  // the final state had the recorded hash, once `finished`
+} Replayer;
+
+// Start recording `emu` from its current state to the file at `path`
+// Returns false if the file cannot be written, or with `EMU_BANKING` if bank
+// memory is attached (it is not part of the recording)
+bool recorder_open(Recorder *rec, const char *path, const Emulator *emu);
+
+// Called by the emulator for each input from the host
+void recorder_note(Recorder *rec, const RecordEvent *event);
+
+// Write the END event for the current state of `emu` and close the file
+// Returns false if anything could not be written
+bool recorder_close(Recorder *rec, const Emulator *emu);
+
+// Hash of the machine state of `emu`: memory, registers, cycles, interrupts
+// and whether it is running
+u64 record_state_hash(const Emulator *emu);
+
+// Open a recording and put `emu` in the state it starts from, keeping its
+// `debug_output`, and `fusion` only if the recorded run had it too
+// Returns false if it cannot be read or was made by another build
+bool replayer_open(Replayer *rep, const char *path, Emulator *emu);
+
+void replayer_close(Replayer *rep);
+
+// `emu_run`, applying the recorded events on the cycles they happened at
+// Stops early, as `EMU_STOP_LIMIT`, once the recording is `finished`
+EmuStop replay_run(Replayer *rep, Emulator *emu, u64 max_cycles);
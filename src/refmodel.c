@@ -0,0 +1,637 @@
+#include "refmodel.h"
+
+#include "opcode.h"
+
+// status bits
+#define P_C 0x01
+#define P_Z 0x02
+#define P_I 0x04
+#define P_D 0x08
+#define P_V 0x40
+#define P_N 0x80
+
+// a mnemonic as one integer, so operations can be switched on
+#define MNEMONIC(A, B, C) ((A) << 16 | (B) << 8 | (C))
+
+void ref_init(RefCpu *ref, const CPU *cpu, u8 *mem) {
+  *ref = (RefCpu){
+      .pc = cpu->pc,
+      .sp = cpu->sp,
+      .a = cpu->a,
+      .x = cpu->x,
+      .y = cpu->y,
+      .p = (u8)((cpu->sr.byte & ~SR_B) | SR_UNUSED),
+      .mem = mem,
+  };
+}
+
+static void record(RefCpu *ref, const u16 addr, const u8 value,
+                   const bool write) {
+  if (ref->n_accesses < REF_MAX_ACCESSES) {
+    ref->accesses[ref->n_accesses++] = (RefAccess){addr, value, write};
+  }
+}
+
+static u8 read(RefCpu *ref, const u16 addr) {
+  record(ref, addr, ref->mem[addr], false);
+  return ref->mem[addr];
+}
+
+static void write(RefCpu *ref, const u16 addr, const u8 value) {
+  record(ref, addr, value, true);
+  ref->mem[addr] = value;
+}
+
+static u8 fetch(RefCpu *ref) { return read(ref, ref->pc++); }
+
+static u16 fetch_word(RefCpu *ref) {
+  const u8 lo = fetch(ref);
+  return (u16)(lo | fetch(ref) << 8);
+}
+
+static void push(RefCpu *ref, const u8 value) {
+  write(ref, 0x0100 | ref->sp, value);
+  ref->sp--;
+}
+
+static u8 pull(RefCpu *ref) {
+  ref->sp++;
+  return read(ref, 0x0100 | ref->sp);
+}
+
+static void set_flag(RefCpu *ref, const u8 flag, const bool set) {
+  ref->p = set ? (ref->p | flag) : (ref->p & (u8)~flag);
+}
+
+static bool flag(const RefCpu *ref, const u8 flag) {
+  return (ref->p & flag) != 0;
+}
+
+static u8 set_nz(RefCpu *ref, const u8 value) {
+  set_flag(ref, P_Z, value == 0);
+  set_flag(ref, P_N, (value & 0x80) != 0);
+  return value;
+}
+
+static void interrupt(RefCpu *ref, const u16 vector, const u8 b) {
+  push(ref, (u8)(ref->pc >> 8));
+  push(ref, (u8)ref->pc);
+  push(ref, ref->p | b);
+  set_flag(ref, P_I, true);
+#ifdef EMU_CPU_65C02
+  set_flag(ref, P_D, false);
+#endif
+  const u8 lo = read(ref, vector);
+  ref->pc = (u16)(lo | read(ref, vector + 1) << 8);
+}
+
+static void branch(RefCpu *ref, const bool taken, const u16 target) {
+  if (taken) {
+    ref->cycles += ((ref->pc ^ target) & 0xFF00) ? 2 : 1;
+    ref->pc = target;
+  }
+}
+
+static void compare(RefCpu *ref, const u8 reg, const u8 m) {
+  set_nz(ref, (u8)(reg - m));
+  set_flag(ref, P_C, reg >= m);
+}
+
+// Decimal mode as described in "Decimal Mode" by Bruce Clark, appendix A: N
+// and V come from the sum before the high digit is adjusted, Z from the
+// binary sum, and SBC sets every flag as in binary mode. The 65C02 (appendix
+// B) takes a cycle more, sets N and Z from the result and adjusts the
+// difference of SBC as a whole.
+static void adc(RefCpu *ref, const u8 m) {
+  const i32 c = flag(ref, P_C);
+  const i32 binary = ref->a + m + c;
+  if (!flag(ref, P_D)) {
+    const i32 sign = (i8)ref->a + (i8)m + c;
+    set_flag(ref, P_V, sign < -128 || sign > 127);
+    set_flag(ref, P_C, binary > 0xFF);
+    ref->a = set_nz(ref, (u8)binary);
+    return;
+  }
+  i32 lo = (ref->a & 0x0F) + (m & 0x0F) + c;
+  if (lo >= 0x0A) {
+    lo = ((lo + 0x06) & 0x0F) + 0x10;
+  }
+  const i32 sign = (i8)(ref->a & 0xF0) + (i8)(m & 0xF0) + lo;
+  i32 sum = (ref->a & 0xF0) + (m & 0xF0) + lo;
+  set_flag(ref, P_V, sign < -128 || sign > 127);
+  set_flag(ref, P_N, (sum & 0x80) != 0);
+  set_flag(ref, P_Z, (u8)binary == 0);
+  if (sum >= 0xA0) {
+    sum += 0x60;
+  }
+  set_flag(ref, P_C, sum >= 0x100);
+  ref->a = (u8)sum;
+#ifdef EMU_CPU_65C02
+  ref->cycles++;
+  set_nz(ref, ref->a);
+#endif
+}
+
+static void sbc(RefCpu *ref, const u8 m) {
+  const i32 borrow = !flag(ref, P_C);
+  const i32 binary = ref->a - m - borrow;
+  const i32 sign = (i8)ref->a - (i8)m - borrow;
+  set_flag(ref, P_V, sign < -128 || sign > 127);
+  set_flag(ref, P_C, binary >= 0);
+  set_nz(ref, (u8)binary);
+  if (!flag(ref, P_D)) {
+    ref->a = (u8)binary;
+    return;
+  }
+  i32 lo = (ref->a & 0x0F) - (m & 0x0F) - borrow;
+#ifdef EMU_CPU_65C02
+  i32 dif = binary;
+  if (dif < 0) {
+    dif -= 0x60;
+  }
+  if (lo < 0) {
+    dif -= 0x06;
+  }
+  ref->cycles++;
+  ref->a = set_nz(ref, (u8)dif);
+#else
+  if (lo < 0) {
+    lo = ((lo - 0x06) & 0x0F) - 0x10;
+  }
+  i32 dif = (ref->a & 0xF0) - (m & 0xF0) + lo;
+  if (dif < 0) {
+    dif -= 0x60;
+  }
+  ref->a = (u8)dif;
+#endif
+}
+
+// The undocumented ARR: AND then ROR A, with C and V from bits 6 and 5 of the
+// result, or in decimal mode N and Z from the binary result and both digits
+// fixed up, as described in "No More Secrets"
+static void arr(RefCpu *ref, const u8 m) {
+  const u8 t = ref->a & m;
+  const u8 r = (u8)(t >> 1 | flag(ref, P_C) << 7);
+  set_nz(ref, r);
+  if (!flag(ref, P_D)) {
+    set_flag(ref, P_C, r & 0x40);
+    set_flag(ref, P_V, ((r >> 6) ^ (r >> 5)) & 1);
+    ref->a = r;
+    return;
+  }
+  const u8 hi = t >> 4;
+  const u8 lo = t & 0x0F;
+  set_flag(ref, P_V, (t ^ r) & 0x40);
+  u8 a = r;
+  if (lo + (lo & 1) > 5) {
+    a = (u8)((a & 0xF0) | ((a + 6) & 0x0F));
+  }
+  set_flag(ref, P_C, hi + (hi & 1) > 5);
+  if (flag(ref, P_C)) {
+    a = (u8)(a + 0x60);
+  }
+  ref->a = a;
+}
+
+// Shifts and rotates, on A or on memory
+static u8 shift(RefCpu *ref, const u32 mnemonic, const u8 x) {
+  const u8 carry_in = flag(ref, P_C);
+  u8 result;
+  switch (mnemonic) {
+  case MNEMONIC('A', 'S', 'L'):
+    result = (u8)(x << 1);
+    set_flag(ref, P_C, x & 0x80);
+    break;
+  case MNEMONIC('L', 'S', 'R'):
+    result = x >> 1;
+    set_flag(ref, P_C, x & 0x01);
+    break;
+  case MNEMONIC('R', 'O', 'L'):
+    result = (u8)(x << 1 | carry_in);
+    set_flag(ref, P_C, x & 0x80);
+    break;
+  default: // ROR
+    result = (u8)(x >> 1 | carry_in << 7);
+    set_flag(ref, P_C, x & 0x01);
+    break;
+  }
+  return set_nz(ref, result);
+}
+
+void ref_step(RefCpu *ref) {
+  ref->n_accesses = 0;
+  if ((ref->interrupts & EMU_INT_NMI) != 0) {
+    ref->interrupts &= (u8)~EMU_INT_NMI;
+    ref->cycles += 7;
+    interrupt(ref, NMI_VECTOR, 0);
+  } else if ((ref->interrupts & EMU_INT_IRQ) != 0 && !flag(ref, P_I)) {
+    ref->cycles += 7;
+    interrupt(ref, IRQ_VECTOR, 0);
+  }
+
+  const u8 opcode = fetch(ref);
+  const OpcodeInfo *info = &opcode_table[opcode];
+  ref->cycles += info->cycles;
+
+  // the effective address, and whether indexing it crossed a page
+  u16 addr = 0;
+  u16 base = 0;
+  switch (info->mode) {
+  case ADDR_IM:
+    addr = ref->pc++;
+    break;
+  case ADDR_ZP:
+    addr = fetch(ref);
+    break;
+  case ADDR_ZPX:
+    addr = (u8)(fetch(ref) + ref->x);
+    break;
+  case ADDR_ZPY:
+    addr = (u8)(fetch(ref) + ref->y);
+    break;
+  case ADDR_ABS:
+    addr = fetch_word(ref);
+    break;
+  case ADDR_ABSX:
+    base = fetch_word(ref);
+    addr = (u16)(base + ref->x);
+    break;
+  case ADDR_ABSY:
+    base = fetch_word(ref);
+    addr = (u16)(base + ref->y);
+    break;
+  case ADDR_IND: {
+    const u16 ptr = fetch_word(ref);
+    const u8 lo = read(ref, ptr);
+#ifdef EMU_CPU_65C02
+    addr = (u16)(lo | read(ref, (u16)(ptr + 1)) << 8);
+#else
+    // the NMOS 6502 does not carry into the high byte of the pointer
+    addr = (u16)(lo | read(ref, (ptr & 0xFF00) | (u8)(ptr + 1)) << 8);
+#endif
+  } break;
+  case ADDR_IAX: {
+    const u16 ptr = (u16)(fetch_word(ref) + ref->x);
+    const u8 lo = read(ref, ptr);
+    addr = (u16)(lo | read(ref, (u16)(ptr + 1)) << 8);
+  } break;
+  case ADDR_ZPI: {
+    const u8 ptr = fetch(ref);
+    const u8 lo = read(ref, ptr);
+    addr = (u16)(lo | read(ref, (u8)(ptr + 1)) << 8);
+  } break;
+  case ADDR_INDX: {
+    const u8 ptr = (u8)(fetch(ref) + ref->x);
+    const u8 lo = read(ref, ptr);
+    addr = (u16)(lo | read(ref, (u8)(ptr + 1)) << 8);
+  } break;
+  case ADDR_INDY: {
+    const u8 ptr = fetch(ref);
+    const u8 lo = read(ref, ptr);
+    base = (u16)(lo | read(ref, (u8)(ptr + 1)) << 8);
+    addr = (u16)(base + ref->y);
+  } break;
+  case ADDR_REL: {
+    const i8 offset = (i8)fetch(ref);
+    addr = (u16)(ref->pc + offset);
+  } break;
+  default:
+    break;
+  }
+  // only loads pay for the page cross, stores and read-modify-writes always
+  // spend that cycle and have it in their base cycles
+  const bool crossed =
+      (info->mode == ADDR_ABSX || info->mode == ADDR_ABSY ||
+       info->mode == ADDR_INDY) &&
+      ((base ^ addr) & 0xFF00) != 0;
+  const u32 mnemonic = (u32)MNEMONIC(info->mnemonic[0], info->mnemonic[1],
+                                     info->mnemonic[2]);
+  switch (mnemonic) {
+  // loads
+  case MNEMONIC('A', 'D', 'C'):
+  case MNEMONIC('A', 'N', 'D'):
+  case MNEMONIC('B', 'I', 'T'):
+  case MNEMONIC('C', 'M', 'P'):
+  case MNEMONIC('C', 'P', 'X'):
+  case MNEMONIC('C', 'P', 'Y'):
+  case MNEMONIC('E', 'O', 'R'):
+  case MNEMONIC('L', 'D', 'A'):
+  case MNEMONIC('L', 'D', 'X'):
+  case MNEMONIC('L', 'D', 'Y'):
+  case MNEMONIC('O', 'R', 'A'):
+  case MNEMONIC('S', 'B', 'C'):
+  case MNEMONIC('L', 'A', 'X'):
+  case MNEMONIC('A', 'N', 'C'):
+  case MNEMONIC('A', 'L', 'R'):
+  case MNEMONIC('A', 'R', 'R'):
+  case MNEMONIC('S', 'B', 'X'): {
+    ref->cycles += crossed;
+    const u8 m = read(ref, addr);
+    switch (mnemonic) {
+    case MNEMONIC('A', 'D', 'C'):
+      adc(ref, m);
+      break;
+    case MNEMONIC('A', 'N', 'D'):
+      ref->a = set_nz(ref, ref->a & m);
+      break;
+    case MNEMONIC('B', 'I', 'T'):
+      set_flag(ref, P_Z, (ref->a & m) == 0);
+      if (info->mode == ADDR_IM) {
+        break; // 65C02 BIT #imm only sets Z
+      }
+      set_flag(ref, P_N, m & 0x80);
+      set_flag(ref, P_V, m & 0x40);
+      break;
+    case MNEMONIC('C', 'M', 'P'):
+      compare(ref, ref->a, m);
+      break;
+    case MNEMONIC('C', 'P', 'X'):
+      compare(ref, ref->x, m);
+      break;
+    case MNEMONIC('C', 'P', 'Y'):
+      compare(ref, ref->y, m);
+      break;
+    case MNEMONIC('E', 'O', 'R'):
+      ref->a = set_nz(ref, ref->a ^ m);
+      break;
+    case MNEMONIC('L', 'D', 'A'):
+      ref->a = set_nz(ref, m);
+      break;
+    case MNEMONIC('L', 'D', 'X'):
+      ref->x = set_nz(ref, m);
+      break;
+    case MNEMONIC('L', 'D', 'Y'):
+      ref->y = set_nz(ref, m);
+      break;
+    case MNEMONIC('O', 'R', 'A'):
+      ref->a = set_nz(ref, ref->a | m);
+      break;
+    case MNEMONIC('L', 'A', 'X'):
+      ref->a = ref->x = set_nz(ref, m);
+      break;
+    case MNEMONIC('A', 'N', 'C'):
+      ref->a = set_nz(ref, ref->a & m);
+      set_flag(ref, P_C, flag(ref, P_N));
+      break;
+    case MNEMONIC('A', 'L', 'R'): {
+      const u8 x = ref->a & m;
+      set_flag(ref, P_C, x & 0x01);
+      ref->a = set_nz(ref, x >> 1);
+    } break;
+    case MNEMONIC('A', 'R', 'R'):
+      arr(ref, m);
+      break;
+    case MNEMONIC('S', 'B', 'X'): {
+      const u8 x = ref->a & ref->x;
+      set_flag(ref, P_C, x >= m);
+      ref->x = set_nz(ref, (u8)(x - m));
+    } break;
+    default: // SBC
+      sbc(ref, m);
+      break;
+    }
+  } break;
+
+  // stores
+  case MNEMONIC('S', 'T', 'A'):
+    write(ref, addr, ref->a);
+    break;
+  case MNEMONIC('S', 'T', 'X'):
+    write(ref, addr, ref->x);
+    break;
+  case MNEMONIC('S', 'T', 'Y'):
+    write(ref, addr, ref->y);
+    break;
+  case MNEMONIC('S', 'T', 'Z'):
+    write(ref, addr, 0);
+    break;
+  case MNEMONIC('S', 'A', 'X'):
+    write(ref, addr, ref->a & ref->x);
+    break;
+
+  // read-modify-writes
+  case MNEMONIC('A', 'S', 'L'):
+  case MNEMONIC('L', 'S', 'R'):
+  case MNEMONIC('R', 'O', 'L'):
+  case MNEMONIC('R', 'O', 'R'):
+    if (info->mode == ADDR_A) {
+      ref->a = shift(ref, mnemonic, ref->a);
+    } else {
+#ifdef EMU_CPU_65C02
+      // abs,X only pays for a page cross, like a load
+      ref->cycles += crossed;
+#endif
+      write(ref, addr, shift(ref, mnemonic, read(ref, addr)));
+    }
+    break;
+  case MNEMONIC('I', 'N', 'C'):
+    if (info->mode == ADDR_A) {
+      ref->a = set_nz(ref, (u8)(ref->a + 1));
+    } else {
+      write(ref, addr, set_nz(ref, (u8)(read(ref, addr) + 1)));
+    }
+    break;
+  case MNEMONIC('D', 'E', 'C'):
+    if (info->mode == ADDR_A) {
+      ref->a = set_nz(ref, (u8)(ref->a - 1));
+    } else {
+      write(ref, addr, set_nz(ref, (u8)(read(ref, addr) - 1)));
+    }
+    break;
+  case MNEMONIC('T', 'S', 'B'):
+  case MNEMONIC('T', 'R', 'B'): {
+    const u8 m = read(ref, addr);
+    set_flag(ref, P_Z, (m & ref->a) == 0);
+    write(ref, addr,
+          mnemonic == MNEMONIC('T', 'S', 'B') ? m | ref->a
+                                              : m & (u8)~ref->a);
+  } break;
+
+  // undocumented read-modify-writes, an operation on A follows the write
+  case MNEMONIC('S', 'L', 'O'):
+  case MNEMONIC('R', 'L', 'A'):
+  case MNEMONIC('S', 'R', 'E'):
+  case MNEMONIC('R', 'R', 'A'): {
+    static const u32 shifts[] = {MNEMONIC('A', 'S', 'L'),
+                                 MNEMONIC('R', 'O', 'L'),
+                                 MNEMONIC('L', 'S', 'R'),
+                                 MNEMONIC('R', 'O', 'R')};
+    const usize which = (opcode >> 5) & 3; // SLO, RLA, SRE, RRA
+    const u8 m = shift(ref, shifts[which], read(ref, addr));
+    write(ref, addr, m);
+    switch (which) {
+    case 0:
+      ref->a = set_nz(ref, ref->a | m);
+      break;
+    case 1:
+      ref->a = set_nz(ref, ref->a & m);
+      break;
+    case 2:
+      ref->a = set_nz(ref, ref->a ^ m);
+      break;
+    default:
+      adc(ref, m);
+      break;
+    }
+  } break;
+  case MNEMONIC('D', 'C', 'P'): {
+    const u8 m = (u8)(read(ref, addr) - 1);
+    write(ref, addr, m);
+    compare(ref, ref->a, m);
+  } break;
+  case MNEMONIC('I', 'S', 'C'): {
+    const u8 m = (u8)(read(ref, addr) + 1);
+    write(ref, addr, m);
+    sbc(ref, m);
+  } break;
+
+  // registers
+  case MNEMONIC('I', 'N', 'X'):
+    ref->x = set_nz(ref, (u8)(ref->x + 1));
+    break;
+  case MNEMONIC('I', 'N', 'Y'):
+    ref->y = set_nz(ref, (u8)(ref->y + 1));
+    break;
+  case MNEMONIC('D', 'E', 'X'):
+    ref->x = set_nz(ref, (u8)(ref->x - 1));
+    break;
+  case MNEMONIC('D', 'E', 'Y'):
+    ref->y = set_nz(ref, (u8)(ref->y - 1));
+    break;
+  case MNEMONIC('T', 'A', 'X'):
+    ref->x = set_nz(ref, ref->a);
+    break;
+  case MNEMONIC('T', 'A', 'Y'):
+    ref->y = set_nz(ref, ref->a);
+    break;
+  case MNEMONIC('T', 'X', 'A'):
+    ref->a = set_nz(ref, ref->x);
+    break;
+  case MNEMONIC('T', 'Y', 'A'):
+    ref->a = set_nz(ref, ref->y);
+    break;
+  case MNEMONIC('T', 'S', 'X'):
+    ref->x = set_nz(ref, ref->sp);
+    break;
+  case MNEMONIC('T', 'X', 'S'):
+    ref->sp = ref->x;
+    break;
+  case MNEMONIC('P', 'H', 'X'):
+    push(ref, ref->x);
+    break;
+  case MNEMONIC('P', 'H', 'Y'):
+    push(ref, ref->y);
+    break;
+  case MNEMONIC('P', 'L', 'X'):
+    ref->x = set_nz(ref, pull(ref));
+    break;
+  case MNEMONIC('P', 'L', 'Y'):
+    ref->y = set_nz(ref, pull(ref));
+    break;
+
+  // flags
+  case MNEMONIC('C', 'L', 'C'):
+    set_flag(ref, P_C, false);
+    break;
+  case MNEMONIC('S', 'E', 'C'):
+    set_flag(ref, P_C, true);
+    break;
+  case MNEMONIC('C', 'L', 'D'):
+    set_flag(ref, P_D, false);
+    break;
+  case MNEMONIC('S', 'E', 'D'):
+    set_flag(ref, P_D, true);
+    break;
+  case MNEMONIC('C', 'L', 'I'):
+    set_flag(ref, P_I, false);
+    break;
+  case MNEMONIC('S', 'E', 'I'):
+    set_flag(ref, P_I, true);
+    break;
+  case MNEMONIC('C', 'L', 'V'):
+    set_flag(ref, P_V, false);
+    break;
+
+  // branches
+  case MNEMONIC('B', 'C', 'C'):
+    branch(ref, !flag(ref, P_C), addr);
+    break;
+  case MNEMONIC('B', 'C', 'S'):
+    branch(ref, flag(ref, P_C), addr);
+    break;
+  case MNEMONIC('B', 'N', 'E'):
+    branch(ref, !flag(ref, P_Z), addr);
+    break;
+  case MNEMONIC('B', 'E', 'Q'):
+    branch(ref, flag(ref, P_Z), addr);
+    break;
+  case MNEMONIC('B', 'P', 'L'):
+    branch(ref, !flag(ref, P_N), addr);
+    break;
+  case MNEMONIC('B', 'M', 'I'):
+    branch(ref, flag(ref, P_N), addr);
+    break;
+  case MNEMONIC('B', 'V', 'C'):
+    branch(ref, !flag(ref, P_V), addr);
+    break;
+  case MNEMONIC('B', 'V', 'S'):
+    branch(ref, flag(ref, P_V), addr);
+    break;
+  case MNEMONIC('B', 'R', 'A'):
+    branch(ref, true, addr);
+    break;
+
+  // the stack and jumps
+  case MNEMONIC('P', 'H', 'A'):
+    push(ref, ref->a);
+    break;
+  case MNEMONIC('P', 'H', 'P'):
+    push(ref, ref->p | SR_B);
+    break;
+  case MNEMONIC('P', 'L', 'A'):
+    ref->a = set_nz(ref, pull(ref));
+    break;
+  case MNEMONIC('P', 'L', 'P'):
+    ref->p = (u8)((pull(ref) & ~SR_B) | SR_UNUSED);
+    break;
+  case MNEMONIC('J', 'M', 'P'):
+    ref->pc = addr;
+    break;
+  case MNEMONIC('J', 'S', 'R'): {
+    const u16 ret = (u16)(ref->pc - 1);
+    push(ref, (u8)(ret >> 8));
+    push(ref, (u8)ret);
+    // the high byte of the target is only fetched after the pushes, which
+    // matters when they overwrite it
+    ref->pc = (u16)((addr & 0xFF) | read(ref, ret) << 8);
+  } break;
+  case MNEMONIC('R', 'T', 'S'): {
+    const u8 lo = pull(ref);
+    ref->pc = (u16)((lo | pull(ref) << 8) + 1);
+  } break;
+  case MNEMONIC('R', 'T', 'I'): {
+    ref->p = (u8)((pull(ref) & ~SR_B) | SR_UNUSED);
+    const u8 lo = pull(ref);
+    ref->pc = (u16)(lo | pull(ref) << 8);
+  } break;
+  case MNEMONIC('B', 'R', 'K'):
+    if ((ref->mem[IRQ_VECTOR] | ref->mem[IRQ_VECTOR + 1]) == 0) {
+      ref->halted = true;
+      break;
+    }
+    ref->pc++;
+    interrupt(ref, IRQ_VECTOR, SR_B);
+    break;
+  case MNEMONIC('N', 'O', 'P'):
+    // the undocumented ones with an operand read it like a load
+    if (info->mode != ADDR_IMPL) {
+      ref->cycles += crossed;
+      read(ref, addr);
+    }
+    break;
+
+  default: // not in `opcode_table`
+    ref->halted = true;
+    break;
+  }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// A second, deliberately plain 6502 to check `emu_tick` against, see
+// `fuzz.c`.
+//
+// Instructions are decoded from `opcode_table` alone: the addressing mode
+// gives the effective address, the mnemonic the operation and the table the
+// base cycles, to which only the page cross and taken branch penalties are
+// added. Nothing is fused, specialised or instrumented, and the flags are
+// kept as a plain byte, so it shares no code with `emu6502.c` beyond the
+// table. Where the emulator has conventions of its own it follows them: an
+// unknown opcode or a BRK with no IRQ handler halts, and interrupts are taken
+// before the instruction of the step they are pending in.
+
+// Most bus accesses one step can make: an interrupt and then a JSR, BRK or
+// read-modify-write
+#define REF_MAX_ACCESSES 16
+
+typedef struct RefAccess {
+  u16 addr;
+  u8 value;
+  bool write;
+} RefAccess;
+
+typedef struct RefCpu {
+  u16 pc;
+  u8 sp;
+  u8 a;
+  u8 x;
+  u8 y;
+  u8 p; // status in the 6502 bit order, as pushed but without B
+  u64 cycles;
+  u8 interrupts; // pending `EMU_INT_*` bits
+  bool halted;
+  u8 *mem; // `MEM_SIZE` bytes
+  // the reads and writes of the last step, leaving out dummy accesses
+  RefAccess accesses[REF_MAX_ACCESSES];
+  usize n_accesses;
+} RefCpu;
+
+// Start from the registers in `cpu` with `mem` as memory
+void ref_init(RefCpu *ref, const CPU *cpu, u8 *mem);
+
+// Take a pending interrupt, if any, and run one instruction
+void ref_step(RefCpu *ref);
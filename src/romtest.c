@@ -0,0 +1,192 @@
+#include "assembler.h"
+#include "breakpoints.h"
+#include "common.h"
+#include "emu6502.h"
+#include "loader.h"
+
+#ifdef ROMTEST_AOT
+#include "aot.h"
+#endif
+
+#include <inttypes.h>
+#include <time.h>
+
+// Runs a test program until it traps, i.e. until an instruction jumps or
+// branches to itself without changing anything, which is how the Klaus Dormann
+// test suites and the programs in tests/ report both success and failure. The
+// run passes if it traps at the success address and every `--check` holds, and
+// its speed is printed either way so `make test` gates correctness and speed
+// together.
+//
+// Sources (`.s`) are assembled first; their `start` and `success` symbols are
+// used unless given on the command line. Images are loaded with `loader.h`.
+// Exit status is 0 if the test passed, 1 if it failed and 2 on errors.
+//
+// Built with `ROMTEST_AOT`, it runs the code of `aot_program`, recompiled
+// from the same test by `emu6502-recomp`, through `aot_step` instead.
+
+#ifdef ROMTEST_AOT
+extern const AotProgram aot_program;
+#endif
+
+#define MAX_CHECKS 16
+
+typedef struct MemCheck {
+  u16 addr;
+  u8 value;
+} MemCheck;
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--load-addr ADDR] [--start ADDR] [--success ADDR] "
+         "[--check ADDR=VALUE]... [--max-cycles N] [--no-fusion] FILE\n",
+         name);
+}
+
+// Parse `ADDR=VALUE`
+static bool parse_check(const char *arg, MemCheck *check) {
+  u16 addr;
+  char addr_str[16];
+  const char *eq = strchr(arg, '=');
+  if (eq == NULL || (usize)(eq - arg) >= sizeof(addr_str)) {
+    return false;
+  }
+  snprintf(addr_str, sizeof(addr_str), "%.*s", (i32)(eq - arg), arg);
+  if (!breakpoint_parse_addr(addr_str, &addr)) {
+    return false;
+  }
+  char *end;
+  const unsigned long value = strtoul(eq + 1, &end, 16);
+  if (end == eq + 1 || *end != '\0' || value > 0xFF) {
+    return false;
+  }
+  *check = (MemCheck){addr, (u8)value};
+  return true;
+}
+
+// A fused pair like `DEX; BNE` can loop back to itself legitimately, so a
+// trap is a step that leaves the PC and the registers as they were
+static bool same_cpu(const CPU *a, const CPU *b) {
+  return a->pc == b->pc && a->sp == b->sp && a->a == b->a && a->x == b->x &&
+         a->y == b->y && a->sr.byte == b->sr.byte;
+}
+
+i32 main(i32 argc, char *argv[]) {
+  const char *path = NULL;
+  i32 load_addr = -1;
+  i32 start = -1;
+  i32 success = -1;
+  MemCheck checks[MAX_CHECKS];
+  usize n_checks = 0;
+  u64 max_cycles = 1000000000000;
+  bool fusion = true;
+
+  for (i32 i = 1; i < argc; i++) {
+    i32 *addr_arg = NULL;
+    if (strcmp(argv[i], "--load-addr") == 0) {
+      addr_arg = &load_addr;
+    } else if (strcmp(argv[i], "--start") == 0) {
+      addr_arg = &start;
+    } else if (strcmp(argv[i], "--success") == 0) {
+      addr_arg = &success;
+    }
+    if (addr_arg != NULL && i + 1 < argc) {
+      u16 addr;
+      if (!breakpoint_parse_addr(argv[++i], &addr)) {
+        printf("invalid address: %s\n", argv[i]);
+        return 2;
+      }
+      *addr_arg = addr;
+    } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+      if (n_checks == MAX_CHECKS ||
+          !parse_check(argv[++i], &checks[n_checks])) {
+        printf("invalid check: %s\n", argv[i]);
+        return 2;
+      }
+      n_checks++;
+    } else if (strcmp(argv[i], "--max-cycles") == 0 && i + 1 < argc) {
+      max_cycles = strtoull(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--no-fusion") == 0) {
+      fusion = false;
+    } else if (path == NULL && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  if (path == NULL) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  static Emulator emu;
+  emu_init(&emu, false);
+  emu.fusion = fusion;
+  const char *ext = strrchr(path, '.');
+  if (ext != NULL && strcmp(ext, ".s") == 0) {
+    static Assembler assembler;
+    asm_init(&assembler);
+    if (!asm_assemble_file(&assembler, path, emu.mem)) {
+      return 2;
+    }
+    u16 addr;
+    if (start < 0 && asm_symbol(&assembler, "start", &addr)) {
+      start = addr;
+    }
+    if (success < 0 && asm_symbol(&assembler, "success", &addr)) {
+      success = addr;
+    }
+  } else {
+    LoadedImage loaded;
+    if (!loader_load(&emu, path, loader_format_from_path(path), load_addr,
+                     &loaded)) {
+      printf("%s\n", loaded.error);
+      return 2;
+    }
+  }
+  emu_reset(&emu);
+  if (start >= 0) {
+    emu.cpu.pc = (u16)start;
+  }
+
+  // after the reset sequence, so only the program is timed
+  const u64 first_cycle = emu.cycles;
+  const clock_t start_time = clock();
+  bool trapped = false;
+  while (emu.is_running && emu.cycles - first_cycle < max_cycles) {
+    const CPU before = emu.cpu;
+#ifdef ROMTEST_AOT
+    aot_step(&emu, &aot_program);
+#else
+    emu_tick(&emu);
+#endif
+    if (same_cpu(&emu.cpu, &before)) {
+      trapped = true;
+      break;
+    }
+  }
+  const f64 seconds = (f64)(clock() - start_time) / (f64)CLOCKS_PER_SEC;
+  const u64 cycles = emu.cycles - first_cycle;
+
+  bool passed = trapped && (success < 0 || emu.cpu.pc == success);
+  for (usize i = 0; i < n_checks; i++) {
+    const u8 value = emu_read_mem_byte(&emu, checks[i].addr);
+    if (value != checks[i].value) {
+      printf("%s: $%04X is $%02X, expected $%02X\n", path, checks[i].addr,
+             value, checks[i].value);
+      passed = false;
+    }
+  }
+  const char *verdict = passed ? "PASS" : "FAIL";
+  if (trapped) {
+    printf("%s %s: trapped at $%04X", verdict, path, emu.cpu.pc);
+  } else if (!emu.is_running) {
+    printf("%s %s: halted at $%04X", verdict, path, emu.cpu.pc);
+  } else {
+    printf("%s %s: no trap within %" PRIu64 " cycles, PC $%04X", verdict,
+           path, max_cycles, emu.cpu.pc);
+  }
+  printf(", %" PRIu64 " cycles in %.3fs (%.1f MHz)\n", cycles, seconds,
+         (seconds > 0) ? (f64)cycles / seconds / 1e6 : 0.0);
+  return passed ? 0 : 1;
+}
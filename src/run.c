@@ -0,0 +1,239 @@
+#include "assembler.h"
+#include "breakpoints.h"
+#include "common.h"
+#include "emu6502.h"
+#include "loader.h"
+
+#include <inttypes.h>
+#include <time.h>
+
+// Runs a program headless within a budget of cycles, instructions and wall
+// clock time, for job runners driving many runs from scripts. The run stops
+// at a `--trap` address (before executing it), on `BRK` with `--brk`, when
+// the emulator halts or when the budget runs out, and the final registers,
+// counters, wall time and speed are printed as one JSON object:
+//
+//   {"rom":"a.bin","stop":"trap","pc":1112,"sp":253,"a":0,"x":0,"y":0,
+//    "sr":48,"cycles":3894486,"instructions":1234567,"seconds":0.005,
+//    "mhz":712.1,"mips":225.7}
+//
+// `stop` is one of "trap", "brk", "halt", "cycles", "instructions" and
+// "seconds". Exit status is 0 on a trap or BRK, 1 when the program halted or
+// ran out of budget and 2 on errors, which print a message instead of JSON.
+//
+// Sources (`.s`) are assembled first, at the addresses their `.org`s give, so
+// `--load-addr` is rejected for them; they start at their `start` symbol
+// unless `--start` is given. Images are loaded with `loader.h`, otherwise
+// starting at the reset vector. Fusion is off while traps or an instruction
+// budget are given, as fused instructions would run past them.
+
+// instructions between checks of the clock
+#define TIME_CHECK_INTERVAL 65536
+
+typedef enum RunStop {
+  RUN_STOP_TRAP,
+  RUN_STOP_BRK,
+  RUN_STOP_HALT,
+  RUN_STOP_CYCLES,
+  RUN_STOP_INSTRUCTIONS,
+  RUN_STOP_SECONDS,
+} RunStop;
+
+static const char *const stop_names[] = {
+    "trap", "brk", "halt", "cycles", "instructions", "seconds",
+};
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--load-addr ADDR] [--start ADDR] [--trap ADDR]... "
+         "[--brk] [--max-cycles N] [--max-instructions N] [--max-seconds S] "
+         "[--no-fusion] FILE\n"
+         "--load-addr is for images, sources are placed by their .org\n",
+         name);
+}
+
+// Parse a whole decimal count
+static bool parse_u64(const char *str, u64 *n) {
+  char *end;
+  *n = strtoull(str, &end, 10);
+  return end != str && *end == '\0' && str[0] != '-';
+}
+
+static f64 now_seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (f64)ts.tv_sec + (f64)ts.tv_nsec / 1e9;
+}
+
+// Print `str` as a JSON string
+static void print_json_string(const char *str) {
+  putchar('"');
+  for (const u8 *p = (const u8 *)str; *p != '\0'; p++) {
+    if (*p == '"' || *p == '\\') {
+      printf("\\%c", *p);
+    } else if (*p < 0x20) {
+      printf("\\u%04x", *p);
+    } else {
+      putchar(*p);
+    }
+  }
+  putchar('"');
+}
+
+i32 main(i32 argc, char *argv[]) {
+  const char *path = NULL;
+  i32 load_addr = -1;
+  i32 start = -1;
+  static Breakpoints traps;
+  bool use_traps = false;
+  bool stop_on_brk = false;
+  u64 max_cycles = UINT64_MAX;
+  u64 max_instructions = UINT64_MAX;
+  bool limit_instructions = false;
+  f64 max_seconds = 0;
+  bool fusion = true;
+  breakpoints_init(&traps);
+
+  for (i32 i = 1; i < argc; i++) {
+    i32 *addr_arg = NULL;
+    if (strcmp(argv[i], "--load-addr") == 0) {
+      addr_arg = &load_addr;
+    } else if (strcmp(argv[i], "--start") == 0) {
+      addr_arg = &start;
+    }
+    if (addr_arg != NULL && i + 1 < argc) {
+      u16 addr;
+      if (!breakpoint_parse_addr(argv[++i], &addr)) {
+        printf("invalid address: %s\n", argv[i]);
+        return 2;
+      }
+      *addr_arg = addr;
+    } else if (strcmp(argv[i], "--trap") == 0 && i + 1 < argc) {
+      u16 addr;
+      if (!breakpoint_parse_addr(argv[++i], &addr)) {
+        printf("invalid trap address: %s\n", argv[i]);
+        return 2;
+      }
+      breakpoint_set(&traps, addr);
+      use_traps = true;
+    } else if (strcmp(argv[i], "--brk") == 0) {
+      stop_on_brk = true;
+    } else if (strcmp(argv[i], "--max-cycles") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &max_cycles)) {
+        printf("invalid cycle count: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--max-instructions") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &max_instructions)) {
+        printf("invalid instruction count: %s\n", argv[i]);
+        return 2;
+      }
+      limit_instructions = true;
+    } else if (strcmp(argv[i], "--max-seconds") == 0 && i + 1 < argc) {
+      char *end;
+      max_seconds = strtod(argv[++i], &end);
+      if (end == argv[i] || *end != '\0' || !(max_seconds > 0)) {
+        printf("invalid number of seconds: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--no-fusion") == 0) {
+      fusion = false;
+    } else if (path == NULL && argv[i][0] != '-') {
+      path = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  if (path == NULL) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  static Emulator emu;
+  emu_init(&emu, false);
+  // a fused sequence would run past a trap address or the instruction budget
+  emu.fusion = fusion && !use_traps && !limit_instructions;
+  const char *ext = strrchr(path, '.');
+  if (ext != NULL && strcmp(ext, ".s") == 0) {
+    if (load_addr >= 0) {
+      printf("--load-addr does not apply to sources, use .org\n");
+      return 2;
+    }
+    static Assembler assembler;
+    asm_init(&assembler);
+    if (!asm_assemble_file(&assembler, path, emu.mem)) {
+      return 2;
+    }
+    u16 addr;
+    if (start < 0 && asm_symbol(&assembler, "start", &addr)) {
+      start = addr;
+    }
+  } else {
+    LoadedImage loaded;
+    if (!loader_load(&emu, path, loader_format_from_path(path), load_addr,
+                     &loaded)) {
+      printf("%s\n", loaded.error);
+      return 2;
+    }
+  }
+  emu_reset(&emu);
+  if (start >= 0) {
+    emu.cpu.pc = (u16)start;
+  }
+  if (use_traps) {
+    // so a tick entering an interrupt handler stops on a trap at its start
+    emu.breakpoints = &traps;
+  }
+
+  // after the reset sequence, so only the program is counted
+  const u64 first_cycle = emu.cycles;
+  const u64 first_instruction = emu.n_instructions;
+  const f64 start_time = now_seconds();
+  u32 until_time_check = TIME_CHECK_INTERVAL;
+  RunStop stop;
+  while (true) {
+    if (!emu.is_running) {
+      stop = RUN_STOP_HALT;
+      break;
+    }
+    if (emu.cycles - first_cycle >= max_cycles) {
+      stop = RUN_STOP_CYCLES;
+      break;
+    }
+    if (emu.n_instructions - first_instruction >= max_instructions) {
+      stop = RUN_STOP_INSTRUCTIONS;
+      break;
+    }
+    if (use_traps && breakpoint_test(&traps, emu.cpu.pc)) {
+      stop = RUN_STOP_TRAP;
+      break;
+    }
+    if (stop_on_brk && emu_read_mem_byte(&emu, emu.cpu.pc) == 0x00) {
+      stop = RUN_STOP_BRK;
+      break;
+    }
+    if (--until_time_check == 0) {
+      until_time_check = TIME_CHECK_INTERVAL;
+      if (max_seconds > 0 && now_seconds() - start_time >= max_seconds) {
+        stop = RUN_STOP_SECONDS;
+        break;
+      }
+    }
+    emu_tick(&emu);
+  }
+  const f64 seconds = now_seconds() - start_time;
+  const u64 cycles = emu.cycles - first_cycle;
+  const u64 instructions = emu.n_instructions - first_instruction;
+
+  const CPU *cpu = &emu.cpu;
+  printf("{\"rom\":");
+  print_json_string(path);
+  printf(",\"stop\":\"%s\",\"pc\":%u,\"sp\":%u,\"a\":%u,\"x\":%u,\"y\":%u,"
+         "\"sr\":%u,\"cycles\":%" PRIu64 ",\"instructions\":%" PRIu64
+         ",\"seconds\":%.6f,\"mhz\":%.1f,\"mips\":%.1f}\n",
+         stop_names[stop], cpu->pc, cpu->sp, cpu->a, cpu->x, cpu->y,
+         cpu->sr.byte, cycles, instructions, seconds,
+         (seconds > 0) ? (f64)cycles / seconds / 1e6 : 0.0,
+         (seconds > 0) ? (f64)instructions / seconds / 1e6 : 0.0);
+  return (stop == RUN_STOP_TRAP || stop == RUN_STOP_BRK) ? 0 : 1;
+}
@@ -0,0 +1,121 @@
+#include "stackguard.h"
+
+#include <inttypes.h>
+
+void stack_guard_init(StackGuard *guard, const bool trap) {
+  memset(guard, 0, sizeof(StackGuard));
+  guard->trap = trap;
+}
+
+void stack_guard_wrapped(StackGuard *guard, const StackWrap wrap,
+                         const u64 cycles) {
+  if (wrap == STACK_WRAP_OVERFLOW) {
+    guard->n_overflows++;
+  } else {
+    guard->n_underflows++;
+  }
+  if (guard->first_wrap == STACK_WRAP_NONE) {
+    guard->first_wrap = wrap;
+    guard->first_wrap_cycle = cycles;
+  }
+  guard->last_wrap = wrap;
+  guard->wrap_hit = guard->trap;
+}
+
+void stack_guard_enter(StackGuard *guard, const u16 addr, const u8 sp) {
+  if (guard->depth == STACK_GUARD_MAX_FRAMES) {
+    guard->dropped++;
+    return;
+  }
+  // the return address went to `sp` and `sp - 1`
+  guard->frames[guard->depth++] =
+      (StackGuardFrame){.addr = addr, .sp = sp, .lowest = (u8)(sp - 1)};
+}
+
+static void charge(StackGuard *guard, const StackGuardFrame *frame) {
+  const u16 usage = (u16)((u8)(frame->sp - frame->lowest) + 1);
+  const u16 depth = (u16)STACK_DEPTH(frame->lowest);
+  if (usage > guard->sub_usage[frame->addr]) {
+    guard->sub_usage[frame->addr] = usage;
+  }
+  if (depth > guard->sub_depth[frame->addr]) {
+    guard->sub_depth[frame->addr] = depth;
+  }
+}
+
+void stack_guard_return(StackGuard *guard, const u8 sp) {
+  // unwind every frame whose return address has been pulled, see callgraph.h
+  while (guard->depth != 0 && sp >= guard->frames[guard->depth - 1].sp) {
+    const StackGuardFrame *frame = &guard->frames[--guard->depth];
+    charge(guard, frame);
+    if (guard->depth != 0) {
+      StackGuardFrame *parent = &guard->frames[guard->depth - 1];
+      if (frame->lowest < parent->lowest) {
+        parent->lowest = frame->lowest;
+      }
+    }
+  }
+}
+
+void stack_guard_finish(StackGuard *guard) {
+  // innermost first, so each caller includes the stack of its callees
+  u8 lowest = 0xFF;
+  for (usize i = guard->depth; i-- > 0;) {
+    StackGuardFrame frame = guard->frames[i];
+    lowest = (frame.lowest < lowest) ? frame.lowest : lowest;
+    frame.lowest = lowest;
+    charge(guard, &frame);
+  }
+}
+
+static const StackGuard *sort_guard;
+
+// deepest first, then most stack used
+static i32 compare_subs(const void *a, const void *b) {
+  const u16 x = *(const u16 *)a;
+  const u16 y = *(const u16 *)b;
+  if (sort_guard->sub_depth[x] != sort_guard->sub_depth[y]) {
+    return (sort_guard->sub_depth[x] < sort_guard->sub_depth[y]) ? 1 : -1;
+  }
+  if (sort_guard->sub_usage[x] != sort_guard->sub_usage[y]) {
+    return (sort_guard->sub_usage[x] < sort_guard->sub_usage[y]) ? 1 : -1;
+  }
+  return (x > y) - (x < y);
+}
+
+void stack_guard_report(const StackGuard *guard, FILE *out, const usize n) {
+  fprintf(out, "Stack: %u of 256 bytes used at most", guard->max_depth);
+  if (guard->max_depth != 0) {
+    fprintf(out, ", down to $01%02X", 0x100 - guard->max_depth);
+  }
+  fprintf(out, "\n");
+  if (guard->first_wrap != STACK_WRAP_NONE) {
+    fprintf(out,
+            "Stack wrapped: %" PRIu64 " overflows, %" PRIu64
+            " underflows, first an %s at %" PRIu64 " cycles\n",
+            guard->n_overflows, guard->n_underflows,
+            (guard->first_wrap == STACK_WRAP_OVERFLOW) ? "overflow"
+                                                       : "underflow",
+            guard->first_wrap_cycle);
+  }
+
+  static u16 subs[MEM_SIZE];
+  usize n_subs = 0;
+  for (usize i = 0; i < MEM_SIZE; i++) {
+    if (guard->sub_usage[i] != 0) {
+      subs[n_subs++] = (u16)i;
+    }
+  }
+  sort_guard = guard;
+  qsort(subs, n_subs, sizeof(u16), compare_subs);
+
+  fprintf(out, "SUB\tDEEPEST\tUSED\n");
+  for (usize i = 0; i < n_subs && i < n; i++) {
+    fprintf(out, "%04X\t%u\t%u\n", subs[i], guard->sub_depth[subs[i]],
+            guard->sub_usage[subs[i]]);
+  }
+  if (guard->dropped != 0) {
+    fprintf(out, "%" PRIu64 " calls deeper than %d frames were not tracked\n",
+            guard->dropped, STACK_GUARD_MAX_FRAMES);
+  }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Stack guard.
+//
+// SP wraps around within page 1 on the 6502, so runaway recursion silently
+// overwrites the bottom of the stack with the top. The guard watches every
+// push and pull: it keeps the deepest stack slot ever written (the low-water
+// mark), counts pushes below $0100 and pulls above $01FF, and can stop
+// `emu_run` with `EMU_STOP_STACK` on the first of them.
+//
+// It also keeps a light shadow call stack, unwound by SP like the call graph
+// profiler's, to charge each subroutine with the most stack it used, return
+// address and callees included, and the deepest slot reached while it ran.
+// A push costs a compare with the low-water mark and with the innermost frame.
+
+#define STACK_GUARD_MAX_FRAMES 128
+
+// Depth of a stack slot: 1 for $01FF down to 256 for $0100
+#define STACK_DEPTH(slot) (0x100 - (u32)(slot))
+
+typedef enum StackWrap {
+  STACK_WRAP_NONE,
+  STACK_WRAP_OVERFLOW,  // pushed with SP at $00
+  STACK_WRAP_UNDERFLOW, // pulled with SP at $FF
+} StackWrap;
+
+typedef struct StackGuardFrame {
+  u16 addr;  // entry address of the subroutine
+  u8 sp;     // SP before the JSR
+  u8 lowest; // deepest slot written since the JSR
+} StackGuardFrame;
+
+typedef struct StackGuard {
+  bool trap;     // stop `emu_run` on a wrap
+  bool wrap_hit; // a wrap to stop on, cleared by `emu_run`
+  StackWrap first_wrap;
+  u64 first_wrap_cycle;
+  StackWrap last_wrap;
+  u64 n_overflows;
+  u64 n_underflows;
+  u32 max_depth; // `STACK_DEPTH` of the deepest slot written, 0 if none
+  StackGuardFrame frames[STACK_GUARD_MAX_FRAMES];
+  usize depth;
+  u64 dropped; // frames not kept because the shadow stack was full
+  // by entry address, 0 for subroutines never called
+  u16 sub_usage[MEM_SIZE]; // most bytes used from the JSR on
+  u16 sub_depth[MEM_SIZE]; // `STACK_DEPTH` of the deepest slot reached
+} StackGuard;
+
+// Clear the guard, stopping on wraps if `trap`
+void stack_guard_init(StackGuard *guard, bool trap);
+
+// Count a wrap, called by `stack_guard_push` and `stack_guard_pull`
+void stack_guard_wrapped(StackGuard *guard, StackWrap wrap, u64 cycles);
+
+// Called by the emulator before pushing to slot `sp`
+static inline void stack_guard_push(StackGuard *guard, const u8 sp,
+                                    const u64 cycles) {
+  if (sp == 0x00) {
+    stack_guard_wrapped(guard, STACK_WRAP_OVERFLOW, cycles);
+  }
+  if (STACK_DEPTH(sp) > guard->max_depth) {
+    guard->max_depth = STACK_DEPTH(sp);
+  }
+  if (guard->depth != 0) {
+    StackGuardFrame *frame = &guard->frames[guard->depth - 1];
+    frame->lowest = (sp < frame->lowest) ? sp : frame->lowest;
+  }
+}
+
+// Called by the emulator before pulling, with SP not yet incremented
+static inline void stack_guard_pull(StackGuard *guard, const u8 sp,
+                                    const u64 cycles) {
+  if (sp == 0xFF) {
+    stack_guard_wrapped(guard, STACK_WRAP_UNDERFLOW, cycles);
+  }
+}
+
+// Called by the emulator on JSR, after the return address is pushed
+// `sp` is the stack pointer before the JSR
+void stack_guard_enter(StackGuard *guard, u16 addr, u8 sp);
+
+// Called by the emulator on RTS, after the return address is pulled
+void stack_guard_return(StackGuard *guard, u8 sp);
+
+// Charge the subroutines still running with the stack they used so far
+// Call before reporting
+void stack_guard_finish(StackGuard *guard);
+
+// Print the low-water mark, the wraps and the `n` subroutines that reached
+// deepest
+void stack_guard_report(const StackGuard *guard, FILE *out, usize n);
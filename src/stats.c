@@ -0,0 +1,102 @@
+#include "stats.h"
+
+#include <inttypes.h>
+
+void opcode_stats_init(OpcodeStats *stats) {
+  memset(stats, 0, sizeof(OpcodeStats));
+  stats->prev = OPCODE_STATS_NO_PREV;
+}
+
+void opcode_stats_merge(OpcodeStats *dst, const OpcodeStats *src) {
+  for (usize i = 0; i < 256; i++) {
+    dst->count[i] += src->count[i];
+    dst->cycles[i] += src->cycles[i];
+    dst->page_crosses[i] += src->page_crosses[i];
+    dst->branches_taken[i] += src->branches_taken[i];
+    dst->branches_not_taken[i] += src->branches_not_taken[i];
+    for (usize j = 0; j < 256; j++) {
+      dst->pairs[i][j] += src->pairs[i][j];
+    }
+  }
+}
+
+static const u64 *sort_counts;
+
+// sort indices by the counts they point to, descending, ties broken by index
+static i32 compare_counts(const void *lhs, const void *rhs) {
+  const u32 l = *(const u32 *)lhs;
+  const u32 r = *(const u32 *)rhs;
+  if (sort_counts[l] != sort_counts[r]) {
+    return (sort_counts[l] < sort_counts[r]) ? 1 : -1;
+  }
+  return (l < r) ? -1 : 1;
+}
+
+// collect the indices of the non-zero entries of `counts` sorted by count
+static usize sorted_nonzero(const u64 *counts, const usize len, u32 *out) {
+  usize n = 0;
+  for (usize i = 0; i < len; i++) {
+    if (counts[i] != 0) {
+      out[n++] = (u32)i;
+    }
+  }
+  sort_counts = counts;
+  qsort(out, n, sizeof(u32), compare_counts);
+  return n;
+}
+
+void opcode_stats_report(const OpcodeStats *stats, FILE *out,
+                         const usize top_pairs) {
+  u64 total = 0;
+  for (usize i = 0; i < 256; i++) {
+    total += stats->count[i];
+  }
+
+  u32 opcodes[256];
+  const usize n = sorted_nonzero(stats->count, 256, opcodes);
+  fprintf(out, "OP\t%%COUNT\tCOUNT\t\tCYCLES\t\tPAGE X\t\tTAKEN\n");
+  for (usize i = 0; i < n; i++) {
+    const u32 op = opcodes[i];
+    fprintf(out, "%02X\t%6.2lf\t%-12" PRIu64 "\t%-12" PRIu64 "\t%-12" PRIu64,
+            op, (f64)stats->count[op] * 100.0 / (f64)total, stats->count[op],
+            stats->cycles[op], stats->page_crosses[op]);
+    const u64 taken = stats->branches_taken[op];
+    const u64 branches = taken + stats->branches_not_taken[op];
+    if (branches != 0) {
+      fprintf(out, "\t%.2lf%%", (f64)taken * 100.0 / (f64)branches);
+    }
+    fprintf(out, "\n");
+  }
+
+  static u32 pairs[256 * 256];
+  const usize n_pairs = sorted_nonzero(&stats->pairs[0][0], 256 * 256, pairs);
+  fprintf(out, "\nPAIR\t%%COUNT\tCOUNT\n");
+  for (usize i = 0; i < n_pairs && i < top_pairs; i++) {
+    const u32 first = pairs[i] >> 8;
+    const u32 second = pairs[i] & 0xFF;
+    const u64 count = stats->pairs[first][second];
+    fprintf(out, "%02X %02X\t%6.2lf\t%" PRIu64 "\n", first, second,
+            (f64)count * 100.0 / (f64)total, count);
+  }
+}
+
+void opcode_stats_write_csv(const OpcodeStats *stats, FILE *out) {
+  for (usize i = 0; i < 256; i++) {
+    if (stats->count[i] != 0) {
+      fprintf(out,
+              "op,%02X,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+              ",%" PRIu64 "\n",
+              (u32)i, stats->count[i], stats->cycles[i],
+              stats->page_crosses[i], stats->branches_taken[i],
+              stats->branches_not_taken[i]);
+    }
+  }
+  for (usize i = 0; i < 256; i++) {
+    for (usize j = 0; j < 256; j++) {
+      if (stats->pairs[i][j] != 0) {
+        fprintf(out, "pair,%02X,%02X,%" PRIu64 "\n", (u32)i, (u32)j,
+                stats->pairs[i][j]);
+      }
+    }
+  }
+}
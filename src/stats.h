@@ -0,0 +1,69 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Opcode mix statistics.
+//
+// Counts executions, cycles, page-cross penalties and branch outcomes per
+// opcode, as well as how often each opcode follows each other opcode.
+// Counters are plain integers owned by whoever attaches them: give every
+// emulator thread its own `OpcodeStats` and combine them with
+// `opcode_stats_merge` once the threads are done, so counting never contends.
+
+#define OPCODE_STATS_NO_PREV 0x100
+
+typedef struct OpcodeStats {
+  u64 count[256];
+  u64 cycles[256];
+  u64 page_crosses[256];
+  u64 branches_taken[256];
+  u64 branches_not_taken[256];
+  u64 pairs[256][256]; // [first][second]
+  u16 prev;            // previous opcode, `OPCODE_STATS_NO_PREV` if none
+  u8 current;          // opcode being executed
+} OpcodeStats;
+
+void opcode_stats_init(OpcodeStats *stats);
+
+// Add the counters of `src` to `dst`
+void opcode_stats_merge(OpcodeStats *dst, const OpcodeStats *src);
+
+// Called by the emulator before executing an instruction
+static inline void opcode_stats_begin(OpcodeStats *stats, const u8 opcode) {
+  if (stats->prev != OPCODE_STATS_NO_PREV) {
+    stats->pairs[stats->prev][opcode]++;
+  }
+  stats->prev = opcode;
+  stats->current = opcode;
+}
+
+// Called by the emulator when a load pays for an indexed address crossing a
+// page boundary
+static inline void opcode_stats_page_cross(OpcodeStats *stats) {
+  stats->page_crosses[stats->current]++;
+}
+
+// Called by the emulator after executing a conditional branch
+static inline void opcode_stats_branch(OpcodeStats *stats, const bool taken) {
+  if (taken) {
+    stats->branches_taken[stats->current]++;
+  } else {
+    stats->branches_not_taken[stats->current]++;
+  }
+}
+
+// Called by the emulator after executing an instruction
+static inline void opcode_stats_end(OpcodeStats *stats, const u64 cycles) {
+  stats->count[stats->current]++;
+  stats->cycles[stats->current] += cycles;
+}
+
+// Print the opcodes sorted by execution count, followed by the `top_pairs` most
+// frequent opcode pairs
+void opcode_stats_report(const OpcodeStats *stats, FILE *out, usize top_pairs);
+
+// Write every non-zero counter as CSV
+// Opcode rows: `op,OPCODE,COUNT,CYCLES,PAGE_CROSSES,TAKEN,NOT_TAKEN`
+// Pair rows:   `pair,FIRST,SECOND,COUNT`
+void opcode_stats_write_csv(const OpcodeStats *stats, FILE *out);
@@ -0,0 +1,193 @@
+#include "common.h"
+#include "monitor.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+// Shows the registers and rates of running emulators that publish their state
+// with `--monitor NAME` (see `monitor.h`), refreshed every `--interval`
+// milliseconds. Without names every monitor found in /dev/shm is shown.
+// Reading a monitor never blocks the emulator that writes it. Found monitors
+// are dropped once their process is gone.
+// Exit status is 0, or 2 on errors.
+
+#define MAX_INSTANCES 256
+// a running emulator that has not published for this long is stuck
+#define STALE_NS 2000000000
+
+typedef struct Instance {
+  char name[MONITOR_NAME_SIZE];
+  const MonitorShared *shared;
+  MonitorSample prev;
+  bool has_prev;
+} Instance;
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--interval MS] [--count N] [NAME...]\n", name);
+}
+
+// Parse a whole decimal number
+static bool parse_u64(const char *str, u64 *n) {
+  char *end;
+  *n = strtoull(str, &end, 10);
+  return end != str && *end == '\0' && str[0] != '-';
+}
+
+static u64 now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+}
+
+static Instance *find(Instance *instances, const usize n, const char *name) {
+  for (usize i = 0; i < n; i++) {
+    if (strcmp(instances[i].name, name) == 0) {
+      return &instances[i];
+    }
+  }
+  return NULL;
+}
+
+static void add(Instance *instances, usize *n, const char *name) {
+  if (*n < MAX_INSTANCES && find(instances, *n, name) == NULL) {
+    instances[*n] = (Instance){0};
+    snprintf(instances[*n].name, MONITOR_NAME_SIZE, "%s", name);
+    (*n)++;
+  }
+}
+
+// Add the monitors in /dev/shm that are not known yet
+static void scan(Instance *instances, usize *n) {
+  DIR *dir = opendir("/dev/shm");
+  if (dir == NULL) {
+    return;
+  }
+  const usize prefix_len = strlen(MONITOR_PREFIX);
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (strncmp(entry->d_name, MONITOR_PREFIX, prefix_len) == 0 &&
+        strlen(entry->d_name + prefix_len) < MONITOR_NAME_SIZE) {
+      add(instances, n, entry->d_name + prefix_len);
+    }
+  }
+  closedir(dir);
+}
+
+static f64 rate(const u64 now, const u64 prev, const f64 seconds) {
+  return (seconds > 0) ? (f64)(now - prev) / seconds : 0.0;
+}
+
+// Print a line for `inst`
+// Returns false if its monitor is gone or its process died
+static bool print_instance(Instance *inst, const u64 now) {
+  if (inst->shared == NULL) {
+    inst->shared = monitor_map(inst->name);
+  }
+  MonitorSample s;
+  if (inst->shared == NULL || !monitor_read(inst->shared, &s)) {
+    printf("%-16s %s\n", inst->name,
+           (inst->shared == NULL) ? "not found" : "unreadable");
+    return inst->shared != NULL;
+  }
+  const char *state = s.running ? "running" : "halted";
+  const bool alive = kill(inst->shared->pid, 0) == 0 || errno != ESRCH;
+  if (!alive) {
+    state = "dead";
+  } else if (s.running && now > s.time_ns && now - s.time_ns > STALE_NS) {
+    state = "stale";
+  }
+  char flags[9];
+  for (usize i = 0; i < 8; i++) {
+    flags[i] = ((s.cpu.sr.byte >> (7 - i)) & 1) ? "NV-BDIZC"[i] : '.';
+  }
+  flags[8] = '\0';
+  printf("%-16s %7d %-8s %04X %02X %02X %02X %02X %s %14" PRIu64,
+         inst->name, inst->shared->pid, state, s.cpu.pc, s.cpu.a, s.cpu.x,
+         s.cpu.y, s.cpu.sp, flags, s.cycles);
+  if (inst->has_prev && s.time_ns > inst->prev.time_ns) {
+    const f64 seconds = (f64)(s.time_ns - inst->prev.time_ns) / 1e9;
+    printf(" %8.2f %8.2f %9.0f",
+           rate(s.cycles, inst->prev.cycles, seconds) / 1e6,
+           rate(s.n_instructions, inst->prev.n_instructions, seconds) / 1e6,
+           rate(s.n_interrupts, inst->prev.n_interrupts, seconds));
+  } else {
+    printf(" %8s %8s %9s", "-", "-", "-");
+  }
+  printf(" %6" PRIu64 "\n", s.n_halts);
+  // keep the older sample while the emulator has not published a new one
+  if (!inst->has_prev || s.time_ns != inst->prev.time_ns) {
+    inst->prev = s;
+    inst->has_prev = true;
+  }
+  return alive;
+}
+
+i32 main(i32 argc, char *argv[]) {
+  static Instance instances[MAX_INSTANCES];
+  usize n = 0;
+  u64 interval_ms = 1000;
+  u64 count = 0; // frames to show, 0 for no limit
+
+  for (i32 i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &interval_ms)) {
+        printf("invalid interval: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+      if (!parse_u64(argv[++i], &count)) {
+        printf("invalid count: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (argv[i][0] != '-') {
+      add(instances, &n, argv[i]);
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  const bool scanning = (n == 0);
+  if (interval_ms == 0) {
+    interval_ms = 1;
+  }
+
+  // the screen is only cleared when refreshing in place on a terminal
+  const bool clear = isatty(STDOUT_FILENO) && count != 1;
+  for (u64 frame = 0; count == 0 || frame < count; frame++) {
+    if (frame > 0) {
+      usleep((useconds_t)(interval_ms * 1000));
+    }
+    if (scanning) {
+      scan(instances, &n);
+    }
+    if (clear) {
+      printf("\033[H\033[2J");
+    }
+    printf("%-16s %7s %-8s %-4s %-2s %-2s %-2s %-2s %-8s %14s %8s %8s %9s "
+           "%6s\n",
+           "NAME", "PID", "STATE", "PC", "A", "X", "Y", "SP", "NV-BDIZC",
+           "CYCLES", "MHz", "MIPS", "INT/s", "HALTS");
+    const u64 now = now_ns();
+    for (usize i = 0; i < n;) {
+      if (!print_instance(&instances[i], now) && scanning) {
+        if (instances[i].shared != NULL) {
+          monitor_unmap(instances[i].shared);
+        }
+        instances[i] = instances[--n];
+      } else {
+        i++;
+      }
+    }
+    fflush(stdout);
+  }
+  for (usize i = 0; i < n; i++) {
+    if (instances[i].shared != NULL) {
+      monitor_unmap(instances[i].shared);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,323 @@
+#include "trace.h"
+#include "disasm.h"
+
+#include <inttypes.h>
+
+static inline void put_u16(u8 *p, const u16 x) {
+  p[0] = (u8)x;
+  p[1] = (u8)(x >> 8);
+}
+
+static inline void put_u32(u8 *p, const u32 x) {
+  put_u16(p, (u16)x);
+  put_u16(p + 2, (u16)(x >> 16));
+}
+
+static inline void put_u64(u8 *p, const u64 x) {
+  put_u32(p, (u32)x);
+  put_u32(p + 4, (u32)(x >> 32));
+}
+
+static inline u16 get_u16(const u8 *p) { return (u16)(p[0] | (p[1] << 8)); }
+
+static inline u32 get_u32(const u8 *p) {
+  return (u32)get_u16(p) | ((u32)get_u16(p + 2) << 16);
+}
+
+static inline u64 get_u64(const u8 *p) {
+  return (u64)get_u32(p) | ((u64)get_u32(p + 4) << 32);
+}
+
+// Record layout:
+//  0  cycles (8)
+//  8  pc (2)
+// 10  opcode, a, x, y, sp, sr (1 each)
+// 16  number of writes (1), interrupt (1), 2 bytes reserved
+// 20  written values (1 each)
+// 28  written addresses (2 each), 4 bytes reserved
+static void encode_record(u8 *p, const TraceRecord *r) {
+  memset(p, 0, TRACE_RECORD_SIZE);
+  put_u64(p, r->cycles);
+  put_u16(p + 8, r->pc);
+  p[10] = r->opcode;
+  p[11] = r->a;
+  p[12] = r->x;
+  p[13] = r->y;
+  p[14] = r->sp;
+  p[15] = r->sr;
+  p[16] = r->n_writes;
+  p[17] = r->interrupt;
+  for (usize i = 0; i < r->n_writes; i++) {
+    p[20 + i] = r->write_val[i];
+    put_u16(p + 28 + i * 2, r->write_addr[i]);
+  }
+}
+
+static void decode_record(const u8 *p, TraceRecord *r) {
+  memset(r, 0, sizeof(TraceRecord));
+  r->cycles = get_u64(p);
+  r->pc = get_u16(p + 8);
+  r->opcode = p[10];
+  r->a = p[11];
+  r->x = p[12];
+  r->y = p[13];
+  r->sp = p[14];
+  r->sr = p[15];
+  r->n_writes = (p[16] > TRACE_MAX_WRITES) ? TRACE_MAX_WRITES : p[16];
+  r->interrupt = p[17];
+  for (usize i = 0; i < r->n_writes; i++) {
+    r->write_val[i] = p[20 + i];
+    r->write_addr[i] = get_u16(p + 28 + i * 2);
+  }
+}
+
+void tracer_init(Tracer *tracer) {
+  tracer->file = NULL;
+  memset(&tracer->current, 0, sizeof(TraceRecord));
+  tracer->n_records = 0;
+  tracer->buf_len = 0;
+  tracer->failed = false;
+  tracer->held = false;
+}
+
+bool tracer_open(Tracer *tracer, const char *path) {
+  tracer_init(tracer);
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  u8 header[TRACE_HEADER_SIZE];
+  memcpy(header, TRACE_MAGIC, 8);
+  put_u32(header + 8, TRACE_VERSION);
+  put_u32(header + 12, TRACE_RECORD_SIZE);
+  if (fwrite(header, 1, TRACE_HEADER_SIZE, file) != TRACE_HEADER_SIZE) {
+    fclose(file);
+    return false;
+  }
+  tracer->file = file;
+  return true;
+}
+
+// Write out the buffered records, remembering in `failed` if that fails
+static void tracer_flush(Tracer *tracer) {
+  if (tracer->file != NULL && tracer->buf_len != 0 &&
+      fwrite(tracer->buf, 1, tracer->buf_len, tracer->file) !=
+          tracer->buf_len) {
+    tracer->failed = true;
+  }
+  tracer->buf_len = 0;
+}
+
+bool tracer_close(Tracer *tracer) {
+  tracer_flush(tracer);
+  if (tracer->file != NULL) {
+    if (fclose(tracer->file) != 0) {
+      tracer->failed = true;
+    }
+    tracer->file = NULL;
+  }
+  return !tracer->failed;
+}
+
+void tracer_emit(Tracer *tracer) {
+  encode_record(&tracer->buf[tracer->buf_len], &tracer->current);
+  tracer->buf_len += TRACE_RECORD_SIZE;
+  if (tracer->buf_len == sizeof(tracer->buf)) {
+    tracer_flush(tracer);
+  }
+}
+
+bool trace_reader_open(TraceReader *reader, const char *path) {
+  reader->file = fopen(path, "rb");
+  reader->index = 0;
+  if (reader->file == NULL) {
+    return false;
+  }
+  u8 header[TRACE_HEADER_SIZE];
+  if (fread(header, 1, TRACE_HEADER_SIZE, reader->file) != TRACE_HEADER_SIZE ||
+      memcmp(header, TRACE_MAGIC, 8) != 0 ||
+      get_u32(header + 8) != TRACE_VERSION ||
+      get_u32(header + 12) != TRACE_RECORD_SIZE) {
+    fclose(reader->file);
+    reader->file = NULL;
+    return false;
+  }
+  return true;
+}
+
+void trace_reader_close(TraceReader *reader) {
+  if (reader->file != NULL) {
+    fclose(reader->file);
+    reader->file = NULL;
+  }
+}
+
+bool trace_read(TraceReader *reader, TraceRecord *record) {
+  u8 buf[TRACE_RECORD_SIZE];
+  if (fread(buf, 1, TRACE_RECORD_SIZE, reader->file) != TRACE_RECORD_SIZE) {
+    return false;
+  }
+  decode_record(buf, record);
+  reader->index++;
+  return true;
+}
+
+u32 trace_compare(const TraceRecord *lhs, const TraceRecord *rhs) {
+  u32 flags = 0;
+  if (lhs->pc != rhs->pc) {
+    flags |= TRACE_DIFF_PC;
+  }
+  if (lhs->opcode != rhs->opcode) {
+    flags |= TRACE_DIFF_OPCODE;
+  }
+  if (lhs->a != rhs->a || lhs->x != rhs->x || lhs->y != rhs->y ||
+      lhs->sp != rhs->sp) {
+    flags |= TRACE_DIFF_REGS;
+  }
+  if (lhs->sr != rhs->sr) {
+    flags |= TRACE_DIFF_FLAGS;
+  }
+  if (lhs->cycles != rhs->cycles) {
+    flags |= TRACE_DIFF_CYCLES;
+  }
+  if (lhs->interrupt != rhs->interrupt) {
+    flags |= TRACE_DIFF_INTERRUPT;
+  }
+  if (lhs->n_writes != rhs->n_writes) {
+    flags |= TRACE_DIFF_WRITES;
+  } else {
+    for (usize i = 0; i < lhs->n_writes; i++) {
+      if (lhs->write_addr[i] != rhs->write_addr[i] ||
+          lhs->write_val[i] != rhs->write_val[i]) {
+        flags |= TRACE_DIFF_WRITES;
+      }
+    }
+  }
+  return flags;
+}
+
+void trace_print_record(FILE *out, const u64 index, const TraceRecord *r) {
+  // operands are not recorded, so only the opcode can be decoded
+  char op[DISASM_MAX_LEN];
+  disasm_opcode(r->opcode, op);
+  const char *interrupt = (r->interrupt == EMU_INT_NMI)   ? "NMI "
+                          : (r->interrupt == EMU_INT_IRQ) ? "IRQ "
+                                                          : "    ";
+  fprintf(out,
+          "%10" PRIu64 "  %s%04X  %02X %-11s  A=%02X X=%02X Y=%02X SP=%02X "
+          "SR=%02X  cycles=%" PRIu64,
+          index, interrupt, r->pc, r->opcode, op, r->a, r->x, r->y, r->sp, r->sr,
+          r->cycles);
+  for (usize i = 0; i < r->n_writes; i++) {
+    fprintf(out, "  [%04X]=%02X", r->write_addr[i], r->write_val[i]);
+  }
+  fprintf(out, "\n");
+}
+
+void trace_diff_init(TraceDiff *diff, const usize context) {
+  memset(diff, 0, sizeof(TraceDiff));
+  diff->context =
+      (context > TRACE_DIFF_MAX_CONTEXT) ? TRACE_DIFF_MAX_CONTEXT : context;
+}
+
+bool trace_diff_feed(TraceDiff *diff, const TraceRecord *lhs,
+                     const TraceRecord *rhs) {
+  if (!diff->diverged) {
+    if (lhs == NULL && rhs == NULL) {
+      return true;
+    }
+    const u32 flags = (lhs == NULL || rhs == NULL) ? TRACE_DIFF_LENGTH
+                                                   : trace_compare(lhs, rhs);
+    if (flags == 0) {
+      const usize slot = diff->index % TRACE_DIFF_MAX_CONTEXT;
+      diff->history[0][slot] = *lhs;
+      diff->history[1][slot] = *rhs;
+      diff->index++;
+      return false;
+    }
+    diff->diverged = true;
+    diff->diverged_at = diff->index;
+    diff->diff_flags = flags;
+  }
+  const TraceRecord *sides[2] = {lhs, rhs};
+  bool done = true;
+  for (usize i = 0; i < 2; i++) {
+    if (sides[i] != NULL && diff->n_trailing[i] <= diff->context) {
+      diff->trailing[i][diff->n_trailing[i]] = *sides[i];
+      diff->n_trailing[i]++;
+    }
+    if (sides[i] != NULL && diff->n_trailing[i] <= diff->context) {
+      done = false;
+    }
+  }
+  diff->index++;
+  return done;
+}
+
+static void print_diff_flags(FILE *out, const u32 flags) {
+  static const char *names[] = {
+      "pc",     "opcode", "registers", "flags",
+      "memory writes", "cycles", "length", "interrupt",
+  };
+  bool first = true;
+  for (usize i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (flags & (1u << i)) {
+      fprintf(out, first ? "%s" : ", %s", names[i]);
+      first = false;
+    }
+  }
+}
+
+void trace_diff_report(const TraceDiff *diff, FILE *out, const char *lhs_name,
+                       const char *rhs_name) {
+  if (!diff->diverged) {
+    fprintf(out, "no divergence in %" PRIu64 " instructions\n", diff->index);
+    return;
+  }
+  fprintf(out, "diverged at instruction %" PRIu64 " (", diff->diverged_at);
+  print_diff_flags(out, diff->diff_flags);
+  fprintf(out, ")\n");
+
+  const u64 n_before = (diff->diverged_at < diff->context)
+                           ? diff->diverged_at
+                           : (u64)diff->context;
+  if (n_before != 0) {
+    fprintf(out, "--- common history\n");
+  }
+  for (u64 i = diff->diverged_at - n_before; i < diff->diverged_at; i++) {
+    trace_print_record(out, i,
+                       &diff->history[0][i % TRACE_DIFF_MAX_CONTEXT]);
+  }
+  const char *names[2] = {lhs_name, rhs_name};
+  for (usize side = 0; side < 2; side++) {
+    fprintf(out, "--- %s\n", names[side]);
+    if (diff->n_trailing[side] == 0) {
+      fprintf(out, "  (ended)\n");
+    }
+    for (usize i = 0; i < diff->n_trailing[side]; i++) {
+      trace_print_record(out, diff->diverged_at + i, &diff->trailing[side][i]);
+    }
+  }
+}
+
+bool trace_lockstep(Emulator *lhs, Emulator *rhs, const u64 max_instructions,
+                    TraceDiff *diff) {
+  for (u64 i = 0; i < max_instructions; i++) {
+    const bool lhs_running = lhs->is_running;
+    const bool rhs_running = rhs->is_running;
+    if (!lhs_running && !rhs_running) {
+      break;
+    }
+    if (lhs_running) {
+      emu_tick(lhs);
+    }
+    if (rhs_running) {
+      emu_tick(rhs);
+    }
+    if (trace_diff_feed(diff, lhs_running ? &lhs->tracer->current : NULL,
+                        rhs_running ? &rhs->tracer->current : NULL)) {
+      break;
+    }
+  }
+  return diff->diverged;
+}
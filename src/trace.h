@@ -0,0 +1,190 @@
+#pragma once
+
+#include "common.h"
+#include "emu6502.h"
+
+// Binary execution traces.
+//
+// A trace file is a 16 byte header followed by one fixed-size record per
+// executed instruction. Records are encoded little endian regardless of the
+// host, so traces from different machines can be compared directly.
+
+#define TRACE_MAGIC "E65TRACE"
+#define TRACE_VERSION 2
+#define TRACE_HEADER_SIZE 16
+#define TRACE_RECORD_SIZE 48
+
+// Most bytes a single instruction writes to memory (BRK and JSR push three,
+// three more when an interrupt is taken before it)
+#define TRACE_MAX_WRITES 8
+
+// Number of records buffered before they are flushed to the file
+#define TRACE_BUF_RECORDS 4096
+
+// One executed instruction, and the interrupt entry before it if one was taken
+// Registers and cycles are the values after the instruction has executed
+typedef struct TraceRecord {
+  u64 cycles;
+  u16 pc; // address of the instruction
+  u8 opcode;
+  u8 a;
+  u8 x;
+  u8 y;
+  u8 sp;
+  u8 sr;
+  u8 interrupt; // `EMU_INT_NMI` or `EMU_INT_IRQ` if taken first, else 0
+  u8 n_writes;
+  u8 write_val[TRACE_MAX_WRITES];
+  u16 write_addr[TRACE_MAX_WRITES];
+} TraceRecord;
+
+typedef struct Tracer {
+  FILE *file; // NULL if the tracer only keeps the last record
+  TraceRecord current;
+  u64 n_records;
+  usize buf_len;
+  bool failed; // a write to the file failed
+  bool held;   // `current` holds an interrupt entry for the next instruction
+  u8 buf[TRACE_BUF_RECORDS * TRACE_RECORD_SIZE];
+} Tracer;
+
+typedef struct TraceReader {
+  FILE *file;
+  u64 index;
+} TraceReader;
+
+// Initialize a tracer that does not write a file
+// Useful for comparing live emulators against each other
+void tracer_init(Tracer *tracer);
+
+// Initialize a tracer writing to the file at `path`
+// Returns false if the file cannot be created
+bool tracer_open(Tracer *tracer, const char *path);
+
+// Flush buffered records and close the file (if any)
+// Returns false if any record could not be written
+bool tracer_close(Tracer *tracer);
+
+// Append the record in `tracer->current` to the output
+void tracer_emit(Tracer *tracer);
+
+// Called by the emulator before taking an interrupt or executing an
+// instruction, so the pushes of an interrupt entry are recorded too
+static inline void trace_start(Tracer *tracer) {
+  if (tracer->held) {
+    tracer->held = false;
+    return;
+  }
+  tracer->current.interrupt = 0;
+  tracer->current.n_writes = 0;
+}
+
+// Called by the emulator when it stops between an interrupt entry and the
+// handler, so the entry stays in the record of the handler's first instruction
+static inline void trace_hold(Tracer *tracer) { tracer->held = true; }
+
+// Called by the emulator when it enters an interrupt handler
+static inline void trace_note_interrupt(Tracer *tracer, const u8 interrupt) {
+  tracer->current.interrupt = interrupt;
+}
+
+// Called by the emulator once it has fetched the opcode of an instruction
+static inline void trace_begin(Tracer *tracer, const u16 pc, const u8 opcode) {
+  tracer->current.pc = pc;
+  tracer->current.opcode = opcode;
+}
+
+// Called by the emulator on every write to memory
+static inline void trace_note_write(Tracer *tracer, const u16 addr,
+                                    const u8 byte) {
+  const u8 i = tracer->current.n_writes;
+  if (i < TRACE_MAX_WRITES) {
+    tracer->current.write_addr[i] = addr;
+    tracer->current.write_val[i] = byte;
+    tracer->current.n_writes++;
+  }
+}
+
+// Called by the emulator after executing an instruction
+static inline void trace_end(Tracer *tracer, const Emulator *emu) {
+  TraceRecord *r = &tracer->current;
+  r->cycles = emu->cycles;
+  r->a = emu->cpu.a;
+  r->x = emu->cpu.x;
+  r->y = emu->cpu.y;
+  r->sp = emu->cpu.sp;
+  r->sr = emu->cpu.sr.byte;
+  if (tracer->file != NULL) {
+    tracer_emit(tracer);
+  }
+  tracer->n_records++;
+}
+
+// Open a trace file for reading
+// Returns false if the file cannot be opened or is not a trace
+bool trace_reader_open(TraceReader *reader, const char *path);
+
+void trace_reader_close(TraceReader *reader);
+
+// Read the next record
+// Returns false at the end of the trace
+bool trace_read(TraceReader *reader, TraceRecord *record);
+
+// Compare two records
+// Returns a bit set of `TRACE_DIFF_*` flags, 0 if they are identical
+u32 trace_compare(const TraceRecord *lhs, const TraceRecord *rhs);
+
+#define TRACE_DIFF_PC (1 << 0)
+#define TRACE_DIFF_OPCODE (1 << 1)
+#define TRACE_DIFF_REGS (1 << 2)
+#define TRACE_DIFF_FLAGS (1 << 3)
+#define TRACE_DIFF_WRITES (1 << 4)
+#define TRACE_DIFF_CYCLES (1 << 5)
+#define TRACE_DIFF_LENGTH (1 << 6) // one side ended before the other
+#define TRACE_DIFF_INTERRUPT (1 << 7)
+
+// Print a record on one line with its opcode decoded, prefixed by its index in
+// the trace
+void trace_print_record(FILE *out, u64 index, const TraceRecord *record);
+
+// Finds the first diverging record of two record streams.
+// Keeps a fixed amount of context, so memory use does not depend on the
+// length of the traces.
+
+#define TRACE_DIFF_MAX_CONTEXT 64
+
+typedef struct TraceDiff {
+  usize context; // number of records to show around the divergence
+  u64 index;    // number of record pairs fed so far
+  bool diverged;
+  u64 diverged_at;
+  u32 diff_flags;
+  // ring buffers of the records before the divergence, index 0 is the lhs
+  TraceRecord history[2][TRACE_DIFF_MAX_CONTEXT];
+  // the diverging record and the ones following it
+  TraceRecord trailing[2][TRACE_DIFF_MAX_CONTEXT + 1];
+  usize n_trailing[2];
+} TraceDiff;
+
+// `context` is clamped to `TRACE_DIFF_MAX_CONTEXT`
+void trace_diff_init(TraceDiff *diff, usize context);
+
+// Feed one record from each side
+// Pass NULL for a side that has ended
+// Returns true once the diff is complete, i.e. a divergence has been found and
+// all the trailing context has been collected
+bool trace_diff_feed(TraceDiff *diff, const TraceRecord *lhs,
+                     const TraceRecord *rhs);
+
+// Print the result of a diff
+// `lhs_name` and `rhs_name` label the two sides
+void trace_diff_report(const TraceDiff *diff, FILE *out, const char *lhs_name,
+                       const char *rhs_name);
+
+// Run two emulators instruction by instruction and diff them as they go
+// Stops at the first divergence (plus context), once either emulator halts,
+// or after `max_instructions`
+// Both emulators must have a tracer attached
+// Returns true if the emulators diverged
+bool trace_lockstep(Emulator *lhs, Emulator *rhs, u64 max_instructions,
+                    TraceDiff *diff);
@@ -0,0 +1,136 @@
+#include "assembler.h"
+#include "common.h"
+#include "emu6502.h"
+#include "loader.h"
+#include "trace.h"
+
+// Compares two trace files written with `emu6502 --trace` and reports the first
+// instruction where they differ.
+//
+// With `--run`, the two arguments are programs instead: both are loaded into
+// their own emulator and run in lockstep with `trace_lockstep`, for up to
+// `--max-instructions`, without writing any trace. Sources (`.s`) start at
+// their `start` symbol and images at the reset vector. Fusion is off, as a
+// fused sequence would be recorded as a single instruction.
+//
+// Exit status is 0 if the traces are identical, 1 if they diverge and 2 on
+// errors.
+
+static void print_usage(const char *name) {
+  printf("usage: %s [--context N] LHS.trace RHS.trace\n"
+         "       %s [--context N] --run [--max-instructions N] LHS RHS\n",
+         name, name);
+}
+
+// Load the program at `path` into `emu` and reset it, with a tracer attached
+static bool load_program(Emulator *emu, Tracer *tracer, const char *path) {
+  emu_init(emu, false);
+  emu->fusion = false;
+  i32 start = -1;
+  const char *ext = strrchr(path, '.');
+  if (ext != NULL && strcmp(ext, ".s") == 0) {
+    static Assembler assembler;
+    asm_init(&assembler);
+    if (!asm_assemble_file(&assembler, path, emu->mem)) {
+      return false;
+    }
+    u16 addr;
+    if (asm_symbol(&assembler, "start", &addr)) {
+      start = addr;
+    }
+  } else {
+    LoadedImage loaded;
+    if (!loader_load(emu, path, loader_format_from_path(path), -1, &loaded)) {
+      printf("%s\n", loaded.error);
+      return false;
+    }
+  }
+  emu_reset(emu);
+  if (start >= 0) {
+    emu->cpu.pc = (u16)start;
+  }
+  tracer_init(tracer);
+  emu->tracer = tracer;
+  return true;
+}
+
+static bool diff_files(const char *paths[2], TraceDiff *diff) {
+  TraceReader readers[2];
+  for (usize i = 0; i < 2; i++) {
+    if (!trace_reader_open(&readers[i], paths[i])) {
+      printf("cannot read trace: %s\n", paths[i]);
+      if (i == 1) {
+        trace_reader_close(&readers[0]);
+      }
+      return false;
+    }
+  }
+  while (true) {
+    TraceRecord lhs, rhs;
+    const bool has_lhs = trace_read(&readers[0], &lhs);
+    const bool has_rhs = trace_read(&readers[1], &rhs);
+    if (!has_lhs && !has_rhs) {
+      break;
+    }
+    if (trace_diff_feed(diff, has_lhs ? &lhs : NULL, has_rhs ? &rhs : NULL)) {
+      break;
+    }
+  }
+  trace_reader_close(&readers[0]);
+  trace_reader_close(&readers[1]);
+  return true;
+}
+
+static bool diff_programs(const char *paths[2], const u64 max_instructions,
+                          TraceDiff *diff) {
+  static Emulator emus[2];
+  static Tracer tracers[2];
+  for (usize i = 0; i < 2; i++) {
+    if (!load_program(&emus[i], &tracers[i], paths[i])) {
+      return false;
+    }
+  }
+  trace_lockstep(&emus[0], &emus[1], max_instructions, diff);
+  return true;
+}
+
+i32 main(i32 argc, char *argv[]) {
+  const char *paths[2] = {NULL, NULL};
+  usize n_paths = 0;
+  usize context = 8;
+  bool run = false;
+  u64 max_instructions = 10000000;
+
+  for (i32 i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--context") == 0 && i + 1 < argc) {
+      context = (usize)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "--run") == 0) {
+      run = true;
+    } else if (strcmp(argv[i], "--max-instructions") == 0 && i + 1 < argc) {
+      char *end;
+      max_instructions = strtoull(argv[++i], &end, 10);
+      if (end == argv[i] || *end != '\0' || argv[i][0] == '-') {
+        printf("invalid instruction count: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (n_paths < 2 && argv[i][0] != '-') {
+      paths[n_paths++] = argv[i];
+    } else {
+      print_usage(argv[0]);
+      return 2;
+    }
+  }
+  if (n_paths != 2) {
+    print_usage(argv[0]);
+    return 2;
+  }
+
+  static TraceDiff diff;
+  trace_diff_init(&diff, context);
+  if (run ? !diff_programs(paths, max_instructions, &diff)
+          : !diff_files(paths, &diff)) {
+    return 2;
+  }
+  trace_diff_report(&diff, stdout, paths[0], paths[1]);
+  return diff.diverged ? 1 : 0;
+}
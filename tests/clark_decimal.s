@@ -0,0 +1,175 @@
+; Bruce Clark's decimal mode test ("Decimal Mode", 6502.org, appendix B, in
+; the public domain), the test Klaus Dormann's suite ships as
+; 6502_decimal_test, run by `make test` (see romtest.c). It adds and subtracts
+; every pair of bytes, including invalid BCD, with the carry clear and set,
+; and compares A and C with results predicted in binary, the only flags the
+; NMOS 6502 defines in decimal mode. The 65C02 adjusts the result of SBC
+; differently, so the CPU is told apart first and the matching prediction is
+; used. A mismatch traps after `test` returns with `error` set; reaching
+; `success` means every result matched.
+
+n1 = $00        ; the operands
+n2 = $01
+ha = $02        ; A and SR of the binary operation
+hnvzc = $03
+da = $04        ; A and SR of the decimal operation
+dnvzc = $05
+ar = $06        ; predicted A, N, V, Z and C (in bit 0 of cf)
+nf = $07
+vf = $08
+zf = $09
+cf = $0A
+error = $0B     ; 1 until the test passes
+n1l = $0C       ; the low and high digits of the operands
+n1h = $0D
+n2l = $0E
+n2h = $0F       ; two bytes, the high digit and the high digit + $0F
+cmos = $11      ; $80 on the 65C02
+
+        *= $0400
+start:  cld
+        ldx #$FF
+        txs
+        ldx #0
+        sed             ; only the 65C02 sets Z from the decimal result
+        clc
+        lda #$99
+        adc #$01
+        cld
+        bne cpu
+        ldx #$80
+cpu:    stx cmos
+        jsr test
+        lda error
+        bne *
+success:
+        jmp success
+
+test:   ldy #1          ; loops through the carry set and clear
+        sty error
+        lda #0
+        sta n1
+        sta n2
+loop1:  lda n2
+        and #$0F
+        sta n2l
+        lda n2
+        and #$F0
+        sta n2h
+        ora #$0F
+        sta n2h+1
+loop2:  lda n1
+        and #$0F
+        sta n1l
+        lda n1
+        and #$F0
+        sta n1h
+        jsr add
+        jsr compare
+        bne done
+        jsr sub
+        jsr compare
+        bne done
+        inc n1
+        bne loop2       ; every value of n1
+        inc n2
+        bne loop1       ; every value of n2
+        dey
+        bpl loop1       ; both values of the carry
+        lda #0
+        sta error
+done:   rts
+
+; The decimal and binary results of n1 + n2, and the predicted A and C
+add:    sed
+        cpy #1          ; carry set if Y = 1
+        lda n1
+        adc n2
+        sta da
+        php
+        pla
+        sta dnvzc
+        cld
+        cpy #1
+        lda n1
+        adc n2
+        sta ha
+        php
+        pla
+        sta hnvzc
+        cpy #1
+        lda n1l
+        adc n2l
+        cmp #$0A
+        ldx #0
+        bcc a1
+        inx
+        adc #5          ; adds 6, the carry is set
+        and #$0F
+        sec
+a1:     ora n1h
+        adc n2h,x       ; adds n2h, or n2h + $10 if the low digit carried
+        php
+        bcs a2
+        cmp #$A0
+        bcc a3
+a2:     adc #$5F        ; adds $60, the carry is set
+        sec
+a3:     sta ar
+        php
+        pla
+        sta cf
+        pla
+        sta vf
+        rts
+
+; The decimal and binary results of n1 - n2, and the predicted A and C
+sub:    sed
+        cpy #1
+        lda n1
+        sbc n2
+        sta da
+        php
+        pla
+        sta dnvzc
+        cld
+        cpy #1
+        lda n1
+        sbc n2
+        sta ha
+        php
+        pla
+        sta hnvzc
+        sta cf          ; C is that of the binary subtraction
+        cpy #1
+        lda n1l
+        sbc n2l
+        ldx #0
+        bcs s1
+        inx
+        bit cmos
+        bmi s0          ; the 65C02 subtracts the 6 from the whole result below
+        sbc #5          ; subtracts 6, the carry is clear
+s0:     and #$0F
+        clc
+s1:     ora n1h
+        sbc n2h,x       ; subtracts n2h, or n2h + $10 if the low digit borrowed
+        bcs s2
+        sbc #$5F        ; subtracts $60, the carry is clear
+s2:     bit cmos
+        bpl s3
+        cpx #0          ; sets the carry
+        beq s3
+        sbc #6          ; the 65C02 also subtracts 6 if the low digit borrowed
+s3:     sta ar
+        rts
+
+; Z set if A and C match the prediction
+compare:
+        lda da
+        cmp ar
+        bne c1
+        lda dnvzc
+        eor cf
+        and #1
+c1:     rts
@@ -0,0 +1,132 @@
+; Decimal mode ADC and SBC of every pair of valid BCD operands with the carry
+; clear and set, checked against results worked out in binary, run by
+; `make test` (see romtest.c). A wrong result or carry traps at its check;
+; reaching `success` means every one matched. Like the NMOS 6502, only A and
+; C are defined in decimal mode, so the other flags are not checked.
+
+FC = $01
+
+n1 = $00        ; operands in binary, 0 to 99
+n2 = $01
+d1 = $02        ; the same in BCD
+d2 = $03
+cin = $04       ; carry in, 0 or 1
+expect = $05    ; expected BCD result
+ecarry = $06    ; expected carry
+bcd = $0300     ; BCD of 0 to 99
+
+        *= $0400
+start:  cld
+        ldx #$FF
+        txs
+
+; the BCD table, counted in binary skipping $xA to $xF
+        ldx #0
+        lda #0
+mk:     sta bcd,x
+        clc
+        adc #1
+        tay
+        and #$0F
+        cmp #$0A
+        bne @next
+        tya
+        clc
+        adc #$06
+        tay
+@next:  tya
+        inx
+        cpx #100
+        bne mk
+
+        lda #0
+        sta n1
+l1:     lda #0
+        sta n2
+l2:     lda #0
+        sta cin
+l3:     ldx n1
+        lda bcd,x
+        sta d1
+        ldx n2
+        lda bcd,x
+        sta d2
+        jsr test_adc
+        jsr test_sbc
+        inc cin
+        lda cin
+        cmp #2
+        bne l3
+        inc n2
+        lda n2
+        cmp #100
+        bne l2
+        inc n1
+        lda n1
+        cmp #100
+        bne l1
+
+success:
+        jmp success
+
+; n1 + n2 + cin
+test_adc:
+        lda cin
+        lsr
+        lda n1
+        adc n2
+        ldy #0
+        cmp #100
+        bcc @fits
+        sbc #100        ; carry is set by the compare
+        ldy #1
+@fits:  tax
+        lda bcd,x
+        sta expect
+        sty ecarry
+        lda cin
+        lsr
+        lda d1
+        sed
+        adc d2
+        cld
+        php
+        cmp expect
+        bne *
+        pla
+        and #FC
+        cmp ecarry
+        bne *
+        rts
+
+; n1 - n2 - (1 - cin)
+test_sbc:
+        lda cin
+        lsr
+        lda n1
+        sbc n2
+        ldy #1
+        bcs @fits
+        adc #100        ; carry is clear, and the borrow wrapped past 0
+        ldy #0
+@fits:  tax
+        lda bcd,x
+        sta expect
+        sty ecarry
+        lda cin
+        lsr
+        lda d1
+        sed
+        sbc d2
+        cld
+        php
+        cmp expect
+        bne *
+        pla
+        and #FC
+        cmp ecarry
+        bne *
+        rts
+
+        *= $FFFC
+        .word start
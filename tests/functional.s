@@ -0,0 +1,1193 @@
+; Functional test of the instruction set, run by `make test` (see romtest.c).
+;
+; Every check branches or jumps to itself when it fails, so the address the
+; emulator traps at identifies the failing check. Reaching `success` means
+; every check passed. All 151 documented opcodes run, each memory mode of the
+; ALU instructions, shifts, INC and DEC included. Decimal mode is covered by
+; decimal.s and clark_decimal.s.
+
+; status register bits
+FN = $80
+FV = $40
+FL = $30        ; B and the unused bit, always set in SR pushed by PHP
+FD = $08
+FI = $04
+FZ = $02
+FC = $01
+
+zp = $10        ; scratch bytes in the zero page
+vec = $20       ; a pointer
+opnd = $30      ; the operand of the checks that try every mode
+ptr = $40       ; two pointers, to absm and to absm-$30
+buf = $0200     ; scratch page
+absm = buf+$30  ; the copy of opnd in the scratch page
+
+        *= $0400
+start:  cld
+        ldx #$FF
+        txs
+        lda #0
+        pha
+        plp             ; every flag clear
+
+; loads set N and Z
+        lda #$80
+        php
+        pla
+        cmp #FL|FN
+        bne *
+        clc             ; the compare set C
+        ldx #0
+        php
+        pla
+        cmp #FL|FZ
+        bne *
+        clc
+        ldy #$7F
+        php
+        pla
+        cmp #FL
+        bne *
+
+; increments, decrements and transfers
+        ldx #$41
+        inx
+        cpx #$42
+        bne *
+        dex
+        dex
+        cpx #$40
+        bne *
+        ldy #$FF
+        iny
+        bne *
+        dey
+        cpy #$FF
+        bne *
+        lda #$55
+        tax
+        tay
+        cpx #$55
+        bne *
+        cpy #$55
+        bne *
+        ldx #$AA
+        txa
+        cmp #$AA
+        bne *
+        ldy #$11
+        tya
+        cmp #$11
+        bne *
+        tsx
+        cpx #$FF
+        bne *
+
+; addressing modes
+        lda #$11
+        sta zp
+        lda #0
+        lda zp
+        cmp #$11
+        bne *
+        ldx #$F3
+        lda #$22
+        sta zp+$0F,x    ; wraps around to $12
+        lda zp+2
+        cmp #$22
+        bne *
+        lda #0
+        lda zp+$0F,x
+        cmp #$22
+        bne *
+        lda #$33
+        sta buf
+        ldx #$10
+        lda #$44
+        sta buf+$F8,x   ; crosses into the next page
+        lda buf+$108
+        cmp #$44
+        bne *
+        lda #0
+        lda buf+$F8,x
+        cmp #$44
+        bne *
+        ldy #$20
+        lda #$55
+        sta buf+$F0,y
+        lda buf+$110
+        cmp #$55
+        bne *
+        ldx buf+$F0,y
+        cpx #$55
+        bne *
+        ldy #$F4
+        ldx #$66
+        stx zp+$0C,y    ; wraps around to zp
+        ldx #0
+        ldx zp+$0C,y
+        cpx #$66
+        bne *
+        lda zp
+        cmp #$66
+        bne *
+        ldx #$F8
+        ldy #$77
+        sty zp+$0C,x    ; wraps around to $14
+        lda zp+4
+        cmp #$77
+        bne *
+        ldy #0
+        ldy zp+$0C,x
+        cpy #$77
+        bne *
+
+; (zp,X) with the pointer wrapping around the zero page, (zp),Y crossing a page
+        lda #<[buf+$40]
+        sta $FF
+        lda #>[buf+$40]
+        sta $00
+        lda #$88
+        sta buf+$40
+        ldx #$FF
+        lda #0
+        lda ($00,x)
+        cmp #$88
+        bne *
+        lda #$99
+        ldx #$FF
+        sta ($00,x)
+        lda #$F0
+        sta vec
+        lda #>buf
+        sta vec+1
+        ldy #$20
+        lda #$AA
+        sta (vec),y
+        lda buf+$110
+        cmp #$AA
+        bne *
+        lda #0
+        lda (vec),y
+        cmp #$AA
+        bne *
+        lda buf+$40
+        cmp #$99
+        bne *
+
+; binary ADC and SBC
+        clc
+        lda #$50
+        adc #$50
+        php
+        cmp #$A0
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$FF
+        adc #$00
+        php
+        cmp #$00
+        bne *
+        pla
+        cmp #FL|FZ|FC
+        bne *
+        clc
+        lda #$D0
+        adc #$90
+        php
+        cmp #$60
+        bne *
+        pla
+        cmp #FL|FV|FC
+        bne *
+        sec
+        lda #$50
+        sbc #$F0
+        php
+        cmp #$60
+        bne *
+        pla
+        cmp #FL
+        bne *
+        sec
+        lda #$50
+        sbc #$B0
+        php
+        cmp #$A0
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$D0
+        sbc #$70
+        php
+        cmp #$60
+        bne *
+        pla
+        cmp #FL|FV|FC
+        bne *
+        clc
+        lda #$05
+        sbc #$03        ; borrows the clear carry
+        cmp #$01
+        bne *
+
+; logic
+        lda #$F0
+        and #$3C
+        cmp #$30
+        bne *
+        ora #$03
+        cmp #$33
+        bne *
+        eor #$FF
+        cmp #$CC
+        bne *
+        lda #$0F
+        and #$F0
+        bne *
+
+; compares
+        lda #$40
+        cmp #$40
+        php
+        pla
+        cmp #FL|FZ|FC
+        bne *
+        lda #$40
+        cmp #$41
+        php
+        pla
+        cmp #FL|FN
+        bne *
+        ldx #$80
+        cpx #$01
+        php
+        pla
+        cmp #FL|FC
+        bne *
+        ldy #$00
+        cpy #$01
+        php
+        pla
+        cmp #FL|FN
+        bne *
+        lda #$41
+        jsr setm
+        ldx #$40
+        cpx opnd
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        ldx #$41
+        cpx absm
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FZ|FC
+        bne *
+        ldy #$42
+        cpy opnd
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        ldy #$00
+        cpy absm
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+
+; the ALU instructions in every memory mode, with X = 2 and Y = $30 so all
+; of them read the operand at opnd or at absm
+        lda #<absm
+        sta ptr
+        lda #>absm
+        sta ptr+1
+        lda #<[absm-$30]
+        sta ptr+2
+        lda #>[absm-$30]
+        sta ptr+3
+        ldx #2
+        ldy #$30
+        lda #$A0
+        jsr setm
+        lda #$0F
+        ora opnd
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$0F
+        ora opnd-2,x
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$0F
+        ora absm
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$0F
+        ora absm-2,x
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$0F
+        ora absm-$30,y
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$0F
+        ora (ptr-2,x)
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$0F
+        ora (ptr+2),y
+        php
+        cmp #$AF
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$8F
+        jsr setm
+        lda #$F3
+        and opnd
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$F3
+        and opnd-2,x
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$F3
+        and absm
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$F3
+        and absm-2,x
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$F3
+        and absm-$30,y
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$F3
+        and (ptr-2,x)
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$F3
+        and (ptr+2),y
+        php
+        cmp #$83
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$5A
+        jsr setm
+        lda #$5A
+        eor opnd
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$5A
+        eor opnd-2,x
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$5A
+        eor absm
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$5A
+        eor absm-2,x
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$5A
+        eor absm-$30,y
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$5A
+        eor (ptr-2,x)
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$5A
+        eor (ptr+2),y
+        php
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        lda #$2F
+        jsr setm
+        sec
+        lda #$50
+        adc opnd
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$50
+        adc opnd-2,x
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$50
+        adc absm
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$50
+        adc absm-2,x
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$50
+        adc absm-$30,y
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$50
+        adc (ptr-2,x)
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        sec
+        lda #$50
+        adc (ptr+2),y
+        php
+        cmp #$80
+        bne *
+        pla
+        cmp #FL|FN|FV
+        bne *
+        lda #$30
+        jsr setm
+        clc
+        lda #$50
+        sbc opnd
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        clc
+        lda #$50
+        sbc opnd-2,x
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        clc
+        lda #$50
+        sbc absm
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        clc
+        lda #$50
+        sbc absm-2,x
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        clc
+        lda #$50
+        sbc absm-$30,y
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        clc
+        lda #$50
+        sbc (ptr-2,x)
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        clc
+        lda #$50
+        sbc (ptr+2),y
+        php
+        cmp #$1F
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        lda #$41
+        jsr setm
+        lda #$40
+        cmp opnd
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        lda #$40
+        cmp opnd-2,x
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        lda #$40
+        cmp absm
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        lda #$40
+        cmp absm-2,x
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        lda #$40
+        cmp absm-$30,y
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        lda #$40
+        cmp (ptr-2,x)
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        lda #$40
+        cmp (ptr+2),y
+        php
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+
+; shifts and rotates
+        lda #$01
+        lsr
+        php
+        cmp #$00
+        bne *
+        pla
+        cmp #FL|FZ|FC
+        bne *
+        clc
+        lda #$81
+        asl a
+        php
+        cmp #$02
+        bne *
+        pla
+        cmp #FL|FC
+        bne *
+        sec
+        lda #$40
+        rol
+        php
+        cmp #$81
+        bne *
+        pla
+        cmp #FL|FN
+        bne *
+        sec
+        lda #$02
+        ror
+        php
+        cmp #$81
+        bne *
+        pla
+        cmp #FL|FN
+        bne *
+        lda #$C0
+        sta zp
+        asl zp
+        lda zp
+        cmp #$80
+        bne *
+        ldx #1
+        lda #$03
+        sta zp+1
+        lsr zp,x
+        lda zp+1
+        cmp #$01
+        bne *
+        clc
+        rol buf
+        lda buf
+        cmp #$66
+        bne *
+        sec
+        ldx #$10
+        ror buf+$F8,x
+        lda buf+$108
+        cmp #$A2
+        bne *
+        ldx #2
+        lda #$C1
+        jsr setm
+        asl opnd
+        php
+        lda opnd
+        cmp #$82
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FN|FC
+        bne *
+        asl opnd-2,x
+        php
+        lda opnd
+        cmp #$04
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        asl absm
+        php
+        lda absm
+        cmp #$82
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FN|FC
+        bne *
+        asl absm-2,x
+        php
+        lda absm
+        cmp #$04
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        lda #$03
+        jsr setm
+        lsr opnd
+        php
+        lda opnd
+        cmp #$01
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        lsr opnd-2,x
+        php
+        lda opnd
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FZ|FC
+        bne *
+        lsr absm
+        php
+        lda absm
+        cmp #$01
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        lsr absm-2,x
+        php
+        lda absm
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FZ|FC
+        bne *
+        lda #$80
+        jsr setm
+        sec
+        rol opnd
+        php
+        lda opnd
+        cmp #$01
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        clc
+        rol opnd-2,x
+        php
+        lda opnd
+        cmp #$02
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #0
+        bne *
+        sec
+        rol absm
+        php
+        lda absm
+        cmp #$01
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FC
+        bne *
+        clc
+        rol absm-2,x
+        php
+        lda absm
+        cmp #$02
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #0
+        bne *
+        lda #$01
+        jsr setm
+        clc
+        ror opnd
+        php
+        lda opnd
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FZ|FC
+        bne *
+        sec
+        ror opnd-2,x
+        php
+        lda opnd
+        cmp #$80
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+        clc
+        ror absm
+        php
+        lda absm
+        cmp #$00
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FZ|FC
+        bne *
+        sec
+        ror absm-2,x
+        php
+        lda absm
+        cmp #$80
+        bne *
+        pla
+        and #FN|FZ|FC
+        cmp #FN
+        bne *
+
+; INC and DEC
+        lda #$FF
+        sta zp
+        inc zp
+        bne *
+        dec zp
+        lda zp
+        cmp #$FF
+        bne *
+        ldx #$10
+        inc buf+$F8,x
+        lda buf+$108
+        cmp #$A3
+        bne *
+        dec buf
+        lda buf
+        cmp #$65
+        bne *
+        lda #$7F
+        jsr setm
+        ldx #2
+        inc opnd-2,x
+        php
+        lda opnd
+        cmp #$80
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        inc absm
+        php
+        lda absm
+        cmp #$80
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #$01
+        jsr setm
+        dec opnd-2,x
+        php
+        lda opnd
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+        dec absm-2,x
+        php
+        lda absm
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FZ
+        bne *
+
+; the remaining modes of the index register loads and stores, and LDA abs,Y
+        ldx #$C3
+        stx opnd
+        stx absm+1
+        ldy #$3C
+        sty absm
+        sty opnd+1
+        ldx #0
+        ldx absm
+        cpx #$3C
+        bne *
+        ldx opnd+1
+        cpx #$3C
+        bne *
+        ldy #0
+        ldy opnd
+        php
+        cpy #$C3
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        ldy absm+1
+        cpy #$C3
+        bne *
+        ldx #1
+        ldy absm-1,x
+        cpy #$3C
+        bne *
+        ldy #$31
+        lda absm-$30,y
+        cmp #$C3
+        bne *
+
+; BIT leaves C alone
+        lda #$C0
+        sta zp
+        sec
+        lda #$01
+        bit zp
+        php
+        pla
+        cmp #FL|FN|FV|FZ|FC
+        bne *
+        lda #$3F
+        sta buf
+        clc
+        lda #$01
+        bit buf
+        php
+        pla
+        cmp #FL
+        bne *
+
+; branches taken and not taken
+        lda #0
+        pha
+        plp
+        bcs *
+        beq *
+        bmi *
+        bvs *
+        bcc b1
+        jmp *
+b1:     bne b2
+        jmp *
+b2:     bpl b3
+        jmp *
+b3:     bvc b4
+        jmp *
+b4:     lda #$FF
+        pha
+        plp
+        bcc *
+        bne *
+        bpl *
+        bvc *
+        bcs b5
+        jmp *
+b5:     beq b6
+        jmp *
+b6:     bmi b7
+        jmp *
+b7:     bvs b8
+        jmp *
+b8:     cld
+        cli
+        ldx #3
+b9:     dex
+        bne b9
+        cpx #0
+        bne *
+
+; the stack
+        jsr sub
+ret:    tsx
+        cpx #$FF
+        bne *
+        cmp #$5A
+        bne *
+        lda #$CC
+        pha
+        lda #0
+        pla
+        php
+        cmp #$CC
+        bne *
+        pla
+        and #FN|FZ
+        cmp #FN
+        bne *
+        lda #FN|FV|FD|FI|FZ|FC
+        pha
+        plp
+        php
+        pla
+        cmp #FL|FN|FV|FD|FI|FZ|FC
+        bne *
+        lda #0
+        pha
+        plp
+
+; the flag instructions and NOP
+        lda #0
+        pha
+        plp
+        sei
+        sed
+        nop
+        php
+        pla
+        cmp #FL|FD|FI
+        bne *
+        cli
+        cld
+        lda #$7F
+        adc #$01        ; overflows
+        clv
+        php
+        pla
+        cmp #FL|FN
+        bne *
+
+; JMP and JMP (ind)
+        jmp j0
+        jmp *
+j0:
+        lda #<j1
+        sta buf+$80
+        lda #>j1
+        sta buf+$81
+        jmp (buf+$80)
+        jmp *
+j1:
+
+; BRK and RTI
+        lda #0
+        sta zp
+        pha
+        plp
+        brk
+        .byte $EA       ; skipped
+brk_ret:
+        lda zp
+        cmp #1
+        bne *
+        php             ; RTI restored I
+        pla
+        and #FI
+        bne *
+
+success:
+        jmp success
+
+sub:    tsx
+        cpx #$FD
+        bne *
+        lda $01FF       ; the return address minus one
+        cmp #>[ret-1]
+        bne *
+        lda $01FE
+        cmp #<[ret-1]
+        bne *
+        lda #$5A
+        rts
+
+; Stores A at opnd and absm
+setm:   sta opnd
+        sta absm
+        rts
+
+irq:    tsx
+        lda $0101,x     ; the pushed status has B set
+        and #FL
+        cmp #FL
+        bne *
+        lda $0102,x     ; and the return address skips the padding byte
+        cmp #<brk_ret
+        bne *
+        lda $0103,x
+        cmp #>brk_ret
+        bne *
+        php             ; interrupts are disabled in the handler
+        pla
+        and #FI
+        beq *
+        inc zp
+        rti
+
+unexpected:
+        jmp unexpected
+
+        *= $FFFA
+        .word unexpected, start, irq